@@ -0,0 +1,262 @@
+#include "avi_adpcm.h"
+
+#include <string.h>
+
+#define WAVE_FORMAT_ADPCM 2
+#define WAVE_FORMAT_DVI_ADPCM 0x11
+
+static const int16_t avi_adpcm_ms_default_coef1[7] = { 256, 512, 0, 192, 240, 460, 392 };
+static const int16_t avi_adpcm_ms_default_coef2[7] = { 0, -256, 0, 64, 0, -208, -232 };
+static const int16_t avi_adpcm_ms_adaptation[16] = { 230, 230, 230, 230, 307, 409, 512, 614, 768, 614, 512, 409, 307, 230, 230, 230 };
+
+static const int16_t avi_adpcm_ima_steps[89] =
+{
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31,
+	34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+	157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+	724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
+	3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+static const int8_t avi_adpcm_ima_index_adjust[16] = { -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8 };
+
+AVI_STATIC_FUNC int16_t avi_adpcm_read_s16(const uint8_t *p)
+{
+	return (int16_t)(p[0] | (p[1] << 8));
+}
+
+AVI_STATIC_FUNC int16_t avi_adpcm_clamp(int32_t v)
+{
+	if (v > 32767) return 32767;
+	if (v < -32768) return -32768;
+	return (int16_t)v;
+}
+
+AVI_FUNC int avi_is_stream_ADPCM(avi_stream_reader *s)
+{
+	avi_stream_info *si;
+	if (!s) return 0;
+	si = s->stream_info;
+	if (!si) return 0;
+	if (!si->format_data_is_valid) return 0;
+	if (!avi_stream_is_audio(si)) return 0;
+	switch (si->audio_format.wFormatTag)
+	{
+	case WAVE_FORMAT_ADPCM:
+	case WAVE_FORMAT_DVI_ADPCM:
+		return si->audio_format.wBitsPerSample == 4;
+	default:
+		return 0;
+	}
+}
+
+// Read `wSamplesPerBlock`, `wNumCoef` and `aCoef` after `wave_format_ex` in the stream format.
+AVI_STATIC_FUNC int avi_adpcm_read_ms_coefs(avi_adpcm_decoder *d, avi_stream_reader *s)
+{
+	avi_stream_info *si = s->stream_info;
+	uint8_t extra[4 + AVI_ADPCM_MAX_COEFS * 4];
+	fsize_t len = si->audio_format.cbSize;
+	fssize_t rl;
+	uint32_t num_coefs;
+
+	if (si->stream_format_len < 18) len = 0;
+	else if (len > si->stream_format_len - 18) len = si->stream_format_len - 18;
+	if (len < 4)
+	{
+		// No coefficients in the format, use the standard ones.
+		d->num_coefs = 7;
+		memcpy(d->coef1, avi_adpcm_ms_default_coef1, sizeof avi_adpcm_ms_default_coef1);
+		memcpy(d->coef2, avi_adpcm_ms_default_coef2, sizeof avi_adpcm_ms_default_coef2);
+		return 1;
+	}
+	if (len > sizeof extra) len = sizeof extra;
+	rl = avi_stream_reader_read_at(s, si->stream_format_offset + 18, extra, len, AVI_IO_HEADER);
+	if (rl < 0 || (fsize_t)rl != len) return 0;
+
+	if (avi_adpcm_read_s16(&extra[0]) > 0) d->samples_per_block = (uint16_t)avi_adpcm_read_s16(&extra[0]);
+	num_coefs = (uint16_t)avi_adpcm_read_s16(&extra[2]);
+	if (!num_coefs || num_coefs > AVI_ADPCM_MAX_COEFS || 4 + num_coefs * 4 > len) return 0;
+	d->num_coefs = num_coefs;
+	for (uint32_t i = 0; i < num_coefs; i++)
+	{
+		d->coef1[i] = avi_adpcm_read_s16(&extra[4 + i * 4]);
+		d->coef2[i] = avi_adpcm_read_s16(&extra[6 + i * 4]);
+	}
+	return 1;
+}
+
+AVI_FUNC int avi_adpcm_init(avi_adpcm_decoder *d, avi_stream_reader *s)
+{
+	wave_format_ex *wf;
+	if (!d || !s) return 0;
+	if (!avi_is_stream_ADPCM(s)) return 0;
+
+	wf = &s->stream_info->audio_format;
+	memset(d, 0, sizeof *d);
+	d->is_ima = wf->wFormatTag == WAVE_FORMAT_DVI_ADPCM;
+	d->channels = wf->nChannels;
+	d->block_align = wf->nBlockAlign;
+	if (!d->channels || d->channels > AVI_ADPCM_MAX_CHANNELS) return 0;
+
+	if (d->is_ima)
+	{
+		// 4 bytes of header and groups of 4 bytes for each channel
+		if (d->block_align < 8 * d->channels || d->block_align % (4 * d->channels)) return 0;
+		d->samples_per_block = (d->block_align - 4 * d->channels) * 2 / d->channels + 1;
+		return 1;
+	}
+
+	// 7 bytes of header for each channel
+	if (d->block_align < 7 * d->channels) return 0;
+	d->samples_per_block = (d->block_align - 7 * d->channels) * 2 / d->channels + 2;
+	if (!avi_adpcm_read_ms_coefs(d, s)) return 0;
+	if (d->samples_per_block > (d->block_align - 7 * d->channels) * 2 / d->channels + 2) return 0;
+	return 1;
+}
+
+// Get the number of frames of a block, the last block of a packet could be short.
+AVI_STATIC_FUNC uint32_t avi_adpcm_get_block_frames(const avi_adpcm_decoder *d, size_t block_len)
+{
+	if (d->is_ima)
+	{
+		if (block_len < 4 * d->channels) return 0;
+		return (uint32_t)((block_len - 4 * d->channels) / (4 * d->channels)) * 8 + 1;
+	}
+	if (block_len < 7 * d->channels) return 0;
+	if (block_len == d->block_align) return d->samples_per_block;
+	return (uint32_t)((block_len - 7 * d->channels) * 2 / d->channels) + 2;
+}
+
+AVI_FUNC uint32_t avi_adpcm_get_num_frames(const avi_adpcm_decoder *d, size_t packet_len)
+{
+	size_t num_blocks;
+	if (!d || !d->block_align) return 0;
+	num_blocks = packet_len / d->block_align;
+	return (uint32_t)(num_blocks * d->samples_per_block) + avi_adpcm_get_block_frames(d, packet_len % d->block_align);
+}
+
+// The channels are decoded together, the nibbles of the channels are interleaved in the block.
+AVI_STATIC_FUNC uint32_t avi_adpcm_decode_ms_block(const avi_adpcm_decoder *d, const uint8_t *block, size_t len, int16_t *pcm, uint32_t num_frames)
+{
+	uint32_t ch = d->channels;
+	int32_t coef1[AVI_ADPCM_MAX_CHANNELS], coef2[AVI_ADPCM_MAX_CHANNELS], delta[AVI_ADPCM_MAX_CHANNELS];
+	int32_t s1[AVI_ADPCM_MAX_CHANNELS], s2[AVI_ADPCM_MAX_CHANNELS];
+	const uint8_t *p = block;
+	uint32_t num_nibbles;
+
+	for (uint32_t c = 0; c < ch; c++)
+	{
+		uint8_t predictor = p[c];
+		if (predictor >= d->num_coefs) return 0;
+		coef1[c] = d->coef1[predictor];
+		coef2[c] = d->coef2[predictor];
+		delta[c] = avi_adpcm_read_s16(&p[ch + c * 2]);
+		s1[c] = avi_adpcm_read_s16(&p[ch * 3 + c * 2]);
+		s2[c] = avi_adpcm_read_s16(&p[ch * 5 + c * 2]);
+	}
+	p += ch * 7;
+
+	// The header has the first 2 samples, the older one first.
+	for (uint32_t c = 0; c < ch; c++)
+	{
+		pcm[c] = (int16_t)s2[c];
+		if (num_frames > 1) pcm[ch + c] = (int16_t)s1[c];
+	}
+	if (num_frames <= 2) return num_frames;
+	pcm += ch * 2;
+
+	num_nibbles = (num_frames - 2) * ch;
+	if ((num_nibbles + 1) / 2 > len - ch * 7) return 0;
+	for (uint32_t i = 0; i < num_nibbles; i++)
+	{
+		uint32_t c = i % ch;
+		uint32_t nibble = (i & 1) ? (p[i >> 1] & 0x0F) : (p[i >> 1] >> 4);
+		int32_t signed_nibble = (nibble & 8) ? (int32_t)nibble - 16 : (int32_t)nibble;
+		int32_t predicted = ((s1[c] * coef1[c]) + (s2[c] * coef2[c])) >> 8;
+		int16_t sample = avi_adpcm_clamp(predicted + signed_nibble * delta[c]);
+		s2[c] = s1[c];
+		s1[c] = sample;
+		delta[c] = (avi_adpcm_ms_adaptation[nibble] * delta[c]) >> 8;
+		if (delta[c] < 16) delta[c] = 16;
+		pcm[i] = sample;
+	}
+	return num_frames;
+}
+
+AVI_STATIC_FUNC uint32_t avi_adpcm_decode_ima_block(const avi_adpcm_decoder *d, const uint8_t *block, size_t len, int16_t *pcm, uint32_t num_frames)
+{
+	uint32_t ch = d->channels;
+	int32_t predictor[AVI_ADPCM_MAX_CHANNELS], index[AVI_ADPCM_MAX_CHANNELS];
+	const uint8_t *p = block;
+	uint32_t num_groups = (num_frames - 1) / 8;
+
+	for (uint32_t c = 0; c < ch; c++)
+	{
+		predictor[c] = avi_adpcm_read_s16(&p[c * 4]);
+		index[c] = p[c * 4 + 2];
+		if (index[c] > 88) return 0;
+		pcm[c] = (int16_t)predictor[c];
+	}
+	p += ch * 4;
+	pcm += ch;
+	if ((size_t)num_groups * 4 * ch > len - ch * 4) return 0;
+
+	// Each group has 4 bytes of each channel, 8 samples of the channel, the low nibble first.
+	for (uint32_t g = 0; g < num_groups; g++)
+	{
+		for (uint32_t c = 0; c < ch; c++)
+		{
+			for (uint32_t i = 0; i < 8; i++)
+			{
+				uint32_t nibble = (i & 1) ? (p[i >> 1] >> 4) : (p[i >> 1] & 0x0F);
+				int32_t step = avi_adpcm_ima_steps[index[c]];
+				int32_t diff = step >> 3;
+				if (nibble & 1) diff += step >> 2;
+				if (nibble & 2) diff += step >> 1;
+				if (nibble & 4) diff += step;
+				predictor[c] = avi_adpcm_clamp((nibble & 8) ? predictor[c] - diff : predictor[c] + diff);
+				index[c] += avi_adpcm_ima_index_adjust[nibble];
+				if (index[c] < 0) index[c] = 0;
+				if (index[c] > 88) index[c] = 88;
+				pcm[i * ch + c] = (int16_t)predictor[c];
+			}
+			p += 4;
+		}
+		pcm += 8 * ch;
+	}
+	return num_groups * 8 + 1;
+}
+
+AVI_FUNC uint32_t avi_adpcm_decode(const avi_adpcm_decoder *d, const void *packet, size_t len, int16_t *pcm, uint32_t max_frames)
+{
+	const uint8_t *p = packet;
+	uint32_t done = 0;
+	if (!d || !d->block_align || !pcm || (!p && len)) return 0;
+	if (avi_adpcm_get_num_frames(d, len) > max_frames) return 0;
+
+	while (len)
+	{
+		size_t block_len = len < d->block_align ? len : d->block_align;
+		uint32_t num_frames = avi_adpcm_get_block_frames(d, block_len);
+		uint32_t decoded;
+		if (!num_frames) break;
+		if (d->is_ima)
+			decoded = avi_adpcm_decode_ima_block(d, p, block_len, &pcm[(size_t)done * d->channels], num_frames);
+		else
+			decoded = avi_adpcm_decode_ms_block(d, p, block_len, &pcm[(size_t)done * d->channels], num_frames);
+		if (!decoded) return 0;
+		done += decoded;
+		p += block_len;
+		len -= block_len;
+	}
+	return done;
+}
+
+AVI_FUNC int avi_adpcm_pipeline_work(const void *packet_data, fsize_t packet_len, fsize_t stream_packet_index, void *result, void *userdata)
+{
+	avi_adpcm_result *res = result;
+	(void)stream_packet_index;
+	if (!res || !userdata) return 0;
+	res->num_frames = avi_adpcm_decode(userdata, packet_data, (size_t)packet_len, res->pcm, res->max_frames);
+	return res->num_frames != 0;
+}
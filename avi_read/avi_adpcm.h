@@ -0,0 +1,85 @@
+#ifndef _AVI_ADPCM_H_
+#define _AVI_ADPCM_H_ 1
+
+#include "avi_reader.h"
+
+#ifndef AVI_ADPCM_MAX_CHANNELS
+#define AVI_ADPCM_MAX_CHANNELS 8
+#endif
+
+#ifndef AVI_ADPCM_MAX_COEFS
+#define AVI_ADPCM_MAX_COEFS 32
+#endif
+
+/// <summary>
+/// Decodes the MS ADPCM (`wFormatTag == 2`) and IMA ADPCM (`wFormatTag == 0x11`) audio streams to interleaved 16-bit PCM.
+/// Every block starts with the decoder state of each channel, so the blocks are decoded independently,
+/// and the packets could be decoded concurrently, e.g. by `avi_pipeline` with `avi_adpcm_pipeline_work()`.
+/// </summary>
+typedef struct
+{
+	int is_ima;
+	uint32_t channels;
+	uint32_t block_align;
+	uint32_t samples_per_block;
+
+	/// The MS ADPCM predictor coefficients from the stream format
+	uint32_t num_coefs;
+	int16_t coef1[AVI_ADPCM_MAX_COEFS];
+	int16_t coef2[AVI_ADPCM_MAX_COEFS];
+}avi_adpcm_decoder;
+
+/// <summary>
+/// The result buffer for `avi_adpcm_pipeline_work()`, set it as the `result` of your `avi_pipeline_slot`.
+/// </summary>
+typedef struct
+{
+	/// Your buffer for the interleaved 16-bit PCM samples
+	int16_t *pcm;
+	uint32_t max_frames;
+
+	/// Number of frames decoded
+	uint32_t num_frames;
+}avi_adpcm_result;
+
+/// <summary>
+/// Check if the audio stream is MS ADPCM or IMA ADPCM.
+/// </summary>
+/// <param name="s">Your stream reader, must be an audio stream, otherwise the returned value is invalid.</param>
+/// <returns>Non-zero if true</returns>
+AVI_FUNC int avi_is_stream_ADPCM(avi_stream_reader *s);
+
+/// <summary>
+/// Initialize the decoder by the stream format. The MS ADPCM coefficients are read from the stream format in the file.
+/// </summary>
+/// <param name="d">Your `avi_adpcm_decoder` to be initialized</param>
+/// <param name="s">Your stream reader of an ADPCM audio stream</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_adpcm_init(avi_adpcm_decoder *d, avi_stream_reader *s);
+
+/// <summary>
+/// Get the number of frames of a packet, to size your PCM buffer.
+/// </summary>
+/// <param name="d">Your `avi_adpcm_decoder`</param>
+/// <param name="packet_len">The length of the packet</param>
+/// <returns>Number of frames, a frame has one sample of each channel.</returns>
+AVI_FUNC uint32_t avi_adpcm_get_num_frames(const avi_adpcm_decoder *d, size_t packet_len);
+
+/// <summary>
+/// Decode the blocks of a packet, the last block could be shorter than `block_align`.
+/// </summary>
+/// <param name="d">Your `avi_adpcm_decoder`</param>
+/// <param name="packet">The packet data, e.g. read by `avi_stream_reader_read_packet()`</param>
+/// <param name="len">The length of the packet</param>
+/// <param name="pcm">Your buffer for the interleaved 16-bit PCM samples</param>
+/// <param name="max_frames">The capacity of `pcm` in frames, see `avi_adpcm_get_num_frames()`</param>
+/// <returns>Number of frames decoded, 0 for fail.</returns>
+AVI_FUNC uint32_t avi_adpcm_decode(const avi_adpcm_decoder *d, const void *packet, size_t len, int16_t *pcm, uint32_t max_frames);
+
+/// <summary>
+/// An `avi_pipeline_work_cb` to decode the packets by your workers. Pass your `avi_adpcm_decoder` as the userdata of the pipeline,
+/// and an `avi_adpcm_result` as the result of each slot, so the slots are the pool of your PCM buffers.
+/// </summary>
+AVI_FUNC int avi_adpcm_pipeline_work(const void *packet_data, fsize_t packet_len, fsize_t stream_packet_index, void *result, void *userdata);
+
+#endif
@@ -0,0 +1,127 @@
+#include "avi_concat.h"
+
+#include <string.h>
+
+AVI_FUNC int avi_concat_init
+(
+	avi_concat *c,
+	avi_writer *w,
+	avi_stdindex_entry *stdindex_buffer,
+	uint32_t stdindex_capacity,
+	void *copy_buffer,
+	size_t copy_buffer_size
+)
+{
+	if (!c || !w) return 0;
+	if (!stdindex_buffer || !stdindex_capacity) return 0;
+	if (!copy_buffer || !copy_buffer_size) return 0;
+
+	memset(c, 0, sizeof *c);
+	c->w = w;
+	c->stdindex_buffer = stdindex_buffer;
+	c->stdindex_capacity = stdindex_capacity;
+	c->copy_buffer = copy_buffer;
+	c->copy_buffer_size = copy_buffer_size;
+	return 1;
+}
+
+AVI_STATIC_FUNC int avi_concat_is_stream_compatible(avi_stream_info *a, avi_stream_info *b)
+{
+	avi_stream_header *ha = &a->stream_header;
+	avi_stream_header *hb = &b->stream_header;
+	if (ha->fccType != hb->fccType) return 0;
+	if (ha->fccHandler != hb->fccHandler) return 0;
+	if (ha->dwScale != hb->dwScale) return 0;
+	if (ha->dwRate != hb->dwRate) return 0;
+	if (ha->dwSampleSize != hb->dwSampleSize) return 0;
+	if (a->stream_format_len != b->stream_format_len) return 0;
+	if (a->format_data_is_valid != b->format_data_is_valid) return 0;
+	if (!a->format_data_is_valid) return 1;
+
+	if (avi_stream_is_video(a))
+	{
+		bitmap_info_header *fa = &a->bitmap_format.BMIF;
+		bitmap_info_header *fb = &b->bitmap_format.BMIF;
+		if (fa->biWidth != fb->biWidth) return 0;
+		if (fa->biHeight != fb->biHeight) return 0;
+		if (fa->biBitCount != fb->biBitCount) return 0;
+		if (fa->biCompression != fb->biCompression) return 0;
+
+		// The indexed color frames must share the palette.
+		if (fa->biBitCount && fa->biBitCount <= 8 && (fa->biCompression == BI_RGB || fa->biCompression == BI_RLE8 || fa->biCompression == BI_RLE4))
+		{
+			uint32_t num_colors = fa->biClrUsed ? fa->biClrUsed : (1u << fa->biBitCount);
+			if (num_colors > 256) num_colors = 256;
+			if (memcmp(a->bitmap_format.palette, b->bitmap_format.palette, num_colors * sizeof(rgb_quad))) return 0;
+		}
+	}
+	else if (avi_stream_is_audio(a))
+	{
+		wave_format_ex *fa = &a->audio_format;
+		wave_format_ex *fb = &b->audio_format;
+		if (fa->wFormatTag != fb->wFormatTag) return 0;
+		if (fa->nChannels != fb->nChannels) return 0;
+		if (fa->nSamplesPerSec != fb->nSamplesPerSec) return 0;
+		if (fa->nBlockAlign != fb->nBlockAlign) return 0;
+		if (fa->wBitsPerSample != fb->wBitsPerSample) return 0;
+	}
+	return 1;
+}
+
+/// The codec extra data after the fixed header, e.g. the decoder config, must match too. So the whole `strf` chunk is compared to the one of the first input.
+AVI_STATIC_FUNC int avi_concat_is_stream_format_same(avi_concat *c, avi_reader *r, uint32_t stream_id)
+{
+	avi_stream_info *si = &r->avi_stream_info[stream_id];
+	fsize_t format_len = c->stream_info[stream_id].stream_format_len;
+	uint8_t format[AVI_TRIM_MAX_FORMAT];
+	fssize_t rl;
+	if (si->stream_format_len != format_len) return 0;
+	if (format_len > sizeof format) return 0;
+	if (!format_len) return 1;
+	rl = avi_reader_read_at(r, si->stream_format_offset, format, format_len, AVI_IO_HEADER);
+	if (rl < 0 || (fsize_t)rl != format_len) return 0;
+	return !memcmp(format, c->stream_format[stream_id], format_len);
+}
+
+AVI_FUNC int avi_concat_is_compatible(avi_concat *c, avi_reader *r)
+{
+	if (!c || !r) return 0;
+	if (!c->num_inputs) return 1;
+	if (r->num_streams != c->num_streams) return 0;
+	for (uint32_t i = 0; i < c->num_streams; i++)
+	{
+		if (!avi_concat_is_stream_compatible(&c->stream_info[i], &r->avi_stream_info[i])) return 0;
+		if (!avi_concat_is_stream_format_same(c, r, i)) return 0;
+	}
+	return 1;
+}
+
+AVI_FUNC int avi_concat_add_input(avi_concat *c, avi_reader *r)
+{
+	if (!c || !r) return 0;
+	if (!r->num_streams) return 0;
+	if (!avi_concat_is_compatible(c, r)) return 0;
+
+	if (!c->num_inputs)
+	{
+		c->num_streams = r->num_streams;
+		memcpy(c->stream_info, r->avi_stream_info, sizeof c->stream_info);
+		if (!avi_trim_begin_writer(&c->t, r, c->w, c->stdindex_buffer, c->stdindex_capacity)) return 0;
+		for (uint32_t i = 0; i < c->num_streams; i++)
+		{
+			memcpy(c->stream_format[i], c->t.streams[i].format, c->t.streams[i].format_len);
+		}
+	}
+
+	if (!avi_trim_copy_all_packets(&c->t, r, c->w, c->copy_buffer, c->copy_buffer_size)) return 0;
+	c->num_inputs++;
+	c->num_packets_copied += c->t.num_packets_copied;
+	c->num_bytes_copied += c->t.num_bytes_copied;
+	return 1;
+}
+
+AVI_FUNC int avi_concat_finish(avi_concat *c)
+{
+	if (!c || !c->num_inputs) return 0;
+	return avi_writer_finish(c->w);
+}
@@ -0,0 +1,78 @@
+#ifndef _AVI_CONCAT_H_
+#define _AVI_CONCAT_H_ 1
+
+#include "avi_trim.h"
+
+/// <summary>
+/// Joins AVI files with the same stream formats into one AVI file without decoding the packets.
+/// The inputs are added one by one, so you only need to open one input at a time.
+/// The writer generates one index for the whole output, so the offsets of the packets are rebased on the way.
+/// </summary>
+typedef struct
+{
+	avi_writer *w;
+	avi_trim t;
+
+	avi_stdindex_entry *stdindex_buffer;
+	uint32_t stdindex_capacity;
+	uint8_t *copy_buffer;
+	size_t copy_buffer_size;
+
+	/// The streams of the first input, the other inputs must match them.
+	uint32_t num_streams;
+	avi_stream_info stream_info[AVI_MAX_STREAMS];
+
+	/// The `strf` chunks of the first input, with the codec extra data after the fixed header. The lengths are in `stream_info`.
+	uint8_t stream_format[AVI_MAX_STREAMS][AVI_TRIM_MAX_FORMAT];
+
+	/// Statistics
+	uint32_t num_inputs;
+	uint64_t num_packets_copied;
+	uint64_t num_bytes_copied;
+}avi_concat;
+
+/// <summary>
+/// Initialize the concatenation.
+/// </summary>
+/// <param name="c">Your `avi_concat` to be initialized, it's big, better not to put it on the stack of your embedded device.</param>
+/// <param name="w">Your initialized `avi_writer` of the output AVI file, with no streams added.</param>
+/// <param name="stdindex_buffer">Your buffer for the standard index entries of the writer, shared evenly by the streams.</param>
+/// <param name="stdindex_capacity">Number of entries of `stdindex_buffer`</param>
+/// <param name="copy_buffer">Your buffer to read the packets, bigger is faster.</param>
+/// <param name="copy_buffer_size">The size of `copy_buffer`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_concat_init
+(
+	avi_concat *c,
+	avi_writer *w,
+	avi_stdindex_entry *stdindex_buffer,
+	uint32_t stdindex_capacity,
+	void *copy_buffer,
+	size_t copy_buffer_size
+);
+
+/// <summary>
+/// Check if the input could be joined: the same number of streams, and each stream has the same type, handler, rate, and format.
+/// The whole `strf` chunk of each stream is compared, including the codec extra data after the fixed header.
+/// </summary>
+/// <param name="c">Your `avi_concat`</param>
+/// <param name="r">Your initialized `avi_reader` of the input AVI file</param>
+/// <returns>Nonzero if the input is compatible. The first input is always compatible.</returns>
+AVI_FUNC int avi_concat_is_compatible(avi_concat *c, avi_reader *r);
+
+/// <summary>
+/// Append every packet of the input to the output. The first input decides the streams and the main header of the output.
+/// </summary>
+/// <param name="c">Your `avi_concat`</param>
+/// <param name="r">Your initialized `avi_reader` of the input AVI file</param>
+/// <returns>0 for fail (including the input is not compatible), nonzero for success.</returns>
+AVI_FUNC int avi_concat_add_input(avi_concat *c, avi_reader *r);
+
+/// <summary>
+/// Finish the output AVI file by calling `avi_writer_finish()`.
+/// </summary>
+/// <param name="c">Your `avi_concat`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_concat_finish(avi_concat *c);
+
+#endif
@@ -0,0 +1,216 @@
+#include "avi_export.h"
+
+#include <string.h>
+
+AVI_STATIC_FUNC void avi_export_put_u32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+AVI_FUNC int avi_export_init
+(
+	avi_export *e,
+	avi_stream_reader *s,
+	avi_export_container container,
+	void *userdata,
+	write_cb f_write,
+	copy_range_cb f_copy_range,
+	void *copy_buffer,
+	size_t copy_buffer_size
+)
+{
+	if (!e || !s || !s->stream_info || !f_write) return 0;
+	if (!f_copy_range && (!copy_buffer || !copy_buffer_size)) return 0;
+	if (container == AVI_EXPORT_WAV && !avi_stream_is_audio(s->stream_info)) return 0;
+
+	memset(e, 0, sizeof *e);
+	e->s = s;
+	e->container = container;
+	e->userdata = userdata;
+	e->f_write = f_write;
+	e->f_copy_range = f_copy_range;
+	e->copy_buffer = copy_buffer;
+	e->copy_buffer_size = copy_buffer_size;
+	return 1;
+}
+
+AVI_STATIC_FUNC int avi_export_write(avi_export *e, const void *data, size_t len)
+{
+	return e->f_write(data, len, e->userdata) == (fssize_t)len;
+}
+
+// The `RIFF WAVE` header, the `fmt ` chunk is the stream format from the AVI file.
+AVI_STATIC_FUNC int avi_export_write_wav_header(avi_export *e, uint64_t data_len)
+{
+	avi_stream_reader *s = e->s;
+	avi_stream_info *si = s->stream_info;
+	uint8_t header[12 + 8 + AVI_EXPORT_MAX_FORMAT + 1 + 8];
+	uint32_t format_len = (uint32_t)si->stream_format_len;
+	uint32_t padded_len = (format_len + 1) & ~1u;
+	uint32_t header_len = 12 + 8 + padded_len + 8;
+	uint64_t riff_len = data_len + header_len - 8 + (data_len & 1);
+	fssize_t rl;
+
+	if (format_len < 16 || format_len > AVI_EXPORT_MAX_FORMAT) return 0;
+	rl = avi_stream_reader_read_at(s, si->stream_format_offset, &header[20], format_len, AVI_IO_HEADER);
+	if (rl < 0 || (uint32_t)rl != format_len) return 0;
+	header[20 + format_len] = 0;
+
+	memcpy(&header[0], "RIFF", 4);
+	avi_export_put_u32(&header[4], riff_len > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)riff_len);
+	memcpy(&header[8], "WAVE", 4);
+	memcpy(&header[12], "fmt ", 4);
+	avi_export_put_u32(&header[16], format_len);
+	memcpy(&header[20 + padded_len], "data", 4);
+	avi_export_put_u32(&header[24 + padded_len], data_len > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)data_len);
+	return avi_export_write(e, header, header_len);
+}
+
+AVI_STATIC_FUNC int avi_export_flush(avi_export *e)
+{
+	avi_stream_reader *s = e->s;
+	if (!e->batch_len) return 1;
+
+	if (e->f_copy_range)
+	{
+		for (uint32_t i = 0; i < e->batch_len; i++)
+		{
+			fsize_t offset = e->batch[i].offset;
+			fsize_t len = e->batch[i].len;
+			while (len)
+			{
+				fssize_t copied = e->f_copy_range(offset, len, e->userdata);
+				if (copied <= 0) return 0;
+				offset += (fsize_t)copied;
+				len -= (fsize_t)copied;
+			}
+		}
+	}
+	else
+	{
+		// One big sequential read for the whole span of the batch, with the chunk headers and the packets of the other streams between the runs.
+		// Then the runs are moved together in the buffer to strip the gaps, and written by one call.
+		fsize_t batch_start = e->batch[0].offset;
+		fsize_t batch_len = e->batch[e->batch_len - 1].offset + e->batch[e->batch_len - 1].len - batch_start;
+		size_t out_len = 0;
+		fssize_t rl;
+		rl = avi_stream_reader_read_at(s, batch_start, e->copy_buffer, batch_len, AVI_IO_PAYLOAD);
+		if (rl < 0 || (fsize_t)rl != batch_len) return 0;
+		for (uint32_t i = 0; i < e->batch_len; i++)
+		{
+			size_t pos = (size_t)(e->batch[i].offset - batch_start);
+			if (pos != out_len) memmove(&e->copy_buffer[out_len], &e->copy_buffer[pos], e->batch[i].len);
+			out_len += e->batch[i].len;
+		}
+		if (!avi_export_write(e, e->copy_buffer, out_len)) return 0;
+	}
+	e->num_runs += e->batch_len;
+	e->num_batches++;
+	e->batch_len = 0;
+	return 1;
+}
+
+AVI_STATIC_FUNC int avi_export_add(avi_export *e, fsize_t offset, fsize_t len)
+{
+	while (len)
+	{
+		fsize_t piece = len;
+		if (e->batch_len)
+		{
+			avi_export_run *last = &e->batch[e->batch_len - 1];
+			fsize_t batch_start = e->batch[0].offset;
+			if (e->batch_len == AVI_EXPORT_MAX_BATCH || offset < last->offset + last->len ||
+				(!e->f_copy_range && offset + len - batch_start > e->copy_buffer_size))
+			{
+				if (!avi_export_flush(e)) return 0;
+			}
+		}
+
+		// A payload bigger than the buffer is split.
+		if (!e->f_copy_range && piece > e->copy_buffer_size) piece = (fsize_t)e->copy_buffer_size;
+		e->batch[e->batch_len].offset = offset;
+		e->batch[e->batch_len].len = piece;
+		e->batch_len++;
+		offset += piece;
+		len -= piece;
+	}
+	return 1;
+}
+
+// The size of the `data` chunk of the `WAVE` file, the sum of the payloads of the stream.
+// If the stream reader finds its packets through the `idx1` chunk, the chunk is read in blocks as big as your buffer instead, in one pass.
+// The packet table and the `indx` cache are walked by the stream reader.
+AVI_STATIC_FUNC uint64_t avi_export_get_data_len(avi_export *e)
+{
+	avi_stream_reader *s = e->s;
+	avi_reader *r = s->r;
+	avi_stream_position rewind = { 0 };
+	fsize_t block_entries = (fsize_t)(e->copy_buffer_size / sizeof(avi_index_entry));
+	uint64_t data_len = 0;
+
+	if (!s->packet_table && !s->indx.num_entries && r->idx1_offset && r->num_indices && e->copy_buffer && block_entries)
+	{
+		avi_index_entry *entries = (avi_index_entry *)e->copy_buffer;
+		for (fsize_t first = 0; first < r->num_indices;)
+		{
+			fsize_t num_entries = avi_reader_read_idx1_block(r, first, entries, block_entries);
+			if (!num_entries) break;
+			for (fsize_t i = 0; i < num_entries; i++)
+			{
+				if (avi_get_fourcc_stream_id(entries[i].dwChunkId) == s->stream_id) data_len += entries[i].dwSize;
+			}
+			first += num_entries;
+		}
+		return data_len;
+	}
+
+	avi_stream_reader_set_position(s, &rewind);
+	while (avi_stream_reader_move_to_next_packet(s, 0)) data_len += s->cur_packet_len;
+	return data_len;
+}
+
+AVI_FUNC int avi_export_stream(avi_export *e)
+{
+	avi_stream_reader *s;
+	avi_stream_position saved;
+	avi_stream_position rewind = { 0 };
+	int mute;
+	int ret = 0;
+	if (!e) return 0;
+	s = e->s;
+
+	avi_stream_reader_get_position(s, &saved);
+	mute = s->mute_cur_stream_debug_print;
+	s->mute_cur_stream_debug_print = 1;
+
+	if (e->container == AVI_EXPORT_WAV)
+	{
+		if (!avi_export_write_wav_header(e, avi_export_get_data_len(e))) goto Finish;
+	}
+
+	avi_stream_reader_set_position(s, &rewind);
+	while (avi_stream_reader_move_to_next_packet(s, 0))
+	{
+		if (!s->cur_packet_len) continue;
+		if (!avi_export_add(e, s->cur_packet_offset, s->cur_packet_len)) goto Finish;
+		e->num_packets++;
+		e->num_bytes += s->cur_packet_len;
+	}
+	if (!avi_export_flush(e)) goto Finish;
+
+	// The `data` chunk is padded to an even size.
+	if (e->container == AVI_EXPORT_WAV && (e->num_bytes & 1))
+	{
+		uint8_t pad = 0;
+		if (!avi_export_write(e, &pad, 1)) goto Finish;
+	}
+	ret = 1;
+
+Finish:
+	avi_stream_reader_set_position(s, &saved);
+	s->mute_cur_stream_debug_print = mute;
+	return ret;
+}
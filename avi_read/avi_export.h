@@ -0,0 +1,102 @@
+#ifndef _AVI_EXPORT_H_
+#define _AVI_EXPORT_H_ 1
+
+#include "avi_writer.h"
+
+#ifndef AVI_EXPORT_MAX_BATCH
+#define AVI_EXPORT_MAX_BATCH 256
+#endif
+
+#ifndef AVI_EXPORT_MAX_FORMAT
+#define AVI_EXPORT_MAX_FORMAT 256
+#endif
+
+/// <summary>
+/// Copy bytes of the AVI file to the end of your output without passing them through your buffers, e.g. by `copy_file_range()`, `sendfile()` or `splice()`.
+/// </summary>
+/// <param name="src_offset">The position in the AVI file</param>
+/// <param name="len">The bytes to copy</param>
+/// <param name="userdata">The data you passed to `avi_export_init()`</param>
+/// <returns>The bytes copied, could be less than `len`. -1 for fail.</returns>
+typedef fssize_t(*copy_range_cb)(fsize_t src_offset, fsize_t len, void *userdata);
+
+typedef enum
+{
+	/// The payloads are written one after another, e.g. a concatenated JPEG stream from an MJPEG stream.
+	AVI_EXPORT_RAW = 0,
+
+	/// A `WAVE` file with the stream format as the `fmt ` chunk, for the audio streams.
+	AVI_EXPORT_WAV = 1,
+}avi_export_container;
+
+/// <summary>
+/// A payload in the AVI file, or the part of it that fits in the buffer.
+/// </summary>
+typedef struct
+{
+	fsize_t offset;
+	fsize_t len;
+}avi_export_run;
+
+/// <summary>
+/// Writes the payloads of a stream into an elementary stream file.
+/// Without your `copy_range_cb`, the payloads are read in big batches: each batch is one read of the whole span, with the chunk headers and the packets of the other streams between the payloads,
+/// then the gaps are stripped in your buffer, and the batch is written by one call of your `write_cb`.
+/// With your `copy_range_cb`, every payload is copied in the kernel by its own call, a kernel copy can't skip the chunk headers between the payloads.
+/// </summary>
+typedef struct
+{
+	avi_stream_reader *s;
+	avi_export_container container;
+
+	void *userdata; /// The data to pass to your callback functions.
+	write_cb f_write;
+	copy_range_cb f_copy_range;
+
+	/// Your buffer for the batches if you don't have `f_copy_range`.
+	uint8_t *copy_buffer;
+	size_t copy_buffer_size;
+
+	avi_export_run batch[AVI_EXPORT_MAX_BATCH];
+	uint32_t batch_len;
+
+	/// Statistics
+	uint64_t num_packets;
+	uint64_t num_bytes;
+	uint64_t num_runs;
+	uint64_t num_batches;
+}avi_export;
+
+/// <summary>
+/// Initialize the export of a stream.
+/// </summary>
+/// <param name="e">Your `avi_export` to be initialized</param>
+/// <param name="s">Your stream reader of the stream to export, its position is restored after exporting.</param>
+/// <param name="container">`AVI_EXPORT_WAV` needs an audio stream</param>
+/// <param name="userdata">The data to pass to your callback functions</param>
+/// <param name="f_write">Your `write()` callback function for the output, it writes the `WAVE` header too.</param>
+/// <param name="f_copy_range">Your function to copy the payloads in the kernel. Passing NULL is allowed to use `copy_buffer`.</param>
+/// <param name="copy_buffer">Your buffer for reading the payloads, needed if `f_copy_range` is NULL.</param>
+/// <param name="copy_buffer_size">The size of `copy_buffer`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_export_init
+(
+	avi_export *e,
+	avi_stream_reader *s,
+	avi_export_container container,
+	void *userdata,
+	write_cb f_write,
+	copy_range_cb f_copy_range,
+	void *copy_buffer,
+	size_t copy_buffer_size
+);
+
+/// <summary>
+/// Write the whole stream. For `AVI_EXPORT_WAV`, the size of the `data` chunk is summed before from the index, so the output is written sequentially without seeking back, it could be a pipe.
+/// An `idx1` chunk is read for it in blocks as big as your `copy_buffer`, the packet table and the `indx` cache of the stream reader are walked as they are. The sizes of a `WAVE` file bigger than 4 GB are clamped to `0xFFFFFFFF`.
+/// </summary>
+/// <param name="e">Your `avi_export`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_export_stream(avi_export *e);
+
+#endif
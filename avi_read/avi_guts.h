@@ -56,6 +56,11 @@ typedef struct
 	uint32_t dwSize;
 } avi_index_entry;
 
+// The flag of `avi_index_entry::dwFlags` for the key frames
+#ifndef AVIIF_KEYFRAME
+#define AVIIF_KEYFRAME 0x00000010L
+#endif
+
 typedef struct
 {
 	uint32_t biSize;
@@ -90,13 +95,22 @@ typedef struct
 	uint8_t A;
 } palette_entry;
 
+/// The palette entry of the `strf` chunk, `RGBQUAD` in the file is blue first.
+typedef struct
+{
+	uint8_t B;
+	uint8_t G;
+	uint8_t R;
+	uint8_t Reserved;
+} rgb_quad;
+
 typedef struct
 {
 	bitmap_info_header BMIF;
 	union
 	{
 		uint32_t bitfields[4];
-		palette_entry palette[256];
+		rgb_quad palette[256];
 	};
 } bitmap_header_max_size;
 
@@ -105,7 +119,7 @@ typedef struct
 	uint8_t first_entry;
 	uint8_t num_entries;
 	uint16_t flags;
-	palette_entry palette[256];
+	palette_entry palette[256]; /// `PALETTEENTRY` in the file is red first, the `A` field is the flags.
 } avi_palette_change_max_size;
 
 typedef struct
@@ -121,6 +135,13 @@ typedef struct
 	uint32_t size;
 } avi_stdindex_entry;
 
+typedef struct
+{
+	uint32_t offset;
+	uint32_t size;
+	uint32_t offset_field2;
+} avi_field_index_entry;
+
 typedef struct
 {
 	uint16_t longs_per_entry;
@@ -0,0 +1,444 @@
+#include "avi_loudness.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifdef AVI_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define AVI_LOUDNESS_PI 3.14159265358979323846
+
+// The absolute gate is -70 LUFS, the energy is `10 ^ ((-70 + 0.691) / 10)`.
+#define AVI_LOUDNESS_ABSOLUTE_GATE 1.1724653045822963e-7
+
+AVI_STATIC_FUNC uint64_t avi_loudness_block_start(const avi_loudness *lz, uint64_t block)
+{
+	return block * lz->sample_rate / 10;
+}
+
+// The 100 ms block containing the frame.
+AVI_STATIC_FUNC uint64_t avi_loudness_block_of(const avi_loudness *lz, uint64_t frame)
+{
+	return (frame * 10 + 9) / lz->sample_rate;
+}
+
+AVI_FUNC uint64_t avi_loudness_get_num_energies(avi_stream_reader *s)
+{
+	avi_stream_header *sh;
+	uint64_t num_blocks;
+	if (!s || !s->stream_info) return 0;
+	sh = &s->stream_info->stream_header;
+	if (!sh->dwRate) return 0;
+
+	// The seconds of the stream is `dwLength * dwScale / dwRate`, for both the sample based and the byte based audio stream headers.
+	num_blocks = (uint64_t)sh->dwLength * sh->dwScale * 10 / sh->dwRate;
+	return num_blocks + 10 + 1;
+}
+
+// The K-weighting filter of ITU-R BS.1770 for any sample rate.
+AVI_STATIC_FUNC void avi_loudness_make_k_weighting(avi_loudness *lz)
+{
+	double rate = lz->sample_rate;
+	double f0 = 1681.974450955533;
+	double gain = 3.999843853973347;
+	double q = 0.7071752369554196;
+	double k = tan(AVI_LOUDNESS_PI * f0 / rate);
+	double vh = pow(10.0, gain / 20.0);
+	double vb = pow(vh, 0.4996667741545416);
+	double a0 = 1.0 + k / q + k * k;
+	lz->shelf[0] = (vh + vb * k / q + k * k) / a0;
+	lz->shelf[1] = 2.0 * (k * k - vh) / a0;
+	lz->shelf[2] = (vh - vb * k / q + k * k) / a0;
+	lz->shelf[3] = 2.0 * (k * k - 1.0) / a0;
+	lz->shelf[4] = (1.0 - k / q + k * k) / a0;
+
+	f0 = 38.13547087602444;
+	q = 0.5003270373238773;
+	k = tan(AVI_LOUDNESS_PI * f0 / rate);
+	a0 = 1.0 + k / q + k * k;
+	lz->high_pass[0] = 1.0;
+	lz->high_pass[1] = -2.0;
+	lz->high_pass[2] = 1.0;
+	lz->high_pass[3] = 2.0 * (k * k - 1.0) / a0;
+	lz->high_pass[4] = (1.0 - k / q + k * k) / a0;
+}
+
+// A Blackman windowed sinc low-pass filter at 4 times the sample rate, split into 4 phases, each phase is normalized to the unity gain.
+AVI_STATIC_FUNC void avi_loudness_make_tp_filter(avi_loudness *lz)
+{
+	uint32_t len = 4 * AVI_LOUDNESS_TP_TAPS;
+	double center = (len - 1) / 2.0;
+	lz->tp_gain = 0;
+	for (uint32_t p = 0; p < 4; p++)
+	{
+		double sum = 0, gain = 0;
+		for (uint32_t k = 0; k < AVI_LOUDNESS_TP_TAPS; k++)
+		{
+			uint32_t n = p + (AVI_LOUDNESS_TP_TAPS - 1 - k) * 4;
+			double x = n - center;
+			double sinc = x == 0 ? 1.0 : sin(AVI_LOUDNESS_PI * x / 4) / (AVI_LOUDNESS_PI * x / 4);
+			double window = 0.42 - 0.5 * cos(2 * AVI_LOUDNESS_PI * n / (len - 1)) + 0.08 * cos(4 * AVI_LOUDNESS_PI * n / (len - 1));
+			lz->tp_filter[p][k] = sinc * window;
+			sum += lz->tp_filter[p][k];
+		}
+		for (uint32_t k = 0; k < AVI_LOUDNESS_TP_TAPS; k++)
+		{
+			lz->tp_filter[p][k] /= sum;
+			gain += fabs(lz->tp_filter[p][k]);
+		}
+		if (gain > lz->tp_gain) lz->tp_gain = gain;
+	}
+}
+
+AVI_FUNC int avi_loudness_init(avi_loudness *lz, avi_stream_reader *s, double *energies, uint64_t num_energies)
+{
+	avi_pcm_layout layout;
+	if (!lz || !s || !energies || !num_energies) return 0;
+	if (!avi_pcm_get_stream_layout(s, &layout)) return 0;
+	if (!s->stream_info->audio_format.nSamplesPerSec) return 0;
+
+	memset(lz, 0, sizeof *lz);
+	lz->layout = layout;
+	lz->block_align = s->stream_info->audio_format.nBlockAlign;
+	lz->sample_rate = s->stream_info->audio_format.nSamplesPerSec;
+	lz->energies = energies;
+	lz->num_energies = num_energies;
+	memset(energies, 0, (size_t)num_energies * sizeof energies[0]);
+
+	for (uint32_t c = 0; c < layout.channels; c++) lz->channel_weight[c] = 1.0;
+	if (layout.channels == 6)
+	{
+		// 5.1 in the order of WAVEFORMATEXTENSIBLE: L, R, C, LFE, Ls, Rs
+		lz->channel_weight[3] = 0;
+		lz->channel_weight[4] = 1.41;
+		lz->channel_weight[5] = 1.41;
+	}
+	avi_loudness_make_k_weighting(lz);
+	avi_loudness_make_tp_filter(lz);
+	return 1;
+}
+
+AVI_STATIC_FUNC int avi_loudness_close_block(const avi_loudness *lz, avi_loudness_range *lr)
+{
+	if (!lr->has_head)
+	{
+		lr->has_head = 1;
+		lr->head_block = lr->cur_block;
+		lr->head_energy = lr->cur_energy;
+	}
+	else
+	{
+		if (lr->cur_block >= lz->num_energies) return 0;
+		lz->energies[lr->cur_block] += lr->cur_energy;
+	}
+	lr->cur_block++;
+	lr->cur_block_end = avi_loudness_block_start(lz, lr->cur_block + 1);
+	lr->cur_energy = 0;
+	return 1;
+}
+
+#ifdef AVI_USE_SSE2
+// The sample peak and the sum of squares, 4 frames at a time: the `channels` vectors of 4 frames always hold the same channels in the same lanes.
+// The squares are summed in `double` like the portable loop, only the order of the additions differs.
+// Returns the number of frames done, the rest are left for the portable loop.
+AVI_STATIC_FUNC uint32_t avi_loudness_sample_stats_sse2(uint32_t channels, avi_loudness_range *lr, const float *pcm, uint32_t num_frames)
+{
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	__m128 peak[AVI_PCM_MAX_CHANNELS];
+	__m128d sum_lo[AVI_PCM_MAX_CHANNELS];
+	__m128d sum_hi[AVI_PCM_MAX_CHANNELS];
+	float lane_peak[4];
+	double lane_sum[4];
+	uint32_t i = 0;
+	if (num_frames < 4) return 0;
+	for (uint32_t v = 0; v < channels; v++)
+	{
+		peak[v] = _mm_setzero_ps();
+		sum_lo[v] = _mm_setzero_pd();
+		sum_hi[v] = _mm_setzero_pd();
+	}
+	for (; i + 4 <= num_frames; i += 4)
+	{
+		const float *frames = &pcm[(size_t)i * channels];
+		for (uint32_t v = 0; v < channels; v++)
+		{
+			__m128 x = _mm_loadu_ps(&frames[v * 4]);
+			__m128d lo = _mm_cvtps_pd(x);
+			__m128d hi = _mm_cvtps_pd(_mm_movehl_ps(x, x));
+
+			// The sample is the first operand, so a NaN sample keeps the peak like the portable loop.
+			peak[v] = _mm_max_ps(_mm_and_ps(x, abs_mask), peak[v]);
+			sum_lo[v] = _mm_add_pd(sum_lo[v], _mm_mul_pd(lo, lo));
+			sum_hi[v] = _mm_add_pd(sum_hi[v], _mm_mul_pd(hi, hi));
+		}
+	}
+	for (uint32_t v = 0; v < channels; v++)
+	{
+		_mm_storeu_ps(lane_peak, peak[v]);
+		_mm_storeu_pd(&lane_sum[0], sum_lo[v]);
+		_mm_storeu_pd(&lane_sum[2], sum_hi[v]);
+		for (uint32_t k = 0; k < 4; k++)
+		{
+			uint32_t c = (v * 4 + k) % channels;
+			if (lane_peak[k] > lr->sample_peak[c]) lr->sample_peak[c] = lane_peak[k];
+			lr->sum_squares[c] += lane_sum[k];
+		}
+	}
+	return i;
+}
+#endif
+
+AVI_STATIC_FUNC void avi_loudness_sample_stats(uint32_t channels, avi_loudness_range *lr, const float *pcm, uint32_t num_frames)
+{
+	uint32_t i = 0;
+#ifdef AVI_USE_SSE2
+	i = avi_loudness_sample_stats_sse2(channels, lr, pcm, num_frames);
+#endif
+	for (; i < num_frames; i++)
+	{
+		const float *frame = &pcm[(size_t)i * channels];
+		for (uint32_t c = 0; c < channels; c++)
+		{
+			double x = frame[c];
+			double ax = fabs(x);
+			if (ax > lr->sample_peak[c]) lr->sample_peak[c] = ax;
+			lr->sum_squares[c] += x * x;
+		}
+	}
+}
+
+AVI_STATIC_FUNC int avi_loudness_process(const avi_loudness *lz, avi_loudness_range *lr, const float *pcm, uint32_t num_frames)
+{
+	uint32_t channels = lz->layout.channels;
+	avi_loudness_sample_stats(channels, lr, pcm, num_frames);
+	for (uint32_t i = 0; i < num_frames; i++)
+	{
+		const float *frame = &pcm[(size_t)i * channels];
+		double energy = 0;
+		lr->tp_pos = (lr->tp_pos + 1) % AVI_LOUDNESS_TP_TAPS;
+		for (uint32_t c = 0; c < channels; c++)
+		{
+			double x = frame[c];
+			double ax = fabs(x);
+			double y, *z = lr->kw_state[c];
+			double *history = lr->tp_history[c];
+
+			// Only a window with a sample loud enough could have an interpolated sample above the true-peak so far.
+			history[lr->tp_pos] = x;
+			history[lr->tp_pos + AVI_LOUDNESS_TP_TAPS] = x;
+			if (ax * lz->tp_gain > lr->true_peak[c]) lr->tp_hot[c] = AVI_LOUDNESS_TP_TAPS;
+			if (lr->tp_hot[c])
+			{
+				const double *window = &history[lr->tp_pos + 1];
+				for (uint32_t p = 0; p < 4; p++)
+				{
+					double v = 0;
+					for (uint32_t k = 0; k < AVI_LOUDNESS_TP_TAPS; k++) v += lz->tp_filter[p][k] * window[k];
+					v = fabs(v);
+					if (v > lr->true_peak[c]) lr->true_peak[c] = v;
+				}
+				lr->tp_hot[c]--;
+			}
+
+			// The K-weighting filter, 2 biquads of the transposed direct form II.
+			y = lz->shelf[0] * x + z[0];
+			z[0] = lz->shelf[1] * x - lz->shelf[3] * y + z[1];
+			z[1] = lz->shelf[2] * x - lz->shelf[4] * y;
+			x = y;
+			y = lz->high_pass[0] * x + z[2];
+			z[2] = lz->high_pass[1] * x - lz->high_pass[3] * y + z[3];
+			z[3] = lz->high_pass[2] * x - lz->high_pass[4] * y;
+			energy += lz->channel_weight[c] * y * y;
+		}
+		lr->cur_energy += energy;
+		if (++lr->cur_frame == lr->cur_block_end)
+		{
+			if (!avi_loudness_close_block(lz, lr)) return 0;
+		}
+	}
+	return 1;
+}
+
+AVI_STATIC_FUNC int avi_loudness_process_packet(const avi_loudness *lz, avi_loudness_range *lr, const uint8_t *packet, size_t len)
+{
+	float pcm[AVI_LOUDNESS_BLOCK_FRAMES * AVI_PCM_MAX_CHANNELS];
+	size_t frame_size = (size_t)lz->block_align;
+
+	// Every slice fits in `pcm` with the unfinished frame of the last packet.
+	size_t slice_size = (AVI_LOUDNESS_BLOCK_FRAMES - 1) * frame_size;
+	while (len)
+	{
+		size_t slice = len < slice_size ? len : slice_size;
+		uint32_t n = avi_pcm_converter_process(&lr->converter, packet, slice, pcm, AVI_LOUDNESS_BLOCK_FRAMES);
+		if (!avi_loudness_process(lz, lr, pcm, n)) return 0;
+		packet += slice;
+		len -= slice;
+	}
+	return 1;
+}
+
+AVI_FUNC int avi_loudness_scan_range
+(
+	const avi_loudness *lz,
+	avi_loudness_range *lr,
+	avi_stream_reader *s,
+	const avi_stream_range *range,
+	void *buffer,
+	size_t buffer_size
+)
+{
+	avi_pcm_layout dst_layout;
+	int has_packet;
+	if (!lz || !lr || !s || !range || !buffer) return 0;
+
+	memset(lr, 0, sizeof *lr);
+	dst_layout.format = AVI_PCM_F32;
+	dst_layout.channels = lz->layout.channels;
+	dst_layout.planar = 0;
+	if (!avi_pcm_converter_init(&lr->converter, lz->layout, dst_layout)) return 0;
+
+	lr->first_frame = range->first.cur_stream_byte_offset / lz->block_align;
+	lr->cur_frame = lr->first_frame;
+	lr->cur_block = avi_loudness_block_of(lz, lr->first_frame);
+	lr->cur_block_end = avi_loudness_block_start(lz, lr->cur_block + 1);
+
+	has_packet = avi_stream_reader_move_to_range(s, range, 0);
+	if (!has_packet) return 0;
+	while (has_packet)
+	{
+		fsize_t offsets[AVI_LOUDNESS_MAX_SPAN_PACKETS];
+		fsize_t lengths[AVI_LOUDNESS_MAX_SPAN_PACKETS];
+		uint32_t num_packets = 0;
+		fsize_t span_start = 0, span_end = 0;
+		uint8_t *span = buffer;
+
+		// Gather the nearby packets into a span, the stream reader stops at the first packet out of the span.
+		do
+		{
+			fsize_t offset = s->cur_packet_offset;
+			fsize_t len = s->cur_packet_len;
+			if (!len) continue;
+			if (num_packets)
+			{
+				if (num_packets == AVI_LOUDNESS_MAX_SPAN_PACKETS) break;
+				if (offset < span_end || offset - span_end > AVI_LOUDNESS_MAX_GAP) break;
+				if (offset + len - span_start > buffer_size) break;
+			}
+			else
+			{
+				if (len > buffer_size) return 0;
+				span_start = offset;
+			}
+			offsets[num_packets] = offset;
+			lengths[num_packets] = len;
+			num_packets++;
+			span_end = offset + len;
+		} while ((has_packet = avi_stream_reader_move_to_next_packet_in_range(s, range, 0)) != 0);
+		if (!num_packets) break;
+
+		if (avi_stream_reader_read_at(s, span_start, span, span_end - span_start, AVI_IO_PAYLOAD) != (fssize_t)(span_end - span_start)) return 0;
+		for (uint32_t i = 0; i < num_packets; i++)
+		{
+			if (!avi_loudness_process_packet(lz, lr, span + (offsets[i] - span_start), lengths[i])) return 0;
+		}
+	}
+	lr->is_done = 1;
+	return 1;
+}
+
+AVI_STATIC_FUNC int avi_loudness_add_energy(avi_loudness *lz, uint64_t block, double energy)
+{
+	if (block >= lz->num_energies) return energy == 0;
+	lz->energies[block] += energy;
+	return 1;
+}
+
+AVI_FUNC int avi_loudness_merge(avi_loudness *lz, const avi_loudness_range *lr)
+{
+	if (!lz || !lr || !lr->is_done) return 0;
+	for (uint32_t c = 0; c < lz->layout.channels; c++)
+	{
+		if (lr->sample_peak[c] > lz->sample_peak[c]) lz->sample_peak[c] = lr->sample_peak[c];
+		if (lr->true_peak[c] > lz->true_peak[c]) lz->true_peak[c] = lr->true_peak[c];
+		lz->sum_squares[c] += lr->sum_squares[c];
+	}
+	lz->num_frames += lr->cur_frame - lr->first_frame;
+	if (lr->cur_frame > lz->end_frame) lz->end_frame = lr->cur_frame;
+
+	// The head and the tail blocks could be shared with the neighbor ranges.
+	if (lr->has_head && !avi_loudness_add_energy(lz, lr->head_block, lr->head_energy)) return 0;
+	return avi_loudness_add_energy(lz, lr->cur_block, lr->cur_energy);
+}
+
+AVI_FUNC int avi_loudness_scan(avi_loudness *lz, avi_stream_reader *s, void *buffer, size_t buffer_size)
+{
+	avi_stream_range range;
+	avi_stream_position saved;
+	avi_loudness_range lr;
+	uint32_t num_ranges = 0;
+	int ret;
+	if (!lz || !s) return 0;
+	if (!avi_stream_reader_partition(s, 1, 0, &range, &num_ranges) || !num_ranges) return 0;
+
+	avi_stream_reader_get_position(s, &saved);
+	ret = avi_loudness_scan_range(lz, &lr, s, &range, buffer, buffer_size);
+	avi_stream_reader_set_position(s, &saved);
+	return ret && avi_loudness_merge(lz, &lr);
+}
+
+AVI_FUNC int avi_loudness_get_result(const avi_loudness *lz, avi_loudness_result *result)
+{
+	uint64_t num_sub_blocks;
+	double sum = 0, relative_gate;
+	uint64_t count = 0;
+	if (!lz || !result) return 0;
+
+	memset(result, 0, sizeof *result);
+	result->channels = lz->layout.channels;
+	result->num_frames = lz->num_frames;
+	for (uint32_t c = 0; c < lz->layout.channels; c++)
+	{
+		result->sample_peak[c] = lz->sample_peak[c];
+		result->true_peak[c] = lz->true_peak[c] > lz->sample_peak[c] ? lz->true_peak[c] : lz->sample_peak[c];
+		result->rms[c] = lz->num_frames ? sqrt(lz->sum_squares[c] / lz->num_frames) : 0;
+	}
+
+	// The 400 ms blocks overlap by 75%, the block `j` is the 100 ms blocks from `j - 3` to `j`. The unfinished block at the end is not counted.
+	num_sub_blocks = avi_loudness_block_of(lz, lz->end_frame);
+	if (num_sub_blocks > lz->num_energies) num_sub_blocks = lz->num_energies;
+	result->num_blocks = num_sub_blocks >= 4 ? num_sub_blocks - 3 : 0;
+	result->integrated_loudness = -HUGE_VAL;
+	result->relative_threshold = -HUGE_VAL;
+
+	for (uint64_t j = 3; j < num_sub_blocks; j++)
+	{
+		double e = lz->energies[j - 3] + lz->energies[j - 2] + lz->energies[j - 1] + lz->energies[j];
+		e /= (double)(avi_loudness_block_start(lz, j + 1) - avi_loudness_block_start(lz, j - 3));
+		if (e > AVI_LOUDNESS_ABSOLUTE_GATE)
+		{
+			sum += e;
+			count++;
+		}
+	}
+	if (!count) return 1;
+
+	// The relative gate is 10 LU below the loudness of the blocks passed the absolute gate.
+	relative_gate = sum / count / 10;
+	result->relative_threshold = -0.691 + 10 * log10(sum / count) - 10;
+	sum = 0;
+	count = 0;
+	for (uint64_t j = 3; j < num_sub_blocks; j++)
+	{
+		double e = lz->energies[j - 3] + lz->energies[j - 2] + lz->energies[j - 1] + lz->energies[j];
+		e /= (double)(avi_loudness_block_start(lz, j + 1) - avi_loudness_block_start(lz, j - 3));
+		if (e > AVI_LOUDNESS_ABSOLUTE_GATE && e > relative_gate)
+		{
+			sum += e;
+			count++;
+		}
+	}
+	result->num_gated_blocks = count;
+	if (count) result->integrated_loudness = -0.691 + 10 * log10(sum / count);
+	return 1;
+}
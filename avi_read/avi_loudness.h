@@ -0,0 +1,196 @@
+#ifndef _AVI_LOUDNESS_H_
+#define _AVI_LOUDNESS_H_ 1
+
+#include "avi_pcm.h"
+
+/// <summary>
+/// The frames converted to `float` per step, they are kept on the stack.
+/// </summary>
+#ifndef AVI_LOUDNESS_BLOCK_FRAMES
+#define AVI_LOUDNESS_BLOCK_FRAMES 256
+#endif
+
+/// <summary>
+/// The nearby packets of a range are read by one `f_read()` if the gap between them is not bigger than this, e.g. a small video frame between 2 audio packets.
+/// </summary>
+#ifndef AVI_LOUDNESS_MAX_GAP
+#define AVI_LOUDNESS_MAX_GAP 4096
+#endif
+
+/// <summary>
+/// The limit of the number of packets read by one `f_read()`.
+/// </summary>
+#ifndef AVI_LOUDNESS_MAX_SPAN_PACKETS
+#define AVI_LOUDNESS_MAX_SPAN_PACKETS 64
+#endif
+
+/// <summary>
+/// The taps of each phase of the 4x oversampling filter for the true-peak.
+/// </summary>
+#define AVI_LOUDNESS_TP_TAPS 12
+
+/// <summary>
+/// The shared context of the analysis of a PCM audio stream: the filter coefficients and your buffer of the 100 ms block energies.
+/// The scanning of the ranges only reads it, except for writing the energies of the blocks inside of each range.
+/// </summary>
+typedef struct
+{
+	avi_pcm_layout layout;
+	uint32_t block_align;
+	uint32_t sample_rate;
+
+	/// The K-weighting filter: the high shelf, then the high pass, as `b0, b1, b2, a1, a2`.
+	double shelf[5];
+	double high_pass[5];
+
+	/// The weight of each channel for the loudness, the LFE channel of 5.1 is 0, the surround channels are 1.41.
+	double channel_weight[AVI_PCM_MAX_CHANNELS];
+
+	/// The 4 phases of the oversampling filter, the coefficients are in the order of the samples, the oldest first.
+	double tp_filter[4][AVI_LOUDNESS_TP_TAPS];
+
+	/// The sum of `tp_filter` magnitudes of the biggest phase, bounds the interpolated samples.
+	double tp_gain;
+
+	/// Your buffer for the energy of each 100 ms block, zeroed by `avi_loudness_init()`.
+	double *energies;
+	uint64_t num_energies;
+
+	/// The merged results of the ranges, see `avi_loudness_merge()`.
+	double sample_peak[AVI_PCM_MAX_CHANNELS];
+	double true_peak[AVI_PCM_MAX_CHANNELS];
+	double sum_squares[AVI_PCM_MAX_CHANNELS];
+	uint64_t num_frames;
+
+	/// The end of the stream in frames, the last range tells it.
+	uint64_t end_frame;
+}avi_loudness;
+
+/// <summary>
+/// The state of scanning a range of the stream, one for each of your workers.
+/// The filters start from silence at the start of the range, so the first milliseconds of the range are weighted a little differently from a sequential scan.
+/// </summary>
+typedef struct
+{
+	avi_pcm_converter converter;
+
+	/// The K-weighting filter state of each channel, 2 for each biquad.
+	double kw_state[AVI_PCM_MAX_CHANNELS][4];
+
+	/// The last samples of each channel for the oversampling, written twice so the window is always contiguous.
+	double tp_history[AVI_PCM_MAX_CHANNELS][AVI_LOUDNESS_TP_TAPS * 2];
+	uint32_t tp_pos;
+
+	/// The samples left that need the oversampling, only the windows with a loud sample could raise the true-peak.
+	uint32_t tp_hot[AVI_PCM_MAX_CHANNELS];
+
+	double sample_peak[AVI_PCM_MAX_CHANNELS];
+	double true_peak[AVI_PCM_MAX_CHANNELS];
+	double sum_squares[AVI_PCM_MAX_CHANNELS];
+
+	/// The frames of the range
+	uint64_t first_frame;
+	uint64_t cur_frame;
+
+	/// The 100 ms block being filled, it's the tail of the range at last.
+	uint64_t cur_block;
+	uint64_t cur_block_end;
+	double cur_energy;
+
+	/// The first block of the range, it's shared with the previous range, so it's added by `avi_loudness_merge()`.
+	uint64_t head_block;
+	double head_energy;
+	int has_head;
+
+	int is_done;
+}avi_loudness_range;
+
+/// <summary>
+/// The loudness of a stream. The peaks and RMS are linear from 0 to 1, use `20 * log10()` for dBFS.
+/// </summary>
+typedef struct
+{
+	uint32_t channels;
+	double sample_peak[AVI_PCM_MAX_CHANNELS];
+	double true_peak[AVI_PCM_MAX_CHANNELS]; /// Estimated by 4x oversampling
+	double rms[AVI_PCM_MAX_CHANNELS];
+
+	/// The gated integrated loudness in LUFS like EBU R128, `-HUGE_VAL` if every block is gated.
+	double integrated_loudness;
+
+	/// The relative gate threshold in LUFS
+	double relative_threshold;
+
+	/// Number of the 400 ms blocks, and the blocks passed the gates
+	uint64_t num_blocks;
+	uint64_t num_gated_blocks;
+
+	uint64_t num_frames;
+}avi_loudness_result;
+
+/// <summary>
+/// Get the number of 100 ms blocks of the stream by the stream header, to size your energy buffer.
+/// One more second is added in case the header is not accurate.
+/// </summary>
+/// <param name="s">Your stream reader of a PCM audio stream</param>
+/// <returns>0 for fail</returns>
+AVI_FUNC uint64_t avi_loudness_get_num_energies(avi_stream_reader *s);
+
+/// <summary>
+/// Initialize the analysis of a PCM audio stream, see `avi_pcm_get_stream_layout()` for the supported formats.
+/// </summary>
+/// <param name="lz">Your `avi_loudness` to be initialized</param>
+/// <param name="s">Your stream reader of the audio stream</param>
+/// <param name="energies">Your buffer for the block energies</param>
+/// <param name="num_energies">Number of `energies`, see `avi_loudness_get_num_energies()`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_loudness_init(avi_loudness *lz, avi_stream_reader *s, double *energies, uint64_t num_energies);
+
+/// <summary>
+/// Scan a range of the stream. Call it from your worker threads concurrently, each with its own `avi_loudness_range` and its own stream reader that has its own file handle.
+/// The ranges come from `avi_stream_reader_partition()`, the nearby packets are read by one `f_read()` into your buffer.
+/// </summary>
+/// <param name="lz">The shared `avi_loudness`</param>
+/// <param name="lr">Your `avi_loudness_range` to receive the results of the range</param>
+/// <param name="s">The stream reader of this worker, see `avi_stream_reader_clone()` and `avi_stream_reader_set_read_seek_tell()`</param>
+/// <param name="range">The range to scan</param>
+/// <param name="buffer">Your buffer for reading the packets, must be bigger than any packet, bigger is better</param>
+/// <param name="buffer_size">The size of `buffer`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_loudness_scan_range
+(
+	const avi_loudness *lz,
+	avi_loudness_range *lr,
+	avi_stream_reader *s,
+	const avi_stream_range *range,
+	void *buffer,
+	size_t buffer_size
+);
+
+/// <summary>
+/// Merge the results of a scanned range. The ranges could be merged in any order, but not concurrently.
+/// </summary>
+/// <param name="lz">The shared `avi_loudness`</param>
+/// <param name="lr">The scanned range</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_loudness_merge(avi_loudness *lz, const avi_loudness_range *lr);
+
+/// <summary>
+/// Scan the whole stream in the calling thread, then merge it.
+/// </summary>
+/// <param name="lz">Your initialized `avi_loudness`</param>
+/// <param name="s">Your stream reader, its position is restored after scanning.</param>
+/// <param name="buffer">Your buffer for reading the packets</param>
+/// <param name="buffer_size">The size of `buffer`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_loudness_scan(avi_loudness *lz, avi_stream_reader *s, void *buffer, size_t buffer_size);
+
+/// <summary>
+/// Get the results after all of the ranges are merged. The integrated loudness is gated by the absolute gate -70 LUFS and the relative gate -10 LU.
+/// </summary>
+/// <param name="lz">The `avi_loudness` with all of the ranges merged</param>
+/// <param name="result">Your `avi_loudness_result` to receive the results</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_loudness_get_result(const avi_loudness *lz, avi_loudness_result *result);
+
+#endif
@@ -0,0 +1,223 @@
+#include "avi_mjpeg.h"
+
+#include <string.h>
+
+#define JPEG_SOI 0xD8
+#define JPEG_EOI 0xD9
+#define JPEG_SOS 0xDA
+#define JPEG_DHT 0xC4
+#define JPEG_DAC 0xCC
+#define JPEG_JPG 0xC8
+#define JPEG_TEM 0x01
+
+// The default Huffman tables from ITU-T T.81 Annex K.3, as one `DHT` marker segment, the same as the AVI1 Motion JPEG format expects.
+static const uint8_t avi_mjpeg_default_dht[] =
+{
+	0xFF, JPEG_DHT, 0x01, 0xA2,
+
+	// DC luminance
+	0x00,
+	0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
+
+	// AC luminance
+	0x10,
+	0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04, 0x04, 0x00, 0x00, 0x01, 0x7D,
+	0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+	0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+	0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+	0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+	0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+	0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+	0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+	0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+	0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+	0xF9, 0xFA,
+
+	// DC chrominance
+	0x01,
+	0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
+
+	// AC chrominance
+	0x11,
+	0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04, 0x04, 0x00, 0x01, 0x02, 0x77,
+	0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+	0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+	0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+	0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+	0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+	0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+	0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+	0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+	0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+	0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+	0xF9, 0xFA,
+};
+
+static const uint8_t avi_mjpeg_eoi[] = { 0xFF, JPEG_EOI };
+
+AVI_STATIC_FUNC uint16_t avi_mjpeg_read_be16(const uint8_t *p)
+{
+	return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+// The markers without a length field
+AVI_STATIC_FUNC int avi_mjpeg_is_standalone_marker(uint8_t marker)
+{
+	if (marker >= 0xD0 && marker <= 0xD9) return 1; // RSTn, SOI, EOI
+	return marker == JPEG_TEM;
+}
+
+AVI_STATIC_FUNC int avi_mjpeg_is_sof_marker(uint8_t marker)
+{
+	if (marker < 0xC0 || marker > 0xCF) return 0;
+	return marker != JPEG_DHT && marker != JPEG_JPG && marker != JPEG_DAC;
+}
+
+// The arithmetic coding frames don't use the Huffman tables.
+AVI_STATIC_FUNC int avi_mjpeg_is_huffman_sof(uint8_t marker)
+{
+	return marker <= 0xC7;
+}
+
+// Find the next `0xFF` byte. `memchr()` of the C library scans many bytes per step, the entropy coded data is the bulk of the frame.
+AVI_STATIC_FUNC size_t avi_mjpeg_find_ff(const uint8_t *data, size_t pos, size_t len)
+{
+	const uint8_t *p;
+	if (pos >= len) return len;
+	p = memchr(data + pos, 0xFF, len - pos);
+	return p ? (size_t)(p - data) : len;
+}
+
+// Parse the marker segments from `SOI` to the first `SOS`.
+AVI_STATIC_FUNC int avi_mjpeg_parse_headers(const uint8_t *data, size_t len, avi_mjpeg_frame *f)
+{
+	size_t pos = f->soi_offset + 2;
+	for (;;)
+	{
+		uint8_t marker;
+		uint16_t seg_len;
+
+		if (pos >= len || data[pos] != 0xFF) return 0;
+		while (pos < len && data[pos] == 0xFF) pos++; // Fill bytes
+		if (pos >= len) return 0;
+		marker = data[pos++];
+		if (avi_mjpeg_is_standalone_marker(marker))
+		{
+			if (marker == JPEG_EOI) return 0;
+			continue;
+		}
+		if (pos + 2 > len) return 0;
+		seg_len = avi_mjpeg_read_be16(data + pos);
+		if (seg_len < 2 || pos + seg_len > len) return 0;
+
+		if (avi_mjpeg_is_sof_marker(marker) && !f->sof_marker)
+		{
+			if (seg_len < 8) return 0;
+			f->sof_marker = marker;
+			f->precision = data[pos + 2];
+			f->height = avi_mjpeg_read_be16(data + pos + 3);
+			f->width = avi_mjpeg_read_be16(data + pos + 5);
+			f->num_components = data[pos + 7];
+		}
+		else if (marker == JPEG_DHT)
+		{
+			f->has_dht = 1;
+		}
+		else if (marker == JPEG_SOS)
+		{
+			f->sos_offset = pos - 2;
+			return f->sof_marker != 0;
+		}
+		pos += seg_len;
+	}
+}
+
+// Find the end of `EOI` after the first `SOS`. The marker segments between the scans of a progressive frame are skipped by their lengths.
+AVI_STATIC_FUNC size_t avi_mjpeg_find_eoi_end(const uint8_t *data, size_t len, size_t sos_offset)
+{
+	size_t pos = sos_offset + 2;
+	pos += avi_mjpeg_read_be16(data + pos);
+	for (;;)
+	{
+		uint8_t marker;
+		pos = avi_mjpeg_find_ff(data, pos, len);
+		if (pos + 1 >= len) return 0;
+		marker = data[pos + 1];
+		if (marker == 0x00 || marker == 0xFF || avi_mjpeg_is_standalone_marker(marker))
+		{
+			if (marker == JPEG_EOI) return pos + 2;
+			pos++;
+			continue;
+		}
+		if (pos + 4 > len) return 0;
+		pos += 2 + avi_mjpeg_read_be16(data + pos + 2);
+	}
+}
+
+AVI_STATIC_FUNC void avi_mjpeg_add_segment(avi_mjpeg_frame *f, const uint8_t *data, size_t len)
+{
+	if (!len) return;
+	f->segments[f->num_segments].data = data;
+	f->segments[f->num_segments].len = len;
+	f->num_segments++;
+	f->total_len += len;
+}
+
+AVI_FUNC int avi_mjpeg_normalize(const void *frame, size_t len, avi_mjpeg_frame *f)
+{
+	const uint8_t *data = frame;
+	size_t pos;
+
+	if (!f) return 0;
+	memset(f, 0, sizeof *f);
+	if (!data || len < 4) return 0;
+
+	// Some encoders put padding before `SOI`.
+	for (pos = avi_mjpeg_find_ff(data, 0, len); pos + 1 < len; pos = avi_mjpeg_find_ff(data, pos + 1, len))
+	{
+		if (data[pos + 1] == JPEG_SOI) break;
+	}
+	if (pos + 1 >= len) return 0;
+	f->soi_offset = pos;
+
+	if (!avi_mjpeg_parse_headers(data, len, f)) return 0;
+	f->eoi_end = avi_mjpeg_find_eoi_end(data, len, f->sos_offset);
+	if (!f->eoi_end)
+	{
+		f->eoi_end = len;
+		f->eoi_appended = 1;
+	}
+
+	avi_mjpeg_add_segment(f, data + f->soi_offset, f->sos_offset - f->soi_offset);
+	if (!f->has_dht && avi_mjpeg_is_huffman_sof(f->sof_marker))
+	{
+		avi_mjpeg_add_segment(f, avi_mjpeg_default_dht, sizeof avi_mjpeg_default_dht);
+		f->dht_inserted = 1;
+	}
+	avi_mjpeg_add_segment(f, data + f->sos_offset, f->eoi_end - f->sos_offset);
+	if (f->eoi_appended) avi_mjpeg_add_segment(f, avi_mjpeg_eoi, sizeof avi_mjpeg_eoi);
+	return 1;
+}
+
+AVI_FUNC int avi_mjpeg_read_frame(avi_stream_reader *s, void *buffer, size_t buffer_size, avi_mjpeg_frame *f)
+{
+	if (!s || !buffer || !f) return 0;
+	if (s->cur_packet_len > buffer_size) return 0;
+	if (!avi_stream_reader_read_packet(s, buffer, buffer_size)) return 0;
+	return avi_mjpeg_normalize(buffer, (size_t)s->cur_packet_len, f);
+}
+
+AVI_FUNC size_t avi_mjpeg_gather(const avi_mjpeg_frame *f, void *buffer, size_t buffer_size)
+{
+	uint8_t *dst = buffer;
+	if (!f || !buffer || f->total_len > buffer_size) return 0;
+	for (uint32_t i = 0; i < f->num_segments; i++)
+	{
+		memcpy(dst, f->segments[i].data, f->segments[i].len);
+		dst += f->segments[i].len;
+	}
+	return f->total_len;
+}
@@ -0,0 +1,88 @@
+#ifndef _AVI_MJPEG_H_
+#define _AVI_MJPEG_H_ 1
+
+#include "avi_reader.h"
+
+/// <summary>
+/// 3 segments for the normalized frame: the headers before `SOS`, the default Huffman tables, and the rest until `EOI`.
+/// One more for the `EOI` marker if the frame lost it.
+/// </summary>
+#ifndef AVI_MJPEG_MAX_SEGMENTS
+#define AVI_MJPEG_MAX_SEGMENTS 4
+#endif
+
+/// <summary>
+/// A piece of the normalized JPEG file, pointing into your frame buffer or into the constant tables of this module.
+/// </summary>
+typedef struct
+{
+	const uint8_t *data;
+	size_t len;
+}avi_mjpeg_segment;
+
+/// <summary>
+/// A Motion JPEG frame is a JPEG image without the Huffman tables (`DHT`), the decoder is expected to use the default tables
+/// from the JPEG standard (ITU-T T.81 Annex K.3). Most still image decoders don't know that.
+/// The normalizer scans the markers of the frame and describes a complete JPEG file as a scatter-gather list of segments,
+/// with the default `DHT` inserted before `SOS` when missing, and the padding after `EOI` trimmed. The frame data is not copied.
+/// </summary>
+typedef struct
+{
+	avi_mjpeg_segment segments[AVI_MJPEG_MAX_SEGMENTS];
+	uint32_t num_segments;
+
+	/// The total length of the segments
+	size_t total_len;
+
+	/// From the `SOF` marker
+	uint16_t width;
+	uint16_t height;
+	uint8_t precision;
+	uint8_t num_components;
+	uint8_t sof_marker; /// 0xC0 for baseline, 0xC2 for progressive, etc.
+
+	/// The positions in your frame buffer
+	size_t soi_offset;
+	size_t sos_offset;
+	size_t eoi_end;
+
+	/// Did the frame have its own `DHT`?
+	int has_dht;
+
+	/// Was the default `DHT` inserted?
+	int dht_inserted;
+
+	/// Was the `EOI` missing and appended?
+	int eoi_appended;
+}avi_mjpeg_frame;
+
+/// <summary>
+/// Scan the markers of a JPEG frame in memory and build the segments of the normalized JPEG file.
+/// The frame buffer must stay valid while you use the segments.
+/// </summary>
+/// <param name="frame">Your buffer of the frame, e.g. read by `avi_stream_reader_read_packet()`</param>
+/// <param name="len">The length of the frame</param>
+/// <param name="f">Your `avi_mjpeg_frame` to receive the segments</param>
+/// <returns>0 for fail (no `SOI`, broken marker segments, or no `SOF` or `SOS`), nonzero for success.</returns>
+AVI_FUNC int avi_mjpeg_normalize(const void *frame, size_t len, avi_mjpeg_frame *f);
+
+/// <summary>
+/// Read the current packet of the JPEG video stream into your buffer, then call `avi_mjpeg_normalize()`.
+/// </summary>
+/// <param name="s">Your stream reader of a JPEG video stream, see `avi_is_stream_JPEG()`</param>
+/// <param name="buffer">Your buffer for the packet</param>
+/// <param name="buffer_size">The size of your buffer, must be not less than `cur_packet_len`</param>
+/// <param name="f">Your `avi_mjpeg_frame` to receive the segments</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_mjpeg_read_frame(avi_stream_reader *s, void *buffer, size_t buffer_size, avi_mjpeg_frame *f);
+
+/// <summary>
+/// Gather the segments into one buffer, for the decoders that can't take a scatter-gather list.
+/// </summary>
+/// <param name="f">Your `avi_mjpeg_frame` from `avi_mjpeg_normalize()`</param>
+/// <param name="buffer">Your buffer for the JPEG file, must not overlap your frame buffer.</param>
+/// <param name="buffer_size">The size of your buffer, must be not less than `total_len`</param>
+/// <returns>The bytes written, 0 for fail.</returns>
+AVI_FUNC size_t avi_mjpeg_gather(const avi_mjpeg_frame *f, void *buffer, size_t buffer_size);
+
+#endif
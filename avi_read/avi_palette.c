@@ -0,0 +1,184 @@
+#include "avi_palette.h"
+
+#include <string.h>
+
+AVI_STATIC_FUNC int avi_palette_is_change_packet(uint32_t fourcc)
+{
+	char fourcc_buf[5] = { 0 };
+	memcpy(fourcc_buf, &fourcc, 4);
+	return fourcc_buf[2] == 'p' && fourcc_buf[3] == 'c';
+}
+
+AVI_STATIC_FUNC void avi_palette_take_snapshot(avi_palette_index *pi, avi_palette_snapshot *snapshot, uint32_t change_index)
+{
+	bitmap_header_max_size *bf = &pi->s->stream_info->bitmap_format;
+	snapshot->change_index = change_index;
+	snapshot->clr_used = bf->BMIF.biClrUsed;
+	snapshot->clr_important = bf->BMIF.biClrImportant;
+	memcpy(snapshot->palette, bf->palette, sizeof snapshot->palette);
+}
+
+AVI_STATIC_FUNC void avi_palette_load_snapshot(avi_palette_index *pi, const avi_palette_snapshot *snapshot)
+{
+	bitmap_header_max_size *bf = &pi->s->stream_info->bitmap_format;
+	bf->BMIF.biClrUsed = snapshot->clr_used;
+	bf->BMIF.biClrImportant = snapshot->clr_important;
+	memcpy(bf->palette, snapshot->palette, sizeof bf->palette);
+}
+
+AVI_STATIC_FUNC int avi_palette_apply_change(avi_palette_index *pi, const avi_palette_change_info *change)
+{
+	avi_stream_reader *s = pi->s;
+	avi_palette_change_max_size pc;
+	fsize_t len = change->len;
+	fssize_t rl;
+	if (len > sizeof pc) len = sizeof pc;
+	memset(&pc, 0, sizeof pc);
+	rl = avi_stream_reader_read_at(s, change->offset, &pc, len, AVI_IO_PAYLOAD);
+	if (rl < 0 || (fsize_t)rl != len) return 0;
+	return avi_apply_palette_change(s, &pc);
+}
+
+/// Read the palette of the stream format, the palette in the stream info could be changed already.
+AVI_STATIC_FUNC int avi_palette_read_initial(avi_palette_index *pi)
+{
+	avi_stream_reader *s = pi->s;
+	avi_stream_info *si = s->stream_info;
+	bitmap_header_max_size format;
+	fsize_t len = si->stream_format_len;
+	fssize_t rl;
+	if (len > sizeof format) len = sizeof format;
+	memset(&format, 0, sizeof format);
+	rl = avi_stream_reader_read_at(s, si->stream_format_offset, &format, len, AVI_IO_HEADER);
+	if (rl < 0 || (fsize_t)rl != len) return 0;
+	pi->initial.change_index = 0;
+	pi->initial.clr_used = format.BMIF.biClrUsed;
+	pi->initial.clr_important = format.BMIF.biClrImportant;
+	memcpy(pi->initial.palette, format.palette, sizeof pi->initial.palette);
+	return 1;
+}
+
+/// Drop every other snapshot and double the interval, so the snapshots stay spread evenly over the palette changes found so far.
+AVI_STATIC_FUNC void avi_palette_thin_snapshots(avi_palette_index *pi)
+{
+	uint32_t num_kept = 0;
+	pi->snapshot_interval *= 2;
+	for (uint32_t i = 0; i < pi->num_snapshots; i++)
+	{
+		if ((pi->snapshots[i].change_index + 1) % pi->snapshot_interval) continue;
+		if (num_kept != i) pi->snapshots[num_kept] = pi->snapshots[i];
+		num_kept++;
+	}
+	pi->num_snapshots = num_kept;
+}
+
+AVI_FUNC int avi_palette_index_build
+(
+	avi_palette_index *pi,
+	avi_stream_reader *s,
+	avi_palette_change_info *changes,
+	uint32_t max_changes,
+	avi_palette_snapshot *snapshots,
+	uint32_t max_snapshots,
+	uint32_t snapshot_interval
+)
+{
+	avi_stream_position saved;
+	avi_stream_position rewind = { 0 };
+	avi_palette_snapshot current;
+	int mute;
+	if (!pi || !s || !changes || !max_changes) return 0;
+	if (!avi_is_stream_indexed_color(s)) return 0;
+	if (!snapshots) max_snapshots = 0;
+	if (!snapshot_interval) snapshot_interval = 1;
+
+	memset(pi, 0, sizeof *pi);
+	pi->s = s;
+	pi->changes = changes;
+	pi->max_changes = max_changes;
+	pi->snapshots = snapshots;
+	pi->max_snapshots = max_snapshots;
+	pi->snapshot_interval = snapshot_interval;
+	if (!avi_palette_read_initial(pi)) return 0;
+
+	// Walk the stream with the initial palette, then give the caller's palette back.
+	avi_palette_take_snapshot(pi, &current, 0);
+	avi_palette_load_snapshot(pi, &pi->initial);
+	avi_stream_reader_get_position(s, &saved);
+	mute = s->mute_cur_stream_debug_print;
+	s->mute_cur_stream_debug_print = 1;
+
+	avi_stream_reader_set_position(s, &rewind);
+	while (avi_stream_reader_move_to_next_packet(s, 0))
+	{
+		avi_palette_change_info *change;
+		if (!avi_palette_is_change_packet(s->cur_4cc)) continue;
+		if (pi->num_changes >= pi->max_changes) goto ErrRet;
+		change = &pi->changes[pi->num_changes];
+		change->packet_index = s->cur_stream_packet_index;
+		change->offset = s->cur_packet_offset;
+		change->len = s->cur_packet_len;
+		if (!avi_palette_apply_change(pi, change)) goto ErrRet;
+		pi->num_changes++;
+		if (!pi->max_snapshots || pi->num_changes % pi->snapshot_interval) continue;
+		if (pi->num_snapshots >= pi->max_snapshots) avi_palette_thin_snapshots(pi);
+		if (pi->num_changes % pi->snapshot_interval == 0)
+		{
+			avi_palette_take_snapshot(pi, &pi->snapshots[pi->num_snapshots++], pi->num_changes - 1);
+		}
+	}
+
+	avi_stream_reader_set_position(s, &saved);
+	s->mute_cur_stream_debug_print = mute;
+	avi_palette_load_snapshot(pi, &current);
+	return 1;
+ErrRet:
+	avi_stream_reader_set_position(s, &saved);
+	s->mute_cur_stream_debug_print = mute;
+	avi_palette_load_snapshot(pi, &current);
+	return 0;
+}
+
+AVI_FUNC int avi_palette_index_restore(avi_palette_index *pi, fsize_t packet_index)
+{
+	const avi_palette_snapshot *snapshot = NULL;
+	uint32_t num_changes_before;
+	uint32_t first_change = 0;
+	uint32_t lo, hi;
+	if (!pi || !pi->s) return 0;
+
+	// Count the palette changes before the packet.
+	lo = 0;
+	hi = pi->num_changes;
+	while (lo < hi)
+	{
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (pi->changes[mid].packet_index < packet_index) lo = mid + 1;
+		else hi = mid;
+	}
+	num_changes_before = lo;
+
+	// Find the last snapshot within these changes.
+	lo = 0;
+	hi = pi->num_snapshots;
+	while (lo < hi)
+	{
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (pi->snapshots[mid].change_index < num_changes_before) lo = mid + 1;
+		else hi = mid;
+	}
+	if (lo)
+	{
+		snapshot = &pi->snapshots[lo - 1];
+		first_change = snapshot->change_index + 1;
+	}
+	avi_palette_load_snapshot(pi, snapshot ? snapshot : &pi->initial);
+
+	pi->num_changes_replayed = 0;
+	for (uint32_t i = first_change; i < num_changes_before; i++)
+	{
+		if (!avi_palette_apply_change(pi, &pi->changes[i])) return 0;
+		pi->num_changes_replayed++;
+	}
+	return 1;
+}
@@ -0,0 +1,86 @@
+#ifndef _AVI_PALETTE_H_
+#define _AVI_PALETTE_H_ 1
+
+#include "avi_reader.h"
+
+/// <summary>
+/// The position of a palette change packet (`##pc`) of an indexed color video stream.
+/// </summary>
+typedef struct
+{
+	fsize_t packet_index; /// The stream packet index of the palette change packet
+	fsize_t offset;       /// The position of the packet payload in the file.
+	fsize_t len;          /// The packet length
+}avi_palette_change_info;
+
+/// <summary>
+/// The palette after applying a palette change packet.
+/// </summary>
+typedef struct
+{
+	uint32_t change_index; /// The index of the palette change in `avi_palette_index::changes`
+	uint32_t clr_used;
+	uint32_t clr_important;
+	rgb_quad palette[256];
+}avi_palette_snapshot;
+
+/// <summary>
+/// The palette of an indexed color video depends on every palette change packet before the current frame.
+/// This index records the positions of the palette change packets, and the snapshots of the palette every `snapshot_interval` changes.
+/// The interval doubles whenever the snapshots are full, so however many changes the stream has, the snapshots are spread over all of them.
+/// After a random seek, the palette is restored from the nearest snapshot, then at most `snapshot_interval - 1` palette change packets are read.
+/// </summary>
+typedef struct
+{
+	avi_stream_reader *s;
+
+	/// The palette from the stream format `strf`, before any palette change.
+	avi_palette_snapshot initial;
+
+	/// Your buffer for the palette change positions
+	avi_palette_change_info *changes;
+	uint32_t max_changes;
+	uint32_t num_changes;
+
+	/// Your buffer for the snapshots, could be NULL, then every palette change before the frame is read.
+	avi_palette_snapshot *snapshots;
+	uint32_t max_snapshots;
+	uint32_t num_snapshots;
+	uint32_t snapshot_interval; /// The final interval after the snapshots were thinned out.
+
+	/// Number of palette change packets read by the last `avi_palette_index_restore()`
+	uint32_t num_changes_replayed;
+}avi_palette_index;
+
+/// <summary>
+/// Walk the packets of the stream to find the palette change packets and make the snapshots. The position of the stream reader is kept.
+/// </summary>
+/// <param name="pi">Your `avi_palette_index` to be initialized, it's big, better not to put it on the stack of your embedded device.</param>
+/// <param name="s">Your stream reader of an indexed color video stream</param>
+/// <param name="changes">Your buffer for the palette change positions</param>
+/// <param name="max_changes">Number of entries of `changes`</param>
+/// <param name="snapshots">Your buffer for the snapshots, could be NULL.</param>
+/// <param name="max_snapshots">Number of entries of `snapshots`</param>
+/// <param name="snapshot_interval">Make a snapshot at least every this many palette changes, zero for every change. When the snapshots are full, every other one is dropped and the interval doubles.</param>
+/// <returns>0 for fail (including more palette changes than `max_changes`), nonzero for success.</returns>
+AVI_FUNC int avi_palette_index_build
+(
+	avi_palette_index *pi,
+	avi_stream_reader *s,
+	avi_palette_change_info *changes,
+	uint32_t max_changes,
+	avi_palette_snapshot *snapshots,
+	uint32_t max_snapshots,
+	uint32_t snapshot_interval
+);
+
+/// <summary>
+/// Set the palette of the stream (`bitmap_format.palette`) to the palette of the packet, as if every palette change before it was applied.
+/// Call this after seeking, e.g. with `s->cur_stream_packet_index`.
+/// </summary>
+/// <param name="pi">Your `avi_palette_index`</param>
+/// <param name="packet_index">The stream packet index to restore the palette for.</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_palette_index_restore(avi_palette_index *pi, fsize_t packet_index);
+
+#endif
@@ -0,0 +1,491 @@
+#include "avi_pcm.h"
+
+#include <string.h>
+
+#ifdef AVI_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define WAVE_FORMAT_PCM 1
+#define WAVE_FORMAT_IEEE_FLOAT 3
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+AVI_FUNC int avi_pcm_get_stream_layout(avi_stream_reader *s, avi_pcm_layout *layout)
+{
+	wave_format_ex *wf;
+	if (!s || !s->stream_info || !layout) return 0;
+	if (!s->stream_info->format_data_is_valid) return 0;
+	if (!avi_stream_is_audio(s->stream_info)) return 0;
+
+	wf = &s->stream_info->audio_format;
+	if (!wf->nChannels || wf->nChannels > AVI_PCM_MAX_CHANNELS) return 0;
+	layout->channels = wf->nChannels;
+	layout->planar = 0;
+	layout->format = AVI_PCM_UNKNOWN;
+	switch (wf->wFormatTag)
+	{
+	case WAVE_FORMAT_PCM:
+		switch (wf->wBitsPerSample)
+		{
+		case 8: layout->format = AVI_PCM_U8; break;
+		case 16: layout->format = AVI_PCM_S16; break;
+		case 24: layout->format = AVI_PCM_S24; break;
+		case 32: layout->format = AVI_PCM_S32; break;
+		}
+		break;
+	case WAVE_FORMAT_IEEE_FLOAT:
+		if (wf->wBitsPerSample == 32) layout->format = AVI_PCM_F32;
+		break;
+	case WAVE_FORMAT_EXTENSIBLE:
+		// The sub format GUID is not kept, only the sizes that can't be float are taken as integers.
+		switch (wf->wBitsPerSample)
+		{
+		case 8: layout->format = AVI_PCM_U8; break;
+		case 16: layout->format = AVI_PCM_S16; break;
+		case 24: layout->format = AVI_PCM_S24; break;
+		}
+		break;
+	}
+	if (layout->format == AVI_PCM_UNKNOWN) return 0;
+	return wf->nBlockAlign == avi_pcm_get_bytes_per_sample(layout->format) * layout->channels;
+}
+
+AVI_FUNC uint32_t avi_pcm_get_bytes_per_sample(avi_pcm_sample_format format)
+{
+	switch (format)
+	{
+	case AVI_PCM_U8: return 1;
+	case AVI_PCM_S16: return 2;
+	case AVI_PCM_S24: return 3;
+	case AVI_PCM_S32: return 4;
+	case AVI_PCM_F32: return 4;
+	default: return 0;
+	}
+}
+
+AVI_STATIC_FUNC int avi_pcm_is_valid_layout(avi_pcm_layout l)
+{
+	return avi_pcm_get_bytes_per_sample(l.format) && l.channels && l.channels <= AVI_PCM_MAX_CHANNELS;
+}
+
+// Get the first sample of the channel and the step to the next sample.
+AVI_STATIC_FUNC size_t avi_pcm_get_sample_pos(avi_pcm_layout l, uint32_t total_frames, uint32_t frame, uint32_t channel, size_t *step)
+{
+	size_t bps = avi_pcm_get_bytes_per_sample(l.format);
+	if (l.planar)
+	{
+		*step = bps;
+		return ((size_t)channel * total_frames + frame) * bps;
+	}
+	*step = bps * l.channels;
+	return ((size_t)frame * l.channels + channel) * bps;
+}
+
+#ifdef AVI_USE_SSE2
+// The interleaved 16-bit samples to full scale `int32_t`, 8 samples at a time. Returns the number of samples done.
+AVI_STATIC_FUNC size_t avi_pcm_s16_to_s32_sse2(const uint8_t *src, int32_t *dst, size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)&src[i * 2]);
+		_mm_storeu_si128((__m128i *)&dst[i], _mm_unpacklo_epi16(zero, v));
+		_mm_storeu_si128((__m128i *)&dst[i + 4], _mm_unpackhi_epi16(zero, v));
+	}
+	return i;
+}
+
+// Full scale `int32_t` to the interleaved 16-bit samples, 8 samples at a time. Returns the number of samples done.
+AVI_STATIC_FUNC size_t avi_pcm_s32_to_s16_sse2(const int32_t *src, uint8_t *dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i a = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)&src[i]), 16);
+		__m128i b = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)&src[i + 4]), 16);
+		_mm_storeu_si128((__m128i *)&dst[i * 2], _mm_packs_epi32(a, b));
+	}
+	return i;
+}
+
+// Full scale `int32_t` to the interleaved float samples, 4 samples at a time. Returns the number of samples done.
+AVI_STATIC_FUNC size_t avi_pcm_s32_to_f32_sse2(const int32_t *src, uint8_t *dst, size_t count)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 v = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)&src[i]));
+		_mm_storeu_ps((float *)&dst[i * 4], _mm_mul_ps(v, scale));
+	}
+	return i;
+}
+#endif
+
+// Read the samples of `n` frames as full scale `int32_t`, interleaved.
+// The integer intermediate keeps the conversion fast on the CPUs without an FPU, unless the float format is involved.
+AVI_STATIC_FUNC void avi_pcm_read_block(const uint8_t *buf, avi_pcm_layout l, uint32_t total_frames, uint32_t first_frame, uint32_t n, int32_t *out)
+{
+#ifdef AVI_USE_SSE2
+	if (!l.planar && l.format == AVI_PCM_S16)
+	{
+		// The samples of the interleaved frames are already in the order of `out`.
+		size_t count = (size_t)n * l.channels;
+		const uint8_t *p = buf + (size_t)first_frame * l.channels * 2;
+		for (size_t i = avi_pcm_s16_to_s32_sse2(p, out, count); i < count; i++) out[i] = (int32_t)(int16_t)(p[i * 2] | (p[i * 2 + 1] << 8)) * 0x10000;
+		return;
+	}
+#endif
+	for (uint32_t ch = 0; ch < l.channels; ch++)
+	{
+		size_t step;
+		const uint8_t *p = buf + avi_pcm_get_sample_pos(l, total_frames, first_frame, ch, &step);
+		int32_t *o = out + ch;
+		switch (l.format)
+		{
+		case AVI_PCM_U8:
+			for (uint32_t f = 0; f < n; f++, p += step) o[f * l.channels] = ((int32_t)p[0] - 128) * 0x1000000;
+			break;
+		case AVI_PCM_S16:
+			for (uint32_t f = 0; f < n; f++, p += step) o[f * l.channels] = (int32_t)(int16_t)(p[0] | (p[1] << 8)) * 0x10000;
+			break;
+		case AVI_PCM_S24:
+			for (uint32_t f = 0; f < n; f++, p += step) o[f * l.channels] = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
+			break;
+		case AVI_PCM_S32:
+			for (uint32_t f = 0; f < n; f++, p += step) o[f * l.channels] = (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+			break;
+		case AVI_PCM_F32:
+			for (uint32_t f = 0; f < n; f++, p += step)
+			{
+				float v;
+				memcpy(&v, p, 4);
+				v *= 2147483648.0f;
+				if (v >= 2147483647.0f) o[f * l.channels] = INT32_MAX;
+				else if (v <= -2147483648.0f) o[f * l.channels] = INT32_MIN;
+				else o[f * l.channels] = (int32_t)v;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+AVI_STATIC_FUNC void avi_pcm_write_block(uint8_t *buf, avi_pcm_layout l, uint32_t total_frames, uint32_t first_frame, uint32_t n, const int32_t *in)
+{
+#ifdef AVI_USE_SSE2
+	if (!l.planar && (l.format == AVI_PCM_S16 || l.format == AVI_PCM_F32))
+	{
+		// Convert the bulk of the block here, then let the portable loops below finish the frames left.
+		size_t count = (size_t)n * l.channels;
+		uint8_t *p = buf + (size_t)first_frame * l.channels * avi_pcm_get_bytes_per_sample(l.format);
+		size_t done = l.format == AVI_PCM_S16 ? avi_pcm_s32_to_s16_sse2(in, p, count) : avi_pcm_s32_to_f32_sse2(in, p, count);
+		uint32_t done_frames = (uint32_t)(done / l.channels);
+		first_frame += done_frames;
+		n -= done_frames;
+		in += (size_t)done_frames * l.channels;
+	}
+#endif
+	for (uint32_t ch = 0; ch < l.channels; ch++)
+	{
+		size_t step;
+		uint8_t *p = buf + avi_pcm_get_sample_pos(l, total_frames, first_frame, ch, &step);
+		const int32_t *s = in + ch;
+		switch (l.format)
+		{
+		case AVI_PCM_U8:
+			for (uint32_t f = 0; f < n; f++, p += step) p[0] = (uint8_t)((s[f * l.channels] >> 24) + 128);
+			break;
+		case AVI_PCM_S16:
+			for (uint32_t f = 0; f < n; f++, p += step)
+			{
+				int32_t v = s[f * l.channels] >> 16;
+				p[0] = (uint8_t)v;
+				p[1] = (uint8_t)(v >> 8);
+			}
+			break;
+		case AVI_PCM_S24:
+			for (uint32_t f = 0; f < n; f++, p += step)
+			{
+				uint32_t v = (uint32_t)s[f * l.channels];
+				p[0] = (uint8_t)(v >> 8);
+				p[1] = (uint8_t)(v >> 16);
+				p[2] = (uint8_t)(v >> 24);
+			}
+			break;
+		case AVI_PCM_S32:
+			for (uint32_t f = 0; f < n; f++, p += step)
+			{
+				uint32_t v = (uint32_t)s[f * l.channels];
+				p[0] = (uint8_t)v;
+				p[1] = (uint8_t)(v >> 8);
+				p[2] = (uint8_t)(v >> 16);
+				p[3] = (uint8_t)(v >> 24);
+			}
+			break;
+		case AVI_PCM_F32:
+			for (uint32_t f = 0; f < n; f++, p += step)
+			{
+				float v = (float)s[f * l.channels] * (1.0f / 2147483648.0f);
+				memcpy(p, &v, 4);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+// The speakers of the default channel masks of `WAVEFORMATEXTENSIBLE`, the channels of a frame are in this order.
+enum
+{
+	AVI_SPK_FL, AVI_SPK_FR, AVI_SPK_FC, AVI_SPK_LFE, AVI_SPK_BL, AVI_SPK_BR, AVI_SPK_BC, AVI_SPK_SL, AVI_SPK_SR, AVI_SPK_NONE
+};
+
+static const uint8_t avi_pcm_speakers[9][8] =
+{
+	{ AVI_SPK_NONE },
+	{ AVI_SPK_FC },
+	{ AVI_SPK_FL, AVI_SPK_FR },
+	{ AVI_SPK_FL, AVI_SPK_FR, AVI_SPK_FC },
+	{ AVI_SPK_FL, AVI_SPK_FR, AVI_SPK_BL, AVI_SPK_BR },
+	{ AVI_SPK_FL, AVI_SPK_FR, AVI_SPK_FC, AVI_SPK_BL, AVI_SPK_BR },
+	{ AVI_SPK_FL, AVI_SPK_FR, AVI_SPK_FC, AVI_SPK_LFE, AVI_SPK_BL, AVI_SPK_BR },
+	{ AVI_SPK_FL, AVI_SPK_FR, AVI_SPK_FC, AVI_SPK_LFE, AVI_SPK_BC, AVI_SPK_SL, AVI_SPK_SR },
+	{ AVI_SPK_FL, AVI_SPK_FR, AVI_SPK_FC, AVI_SPK_LFE, AVI_SPK_BL, AVI_SPK_BR, AVI_SPK_SL, AVI_SPK_SR },
+};
+
+// The gains of the mixing matrix are 16.16 fixed point, -3 dB is `0.7071`.
+#define AVI_PCM_GAIN_ONE 0x10000
+#define AVI_PCM_GAIN_M3DB 46341
+
+AVI_STATIC_FUNC int avi_pcm_find_speaker(uint32_t channels, uint8_t speaker)
+{
+	for (uint32_t c = 0; c < channels; c++)
+	{
+		if (avi_pcm_speakers[channels][c] == speaker) return (int)c;
+	}
+	return -1;
+}
+
+// Add a source speaker to the row of gains of the destination channels. A speaker missing in the destination is folded into its neighbors at -3 dB,
+// the surrounds fall back to the other pair of surrounds first. The LFE channel is dropped.
+AVI_STATIC_FUNC void avi_pcm_add_speaker(int64_t *gains, uint32_t dst_channels, uint8_t speaker, int64_t gain)
+{
+	int c = avi_pcm_find_speaker(dst_channels, speaker);
+	int c1, c2;
+	if (c >= 0)
+	{
+		gains[c] += gain;
+		return;
+	}
+	switch (speaker)
+	{
+	case AVI_SPK_FL:
+	case AVI_SPK_FR:
+		avi_pcm_add_speaker(gains, dst_channels, AVI_SPK_FC, gain * AVI_PCM_GAIN_M3DB / AVI_PCM_GAIN_ONE);
+		break;
+	case AVI_SPK_FC:
+		avi_pcm_add_speaker(gains, dst_channels, AVI_SPK_FL, gain * AVI_PCM_GAIN_M3DB / AVI_PCM_GAIN_ONE);
+		avi_pcm_add_speaker(gains, dst_channels, AVI_SPK_FR, gain * AVI_PCM_GAIN_M3DB / AVI_PCM_GAIN_ONE);
+		break;
+	case AVI_SPK_BL:
+	case AVI_SPK_SL:
+		c = avi_pcm_find_speaker(dst_channels, speaker == AVI_SPK_BL ? AVI_SPK_SL : AVI_SPK_BL);
+		if (c >= 0) gains[c] += gain;
+		else avi_pcm_add_speaker(gains, dst_channels, AVI_SPK_FL, gain * AVI_PCM_GAIN_M3DB / AVI_PCM_GAIN_ONE);
+		break;
+	case AVI_SPK_BR:
+	case AVI_SPK_SR:
+		c = avi_pcm_find_speaker(dst_channels, speaker == AVI_SPK_BR ? AVI_SPK_SR : AVI_SPK_BR);
+		if (c >= 0) gains[c] += gain;
+		else avi_pcm_add_speaker(gains, dst_channels, AVI_SPK_FR, gain * AVI_PCM_GAIN_M3DB / AVI_PCM_GAIN_ONE);
+		break;
+	case AVI_SPK_BC:
+		c1 = avi_pcm_find_speaker(dst_channels, AVI_SPK_BL);
+		c2 = avi_pcm_find_speaker(dst_channels, AVI_SPK_BR);
+		if (c1 < 0 || c2 < 0)
+		{
+			c1 = avi_pcm_find_speaker(dst_channels, AVI_SPK_SL);
+			c2 = avi_pcm_find_speaker(dst_channels, AVI_SPK_SR);
+		}
+		if (c1 >= 0 && c2 >= 0)
+		{
+			gains[c1] += gain * AVI_PCM_GAIN_M3DB / AVI_PCM_GAIN_ONE;
+			gains[c2] += gain * AVI_PCM_GAIN_M3DB / AVI_PCM_GAIN_ONE;
+		}
+		else
+		{
+			avi_pcm_add_speaker(gains, dst_channels, AVI_SPK_FL, gain * AVI_PCM_GAIN_M3DB / AVI_PCM_GAIN_ONE);
+			avi_pcm_add_speaker(gains, dst_channels, AVI_SPK_FR, gain * AVI_PCM_GAIN_M3DB / AVI_PCM_GAIN_ONE);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+// Make the mixing matrix `matrix[dst_channel * src_channels + src_channel]`.
+// Each destination channel is normalized so its gains add up to at most 1, e.g. stereo to mono is `(L + R) / 2`.
+AVI_STATIC_FUNC void avi_pcm_make_mix_matrix(uint32_t src_channels, uint32_t dst_channels, int32_t *matrix)
+{
+	int64_t gains[AVI_PCM_MAX_CHANNELS * AVI_PCM_MAX_CHANNELS] = { 0 };
+	if (src_channels > 8 || dst_channels > 8)
+	{
+		// No speaker positions for so many channels, the channels are matched by the number.
+		for (uint32_t c = 0; c < dst_channels && c < src_channels; c++) gains[c * src_channels + c] = AVI_PCM_GAIN_ONE;
+	}
+	else if (src_channels == 1)
+	{
+		// Mono goes to both front speakers, or the center one.
+		int fl = avi_pcm_find_speaker(dst_channels, AVI_SPK_FL);
+		int fr = avi_pcm_find_speaker(dst_channels, AVI_SPK_FR);
+		if (fl >= 0 && fr >= 0)
+		{
+			gains[fl] = AVI_PCM_GAIN_ONE;
+			gains[fr] = AVI_PCM_GAIN_ONE;
+		}
+		else
+		{
+			gains[avi_pcm_find_speaker(dst_channels, AVI_SPK_FC)] = AVI_PCM_GAIN_ONE;
+		}
+	}
+	else
+	{
+		for (uint32_t i = 0; i < src_channels; i++)
+		{
+			int64_t column[8] = { 0 };
+			avi_pcm_add_speaker(column, dst_channels, avi_pcm_speakers[src_channels][i], AVI_PCM_GAIN_ONE);
+			for (uint32_t c = 0; c < dst_channels; c++) gains[c * src_channels + i] = column[c];
+		}
+	}
+
+	for (uint32_t c = 0; c < dst_channels; c++)
+	{
+		int64_t *row = &gains[c * src_channels];
+		int64_t sum = 0;
+		for (uint32_t i = 0; i < src_channels; i++) sum += row[i];
+		for (uint32_t i = 0; i < src_channels; i++) matrix[c * src_channels + i] = (int32_t)(sum > AVI_PCM_GAIN_ONE ? row[i] * AVI_PCM_GAIN_ONE / sum : row[i]);
+	}
+}
+
+AVI_STATIC_FUNC void avi_pcm_mix_block(const int32_t *in, uint32_t in_channels, int32_t *out, uint32_t out_channels, uint32_t n, const int32_t *matrix)
+{
+	for (uint32_t f = 0; f < n; f++)
+	{
+		const int32_t *fi = &in[f * in_channels];
+		int32_t *fo = &out[f * out_channels];
+		for (uint32_t c = 0; c < out_channels; c++)
+		{
+			const int32_t *row = &matrix[c * in_channels];
+			int64_t sum = 0;
+			for (uint32_t j = 0; j < in_channels; j++) sum += (int64_t)fi[j] * row[j];
+			sum /= AVI_PCM_GAIN_ONE;
+			if (sum > INT32_MAX) sum = INT32_MAX;
+			if (sum < INT32_MIN) sum = INT32_MIN;
+			fo[c] = (int32_t)sum;
+		}
+	}
+}
+
+// Convert `n` frames, the buffers could have more frames than `n` for the planar layouts.
+AVI_STATIC_FUNC void avi_pcm_convert_frames
+(
+	const uint8_t *src,
+	avi_pcm_layout src_layout,
+	uint32_t src_total_frames,
+	uint8_t *dst,
+	avi_pcm_layout dst_layout,
+	uint32_t dst_total_frames,
+	uint32_t dst_first_frame,
+	uint32_t n
+)
+{
+	int32_t in[AVI_PCM_BLOCK_FRAMES * AVI_PCM_MAX_CHANNELS];
+	int32_t mixed[AVI_PCM_BLOCK_FRAMES * AVI_PCM_MAX_CHANNELS];
+	int32_t matrix[AVI_PCM_MAX_CHANNELS * AVI_PCM_MAX_CHANNELS];
+	int need_mix = src_layout.channels != dst_layout.channels;
+	if (need_mix) avi_pcm_make_mix_matrix(src_layout.channels, dst_layout.channels, matrix);
+	for (uint32_t first = 0; first < n; first += AVI_PCM_BLOCK_FRAMES)
+	{
+		uint32_t count = n - first < AVI_PCM_BLOCK_FRAMES ? n - first : AVI_PCM_BLOCK_FRAMES;
+		avi_pcm_read_block(src, src_layout, src_total_frames, first, count, in);
+		if (need_mix) avi_pcm_mix_block(in, src_layout.channels, mixed, dst_layout.channels, count, matrix);
+		avi_pcm_write_block(dst, dst_layout, dst_total_frames, dst_first_frame + first, count, need_mix ? mixed : in);
+	}
+}
+
+AVI_FUNC size_t avi_pcm_convert(const void *src, avi_pcm_layout src_layout, void *dst, avi_pcm_layout dst_layout, uint32_t num_frames)
+{
+	size_t dst_size;
+	if (!src || !dst) return 0;
+	if (!avi_pcm_is_valid_layout(src_layout) || !avi_pcm_is_valid_layout(dst_layout)) return 0;
+
+	dst_size = (size_t)num_frames * dst_layout.channels * avi_pcm_get_bytes_per_sample(dst_layout.format);
+	if (src == dst)
+	{
+		size_t src_frame_size = (size_t)src_layout.channels * avi_pcm_get_bytes_per_sample(src_layout.format);
+		size_t dst_frame_size = (size_t)dst_layout.channels * avi_pcm_get_bytes_per_sample(dst_layout.format);
+		if (src_layout.planar || dst_layout.planar) return 0;
+		if (dst_frame_size > src_frame_size) return 0;
+	}
+	avi_pcm_convert_frames(src, src_layout, num_frames, dst, dst_layout, num_frames, 0, num_frames);
+	return dst_size;
+}
+
+AVI_FUNC int avi_pcm_converter_init(avi_pcm_converter *c, avi_pcm_layout src_layout, avi_pcm_layout dst_layout)
+{
+	if (!c) return 0;
+	if (!avi_pcm_is_valid_layout(src_layout) || !avi_pcm_is_valid_layout(dst_layout)) return 0;
+	if (src_layout.planar) return 0;
+	memset(c, 0, sizeof *c);
+	c->src = src_layout;
+	c->dst = dst_layout;
+	return 1;
+}
+
+AVI_FUNC uint32_t avi_pcm_converter_process(avi_pcm_converter *c, const void *packet, size_t len, void *dst, uint32_t max_frames)
+{
+	const uint8_t *p = packet;
+	size_t frame_size;
+	uint64_t num_frames;
+	uint32_t total, done = 0, n;
+	size_t tail;
+	if (!c || !dst || (!p && len)) return 0;
+
+	frame_size = (size_t)c->src.channels * avi_pcm_get_bytes_per_sample(c->src.format);
+	num_frames = ((uint64_t)c->partial_len + len) / frame_size;
+	total = num_frames < max_frames ? (uint32_t)num_frames : max_frames;
+
+	// Finish the frame cut by the last packet.
+	if (c->partial_len)
+	{
+		size_t need = frame_size - c->partial_len;
+		if (len < need)
+		{
+			memcpy(c->partial + c->partial_len, p, len);
+			c->partial_len += (uint32_t)len;
+			return 0;
+		}
+		memcpy(c->partial + c->partial_len, p, need);
+		p += need;
+		len -= need;
+		c->partial_len = 0;
+		if (total)
+		{
+			avi_pcm_convert_frames(c->partial, c->src, 1, dst, c->dst, total, 0, 1);
+			done = 1;
+		}
+	}
+
+	n = (uint32_t)(len / frame_size < (size_t)(total - done) ? len / frame_size : (size_t)(total - done));
+	avi_pcm_convert_frames(p, c->src, n, dst, c->dst, total, done, n);
+	done += n;
+
+	tail = len % frame_size;
+	memcpy(c->partial, p + len - tail, tail);
+	c->partial_len = (uint32_t)tail;
+	return done;
+}
@@ -0,0 +1,104 @@
+#ifndef _AVI_PCM_H_
+#define _AVI_PCM_H_ 1
+
+#include "avi_reader.h"
+
+#ifndef AVI_PCM_MAX_CHANNELS
+#define AVI_PCM_MAX_CHANNELS 8
+#endif
+
+/// <summary>
+/// The frames converted per step, the samples of a step are kept on the stack as `int32_t`.
+/// </summary>
+#ifndef AVI_PCM_BLOCK_FRAMES
+#define AVI_PCM_BLOCK_FRAMES 16
+#endif
+
+typedef enum
+{
+	AVI_PCM_UNKNOWN = 0,
+	AVI_PCM_U8 = 1,
+	AVI_PCM_S16 = 2,
+	AVI_PCM_S24 = 3, /// Packed in 3 bytes
+	AVI_PCM_S32 = 4,
+	AVI_PCM_F32 = 5, /// From -1.0 to 1.0
+}avi_pcm_sample_format;
+
+/// <summary>
+/// The layout of the PCM samples in a buffer, all little endian.
+/// The interleaved samples are in the order of frames, a frame has one sample of each channel.
+/// The planar samples are in the order of channels, each channel has `num_frames` samples of the buffer.
+/// </summary>
+typedef struct
+{
+	avi_pcm_sample_format format;
+	uint32_t channels;
+	int planar;
+}avi_pcm_layout;
+
+/// <summary>
+/// Converts the PCM packets of a stream, a frame cut by the end of a packet is kept until the next packet.
+/// </summary>
+typedef struct
+{
+	avi_pcm_layout src;
+	avi_pcm_layout dst;
+
+	/// The bytes of an unfinished frame from the last packet
+	uint8_t partial[AVI_PCM_MAX_CHANNELS * 4];
+	uint32_t partial_len;
+}avi_pcm_converter;
+
+/// <summary>
+/// Get the sample layout of a PCM audio stream, `WAVE_FORMAT_PCM` or `WAVE_FORMAT_IEEE_FLOAT`. The samples in the AVI file are interleaved.
+/// </summary>
+/// <param name="s">Your stream reader of an audio stream</param>
+/// <param name="layout">Your `avi_pcm_layout` to receive the layout</param>
+/// <returns>0 for fail (not a PCM stream, or too many channels), nonzero for success.</returns>
+AVI_FUNC int avi_pcm_get_stream_layout(avi_stream_reader *s, avi_pcm_layout *layout);
+
+/// <summary>
+/// Get the bytes of one sample of the format.
+/// </summary>
+/// <returns>0 for `AVI_PCM_UNKNOWN`</returns>
+AVI_FUNC uint32_t avi_pcm_get_bytes_per_sample(avi_pcm_sample_format format);
+
+/// <summary>
+/// Convert the samples to another format, layout, or number of channels.
+/// The channels are mixed by the speakers of the default channel masks: 1 is mono, 2 is stereo, 3 is `FL FR FC`, 4 is `FL FR BL BR`, 5 is `FL FR FC BL BR`,
+/// 6 is 5.1 `FL FR FC LFE BL BR`, 7 is 6.1 `FL FR FC LFE BC SL SR`, 8 is 7.1 `FL FR FC LFE BL BR SL SR`.
+/// A source speaker missing in the destination is mixed into its neighbors at -3 dB, e.g. the center and the surrounds into both front speakers,
+/// the LFE channel is dropped, then each destination channel is normalized so it can't clip, e.g. stereo to mono is `(L + R) / 2`.
+/// Mono to more channels duplicates the channel into both front speakers, the other destination speakers missing in the source are silent.
+/// With more than 8 channels, the channels are matched by the number.
+/// The conversion could be done in place if both layouts are interleaved, and the destination frame is not bigger than the source frame.
+/// </summary>
+/// <param name="src">The source samples</param>
+/// <param name="src_layout">The source layout</param>
+/// <param name="dst">Your buffer for the destination samples</param>
+/// <param name="dst_layout">The destination layout</param>
+/// <param name="num_frames">Number of frames to convert</param>
+/// <returns>The bytes written to `dst`, 0 for fail.</returns>
+AVI_FUNC size_t avi_pcm_convert(const void *src, avi_pcm_layout src_layout, void *dst, avi_pcm_layout dst_layout, uint32_t num_frames);
+
+/// <summary>
+/// Initialize the converter for the packets of an audio stream.
+/// </summary>
+/// <param name="c">Your `avi_pcm_converter` to be initialized</param>
+/// <param name="src_layout">The layout of the packets, must be interleaved, see `avi_pcm_get_stream_layout()`</param>
+/// <param name="dst_layout">The layout you want</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_pcm_converter_init(avi_pcm_converter *c, avi_pcm_layout src_layout, avi_pcm_layout dst_layout);
+
+/// <summary>
+/// Convert a packet. The frames completed by this packet are written to `dst`, for the planar layout, each channel has the returned number of samples.
+/// </summary>
+/// <param name="c">Your `avi_pcm_converter`</param>
+/// <param name="packet">The packet data, e.g. read by `avi_stream_reader_read_packet()`</param>
+/// <param name="len">The length of the packet</param>
+/// <param name="dst">Your buffer for the destination samples</param>
+/// <param name="max_frames">The capacity of `dst` in frames, should be at least `len / src_frame_size + 1`, the frames that don't fit are dropped.</param>
+/// <returns>Number of frames written to `dst`</returns>
+AVI_FUNC uint32_t avi_pcm_converter_process(avi_pcm_converter *c, const void *packet, size_t len, void *dst, uint32_t max_frames);
+
+#endif
@@ -0,0 +1,179 @@
+#include "avi_pipeline.h"
+
+#include <string.h>
+
+AVI_STATIC_FUNC void avi_pipeline_lock(avi_pipeline *p)
+{
+	if (p->f_lock) p->f_lock(p->userdata);
+}
+
+AVI_STATIC_FUNC void avi_pipeline_unlock(avi_pipeline *p)
+{
+	if (p->f_unlock) p->f_unlock(p->userdata);
+}
+
+AVI_STATIC_FUNC avi_pipeline_slot *avi_pipeline_get_slot(avi_pipeline *p, uint64_t seq)
+{
+	return &p->slots[seq % p->num_slots];
+}
+
+AVI_FUNC int avi_pipeline_init
+(
+	avi_pipeline *p,
+	avi_stream_reader *s,
+	avi_pipeline_slot *slots,
+	uint32_t num_slots,
+	avi_pipeline_drop_policy drop_policy,
+	avi_pipeline_work_cb f_work,
+	avi_pipeline_deliver_cb f_deliver,
+	void *userdata,
+	avi_lock_cb f_lock,
+	avi_lock_cb f_unlock
+)
+{
+	if (!p) return 0;
+	if (!s || !slots || !num_slots) return 0;
+	if (!f_work || !f_deliver) return 0;
+	if (!f_lock != !f_unlock) return 0;
+
+	memset(p, 0, sizeof *p);
+	p->s = s;
+	p->slots = slots;
+	p->num_slots = num_slots;
+	p->drop_policy = drop_policy;
+	p->f_work = f_work;
+	p->f_deliver = f_deliver;
+	p->userdata = userdata;
+	p->f_lock = f_lock;
+	p->f_unlock = f_unlock;
+	for (uint32_t i = 0; i < num_slots; i++)
+	{
+		slots[i].state = AVI_SLOT_FREE;
+		slots[i].packet_len = 0;
+		slots[i].stream_packet_index = 0;
+		slots[i].is_ok = 0;
+	}
+	return 1;
+}
+
+AVI_FUNC avi_step_result avi_pipeline_feed(avi_pipeline *p)
+{
+	avi_stream_reader *s;
+	avi_pipeline_slot *slot;
+	int is_free;
+	if (!p) return AVI_STEP_FAILED;
+	s = p->s;
+	if (p->is_end_of_stream) return AVI_STEP_FAILED;
+
+	avi_pipeline_lock(p);
+	slot = avi_pipeline_get_slot(p, p->feed_seq);
+	is_free = (slot->state == AVI_SLOT_FREE);
+	if (is_free) slot->state = AVI_SLOT_READING;
+	avi_pipeline_unlock(p);
+
+	// The consumer falls behind, the incoming packet could be dropped without reading its payload.
+	if (!is_free && p->drop_policy == AVI_PIPELINE_WAIT) return AVI_STEP_IN_PROGRESS;
+
+	if (!p->has_held_packet)
+	{
+		if (!avi_stream_reader_move_to_next_packet(s, 0)) goto EndOfStream;
+	}
+	p->has_held_packet = 0;
+
+	if (!is_free)
+	{
+		if (p->drop_policy == AVI_PIPELINE_DROP_NON_KEYFRAME && s->cur_packet_is_keyframe)
+		{
+			// Don't drop the key frame, hold it and feed it next time.
+			p->has_held_packet = 1;
+			return AVI_STEP_IN_PROGRESS;
+		}
+		p->num_dropped++;
+		return AVI_STEP_DONE;
+	}
+
+	slot->stream_packet_index = s->cur_stream_packet_index;
+	slot->packet_len = s->cur_packet_len;
+	slot->is_ok = avi_stream_reader_read_packet(s, slot->packet_buffer, slot->packet_buffer_size);
+
+	avi_pipeline_lock(p);
+	slot->state = slot->is_ok ? AVI_SLOT_PENDING : AVI_SLOT_DONE;
+	p->feed_seq++;
+	avi_pipeline_unlock(p);
+	return AVI_STEP_DONE;
+
+EndOfStream:
+	avi_pipeline_lock(p);
+	if (is_free) slot->state = AVI_SLOT_FREE;
+	p->is_end_of_stream = 1;
+	avi_pipeline_unlock(p);
+	return AVI_STEP_FAILED;
+}
+
+AVI_FUNC int avi_pipeline_work(avi_pipeline *p)
+{
+	avi_pipeline_slot *slot = NULL;
+	int is_ok;
+	if (!p) return 0;
+
+	// Take the oldest pending packet, so that the consumer gets the results as early as possible.
+	avi_pipeline_lock(p);
+	for (uint64_t seq = p->deliver_seq; seq < p->feed_seq; seq++)
+	{
+		avi_pipeline_slot *cur = avi_pipeline_get_slot(p, seq);
+		if (cur->state == AVI_SLOT_PENDING)
+		{
+			cur->state = AVI_SLOT_WORKING;
+			slot = cur;
+			break;
+		}
+	}
+	avi_pipeline_unlock(p);
+	if (!slot) return 0;
+
+	is_ok = p->f_work(slot->packet_buffer, slot->packet_len, slot->stream_packet_index, slot->result, p->userdata);
+
+	avi_pipeline_lock(p);
+	slot->is_ok = is_ok;
+	slot->state = AVI_SLOT_DONE;
+	avi_pipeline_unlock(p);
+	return 1;
+}
+
+AVI_FUNC uint32_t avi_pipeline_deliver(avi_pipeline *p)
+{
+	uint32_t delivered = 0;
+	if (!p) return 0;
+
+	for (;;)
+	{
+		avi_pipeline_slot *slot;
+		int is_done;
+
+		avi_pipeline_lock(p);
+		slot = avi_pipeline_get_slot(p, p->deliver_seq);
+		is_done = (p->deliver_seq < p->feed_seq && slot->state == AVI_SLOT_DONE);
+		if (is_done) slot->state = AVI_SLOT_DELIVERING;
+		avi_pipeline_unlock(p);
+		if (!is_done) break;
+
+		p->f_deliver(slot->stream_packet_index, slot->result, slot->is_ok, p->userdata);
+		delivered++;
+
+		avi_pipeline_lock(p);
+		slot->state = AVI_SLOT_FREE;
+		p->deliver_seq++;
+		avi_pipeline_unlock(p);
+	}
+	return delivered;
+}
+
+AVI_FUNC int avi_pipeline_is_finished(avi_pipeline *p)
+{
+	int ret;
+	if (!p) return 1;
+	avi_pipeline_lock(p);
+	ret = p->is_end_of_stream && p->deliver_seq == p->feed_seq;
+	avi_pipeline_unlock(p);
+	return ret;
+}
@@ -0,0 +1,165 @@
+#ifndef _AVI_PIPELINE_H_
+#define _AVI_PIPELINE_H_ 1
+
+#include "avi_reader.h"
+
+/// <summary>
+/// Process the packet, e.g. decode a JPEG frame. Called by your worker threads concurrently, without holding the lock.
+/// </summary>
+/// <param name="packet_data">The payload of the packet</param>
+/// <param name="packet_len">The length of the payload</param>
+/// <param name="stream_packet_index">The packet index of the stream</param>
+/// <param name="result">The result buffer of the slot, you provided it in `avi_pipeline_slot`</param>
+/// <param name="userdata">The data you passed to `avi_pipeline_init()`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+typedef int(*avi_pipeline_work_cb)(const void *packet_data, fsize_t packet_len, fsize_t stream_packet_index, void *result, void *userdata);
+
+/// <summary>
+/// Receive the processed packet, strictly in the order of the stream. Dropped packets are not delivered.
+/// </summary>
+/// <param name="stream_packet_index">The packet index of the stream</param>
+/// <param name="result">The result buffer of the slot, filled by your `avi_pipeline_work_cb`</param>
+/// <param name="is_ok">Nonzero if your `avi_pipeline_work_cb` succeeded.</param>
+/// <param name="userdata">The data you passed to `avi_pipeline_init()`</param>
+typedef void(*avi_pipeline_deliver_cb)(fsize_t stream_packet_index, void *result, int is_ok, void *userdata);
+
+/// <summary>
+/// Your mutex lock/unlock functions. The pipeline has no threads by itself, you run the threads.
+/// </summary>
+typedef void(*avi_lock_cb)(void *userdata);
+
+/// What to do when all of the slots are busy because the consumer falls behind.
+typedef enum
+{
+	/// `avi_pipeline_feed()` returns `AVI_STEP_IN_PROGRESS`, call it again later.
+	AVI_PIPELINE_WAIT = 0,
+
+	/// Skip the incoming packet.
+	AVI_PIPELINE_DROP_INCOMING = 1,
+
+	/// Skip the incoming packet only if it's not a key frame, otherwise wait.
+	AVI_PIPELINE_DROP_NON_KEYFRAME = 2,
+}avi_pipeline_drop_policy;
+
+typedef enum
+{
+	AVI_SLOT_FREE = 0,
+	AVI_SLOT_READING,
+	AVI_SLOT_PENDING,
+	AVI_SLOT_WORKING,
+	AVI_SLOT_DONE,
+	AVI_SLOT_DELIVERING,
+}avi_pipeline_slot_state;
+
+/// <summary>
+/// A slot of the reorder window. You provide the buffers, the pipeline never allocates memory.
+/// </summary>
+typedef struct
+{
+	/// Your buffer to store the packet payload.
+	void *packet_buffer;
+
+	/// The size of `packet_buffer`. `dwSuggestedBufferSize` of the stream header is a good hint.
+	size_t packet_buffer_size;
+
+	/// Your buffer to store the result of your `avi_pipeline_work_cb`.
+	void *result;
+
+	/// The state of the slot, managed by the pipeline.
+	volatile avi_pipeline_slot_state state;
+	fsize_t packet_len;
+	fsize_t stream_packet_index;
+	int is_ok;
+}avi_pipeline_slot;
+
+/// <summary>
+/// Hands the packets of an `avi_stream_reader` to your workers, then delivers the results in the order of the stream.
+/// One producer calls `avi_pipeline_feed()`, any number of workers call `avi_pipeline_work()`, one consumer calls `avi_pipeline_deliver()`.
+/// The slots are used as a ring buffer, so at most `num_slots` packets are in flight, which bounds the reorder window.
+/// </summary>
+typedef struct
+{
+	avi_stream_reader *s;
+	avi_pipeline_slot *slots;
+	uint32_t num_slots;
+	avi_pipeline_drop_policy drop_policy;
+
+	void *userdata; /// The data to pass to your callback functions.
+	avi_pipeline_work_cb f_work;
+	avi_pipeline_deliver_cb f_deliver;
+	avi_lock_cb f_lock;
+	avi_lock_cb f_unlock;
+
+	/// The sequence number of the next slot to feed.
+	uint64_t feed_seq;
+
+	/// The sequence number of the next slot to deliver.
+	uint64_t deliver_seq;
+
+	/// A key frame is waiting for a free slot, see `AVI_PIPELINE_DROP_NON_KEYFRAME`.
+	int has_held_packet;
+
+	/// The stream has no more packets to feed.
+	volatile int is_end_of_stream;
+
+	/// Number of packets dropped due to the drop policy.
+	fsize_t num_dropped;
+}avi_pipeline;
+
+/// <summary>
+/// Initialize the pipeline.
+/// </summary>
+/// <param name="p">Your pipeline to be initialized</param>
+/// <param name="s">Your stream reader, only used by `avi_pipeline_feed()`</param>
+/// <param name="slots">Your slots with their buffers</param>
+/// <param name="num_slots">Number of slots, usually a bit more than your number of workers</param>
+/// <param name="drop_policy">See `avi_pipeline_drop_policy`</param>
+/// <param name="f_work">Your function to process a packet</param>
+/// <param name="f_deliver">Your function to receive the results in order</param>
+/// <param name="userdata">The data to pass to your callback functions</param>
+/// <param name="f_lock">Your mutex lock function. Passing NULL is allowed if you use the pipeline in one thread.</param>
+/// <param name="f_unlock">Your mutex unlock function. Passing NULL is allowed if you use the pipeline in one thread.</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_pipeline_init
+(
+	avi_pipeline *p,
+	avi_stream_reader *s,
+	avi_pipeline_slot *slots,
+	uint32_t num_slots,
+	avi_pipeline_drop_policy drop_policy,
+	avi_pipeline_work_cb f_work,
+	avi_pipeline_deliver_cb f_deliver,
+	void *userdata,
+	avi_lock_cb f_lock,
+	avi_lock_cb f_unlock
+);
+
+/// <summary>
+/// Move the stream reader to the next packet, then read its payload into a free slot.
+/// </summary>
+/// <param name="p">Your pipeline</param>
+/// <returns>`AVI_STEP_DONE` if a packet was queued or dropped, `AVI_STEP_IN_PROGRESS` if no slot is free, `AVI_STEP_FAILED` for the end of the stream or fail.</returns>
+AVI_FUNC avi_step_result avi_pipeline_feed(avi_pipeline *p);
+
+/// <summary>
+/// Take the oldest pending packet and process it by calling your `avi_pipeline_work_cb`. Call it from your worker threads.
+/// </summary>
+/// <param name="p">Your pipeline</param>
+/// <returns>Nonzero if a packet was processed, 0 if there's nothing to do.</returns>
+AVI_FUNC int avi_pipeline_work(avi_pipeline *p);
+
+/// <summary>
+/// Deliver every processed packet that is next in the order of the stream by calling your `avi_pipeline_deliver_cb`.
+/// </summary>
+/// <param name="p">Your pipeline</param>
+/// <returns>Number of packets delivered.</returns>
+AVI_FUNC uint32_t avi_pipeline_deliver(avi_pipeline *p);
+
+/// <summary>
+/// Check if all of the packets of the stream were fed and delivered.
+/// </summary>
+/// <param name="p">Your pipeline</param>
+/// <returns>Nonzero if finished.</returns>
+AVI_FUNC int avi_pipeline_is_finished(avi_pipeline *p);
+
+#endif
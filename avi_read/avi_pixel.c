@@ -0,0 +1,715 @@
+#include "avi_pixel.h"
+
+#include <string.h>
+
+#ifdef AVI_USE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef AVI_USE_SSSE3
+#include <tmmintrin.h>
+#endif
+#ifdef AVI_USE_AVX2
+#include <immintrin.h>
+#endif
+
+// Convert one row of pixels. The loops are kept simple so the compiler could vectorize them.
+typedef void (*avi_pixel_row_cb)(const uint8_t *src, uint8_t *dst, uint32_t width);
+
+#ifdef AVI_USE_SSE2
+// Convert the 32-bit pixels 4 at a time: swap the first and the third bytes if `swap_rb`, then set the bits of `set_bits`, e.g. the alpha byte.
+// Returns the number of pixels done, the rest are left for the portable loop.
+AVI_STATIC_FUNC uint32_t avi_pixel_shuffle32_sse2(const uint8_t *src, uint8_t *dst, uint32_t width, int swap_rb, uint32_t set_bits)
+{
+	const __m128i keep = _mm_set1_epi32(swap_rb ? (int)0xFF00FF00 : -1);
+	const __m128i low = _mm_set1_epi32(0xFF);
+	const __m128i set = _mm_set1_epi32((int)set_bits);
+	uint32_t x = 0;
+	for (; x + 4 <= width; x += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)&src[x * 4]);
+		__m128i r = _mm_and_si128(v, keep);
+		if (swap_rb)
+		{
+			r = _mm_or_si128(r, _mm_and_si128(_mm_srli_epi32(v, 16), low));
+			r = _mm_or_si128(r, _mm_slli_epi32(_mm_and_si128(v, low), 16));
+		}
+		_mm_storeu_si128((__m128i *)&dst[x * 4], _mm_or_si128(r, set));
+	}
+	return x;
+}
+#endif
+
+AVI_STATIC_FUNC uint8_t avi_pixel_expand5(uint32_t v)
+{
+	return (uint8_t)((v << 3) | (v >> 2));
+}
+
+AVI_STATIC_FUNC uint8_t avi_pixel_expand6(uint32_t v)
+{
+	return (uint8_t)((v << 2) | (v >> 4));
+}
+
+AVI_STATIC_FUNC void avi_pixel_write565(uint8_t *dst, uint32_t r, uint32_t g, uint32_t b)
+{
+	uint32_t v = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+	dst[0] = (uint8_t)v;
+	dst[1] = (uint8_t)(v >> 8);
+}
+
+AVI_STATIC_FUNC void avi_pixel_rgb555_to_rgb565(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++)
+	{
+		uint32_t v = src[x * 2] | ((uint32_t)src[x * 2 + 1] << 8);
+		uint32_t g = (v >> 5) & 0x1F;
+		v = ((v & 0x7C00) << 1) | (((g << 1) | (g >> 4)) << 5) | (v & 0x1F);
+		dst[x * 2] = (uint8_t)v;
+		dst[x * 2 + 1] = (uint8_t)(v >> 8);
+	}
+}
+
+AVI_STATIC_FUNC void avi_pixel_rgb555_to_bgra8888(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++)
+	{
+		uint32_t v = src[x * 2] | ((uint32_t)src[x * 2 + 1] << 8);
+		dst[x * 4 + 0] = avi_pixel_expand5(v & 0x1F);
+		dst[x * 4 + 1] = avi_pixel_expand5((v >> 5) & 0x1F);
+		dst[x * 4 + 2] = avi_pixel_expand5((v >> 10) & 0x1F);
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+
+AVI_STATIC_FUNC void avi_pixel_rgb555_to_rgba8888(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++)
+	{
+		uint32_t v = src[x * 2] | ((uint32_t)src[x * 2 + 1] << 8);
+		dst[x * 4 + 0] = avi_pixel_expand5((v >> 10) & 0x1F);
+		dst[x * 4 + 1] = avi_pixel_expand5((v >> 5) & 0x1F);
+		dst[x * 4 + 2] = avi_pixel_expand5(v & 0x1F);
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+
+AVI_STATIC_FUNC void avi_pixel_rgb565_to_rgb565(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	memcpy(dst, src, (size_t)width * 2);
+}
+
+AVI_STATIC_FUNC void avi_pixel_rgb565_to_bgra8888(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++)
+	{
+		uint32_t v = src[x * 2] | ((uint32_t)src[x * 2 + 1] << 8);
+		dst[x * 4 + 0] = avi_pixel_expand5(v & 0x1F);
+		dst[x * 4 + 1] = avi_pixel_expand6((v >> 5) & 0x3F);
+		dst[x * 4 + 2] = avi_pixel_expand5(v >> 11);
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+
+AVI_STATIC_FUNC void avi_pixel_rgb565_to_rgba8888(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++)
+	{
+		uint32_t v = src[x * 2] | ((uint32_t)src[x * 2 + 1] << 8);
+		dst[x * 4 + 0] = avi_pixel_expand5(v >> 11);
+		dst[x * 4 + 1] = avi_pixel_expand6((v >> 5) & 0x3F);
+		dst[x * 4 + 2] = avi_pixel_expand5(v & 0x1F);
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+
+AVI_STATIC_FUNC void avi_pixel_bgr888_to_rgb565(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++)
+	{
+		avi_pixel_write565(&dst[x * 2], src[x * 3 + 2], src[x * 3 + 1], src[x * 3 + 0]);
+	}
+}
+
+AVI_STATIC_FUNC void avi_pixel_bgr888_to_bgra8888(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++)
+	{
+		dst[x * 4 + 0] = src[x * 3 + 0];
+		dst[x * 4 + 1] = src[x * 3 + 1];
+		dst[x * 4 + 2] = src[x * 3 + 2];
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+
+AVI_STATIC_FUNC void avi_pixel_bgr888_to_rgba8888(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++)
+	{
+		dst[x * 4 + 0] = src[x * 3 + 2];
+		dst[x * 4 + 1] = src[x * 3 + 1];
+		dst[x * 4 + 2] = src[x * 3 + 0];
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+
+AVI_STATIC_FUNC void avi_pixel_bgrx8888_to_rgb565(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++)
+	{
+		avi_pixel_write565(&dst[x * 2], src[x * 4 + 2], src[x * 4 + 1], src[x * 4 + 0]);
+	}
+}
+
+AVI_STATIC_FUNC void avi_pixel_bgrx8888_to_bgra8888(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+#ifdef AVI_USE_SSE2
+	x = avi_pixel_shuffle32_sse2(src, dst, width, 0, 0xFF000000);
+#endif
+	for (; x < width; x++)
+	{
+		dst[x * 4 + 0] = src[x * 4 + 0];
+		dst[x * 4 + 1] = src[x * 4 + 1];
+		dst[x * 4 + 2] = src[x * 4 + 2];
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+
+AVI_STATIC_FUNC void avi_pixel_bgrx8888_to_rgba8888(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+#ifdef AVI_USE_SSE2
+	x = avi_pixel_shuffle32_sse2(src, dst, width, 1, 0xFF000000);
+#endif
+	for (; x < width; x++)
+	{
+		dst[x * 4 + 0] = src[x * 4 + 2];
+		dst[x * 4 + 1] = src[x * 4 + 1];
+		dst[x * 4 + 2] = src[x * 4 + 0];
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+
+AVI_STATIC_FUNC void avi_pixel_bgra8888_to_bgra8888(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	memcpy(dst, src, (size_t)width * 4);
+}
+
+AVI_STATIC_FUNC void avi_pixel_bgra8888_to_rgba8888(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+#ifdef AVI_USE_SSE2
+	x = avi_pixel_shuffle32_sse2(src, dst, width, 1, 0);
+#endif
+	for (; x < width; x++)
+	{
+		dst[x * 4 + 0] = src[x * 4 + 2];
+		dst[x * 4 + 1] = src[x * 4 + 1];
+		dst[x * 4 + 2] = src[x * 4 + 0];
+		dst[x * 4 + 3] = src[x * 4 + 3];
+	}
+}
+
+AVI_STATIC_FUNC void avi_pixel_rgba8888_to_rgb565(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++)
+	{
+		avi_pixel_write565(&dst[x * 2], src[x * 4 + 0], src[x * 4 + 1], src[x * 4 + 2]);
+	}
+}
+
+AVI_STATIC_FUNC avi_pixel_row_cb avi_pixel_get_row_converter(avi_pixel_format src_format, avi_pixel_format dst_format)
+{
+	switch (src_format)
+	{
+	case AVI_PIXEL_RGB555:
+		switch (dst_format)
+		{
+		case AVI_PIXEL_RGB565: return avi_pixel_rgb555_to_rgb565;
+		case AVI_PIXEL_BGRA8888: return avi_pixel_rgb555_to_bgra8888;
+		case AVI_PIXEL_RGBA8888: return avi_pixel_rgb555_to_rgba8888;
+		default: return NULL;
+		}
+	case AVI_PIXEL_RGB565:
+		switch (dst_format)
+		{
+		case AVI_PIXEL_RGB565: return avi_pixel_rgb565_to_rgb565;
+		case AVI_PIXEL_BGRA8888: return avi_pixel_rgb565_to_bgra8888;
+		case AVI_PIXEL_RGBA8888: return avi_pixel_rgb565_to_rgba8888;
+		default: return NULL;
+		}
+	case AVI_PIXEL_BGR888:
+		switch (dst_format)
+		{
+		case AVI_PIXEL_RGB565: return avi_pixel_bgr888_to_rgb565;
+		case AVI_PIXEL_BGRA8888: return avi_pixel_bgr888_to_bgra8888;
+		case AVI_PIXEL_RGBA8888: return avi_pixel_bgr888_to_rgba8888;
+		default: return NULL;
+		}
+	case AVI_PIXEL_BGRX8888:
+		switch (dst_format)
+		{
+		case AVI_PIXEL_RGB565: return avi_pixel_bgrx8888_to_rgb565;
+		case AVI_PIXEL_BGRA8888: return avi_pixel_bgrx8888_to_bgra8888;
+		case AVI_PIXEL_RGBA8888: return avi_pixel_bgrx8888_to_rgba8888;
+		default: return NULL;
+		}
+	case AVI_PIXEL_BGRA8888:
+		switch (dst_format)
+		{
+		case AVI_PIXEL_RGB565: return avi_pixel_bgrx8888_to_rgb565;
+		case AVI_PIXEL_BGRA8888: return avi_pixel_bgra8888_to_bgra8888;
+		case AVI_PIXEL_RGBA8888: return avi_pixel_bgra8888_to_rgba8888;
+		default: return NULL;
+		}
+	case AVI_PIXEL_RGBA8888:
+		switch (dst_format)
+		{
+		case AVI_PIXEL_RGB565: return avi_pixel_rgba8888_to_rgb565;
+		case AVI_PIXEL_BGRA8888: return avi_pixel_bgra8888_to_rgba8888; // Swapping R and B works both ways
+		case AVI_PIXEL_RGBA8888: return avi_pixel_bgra8888_to_bgra8888;
+		default: return NULL;
+		}
+	default:
+		return NULL;
+	}
+}
+
+AVI_FUNC avi_pixel_format avi_pixel_get_stream_format(avi_stream_reader *s)
+{
+	bitmap_info_header *bmif;
+	if (!s || !s->stream_info) return AVI_PIXEL_UNKNOWN;
+	if (avi_is_stream_RGB565(s)) return AVI_PIXEL_RGB565;
+	if (avi_is_stream_RGB555(s)) return AVI_PIXEL_RGB555;
+	if (avi_is_stream_RGB888(s)) return AVI_PIXEL_BGR888;
+	bmif = &s->stream_info->bitmap_format.BMIF;
+	if (s->stream_info->format_data_is_valid && bmif->biCompression == BI_RGB && bmif->biBitCount == 32) return AVI_PIXEL_BGRX8888;
+	return AVI_PIXEL_UNKNOWN;
+}
+
+AVI_FUNC uint32_t avi_pixel_get_bytes_per_pixel(avi_pixel_format format)
+{
+	switch (format)
+	{
+	case AVI_PIXEL_INDEX8:
+		return 1;
+	case AVI_PIXEL_RGB555:
+	case AVI_PIXEL_RGB565:
+		return 2;
+	case AVI_PIXEL_BGR888:
+		return 3;
+	case AVI_PIXEL_BGRX8888:
+	case AVI_PIXEL_BGRA8888:
+	case AVI_PIXEL_RGBA8888:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+AVI_FUNC uint32_t avi_pixel_pack_color(avi_pixel_format format, palette_entry color)
+{
+	uint8_t bytes[4] = { 0 };
+	uint32_t ret;
+	switch (format)
+	{
+	case AVI_PIXEL_RGB555:
+		ret = ((uint32_t)(color.R >> 3) << 10) | ((uint32_t)(color.G >> 3) << 5) | (color.B >> 3);
+		bytes[0] = (uint8_t)ret;
+		bytes[1] = (uint8_t)(ret >> 8);
+		break;
+	case AVI_PIXEL_RGB565:
+		avi_pixel_write565(bytes, color.R, color.G, color.B);
+		break;
+	case AVI_PIXEL_BGR888:
+	case AVI_PIXEL_BGRX8888:
+	case AVI_PIXEL_BGRA8888:
+		bytes[0] = color.B;
+		bytes[1] = color.G;
+		bytes[2] = color.R;
+		bytes[3] = 0xFF;
+		break;
+	case AVI_PIXEL_RGBA8888:
+		bytes[0] = color.R;
+		bytes[1] = color.G;
+		bytes[2] = color.B;
+		bytes[3] = 0xFF;
+		break;
+	default:
+		break;
+	}
+	memcpy(&ret, bytes, sizeof ret);
+	return ret;
+}
+
+AVI_FUNC uint32_t avi_pixel_pack_rgb_quad(avi_pixel_format format, rgb_quad color)
+{
+	palette_entry c;
+	c.R = color.R;
+	c.G = color.G;
+	c.B = color.B;
+	c.A = 0;
+	return avi_pixel_pack_color(format, c);
+}
+
+AVI_FUNC size_t avi_pixel_get_dib_stride(uint32_t width, uint32_t bit_count)
+{
+	return (((size_t)width * bit_count + 31) / 32) * 4;
+}
+
+AVI_FUNC int avi_pixel_convert
+(
+	const void *src,
+	avi_pixel_format src_format,
+	size_t src_stride,
+	int bottom_up,
+	void *dst,
+	avi_pixel_format dst_format,
+	size_t dst_stride,
+	uint32_t width,
+	uint32_t height
+)
+{
+	const uint8_t *src_row = src;
+	uint8_t *dst_row = dst;
+	avi_pixel_row_cb convert_row = avi_pixel_get_row_converter(src_format, dst_format);
+	if (!src || !dst || !convert_row) return 0;
+	if (src_stride < (size_t)width * avi_pixel_get_bytes_per_pixel(src_format)) return 0;
+	if (dst_stride < (size_t)width * avi_pixel_get_bytes_per_pixel(dst_format)) return 0;
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		uint32_t src_y = bottom_up ? height - 1 - y : y;
+		convert_row(&src_row[src_y * src_stride], dst_row, width);
+		dst_row += dst_stride;
+	}
+	return 1;
+}
+
+AVI_FUNC int avi_pixel_convert_frame
+(
+	avi_stream_reader *s,
+	const void *frame,
+	size_t frame_len,
+	void *dst,
+	avi_pixel_format dst_format,
+	size_t dst_stride
+)
+{
+	bitmap_info_header *bmif;
+	avi_pixel_format src_format = avi_pixel_get_stream_format(s);
+	uint32_t width, height;
+	size_t src_stride;
+	int bottom_up;
+	if (src_format == AVI_PIXEL_UNKNOWN) return 0;
+
+	bmif = &s->stream_info->bitmap_format.BMIF;
+	if (bmif->biWidth <= 0 || bmif->biHeight == 0) return 0;
+	width = (uint32_t)bmif->biWidth;
+	bottom_up = bmif->biHeight > 0;
+	height = bottom_up ? (uint32_t)bmif->biHeight : (uint32_t)-(int64_t)bmif->biHeight;
+	src_stride = avi_pixel_get_dib_stride(width, bmif->biBitCount);
+	if (frame_len < src_stride * height) return 0;
+
+	return avi_pixel_convert(frame, src_format, src_stride, bottom_up, dst, dst_format, dst_stride, width, height);
+}
+
+AVI_FUNC int avi_pixel_lut_init(avi_pixel_lut *lut, avi_pixel_format format, const rgb_quad *palette, uint32_t num_colors)
+{
+	if (!lut) return 0;
+	switch (format)
+	{
+	case AVI_PIXEL_INDEX8:
+	case AVI_PIXEL_RGB565:
+	case AVI_PIXEL_BGRA8888:
+	case AVI_PIXEL_RGBA8888:
+		break;
+	default:
+		return 0;
+	}
+	if (num_colors > 256) num_colors = 256;
+	if (!palette) num_colors = 0;
+
+	lut->format = format;
+	lut->bytes_per_pixel = avi_pixel_get_bytes_per_pixel(format);
+	lut->num_colors = num_colors;
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		rgb_quad black = { 0, 0, 0, 0 };
+		if (format == AVI_PIXEL_INDEX8)
+		{
+			uint8_t index = (uint8_t)i;
+			lut->lut[i] = 0;
+			memcpy(&lut->lut[i], &index, 1);
+		}
+		else
+		{
+			lut->lut[i] = avi_pixel_pack_rgb_quad(format, i < num_colors ? palette[i] : black);
+		}
+	}
+	return 1;
+}
+
+AVI_FUNC int avi_pixel_lut_init_from_stream(avi_pixel_lut *lut, avi_stream_reader *s, avi_pixel_format format)
+{
+	bitmap_info_header *bmif;
+	uint32_t num_colors;
+	if (!avi_is_stream_indexed_color(s)) return 0;
+	bmif = &s->stream_info->bitmap_format.BMIF;
+	num_colors = bmif->biClrUsed ? bmif->biClrUsed : (1u << bmif->biBitCount);
+	return avi_pixel_lut_init(lut, format, s->stream_info->bitmap_format.palette, num_colors);
+}
+
+AVI_FUNC int avi_pixel_lut_apply_palette_change(avi_pixel_lut *lut, avi_stream_reader *s, void *pc)
+{
+	avi_palette_change_max_size *pc_data = pc;
+	uint32_t end;
+	if (!lut) return 0;
+	if (!avi_apply_palette_change(s, pc)) return 0;
+	if (lut->format == AVI_PIXEL_INDEX8) return 1;
+
+	end = (uint32_t)pc_data->first_entry + pc_data->num_entries;
+	if (end > 256) end = 256;
+	for (uint32_t i = pc_data->first_entry; i < end; i++)
+	{
+		lut->lut[i] = avi_pixel_pack_rgb_quad(lut->format, s->stream_info->bitmap_format.palette[i]);
+	}
+	if (lut->num_colors < end) lut->num_colors = end;
+	return 1;
+}
+
+#ifdef AVI_USE_AVX2
+// Look up 8 of the 8-bit indices at a time by the gather instruction. Returns the number of pixels done.
+AVI_STATIC_FUNC uint32_t avi_pixel_expand8_bpp4_avx2(const uint8_t *src, uint8_t *dst, uint32_t width, const uint32_t *lut)
+{
+	uint32_t x = 0;
+	for (; x + 8 <= width; x += 8)
+	{
+		__m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)&src[x]));
+		_mm256_storeu_si256((__m256i *)&dst[x * 4], _mm256_i32gather_epi32((const int *)lut, index, 4));
+	}
+	return x;
+}
+
+// The same gather for the 16-bit pixels, the upper halves of the entries are zero so they are packed without saturating.
+AVI_STATIC_FUNC uint32_t avi_pixel_expand8_bpp2_avx2(const uint8_t *src, uint8_t *dst, uint32_t width, const uint32_t *lut)
+{
+	uint32_t x = 0;
+	for (; x + 8 <= width; x += 8)
+	{
+		__m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)&src[x]));
+		__m256i pixels = _mm256_i32gather_epi32((const int *)lut, index, 4);
+		_mm_storeu_si128((__m128i *)&dst[x * 2], _mm_packus_epi32(_mm256_castsi256_si128(pixels), _mm256_extracti128_si256(pixels, 1)));
+	}
+	return x;
+}
+#endif
+
+#ifdef AVI_USE_SSE2
+// Unpack 16 of the 1, 2, or 4-bit indices to one byte each, the leftmost pixel is in the most significant bits.
+// Reads `2 * bit_count` bytes of `src`.
+AVI_STATIC_FUNC __m128i avi_pixel_unpack16_sse2(const uint8_t *src, uint32_t bit_count)
+{
+	__m128i v;
+	if (bit_count == 4)
+	{
+		const __m128i mask = _mm_set1_epi8(0x0F);
+		v = _mm_loadl_epi64((const __m128i *)src);
+		return _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(v, 4), mask), _mm_and_si128(v, mask));
+	}
+	else if (bit_count == 2)
+	{
+		const __m128i mask = _mm_set1_epi8(0x03);
+		uint32_t packed;
+		memcpy(&packed, src, 4);
+		v = _mm_cvtsi32_si128((int)packed);
+		return _mm_unpacklo_epi16(
+			_mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(v, 6), mask), _mm_and_si128(_mm_srli_epi16(v, 4), mask)),
+			_mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(v, 2), mask), _mm_and_si128(v, mask)));
+	}
+	else
+	{
+		const __m128i mask = _mm_set1_epi8(0x01);
+		uint16_t packed;
+		memcpy(&packed, src, 2);
+		v = _mm_cvtsi32_si128(packed);
+		return _mm_unpacklo_epi32(
+			_mm_unpacklo_epi16(
+				_mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(v, 7), mask), _mm_and_si128(_mm_srli_epi16(v, 6), mask)),
+				_mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(v, 5), mask), _mm_and_si128(_mm_srli_epi16(v, 4), mask))),
+			_mm_unpacklo_epi16(
+				_mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(v, 3), mask), _mm_and_si128(_mm_srli_epi16(v, 2), mask)),
+				_mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(v, 1), mask), _mm_and_si128(v, mask))));
+	}
+}
+
+// The 8-bit output only needs the indices unpacked. Returns the number of pixels done.
+AVI_STATIC_FUNC uint32_t avi_pixel_expand_packed_bpp1_sse2(const uint8_t *src, uint32_t bit_count, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		_mm_storeu_si128((__m128i *)&dst[x], avi_pixel_unpack16_sse2(&src[x * bit_count / 8], bit_count));
+	}
+	return x;
+}
+#endif
+
+#ifdef AVI_USE_SSSE3
+// The 1, 2, and 4-bit indices address at most 16 colors, so each byte of the pixels is looked up from one register by the byte shuffle.
+// Returns the number of pixels done.
+AVI_STATIC_FUNC uint32_t avi_pixel_expand_packed_ssse3(const uint8_t *src, uint32_t bit_count, uint8_t *dst, uint32_t width, const avi_pixel_lut *lut)
+{
+	uint8_t planes[4][16];
+	__m128i plane0, plane1, plane2, plane3;
+	uint32_t bpp = lut->bytes_per_pixel;
+	uint32_t x = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		uint8_t bytes[4];
+		memcpy(bytes, &lut->lut[i], 4);
+		for (uint32_t j = 0; j < 4; j++) planes[j][i] = bytes[j];
+	}
+	plane0 = _mm_loadu_si128((const __m128i *)planes[0]);
+	plane1 = _mm_loadu_si128((const __m128i *)planes[1]);
+	plane2 = _mm_loadu_si128((const __m128i *)planes[2]);
+	plane3 = _mm_loadu_si128((const __m128i *)planes[3]);
+	for (; x + 16 <= width; x += 16)
+	{
+		__m128i index = avi_pixel_unpack16_sse2(&src[x * bit_count / 8], bit_count);
+		__m128i b0 = _mm_shuffle_epi8(plane0, index);
+		__m128i b1 = _mm_shuffle_epi8(plane1, index);
+		__m128i lo01 = _mm_unpacklo_epi8(b0, b1);
+		__m128i hi01 = _mm_unpackhi_epi8(b0, b1);
+		if (bpp == 2)
+		{
+			_mm_storeu_si128((__m128i *)&dst[x * 2], lo01);
+			_mm_storeu_si128((__m128i *)&dst[x * 2 + 16], hi01);
+		}
+		else
+		{
+			__m128i b2 = _mm_shuffle_epi8(plane2, index);
+			__m128i b3 = _mm_shuffle_epi8(plane3, index);
+			__m128i lo23 = _mm_unpacklo_epi8(b2, b3);
+			__m128i hi23 = _mm_unpackhi_epi8(b2, b3);
+			_mm_storeu_si128((__m128i *)&dst[x * 4], _mm_unpacklo_epi16(lo01, lo23));
+			_mm_storeu_si128((__m128i *)&dst[x * 4 + 16], _mm_unpackhi_epi16(lo01, lo23));
+			_mm_storeu_si128((__m128i *)&dst[x * 4 + 32], _mm_unpacklo_epi16(hi01, hi23));
+			_mm_storeu_si128((__m128i *)&dst[x * 4 + 48], _mm_unpackhi_epi16(hi01, hi23));
+		}
+	}
+	return x;
+}
+#endif
+
+// Expand one row of indexed color pixels. The 8-bit rows have a loop for each pixel size, so the copies are of constant size.
+AVI_STATIC_FUNC void avi_pixel_expand_row(const uint8_t *src, uint32_t bit_count, uint8_t *dst, uint32_t width, const avi_pixel_lut *lut)
+{
+	uint32_t bpp = lut->bytes_per_pixel;
+	uint32_t x = 0;
+	if (bit_count == 8)
+	{
+		switch (bpp)
+		{
+		case 1:
+			memcpy(dst, src, width);
+			break;
+		case 2:
+#ifdef AVI_USE_AVX2
+			x = avi_pixel_expand8_bpp2_avx2(src, dst, width, lut->lut);
+#endif
+			for (; x < width; x++) memcpy(&dst[x * 2], &lut->lut[src[x]], 2);
+			break;
+		case 4:
+#ifdef AVI_USE_AVX2
+			x = avi_pixel_expand8_bpp4_avx2(src, dst, width, lut->lut);
+#endif
+			for (; x < width; x++) memcpy(&dst[x * 4], &lut->lut[src[x]], 4);
+			break;
+		}
+		return;
+	}
+
+#ifdef AVI_USE_SSE2
+	if (bpp == 1) x = avi_pixel_expand_packed_bpp1_sse2(src, bit_count, dst, width);
+#endif
+#ifdef AVI_USE_SSSE3
+	if (bpp != 1) x = avi_pixel_expand_packed_ssse3(src, bit_count, dst, width, lut);
+#endif
+	src += x * bit_count / 8;
+	dst += (size_t)x * bpp;
+
+	// The leftmost pixel is in the most significant bits.
+	while (x < width)
+	{
+		uint32_t byte = *src++;
+		for (uint32_t bit = 0; bit < 8 && x < width; bit += bit_count, x++)
+		{
+			uint32_t index = (byte << bit & 0xFF) >> (8 - bit_count);
+			memcpy(dst, &lut->lut[index], bpp);
+			dst += bpp;
+		}
+	}
+}
+
+AVI_FUNC int avi_pixel_expand_indexed
+(
+	const void *src,
+	uint32_t bit_count,
+	size_t src_stride,
+	int bottom_up,
+	void *dst,
+	size_t dst_stride,
+	uint32_t width,
+	uint32_t height,
+	const avi_pixel_lut *lut
+)
+{
+	const uint8_t *src_row = src;
+	uint8_t *dst_row = dst;
+	if (!src || !dst || !lut || !lut->bytes_per_pixel) return 0;
+	switch (bit_count)
+	{
+	case 1: case 2: case 4: case 8:
+		break;
+	default:
+		return 0;
+	}
+	if (src_stride < ((size_t)width * bit_count + 7) / 8) return 0;
+	if (dst_stride < (size_t)width * lut->bytes_per_pixel) return 0;
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		uint32_t src_y = bottom_up ? height - 1 - y : y;
+		avi_pixel_expand_row(&src_row[src_y * src_stride], bit_count, dst_row, width, lut);
+		dst_row += dst_stride;
+	}
+	return 1;
+}
+
+AVI_FUNC int avi_pixel_expand_frame
+(
+	avi_stream_reader *s,
+	const void *frame,
+	size_t frame_len,
+	void *dst,
+	size_t dst_stride,
+	const avi_pixel_lut *lut
+)
+{
+	bitmap_info_header *bmif;
+	uint32_t width, height;
+	size_t src_stride;
+	int bottom_up;
+	if (!avi_is_stream_indexed_color(s)) return 0;
+
+	bmif = &s->stream_info->bitmap_format.BMIF;
+	if (bmif->biCompression != BI_RGB) return 0;
+	if (bmif->biWidth <= 0 || bmif->biHeight == 0) return 0;
+	width = (uint32_t)bmif->biWidth;
+	bottom_up = bmif->biHeight > 0;
+	height = bottom_up ? (uint32_t)bmif->biHeight : (uint32_t)-(int64_t)bmif->biHeight;
+	src_stride = avi_pixel_get_dib_stride(width, bmif->biBitCount);
+	if (frame_len < src_stride * height) return 0;
+
+	return avi_pixel_expand_indexed(frame, bmif->biBitCount, src_stride, bottom_up, dst, dst_stride, width, height, lut);
+}
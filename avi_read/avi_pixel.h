@@ -0,0 +1,195 @@
+#ifndef _AVI_PIXEL_H_
+#define _AVI_PIXEL_H_ 1
+
+#include "avi_reader.h"
+
+/// <summary>
+/// The pixel formats, named in memory byte order except the 16-bit ones, which are little endian 16-bit words.
+/// </summary>
+typedef enum
+{
+	AVI_PIXEL_UNKNOWN = 0,
+	AVI_PIXEL_RGB555 = 1,   /// 16-bit `0RRRRRGG GGGBBBBB`, the DIB `BI_RGB` 16-bit format
+	AVI_PIXEL_RGB565 = 2,   /// 16-bit `RRRRRGGG GGGBBBBB`
+	AVI_PIXEL_BGR888 = 3,   /// 24-bit, the DIB `BI_RGB` 24-bit format
+	AVI_PIXEL_BGRX8888 = 4, /// 32-bit, the DIB `BI_RGB` 32-bit format, the 4th byte is not alpha
+	AVI_PIXEL_BGRA8888 = 5,
+	AVI_PIXEL_RGBA8888 = 6,
+	AVI_PIXEL_INDEX8 = 7,   /// 8-bit palette index, the output of the indexed color decoders
+}avi_pixel_format;
+
+/// <summary>
+/// Get the pixel format of an uncompressed video stream, see `avi_is_stream_RGB555()`, `avi_is_stream_RGB565()`, and `avi_is_stream_RGB888()`.
+/// </summary>
+/// <param name="s">Your stream reader, must be a video stream.</param>
+/// <returns>The pixel format, or `AVI_PIXEL_UNKNOWN` for the compressed or indexed color streams.</returns>
+AVI_FUNC avi_pixel_format avi_pixel_get_stream_format(avi_stream_reader *s);
+
+/// <summary>
+/// Get the bytes per pixel of the format.
+/// </summary>
+/// <returns>0 for `AVI_PIXEL_UNKNOWN`</returns>
+AVI_FUNC uint32_t avi_pixel_get_bytes_per_pixel(avi_pixel_format format);
+
+/// <summary>
+/// Pack a color into one pixel of the format, e.g. to make the lookup table of a palette.
+/// The first `avi_pixel_get_bytes_per_pixel()` bytes of the returned value in memory are the pixel, copy them by `memcpy()`.
+/// </summary>
+/// <param name="format">The pixel format, not `AVI_PIXEL_INDEX8`</param>
+/// <param name="color">The color, the `A` field is ignored.</param>
+/// <returns>The packed pixel</returns>
+AVI_FUNC uint32_t avi_pixel_pack_color(avi_pixel_format format, palette_entry color);
+
+/// <summary>
+/// Pack a palette entry of the stream format (`bitmap_format.palette`) into one pixel of the format, see `avi_pixel_pack_color()`.
+/// </summary>
+/// <param name="format">The pixel format, not `AVI_PIXEL_INDEX8`</param>
+/// <param name="color">The `RGBQUAD` palette entry, the `Reserved` field is ignored.</param>
+/// <returns>The packed pixel</returns>
+AVI_FUNC uint32_t avi_pixel_pack_rgb_quad(avi_pixel_format format, rgb_quad color);
+
+/// <summary>
+/// Get the bytes per row of an uncompressed DIB frame, the rows are padded to 4 bytes.
+/// </summary>
+AVI_FUNC size_t avi_pixel_get_dib_stride(uint32_t width, uint32_t bit_count);
+
+/// <summary>
+/// Convert the pixels from one format to another, with the vertical flip and the strides done in the same pass.
+/// The destination formats are `AVI_PIXEL_RGB565`, `AVI_PIXEL_BGRA8888`, and `AVI_PIXEL_RGBA8888`, the alpha channel is set to 255.
+/// </summary>
+/// <param name="src">The source pixels</param>
+/// <param name="src_format">The source pixel format</param>
+/// <param name="src_stride">The bytes per row of the source</param>
+/// <param name="bottom_up">Nonzero if the first row of the source is the bottom row of the image, as the DIB with positive `biHeight`</param>
+/// <param name="dst">Your buffer for the destination, the first row is the top row.</param>
+/// <param name="dst_format">The destination pixel format</param>
+/// <param name="dst_stride">The bytes per row of the destination</param>
+/// <param name="width">The width in pixels</param>
+/// <param name="height">The height in pixels</param>
+/// <returns>0 for fail (unsupported formats), nonzero for success.</returns>
+AVI_FUNC int avi_pixel_convert
+(
+	const void *src,
+	avi_pixel_format src_format,
+	size_t src_stride,
+	int bottom_up,
+	void *dst,
+	avi_pixel_format dst_format,
+	size_t dst_stride,
+	uint32_t width,
+	uint32_t height
+);
+
+/// <summary>
+/// Convert an uncompressed frame of the stream, e.g. read by `avi_stream_reader_read_packet()`, to your display format.
+/// The size, the orientation and the row padding come from the stream format.
+/// </summary>
+/// <param name="s">Your stream reader of an uncompressed video stream</param>
+/// <param name="frame">The frame data</param>
+/// <param name="frame_len">The length of the frame data</param>
+/// <param name="dst">Your buffer for the destination, the first row is the top row.</param>
+/// <param name="dst_format">The destination pixel format</param>
+/// <param name="dst_stride">The bytes per row of the destination</param>
+/// <returns>0 for fail (unsupported formats, or the frame is too short), nonzero for success.</returns>
+AVI_FUNC int avi_pixel_convert_frame
+(
+	avi_stream_reader *s,
+	const void *frame,
+	size_t frame_len,
+	void *dst,
+	avi_pixel_format dst_format,
+	size_t dst_stride
+);
+
+/// <summary>
+/// The palette of an indexed color stream in the display format, so the frames are expanded by copying the packed pixels.
+/// Keep it in sync with the stream by `avi_pixel_lut_apply_palette_change()`, only the changed entries are packed again.
+/// </summary>
+typedef struct
+{
+	avi_pixel_format format;
+	uint32_t bytes_per_pixel;
+	uint32_t num_colors;
+
+	/// The packed pixels, see `avi_pixel_pack_color()`
+	uint32_t lut[256];
+}avi_pixel_lut;
+
+/// <summary>
+/// Pack the palette into the lookup table, the entries after `num_colors` are black.
+/// For `AVI_PIXEL_INDEX8`, the lookup table maps the indices to themselves.
+/// </summary>
+/// <param name="lut">Your `avi_pixel_lut` to be initialized</param>
+/// <param name="format">The display format: `AVI_PIXEL_INDEX8`, `AVI_PIXEL_RGB565`, `AVI_PIXEL_BGRA8888`, or `AVI_PIXEL_RGBA8888`</param>
+/// <param name="palette">The palette, e.g. `bitmap_format.palette` of the stream info</param>
+/// <param name="num_colors">Number of the palette entries</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_pixel_lut_init(avi_pixel_lut *lut, avi_pixel_format format, const rgb_quad *palette, uint32_t num_colors);
+
+/// <summary>
+/// Pack the palette of the stream format into the lookup table.
+/// </summary>
+/// <param name="lut">Your `avi_pixel_lut` to be initialized</param>
+/// <param name="s">Your stream reader of an indexed color video stream</param>
+/// <param name="format">The display format, see `avi_pixel_lut_init()`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_pixel_lut_init_from_stream(avi_pixel_lut *lut, avi_stream_reader *s, avi_pixel_format format);
+
+/// <summary>
+/// Call `avi_apply_palette_change()`, then pack the changed entries into the lookup table.
+/// Call it in your `on_palette_change` callback function instead of `avi_apply_palette_change()`.
+/// </summary>
+/// <param name="lut">Your `avi_pixel_lut`</param>
+/// <param name="s">Your stream reader of an indexed color video stream</param>
+/// <param name="pc">The palette change packet data</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_pixel_lut_apply_palette_change(avi_pixel_lut *lut, avi_stream_reader *s, void *pc);
+
+/// <summary>
+/// Expand the 1/2/4/8-bit indexed color pixels through the lookup table, with the vertical flip and the strides done in the same pass.
+/// </summary>
+/// <param name="src">The source pixels, the leftmost pixel is in the most significant bits of a byte.</param>
+/// <param name="bit_count">Bits per pixel of the source: 1, 2, 4, or 8</param>
+/// <param name="src_stride">The bytes per row of the source</param>
+/// <param name="bottom_up">Nonzero if the first row of the source is the bottom row of the image</param>
+/// <param name="dst">Your buffer for the destination, the first row is the top row.</param>
+/// <param name="dst_stride">The bytes per row of the destination</param>
+/// <param name="width">The width in pixels</param>
+/// <param name="height">The height in pixels</param>
+/// <param name="lut">The lookup table, its format is the destination format.</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_pixel_expand_indexed
+(
+	const void *src,
+	uint32_t bit_count,
+	size_t src_stride,
+	int bottom_up,
+	void *dst,
+	size_t dst_stride,
+	uint32_t width,
+	uint32_t height,
+	const avi_pixel_lut *lut
+);
+
+/// <summary>
+/// Expand an uncompressed indexed color frame of the stream, e.g. read by `avi_stream_reader_read_packet()`, to your display format.
+/// The size, the orientation and the row padding come from the stream format.
+/// </summary>
+/// <param name="s">Your stream reader of a `BI_RGB` indexed color video stream</param>
+/// <param name="frame">The frame data</param>
+/// <param name="frame_len">The length of the frame data</param>
+/// <param name="dst">Your buffer for the destination, the first row is the top row.</param>
+/// <param name="dst_stride">The bytes per row of the destination</param>
+/// <param name="lut">The lookup table of the stream palette</param>
+/// <returns>0 for fail (not an uncompressed indexed color stream, or the frame is too short), nonzero for success.</returns>
+AVI_FUNC int avi_pixel_expand_frame
+(
+	avi_stream_reader *s,
+	const void *frame,
+	size_t frame_len,
+	void *dst,
+	size_t dst_stride,
+	const avi_pixel_lut *lut
+);
+
+#endif
@@ -0,0 +1,141 @@
+#include "avi_profile.h"
+
+#ifdef AVI_ENABLE_PROFILING
+
+#include <stdio.h>
+#include <string.h>
+
+static avi_profiler *avi_cur_profiler = NULL;
+
+AVI_FUNC int avi_profiler_init
+(
+	avi_profiler *p,
+	void *userdata,
+	avi_clock_cb f_clock,
+	avi_trace_cb f_trace_begin,
+	avi_trace_cb f_trace_end,
+	avi_profile_lock_cb f_lock,
+	avi_profile_lock_cb f_unlock
+)
+{
+	if (!p || !f_clock) return 0;
+	if (!f_lock != !f_unlock) return 0;
+
+	memset(p, 0, sizeof *p);
+	p->userdata = userdata;
+	p->f_clock = f_clock;
+	p->f_trace_begin = f_trace_begin;
+	p->f_trace_end = f_trace_end;
+	p->f_lock = f_lock;
+	p->f_unlock = f_unlock;
+	return 1;
+}
+
+AVI_FUNC void avi_set_profiler(avi_profiler *p)
+{
+	avi_cur_profiler = p;
+}
+
+AVI_FUNC avi_profiler *avi_get_profiler(void)
+{
+	return avi_cur_profiler;
+}
+
+AVI_FUNC void avi_profiler_reset(avi_profiler *p)
+{
+	if (!p) return;
+	if (p->f_lock) p->f_lock(p->userdata);
+	memset(p->histograms, 0, sizeof p->histograms);
+	if (p->f_unlock) p->f_unlock(p->userdata);
+}
+
+AVI_FUNC const char *avi_profile_get_op_name(avi_profile_op op)
+{
+	switch (op)
+	{
+	case AVI_OP_INIT: return "avi_init";
+	case AVI_OP_INDEX_LOAD: return "avi_index_load";
+	case AVI_OP_SEEK: return "avi_seek";
+	case AVI_OP_NEXT_PACKET: return "avi_next_packet";
+	case AVI_OP_PREV_PACKET: return "avi_prev_packet";
+	case AVI_OP_READ_PACKET: return "avi_read_packet";
+	default: return "unknown";
+	}
+}
+
+AVI_STATIC_FUNC uint32_t avi_profile_get_bucket(uint64_t duration_ns)
+{
+	uint32_t bucket = 0;
+	while (duration_ns > 1 && bucket < AVI_PROFILE_NUM_BUCKETS - 1)
+	{
+		duration_ns >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+AVI_FUNC uint64_t avi_latency_histogram_get_percentile(const avi_latency_histogram *h, double percentile)
+{
+	uint64_t rank, seen = 0;
+	if (!h || !h->count) return 0;
+	if (percentile <= 0) return h->min_ns;
+	if (percentile >= 100) return h->max_ns;
+
+	// The rank of the sample at the percentile, from 1 to `count`.
+	rank = (uint64_t)(percentile * (double)h->count / 100.0);
+	if ((double)rank * 100.0 < percentile * (double)h->count) rank++;
+	if (!rank) rank = 1;
+
+	for (uint32_t i = 0; i < AVI_PROFILE_NUM_BUCKETS; i++)
+	{
+		seen += h->buckets[i];
+		if (seen >= rank)
+		{
+			uint64_t upper = i < 63 ? ((uint64_t)2 << i) - 1 : UINT64_MAX;
+			if (i == AVI_PROFILE_NUM_BUCKETS - 1 || upper > h->max_ns) upper = h->max_ns;
+			if (upper < h->min_ns) upper = h->min_ns;
+			return upper;
+		}
+	}
+	return h->max_ns;
+}
+
+AVI_FUNC size_t avi_profile_format_trace_event(char *buffer, size_t buffer_size, const char *name, char phase, uint64_t timestamp_ns, uint32_t pid, uint32_t tid)
+{
+	int len;
+	if (!buffer || !buffer_size || !name) return 0;
+	len = snprintf(buffer, buffer_size, "{\"name\":\"%s\",\"cat\":\"avi\",\"ph\":\"%c\",\"ts\":%" PRIu64 ".%03u,\"pid\":%u,\"tid\":%u}",
+		name, phase, timestamp_ns / 1000, (unsigned)(timestamp_ns % 1000), (unsigned)pid, (unsigned)tid);
+	if (len < 0 || (size_t)len >= buffer_size) return 0;
+	return (size_t)len;
+}
+
+AVI_FUNC uint64_t avi_profile_begin(avi_profiler *p, avi_profile_op op)
+{
+	uint64_t now;
+	if (!p) return 0;
+	now = p->f_clock(p->userdata);
+	if (p->f_trace_begin) p->f_trace_begin(op, avi_profile_get_op_name(op), now, p->userdata);
+	return now;
+}
+
+AVI_FUNC void avi_profile_end(avi_profiler *p, avi_profile_op op, uint64_t start_ns)
+{
+	avi_latency_histogram *h;
+	uint64_t now, duration;
+	if (!p || op >= AVI_OP_NUM_OPS) return;
+	now = p->f_clock(p->userdata);
+	duration = now > start_ns ? now - start_ns : 0;
+	if (p->f_trace_end) p->f_trace_end(op, avi_profile_get_op_name(op), now, p->userdata);
+
+	h = &p->histograms[op];
+	if (p->f_lock) p->f_lock(p->userdata);
+	if (!h->count || duration < h->min_ns) h->min_ns = duration;
+	if (duration > h->max_ns) h->max_ns = duration;
+	h->count++;
+	h->total_ns += duration;
+	h->buckets[avi_profile_get_bucket(duration)]++;
+	if (p->f_unlock) p->f_unlock(p->userdata);
+}
+
+#endif
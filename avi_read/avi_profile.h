@@ -0,0 +1,163 @@
+#ifndef _AVI_PROFILE_H_
+#define _AVI_PROFILE_H_ 1
+
+#include "avi_reader.h"
+
+/// <summary>
+/// The operations of `avi_reader.c` timed by the profiler.
+/// </summary>
+typedef enum
+{
+	AVI_OP_INIT = 0,         /// `avi_reader_init()`, or each call of `avi_reader_init_begin()` and `avi_reader_init_continue()`
+	AVI_OP_INDEX_LOAD = 1,   /// Loading the OpenDML `indx` entries into the index cache
+	AVI_OP_SEEK = 2,         /// `avi_video_seek_to_frame_index()` and `avi_audio_seek_to_byte_offset()`
+	AVI_OP_NEXT_PACKET = 3,  /// `avi_stream_reader_move_to_next_packet()` and `avi_stream_reader_move_to_next_packet_continue()`
+	AVI_OP_PREV_PACKET = 4,  /// `avi_stream_reader_move_to_prev_packet()`
+	AVI_OP_READ_PACKET = 5,  /// `avi_stream_reader_read_packet()`
+	AVI_OP_NUM_OPS = 6,
+}avi_profile_op;
+
+#ifdef AVI_ENABLE_PROFILING
+
+/// <summary>
+/// Bucket `i` of the latency histogram counts the durations from `2^i` to `2^(i+1) - 1` nanoseconds, the last bucket counts all of the longer ones.
+/// </summary>
+#ifndef AVI_PROFILE_NUM_BUCKETS
+#define AVI_PROFILE_NUM_BUCKETS 40
+#endif
+
+/// <summary>
+/// Your clock function.
+/// </summary>
+/// <param name="userdata">The data you passed to `avi_profiler_init()`</param>
+/// <returns>A monotonic time in nanoseconds, e.g. from `clock_gettime(CLOCK_MONOTONIC)` or `QueryPerformanceCounter()`.</returns>
+typedef uint64_t(*avi_clock_cb)(void *userdata);
+
+/// <summary>
+/// Your trace hook, called at the beginning and the end of each timed operation. Nested operations are nested on the same thread,
+/// e.g. a seek contains the packet moves it does, so the calls map directly to the `B`/`E` events of a Chrome trace, see `avi_profile_format_trace_event()`.
+/// </summary>
+/// <param name="op">The operation</param>
+/// <param name="name">The name of the operation, see `avi_profile_get_op_name()`</param>
+/// <param name="timestamp_ns">The time from your `avi_clock_cb`</param>
+/// <param name="userdata">The data you passed to `avi_profiler_init()`</param>
+typedef void(*avi_trace_cb)(avi_profile_op op, const char *name, uint64_t timestamp_ns, void *userdata);
+
+/// <summary>
+/// Your mutex lock/unlock functions for updating the histograms from more than one thread.
+/// </summary>
+typedef void(*avi_profile_lock_cb)(void *userdata);
+
+/// <summary>
+/// The log-bucketed latency histogram of an operation.
+/// </summary>
+typedef struct
+{
+	uint64_t count;
+	uint64_t total_ns;
+	uint64_t min_ns;
+	uint64_t max_ns;
+	uint64_t buckets[AVI_PROFILE_NUM_BUCKETS];
+}avi_latency_histogram;
+
+/// <summary>
+/// The profiler, it records the latency of every timed operation of every reader while it's installed by `avi_set_profiler()`.
+/// Without `AVI_ENABLE_PROFILING` defined, none of this exists and the timed operations compile to what they were.
+/// </summary>
+typedef struct
+{
+	void *userdata; /// The data to pass to your callback functions.
+	avi_clock_cb f_clock;
+	avi_trace_cb f_trace_begin;
+	avi_trace_cb f_trace_end;
+	avi_profile_lock_cb f_lock;
+	avi_profile_lock_cb f_unlock;
+
+	avi_latency_histogram histograms[AVI_OP_NUM_OPS];
+}avi_profiler;
+
+/// <summary>
+/// Initialize the profiler.
+/// </summary>
+/// <param name="p">Your `avi_profiler` to be initialized</param>
+/// <param name="userdata">The data to pass to your callback functions</param>
+/// <param name="f_clock">Your clock function</param>
+/// <param name="f_trace_begin">Your trace hook for the beginning of an operation. Passing NULL is allowed if you only need the histograms.</param>
+/// <param name="f_trace_end">Your trace hook for the end of an operation. Passing NULL is allowed.</param>
+/// <param name="f_lock">Your mutex lock function. Passing NULL is allowed if the readers are used in one thread.</param>
+/// <param name="f_unlock">Your mutex unlock function. Passing NULL is allowed if the readers are used in one thread.</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_profiler_init
+(
+	avi_profiler *p,
+	void *userdata,
+	avi_clock_cb f_clock,
+	avi_trace_cb f_trace_begin,
+	avi_trace_cb f_trace_end,
+	avi_profile_lock_cb f_lock,
+	avi_profile_lock_cb f_unlock
+);
+
+/// <summary>
+/// Install the profiler for all of the readers, so `avi_reader_init()` is timed too. Pass NULL to uninstall it.
+/// Install it before your threads start to use the readers, and uninstall it after they stop.
+/// </summary>
+/// <param name="p">Your initialized `avi_profiler`, or NULL</param>
+AVI_FUNC void avi_set_profiler(avi_profiler *p);
+
+/// <summary>
+/// Get the installed profiler.
+/// </summary>
+/// <returns>The profiler, NULL if none.</returns>
+AVI_FUNC avi_profiler *avi_get_profiler(void);
+
+/// <summary>
+/// Clear the histograms, e.g. after warming up the file cache.
+/// </summary>
+/// <param name="p">Your `avi_profiler`</param>
+AVI_FUNC void avi_profiler_reset(avi_profiler *p);
+
+/// <summary>
+/// Get the name of an operation, e.g. `"avi_seek"`.
+/// </summary>
+/// <param name="op">The operation</param>
+/// <returns>The name, `"unknown"` for an invalid operation.</returns>
+AVI_FUNC const char *avi_profile_get_op_name(avi_profile_op op);
+
+/// <summary>
+/// Estimate a percentile of the latency from the histogram, it's the upper bound of the bucket holding the percentile, and not bigger than `max_ns`.
+/// </summary>
+/// <param name="h">The histogram</param>
+/// <param name="percentile">From 0 to 100, e.g. 99 for p99</param>
+/// <returns>The latency in nanoseconds, 0 if the histogram is empty.</returns>
+AVI_FUNC uint64_t avi_latency_histogram_get_percentile(const avi_latency_histogram *h, double percentile);
+
+/// <summary>
+/// Format a trace event as a Chrome trace JSON object, e.g. `{"name":"avi_seek","cat":"avi","ph":"B","ts":12.345,"pid":1,"tid":2}`.
+/// Write `[` first, then the events separated by `,` from your trace hooks, then `]`, the file opens in `chrome://tracing` and Perfetto.
+/// </summary>
+/// <param name="buffer">Your buffer for the JSON text, 128 bytes are enough for the names of the operations.</param>
+/// <param name="buffer_size">The size of `buffer`</param>
+/// <param name="name">The name of the event</param>
+/// <param name="phase">'B' for begin, 'E' for end</param>
+/// <param name="timestamp_ns">The time in nanoseconds, written in microseconds</param>
+/// <param name="pid">The process ID for the trace viewer</param>
+/// <param name="tid">The thread ID for the trace viewer</param>
+/// <returns>The length of the text, 0 if the buffer is too small.</returns>
+AVI_FUNC size_t avi_profile_format_trace_event(char *buffer, size_t buffer_size, const char *name, char phase, uint64_t timestamp_ns, uint32_t pid, uint32_t tid);
+
+/// Used by `avi_reader.c` at the beginning and the end of each timed operation.
+AVI_FUNC uint64_t avi_profile_begin(avi_profiler *p, avi_profile_op op);
+AVI_FUNC void avi_profile_end(avi_profiler *p, avi_profile_op op, uint64_t start_ns);
+
+#define AVI_PROFILE_BEGIN(op) avi_profiler *avi_prof = avi_get_profiler(); uint64_t avi_prof_start = avi_profile_begin(avi_prof, op)
+#define AVI_PROFILE_END(op) avi_profile_end(avi_prof, op, avi_prof_start)
+
+#else
+
+#define AVI_PROFILE_BEGIN(op)
+#define AVI_PROFILE_END(op)
+
+#endif
+
+#endif
@@ -1,5 +1,12 @@
 #include"avi_reader.h"
 
+#ifdef AVI_ENABLE_PROFILING
+#include"avi_profile.h"
+#else
+#define AVI_PROFILE_BEGIN(op)
+#define AVI_PROFILE_END(op)
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,7 +21,6 @@
 
 /* Flags for index */
 #define AVIIF_LIST          0x00000001L // chunk is a 'LIST'
-#define AVIIF_KEYFRAME      0x00000010L // this frame is a key frame.
 #define AVIIF_FIRSTPART     0x00000020L // this frame is the start of a partial frame.
 #define AVIIF_LASTPART      0x00000040L // this frame is the end of a partial frame.
 #define AVIIF_MIDPART       (AVIIF_LASTPART|AVIIF_FIRSTPART)
@@ -22,6 +28,12 @@
 #define AVIIF_NOTIME	    0x00000100L // this frame doesn't take any time
 #define AVIIF_COMPUSE       0x0FFF0000L // these bits are for compressor use
 
+/* Flags for the standard index entry size */
+#define AVI_STDINDEX_DELTAFRAME 0x80000000 // this frame is not a key frame.
+#define AVI_STDINDEX_SIZEMASK   0x7FFFFFFF
+
+#define AVI_INDEX_2FIELD 0x01 // the index entries have the offsets of the second fields.
+
 #define MATCH4CC(str) (*(const uint32_t*)(str))
 #define MATCH2CC(str) (*(const uint16_t*)(str))
 #define MAKE2CC(c1, c2) ((c1) | ((c2) << 8))
@@ -95,10 +107,18 @@ AVI_FUNC int avi_stream_is_midi(avi_stream_info *si)
 	return !memcmp(&si->stream_header.fccType, "mids", 4);
 }
 
+AVI_STATIC_FUNC void avi_count_read(avi_io_stats *stats, avi_io_category category, fssize_t rl)
+{
+	stats->num_reads[category]++;
+	if (rl > 0) stats->num_read_bytes[category] += (uint64_t)rl;
+}
+
 AVI_STATIC_FUNC int must_match(avi_reader *r, const char *fourcc)
 {
 	char buf[5] = { 0 };
-	if (r->f_read(buf, 4, r->userdata) != 4) return 0;
+	fssize_t rl = r->f_read(buf, 4, r->userdata);
+	avi_count_read(&r->io_stats, AVI_IO_HEADER, rl);
+	if (rl != 4) return 0;
 	if (memcmp(buf, fourcc, 4))
 	{
 		FATAL_PRINTF(r, "Matching FourCC failed: %s != %s" NL, buf, fourcc);
@@ -110,6 +130,7 @@ AVI_STATIC_FUNC int must_match(avi_reader *r, const char *fourcc)
 AVI_STATIC_FUNC int must_read(avi_reader *r, void *buffer, size_t len)
 {
 	fssize_t rl = r->f_read(buffer, len, r->userdata);
+	avi_count_read(&r->io_stats, AVI_IO_HEADER, rl);
 	if (rl == -1)
 	{
 		FATAL_PRINTF(r, "Read %u bytes failed." NL, (unsigned int)len);
@@ -129,6 +150,7 @@ AVI_STATIC_FUNC int must_read(avi_reader *r, void *buffer, size_t len)
 AVI_STATIC_FUNC int must_tell(avi_reader *r, fsize_t *cur_pos)
 {
 	fssize_t told = r->f_tell(r->userdata);
+	r->io_stats.num_tells[AVI_IO_HEADER]++;
 	if (told == -1)
 	{
 		FATAL_PRINTF(r, "`f_tell()` failed." NL, 0);
@@ -144,6 +166,7 @@ AVI_STATIC_FUNC int must_tell(avi_reader *r, fsize_t *cur_pos)
 AVI_STATIC_FUNC int must_seek(avi_reader *r, fsize_t target)
 {
 	fssize_t told = r->f_seek(target, r->userdata);
+	r->io_stats.num_seeks[AVI_IO_HEADER]++;
 	if (told == -1)
 	{
 		FATAL_PRINTF(r, "`f_seek(%x)` failed." NL, target);
@@ -155,10 +178,12 @@ AVI_STATIC_FUNC int must_seek(avi_reader *r, fsize_t target)
 	}
 }
 
-AVI_STATIC_FUNC int must_match_s(avi_stream_reader *r, const char *fourcc)
+AVI_STATIC_FUNC int must_match_s(avi_stream_reader *r, const char *fourcc, avi_io_category category)
 {
 	char buf[5] = { 0 };
-	if (r->f_read(buf, 4, r->userdata) != 4) return 0;
+	fssize_t rl = r->f_read(buf, 4, r->userdata);
+	avi_count_read(&r->io_stats, category, rl);
+	if (rl != 4) return 0;
 	if (memcmp(buf, fourcc, 4))
 	{
 		FATAL_PRINTF(r->r, "Matching FourCC failed: %s != %s" NL, buf, fourcc);
@@ -167,9 +192,10 @@ AVI_STATIC_FUNC int must_match_s(avi_stream_reader *r, const char *fourcc)
 	return 1;
 }
 
-AVI_STATIC_FUNC int must_read_s(avi_stream_reader *r, void *buffer, size_t len)
+AVI_STATIC_FUNC int must_read_s(avi_stream_reader *r, void *buffer, size_t len, avi_io_category category)
 {
 	fssize_t rl = r->f_read(buffer, len, r->userdata);
+	avi_count_read(&r->io_stats, category, rl);
 	if (rl == -1)
 	{
 		FATAL_PRINTF(r->r, "Read %u bytes failed." NL, (unsigned int)len);
@@ -186,9 +212,10 @@ AVI_STATIC_FUNC int must_read_s(avi_stream_reader *r, void *buffer, size_t len)
 	}
 }
 
-AVI_STATIC_FUNC int must_tell_s(avi_stream_reader *r, fsize_t *cur_pos)
+AVI_STATIC_FUNC int must_tell_s(avi_stream_reader *r, fsize_t *cur_pos, avi_io_category category)
 {
 	fssize_t told = r->f_tell(r->userdata);
+	r->io_stats.num_tells[category]++;
 	if (told == -1)
 	{
 		FATAL_PRINTF(r->r, "`f_tell()` failed." NL, 0);
@@ -201,9 +228,10 @@ AVI_STATIC_FUNC int must_tell_s(avi_stream_reader *r, fsize_t *cur_pos)
 	}
 }
 
-AVI_STATIC_FUNC int must_seek_s(avi_stream_reader *r, fsize_t target)
+AVI_STATIC_FUNC int must_seek_s(avi_stream_reader *r, fsize_t target, avi_io_category category)
 {
 	fssize_t told = r->f_seek(target, r->userdata);
+	r->io_stats.num_seeks[category]++;
 	if (told == -1)
 	{
 		FATAL_PRINTF(r->r, "`f_seek(%x)` failed." NL, target);
@@ -224,298 +252,476 @@ AVI_STATIC_FUNC void default_logprintf(void *userdata, const char *format, ...)
 	(void)userdata;
 }
 
-AVI_FUNC int avi_reader_init
-(
-	avi_reader *r,
-	void *userdata,
-	read_cb f_read,
-	seek_cb f_seek,
-	tell_cb f_tell,
-	logprintf_cb f_logprintf,
-	avi_logprintf_level log_level
-)
+/// The base offset of a standard index is 64-bit, the files beyond 4 GB need the high part.
+AVI_STATIC_FUNC fsize_t avi_get_base_offset(const avi_meta_index *mi)
 {
-	if (!f_logprintf) f_logprintf = default_logprintf;
-	if (!r) return 0;
-	if (!f_read) return 0;
-	if (!f_seek) return 0;
-	if (!f_tell) return 0;
-
-	memset(r, 0, sizeof  *r);
-	r->userdata = userdata;
-	r->f_read = f_read;
-	r->f_seek = f_seek;
-	r->f_tell = f_tell;
-	r->f_logprintf = f_logprintf;
-	r->log_level = log_level;
-
-	uint32_t riff_len;
-	if (!must_match(r, "RIFF")) goto ErrRet;
-	if (!must_read(r, &riff_len, 4)) goto ErrRet;
-
-	fsize_t avi_start;
-	if (!must_tell(r, &avi_start)) goto ErrRet;
-	if (!must_match(r, "AVI ")) goto ErrRet;
+#ifdef AVI_ENABLE_4GB_FILES
+	return (fsize_t)mi->reserved[0] | ((fsize_t)mi->reserved[1] << 32);
+#else
+	return mi->reserved[0];
+#endif
+}
 
-	r->end_of_file = (size_t)avi_start + riff_len;
+AVI_STATIC_FUNC int avi_reader_read_toplevel_chunk(avi_reader *r)
+{
 	char fourcc_buf[5] = { 0 };
 	uint32_t chunk_size;
+	fsize_t cur_chunk_pos;
 	fsize_t end_of_chunk;
-	int got_all_we_need = 0;
-	int has_index = 0;
+	int has_index;
 
 	// https://learn.microsoft.com/en-us/windows/win32/directshow/avi-riff-file-reference
-	while (!got_all_we_need)
+	if (!must_seek(r, r->init_next_chunk_pos)) goto ErrRet;
+	if (!must_read(r, fourcc_buf, 4)) goto ErrRet;
+	if (!must_read(r, &chunk_size, 4)) goto ErrRet;
+	if (!must_tell(r, &cur_chunk_pos)) goto ErrRet;
+	end_of_chunk = cur_chunk_pos + chunk_size;
+	switch (MATCH4CC(fourcc_buf))
 	{
-		fsize_t cur_chunk_pos;
+	default:
+	case FCC_JUNK:
+	case FCC_JUNK_:
+		INFO_PRINTF(r, "Skipping chunk \"%s\"" NL, fourcc_buf);
+		break;
+	case FCC_LIST:
+	case FCC_LIST_:
 		if (!must_read(r, fourcc_buf, 4)) goto ErrRet;
-		if (!must_read(r, &chunk_size, 4)) goto ErrRet;
-		if (!must_tell(r, &cur_chunk_pos)) goto ErrRet;
-		end_of_chunk = cur_chunk_pos + chunk_size;
 		switch (MATCH4CC(fourcc_buf))
 		{
-		default:
-		case FCC_JUNK:
-		case FCC_JUNK_:
-			INFO_PRINTF(r, "Skipping chunk \"%s\"" NL, fourcc_buf);
-			break;
-		case FCC_LIST:
-		case FCC_LIST_:
-			if (!must_read(r, fourcc_buf, 4)) goto ErrRet;
-			switch (MATCH4CC(fourcc_buf))
+		case FCC_hdrl:
+		case FCC_hdrl_:
+			INFO_PRINTF(r, "Reading toplevel LIST chunk \"hdrl\"" NL, 0);
+			do
 			{
-			case FCC_hdrl:
-			case FCC_hdrl_:
-				INFO_PRINTF(r, "Reading toplevel LIST chunk \"hdrl\"" NL, 0);
+				fsize_t end_of_hdrl = end_of_chunk;
+				int avih_read = 0;
+				int strl_read = 0;
+
+				char hdrl_fourcc_buf[5] = { 0 };
+				uint32_t hdrl_chunk_size;
+				fsize_t hdrl_chunk_pos;
+				fsize_t hdrl_end_of_chunk;
 				do
 				{
-					fsize_t end_of_hdrl = end_of_chunk;
-					int avih_read = 0;
-					int strl_read = 0;
-
-					char hdrl_fourcc_buf[5] = { 0 };
-					uint32_t hdrl_chunk_size;
-					fsize_t hdrl_chunk_pos;
-					fsize_t hdrl_end_of_chunk;
-					do
+					if (!must_read(r, hdrl_fourcc_buf, 4)) goto ErrRet;
+					if (!must_read(r, &hdrl_chunk_size, 4)) goto ErrRet;
+					if (!must_tell(r, &hdrl_chunk_pos)) goto ErrRet;
+					hdrl_end_of_chunk = hdrl_chunk_pos + hdrl_chunk_size;
+					switch (MATCH4CC(hdrl_fourcc_buf))
 					{
-						if (!must_read(r, hdrl_fourcc_buf, 4)) goto ErrRet;
-						if (!must_read(r, &hdrl_chunk_size, 4)) goto ErrRet;
-						if (!must_tell(r, &hdrl_chunk_pos)) goto ErrRet;
-						hdrl_end_of_chunk = hdrl_chunk_pos + hdrl_chunk_size;
-						switch (MATCH4CC(hdrl_fourcc_buf))
+					case FCC_avih:
+					case FCC_avih_:
+						if (avih_read)
+						{
+							FATAL_PRINTF(r, "AVI file format corrupted: duplicated main AVI header \"avih\"" NL, 0);
+							goto ErrRet;
+						}
+						INFO_PRINTF(r, "Reading the main AVI header \"avih\"" NL, 0);
+						r->avih.cb = hdrl_chunk_size;
+						if (!must_read(r, &(&(r->avih.cb))[1], r->avih.cb)) goto ErrRet;
+						if (r->avih.dwStreams > AVI_MAX_STREAMS)
+						{
+							FATAL_PRINTF(r, "The AVI file contains too many streams (%u) exceeded the limit %d" NL, r->avih.dwStreams, AVI_MAX_STREAMS);
+							goto ErrRet;
+						}
+						avih_read = 1;
+						break;
+					case FCC_LIST:
+					case FCC_LIST_:
+						do
 						{
-						case FCC_avih:
-						case FCC_avih_:
-							if (avih_read)
+							char LIST_fourcc_buf[5] = { 0 };
+							INFO_PRINTF(r, "Reading the stream list" NL, 0);
+							if (!must_read(r, LIST_fourcc_buf, 4)) goto ErrRet;
+							if (!memcmp(LIST_fourcc_buf, "odml", 4))
 							{
-								FATAL_PRINTF(r, "AVI file format corrupted: duplicated main AVI header \"avih\"" NL, 0);
-								goto ErrRet;
+								uint32_t dmlh_size;
+								INFO_PRINTF(r, "Reading the OpenDML header \"dmlh\"" NL, 0);
+								if (!must_match(r, "dmlh")) goto ErrRet;
+								if (!must_read(r, &dmlh_size, 4)) goto ErrRet;
+								if (dmlh_size >= 4)
+								{
+									if (!must_read(r, &r->odml_total_frames, 4)) goto ErrRet;
+								}
+								break;
 							}
-							INFO_PRINTF(r, "Reading the main AVI header \"avih\"" NL, 0);
-							r->avih.cb = hdrl_chunk_size;
-							if (!must_read(r, &(&(r->avih.cb))[1], r->avih.cb)) goto ErrRet;
-							if (r->avih.dwStreams > AVI_MAX_STREAMS)
+							if (memcmp(LIST_fourcc_buf, "strl", 4))
 							{
-								FATAL_PRINTF(r, "The AVI file contains too many streams (%u) exceeded the limit %d" NL, r->avih.dwStreams, AVI_MAX_STREAMS);
+								INFO_PRINTF(r, "Skipping chunk \"%s\"" NL, LIST_fourcc_buf);
+								break;
+							}
+
+							fsize_t string_len = 0;
+							uint32_t stream_id = r->num_streams;
+							if (stream_id >= AVI_MAX_STREAMS)
+							{
+								FATAL_PRINTF(r, "Too many streams in the AVI file, max supported streams is %d" NL, AVI_MAX_STREAMS);
 								goto ErrRet;
 							}
-							has_index = (r->avih.dwFlags & AVIF_HASINDEX) == AVIF_HASINDEX;
-							avih_read = 1;
-							break;
-						case FCC_LIST:
-						case FCC_LIST_:
+							avi_stream_info *stream_data = &r->avi_stream_info[r->num_streams++];
+							const fsize_t max_string_len = AVI_MAX_STREAM_NAME - 1;
+
+							char strl_fourcc[5] = { 0 };
+							uint32_t strl_chunk_size = 0;
+							fsize_t strl_chunk_pos;
+							fsize_t strl_end_of_chunk;
 							do
 							{
-								char LIST_fourcc_buf[5] = { 0 };
-								INFO_PRINTF(r, "Reading the stream list" NL, 0);
-								if (!must_read(r, LIST_fourcc_buf, 4)) goto ErrRet;
-								if (memcmp(LIST_fourcc_buf, "strl", 4))
+								if (!must_read(r, strl_fourcc, 4)) goto ErrRet;
+								if (!must_read(r, &strl_chunk_size, 4)) goto ErrRet;
+								if (!must_tell(r, &strl_chunk_pos)) goto ErrRet;
+								strl_end_of_chunk = strl_chunk_pos + strl_chunk_size;
+								switch (MATCH4CC(strl_fourcc))
 								{
-									INFO_PRINTF(r, "Skipping chunk \"%s\"" NL, LIST_fourcc_buf);
+								default:
+								case FCC_JUNK:
+								case FCC_JUNK_:
+									INFO_PRINTF(r, "Skipping chunk \"%s\"" NL, strl_fourcc);
+									break;
+								case FCC_indx:
+								case FCC_indx_:
+									INFO_PRINTF(r, "Reading the index chunk \"%s\"" NL, strl_fourcc);
+									stream_data->stream_indx_offset = strl_chunk_pos;
+									break;
+								case FCC_strh:
+								case FCC_strh_:
+									INFO_PRINTF(r, "Reading the stream header for stream id %u" NL, stream_id);
+									if (!must_read(r, &stream_data->stream_header, strl_chunk_size)) goto ErrRet;
+									string_len = (sizeof stream_data->stream_name) - 1;
+									break;
+								case FCC_strf:
+								case FCC_strf_:
+									INFO_PRINTF(r, "Reading the stream format for stream id %u" NL, stream_id);
+									if (!must_tell(r, &stream_data->stream_format_offset)) goto ErrRet;
+									stream_data->stream_format_len = strl_chunk_size;
+									break;
+								case FCC_strd:
+								case FCC_strd_:
+									INFO_PRINTF(r, "Reading the stream additional header data for stream id %u" NL, stream_id);
+									if (!must_tell(r, &stream_data->stream_additional_header_data_offset)) goto ErrRet;
+									stream_data->stream_additional_header_data_len = strl_chunk_size;
+									break;
+								case FCC_strn:
+								case FCC_strn_:
+									INFO_PRINTF(r, "Reading the stream name for stream id %u" NL, stream_id);
+									string_len = strl_chunk_size;
+									if (string_len > max_string_len) string_len = max_string_len;
+									if (!must_read(r, &stream_data->stream_name, string_len)) goto ErrRet;
 									break;
 								}
+								if (!must_seek(r, strl_end_of_chunk)) goto ErrRet;
+							} while (strl_end_of_chunk < hdrl_end_of_chunk);
 
-								fsize_t string_len = 0;
-								uint32_t stream_id = r->num_streams;
-								if (stream_id >= AVI_MAX_STREAMS)
+							if (avi_stream_is_video(stream_data))
+							{
+								size_t min_read = sizeof stream_data->bitmap_format.BMIF;
+								memset(&stream_data->bitmap_format, 0, sizeof stream_data->bitmap_format);
+								stream_data->format_data_is_valid = 0;
+								if (stream_data->stream_format_len >= min_read)
 								{
-									FATAL_PRINTF(r, "Too many streams in the AVI file, max supported streams is %d" NL, AVI_MAX_STREAMS);
-									goto ErrRet;
+									if (!must_seek(r, stream_data->stream_format_offset)) goto ErrRet;
+									if (!must_read(r, &stream_data->bitmap_format, stream_data->stream_format_len)) goto ErrRet;
+									stream_data->format_data_is_valid = 1;
 								}
-								avi_stream_info *stream_data = &r->avi_stream_info[r->num_streams++];
-								const fsize_t max_string_len = AVI_MAX_STREAM_NAME - 1;
-
-								char strl_fourcc[5] = { 0 };
-								uint32_t strl_chunk_size = 0;
-								fsize_t strl_chunk_pos;
-								fsize_t strl_end_of_chunk;
-								do
+							}
+							else if (avi_stream_is_audio(stream_data))
+							{
+								size_t max_read = sizeof stream_data->audio_format;
+								size_t min_read = max_read - 2;
+								memset(&stream_data->audio_format, 0, sizeof stream_data->audio_format);
+								stream_data->format_data_is_valid = 0;
+								if (stream_data->stream_format_len >= min_read)
 								{
-									if (!must_read(r, strl_fourcc, 4)) goto ErrRet;
-									if (!must_read(r, &strl_chunk_size, 4)) goto ErrRet;
-									if (!must_tell(r, &strl_chunk_pos)) goto ErrRet;
-									strl_end_of_chunk = strl_chunk_pos + strl_chunk_size;
-									switch (MATCH4CC(strl_fourcc))
+									if (!must_seek(r, stream_data->stream_format_offset)) goto ErrRet;
+									if (!must_read(r, &stream_data->audio_format, max_read)) goto ErrRet;
+									switch (stream_data->audio_format.wFormatTag)
 									{
-									default:
-									case FCC_JUNK:
-									case FCC_JUNK_:
-										INFO_PRINTF(r, "Skipping chunk \"%s\"" NL, strl_fourcc);
-										break;
-									case FCC_indx:
-									case FCC_indx_:
-										INFO_PRINTF(r, "Reading the index chunk \"%s\"" NL, strl_fourcc);
-										stream_data->stream_indx_offset = strl_chunk_pos;
-										break;
-									case FCC_strh:
-									case FCC_strh_:
-										INFO_PRINTF(r, "Reading the stream header for stream id %u" NL, stream_id);
-										if (!must_read(r, &stream_data->stream_header, strl_chunk_size)) goto ErrRet;
-										string_len = (sizeof stream_data->stream_name) - 1;
-										break;
-									case FCC_strf:
-									case FCC_strf_:
-										INFO_PRINTF(r, "Reading the stream format for stream id %u" NL, stream_id);
-										if (!must_tell(r, &stream_data->stream_format_offset)) goto ErrRet;
-										stream_data->stream_format_len = strl_chunk_size;
+									case 2:
 										break;
-									case FCC_strd:
-									case FCC_strd_:
-										INFO_PRINTF(r, "Reading the stream additional header data for stream id %u" NL, stream_id);
-										if (!must_tell(r, &stream_data->stream_additional_header_data_offset)) goto ErrRet;
-										stream_data->stream_additional_header_data_len = strl_chunk_size;
-										break;
-									case FCC_strn:
-									case FCC_strn_:
-										INFO_PRINTF(r, "Reading the stream name for stream id %u" NL, stream_id);
-										string_len = strl_chunk_size;
-										if (string_len > max_string_len) string_len = max_string_len;
-										if (!must_read(r, &stream_data->stream_name, string_len)) goto ErrRet;
+									default:
+										stream_data->audio_format.cbSize = 0;
 										break;
 									}
-									if (!must_seek(r, strl_end_of_chunk)) goto ErrRet;
-								} while (strl_end_of_chunk < hdrl_end_of_chunk);
-
-								if (avi_stream_is_video(stream_data))
-								{
-									size_t min_read = sizeof stream_data->bitmap_format.BMIF;
-									memset(&stream_data->bitmap_format, 0, sizeof stream_data->bitmap_format);
-									stream_data->format_data_is_valid = 0;
-									if (stream_data->stream_format_len >= min_read)
-									{
-										if (!must_seek(r, stream_data->stream_format_offset)) goto ErrRet;
-										if (!must_read(r, &stream_data->bitmap_format, stream_data->stream_format_len)) goto ErrRet;
-										stream_data->format_data_is_valid = 1;
-									}
-								}
-								else if (avi_stream_is_audio(stream_data))
-								{
-									size_t max_read = sizeof stream_data->audio_format;
-									size_t min_read = max_read - 2;
-									memset(&stream_data->audio_format, 0, sizeof stream_data->audio_format);
-									stream_data->format_data_is_valid = 0;
-									if (stream_data->stream_format_len >= min_read)
-									{
-										if (!must_seek(r, stream_data->stream_format_offset)) goto ErrRet;
-										if (!must_read(r, &stream_data->audio_format, max_read)) goto ErrRet;
-										switch (stream_data->audio_format.wFormatTag)
-										{
-										case 2:
-											break;
-										default:
-											stream_data->audio_format.cbSize = 0;
-											break;
-										}
-										stream_data->format_data_is_valid = 1;
-									}
+									stream_data->format_data_is_valid = 1;
 								}
+							}
 
-								char fourcc_type[5] = { 0 };
-								char fourcc_handler[5] = { 0 };
-								*(uint32_t *)fourcc_type = stream_data->stream_header.fccType;
-								*(uint32_t *)fourcc_handler = stream_data->stream_header.fccHandler;
-								if (!string_len)
-								{
-									INFO_PRINTF(r, "Stream %u: Type: \"%s\", Handler: \"%s\"" NL, stream_id, fourcc_type, fourcc_handler);
-								}
-								else
-								{
-									INFO_PRINTF(r, "Stream %u: Type: \"%s\", Handler: \"%s\", Name: %s" NL, stream_id, fourcc_type, fourcc_handler, stream_data->stream_name);
-								}
+							char fourcc_type[5] = { 0 };
+							char fourcc_handler[5] = { 0 };
+							*(uint32_t *)fourcc_type = stream_data->stream_header.fccType;
+							*(uint32_t *)fourcc_handler = stream_data->stream_header.fccHandler;
+							if (!string_len)
+							{
+								INFO_PRINTF(r, "Stream %u: Type: \"%s\", Handler: \"%s\"" NL, stream_id, fourcc_type, fourcc_handler);
+							}
+							else
+							{
+								INFO_PRINTF(r, "Stream %u: Type: \"%s\", Handler: \"%s\", Name: %s" NL, stream_id, fourcc_type, fourcc_handler, stream_data->stream_name);
+							}
 
-								strl_read++;
-							} while (0);
-							break;
-						default:
-						case FCC_JUNK:
-						case FCC_JUNK_:
-							INFO_PRINTF(r, "Skipping chunk \"%s\"" NL, hdrl_fourcc_buf);
-							break;
-						}
-						if (!must_seek(r, hdrl_end_of_chunk)) goto ErrRet;
-					} while (hdrl_end_of_chunk < end_of_hdrl);
-					if (!must_seek(r, end_of_hdrl)) goto ErrRet;
-					if (!avih_read)
-					{
-						FATAL_PRINTF(r, "Missing main AVI header \"avih\"" NL, 0);
-						goto ErrRet;
-					}
-					if (!strl_read)
-					{
-						FATAL_PRINTF(r, "No stream found in the AVI file." NL, 0);
-						goto ErrRet;
+							strl_read++;
+						} while (0);
+						break;
+					default:
+					case FCC_JUNK:
+					case FCC_JUNK_:
+						INFO_PRINTF(r, "Skipping chunk \"%s\"" NL, hdrl_fourcc_buf);
+						break;
 					}
-				} while (0);
-
-				break;
-			case FCC_movi:
-			case FCC_movi_:
-				INFO_PRINTF(r, "Reading toplevel LIST chunk \"movi\"" NL, 0);
-				if (!must_tell(r, &r->stream_data_offset)) goto ErrRet;
+					if (!must_seek(r, hdrl_end_of_chunk)) goto ErrRet;
+				} while (hdrl_end_of_chunk < end_of_hdrl);
+				if (!must_seek(r, end_of_hdrl)) goto ErrRet;
+				if (!avih_read)
+				{
+					FATAL_PRINTF(r, "Missing main AVI header \"avih\"" NL, 0);
+					goto ErrRet;
+				}
+				if (!strl_read)
+				{
+					FATAL_PRINTF(r, "No stream found in the AVI file." NL, 0);
+					goto ErrRet;
+				}
+			} while (0);
 
-				// Check if the AVI file uses LIST(rec) pattern to store the packets
+			break;
+		case FCC_movi:
+		case FCC_movi_:
+			INFO_PRINTF(r, "Reading toplevel LIST chunk \"movi\"" NL, 0);
+			if (!must_tell(r, &r->stream_data_offset)) goto ErrRet;
+			do
+			{
+				// A crashed recorder may leave a broken size, then the packets are searched until the end of the `RIFF` chunk.
+				fsize_t end_of_movi = end_of_chunk;
+				if (end_of_movi <= r->stream_data_offset || end_of_movi > r->end_of_file) end_of_movi = r->end_of_file;
+				r->movi_ranges[0].offset = r->stream_data_offset;
+				r->movi_ranges[0].end = end_of_movi;
+				r->num_movi_ranges = 1;
+			} while (0);
+
+			// Check if the AVI file uses LIST(rec) pattern to store the packets
+			if (!must_read(r, fourcc_buf, 4)) goto ErrRet;
+			if (!memcmp(fourcc_buf, "LIST", 4))
+			{
 				if (!must_read(r, fourcc_buf, 4)) goto ErrRet;
-				if (!memcmp(fourcc_buf, "LIST", 4))
+				if (!memcmp(fourcc_buf, "rec ", 4))
 				{
-					if (!must_read(r, fourcc_buf, 4)) goto ErrRet;
-					if (!memcmp(fourcc_buf, "rec ", 4))
-					{
-						INFO_PRINTF(r, "This AVI file uses `LIST(rec)` structure to store packets." NL, 0);
-					}
-					else
-					{
-						FATAL_PRINTF(r, "Inside LIST(movi): expected LIST(rec), got LIST(%s)." NL, fourcc_buf);
-						goto ErrRet;
-					}
+					INFO_PRINTF(r, "This AVI file uses `LIST(rec)` structure to store packets." NL, 0);
+				}
+				else
+				{
+					FATAL_PRINTF(r, "Inside LIST(movi): expected LIST(rec), got LIST(%s)." NL, fourcc_buf);
+					goto ErrRet;
 				}
-				break;
 			}
 			break;
-		case FCC_idx1:
-		case FCC_idx1_:
-			INFO_PRINTF(r, "Reading toplevel chunk \"idx1\"" NL, 0);
-			if (!must_tell(r, &r->idx1_offset)) goto ErrRet;
-			r->num_indices = chunk_size / sizeof(avi_index_entry);
-			break;
 		}
-		// Skip the current chunk
-		if (!must_seek(r, end_of_chunk)) goto ErrRet;
-		got_all_we_need = r->num_streams && r->stream_data_offset && ((has_index && r->idx1_offset) || !has_index);
-		if (end_of_chunk == r->end_of_file) break;
+		break;
+	case FCC_idx1:
+	case FCC_idx1_:
+		INFO_PRINTF(r, "Reading toplevel chunk \"idx1\"" NL, 0);
+		if (!must_tell(r, &r->idx1_offset)) goto ErrRet;
+		r->num_indices = chunk_size / sizeof(avi_index_entry);
+		break;
+	}
+	// Skip the current chunk
+	if (!must_seek(r, end_of_chunk)) goto ErrRet;
+	r->init_next_chunk_pos = end_of_chunk;
+	has_index = (r->avih.dwFlags & AVIF_HASINDEX) == AVIF_HASINDEX;
+	if (r->num_streams && r->stream_data_offset && ((has_index && r->idx1_offset) || !has_index)) r->is_first_riff_done = 1;
+	if (end_of_chunk == r->end_of_file) r->is_first_riff_done = 1;
+	if (r->is_first_riff_done)
+	{
+		r->init_next_chunk_pos = r->end_of_file + (r->end_of_file & 1);
+		if (!r->stream_data_offset) r->is_init_done = 1;
+	}
+	return 1;
+ErrRet:
+	return 0;
+}
+
+/// Find the `movi` chunk of the `RIFF AVIX` chunk at `r->init_next_chunk_pos`. If there's no more `RIFF AVIX` chunk, the parsing is done.
+AVI_STATIC_FUNC int avi_reader_read_avix_chunk(avi_reader *r)
+{
+	char fourcc_buf[5] = { 0 };
+	uint32_t chunk_size;
+	uint32_t riff_header[3];
+	fsize_t riff_start = r->init_next_chunk_pos;
+	fsize_t end_of_riff;
+	fsize_t pos;
+	fssize_t rl = -1;
+
+	// The end of the file is normal here, so the reading is not `must_read()`.
+	r->io_stats.num_seeks[AVI_IO_HEADER]++;
+	if (r->f_seek(riff_start, r->userdata) != -1)
+	{
+		rl = r->f_read(riff_header, sizeof riff_header, r->userdata);
+		avi_count_read(&r->io_stats, AVI_IO_HEADER, rl);
 	}
+	if (rl != (fssize_t)sizeof riff_header ||
+		memcmp(&riff_header[0], "RIFF", 4) || memcmp(&riff_header[2], "AVIX", 4))
+	{
+		r->is_init_done = 1;
+		return 1;
+	}
+	if (r->num_movi_ranges >= AVI_MAX_RIFF_CHUNKS)
+	{
+		WARN_PRINTF(r, "Too many `RIFF AVIX` chunks, max supported is %d, the rest of the file is ignored." NL, AVI_MAX_RIFF_CHUNKS);
+		r->is_init_done = 1;
+		return 1;
+	}
+	INFO_PRINTF(r, "Reading toplevel chunk \"RIFF AVIX\" at 0x%"PRIxfsize_t NL, riff_start);
 
-	if (!r->idx1_offset)
+	end_of_riff = riff_start + 8 + riff_header[1];
+	pos = riff_start + 12;
+	while (pos + 12 <= end_of_riff)
 	{
-		WARN_PRINTF(r, "No AVI index: per-stream seeking requires per-packet file traversal." NL, 0);
+		fsize_t end_of_chunk;
+		if (!must_seek(r, pos)) goto ErrRet;
+		if (!must_read(r, fourcc_buf, 4)) goto ErrRet;
+		if (!must_read(r, &chunk_size, 4)) goto ErrRet;
+		end_of_chunk = pos + 8 + chunk_size;
+		if (!memcmp(fourcc_buf, "LIST", 4))
+		{
+			if (!must_read(r, fourcc_buf, 4)) goto ErrRet;
+			if (!memcmp(fourcc_buf, "movi", 4))
+			{
+				avi_movi_range *range = &r->movi_ranges[r->num_movi_ranges++];
+				range->offset = pos + 12;
+				range->end = end_of_chunk > end_of_riff ? end_of_riff : end_of_chunk;
+				break;
+			}
+		}
+		pos = end_of_chunk + (chunk_size & 1);
 	}
+	r->init_next_chunk_pos = end_of_riff + (end_of_riff & 1);
+	return 1;
+ErrRet:
+	return 0;
+}
+
+AVI_STATIC_FUNC int avi_reader_init_begin_impl
+(
+	avi_reader *r,
+	void *userdata,
+	read_cb f_read,
+	seek_cb f_seek,
+	tell_cb f_tell,
+	logprintf_cb f_logprintf,
+	avi_logprintf_level log_level
+)
+{
+	if (!f_logprintf) f_logprintf = default_logprintf;
+	if (!r) return 0;
+	if (!f_read) return 0;
+	if (!f_seek) return 0;
+	if (!f_tell) return 0;
+
+	memset(r, 0, sizeof  *r);
+	r->userdata = userdata;
+	r->f_read = f_read;
+	r->f_seek = f_seek;
+	r->f_tell = f_tell;
+	r->f_logprintf = f_logprintf;
+	r->log_level = log_level;
+
+	uint32_t riff_len;
+	if (!must_match(r, "RIFF")) goto ErrRet;
+	if (!must_read(r, &riff_len, 4)) goto ErrRet;
+
+	fsize_t avi_start;
+	if (!must_tell(r, &avi_start)) goto ErrRet;
+	if (!must_match(r, "AVI ")) goto ErrRet;
 
+	r->end_of_file = (size_t)avi_start + riff_len;
+	r->init_next_chunk_pos = avi_start + 4;
 	return 1;
 ErrRet:
 	if (r) FATAL_PRINTF(r, "Reading AVI file failed." NL, 0);
 	return 0;
 }
 
+AVI_FUNC int avi_reader_init_begin
+(
+	avi_reader *r,
+	void *userdata,
+	read_cb f_read,
+	seek_cb f_seek,
+	tell_cb f_tell,
+	logprintf_cb f_logprintf,
+	avi_logprintf_level log_level
+)
+{
+	int ret;
+	AVI_PROFILE_BEGIN(AVI_OP_INIT);
+	ret = avi_reader_init_begin_impl(r, userdata, f_read, f_seek, f_tell, f_logprintf, log_level);
+	AVI_PROFILE_END(AVI_OP_INIT);
+	return ret;
+}
+
+AVI_STATIC_FUNC avi_step_result avi_reader_init_continue_impl(avi_reader *r, uint32_t max_chunks)
+{
+	if (!r) return AVI_STEP_FAILED;
+	if (!r->f_read) return AVI_STEP_FAILED;
+
+	for (uint32_t i = 0; !r->is_init_done; i++)
+	{
+		if (max_chunks && i >= max_chunks) return AVI_STEP_IN_PROGRESS;
+		if (!r->is_first_riff_done)
+		{
+			if (!avi_reader_read_toplevel_chunk(r)) goto ErrRet;
+		}
+		else
+		{
+			if (!avi_reader_read_avix_chunk(r)) goto ErrRet;
+		}
+		if (r->is_init_done && !r->idx1_offset)
+		{
+			WARN_PRINTF(r, "No AVI index: per-stream seeking requires per-packet file traversal." NL, 0);
+		}
+	}
+
+	return AVI_STEP_DONE;
+ErrRet:
+	FATAL_PRINTF(r, "Reading AVI file failed." NL, 0);
+	return AVI_STEP_FAILED;
+}
+
+AVI_FUNC avi_step_result avi_reader_init_continue(avi_reader *r, uint32_t max_chunks)
+{
+	avi_step_result ret;
+	AVI_PROFILE_BEGIN(AVI_OP_INIT);
+	ret = avi_reader_init_continue_impl(r, max_chunks);
+	AVI_PROFILE_END(AVI_OP_INIT);
+	return ret;
+}
+
+AVI_FUNC int avi_reader_init
+(
+	avi_reader *r,
+	void *userdata,
+	read_cb f_read,
+	seek_cb f_seek,
+	tell_cb f_tell,
+	logprintf_cb f_logprintf,
+	avi_logprintf_level log_level
+)
+{
+	int ret;
+	AVI_PROFILE_BEGIN(AVI_OP_INIT);
+	ret = avi_reader_init_begin_impl(r, userdata, f_read, f_seek, f_tell, f_logprintf, log_level) &&
+		avi_reader_init_continue_impl(r, 0) == AVI_STEP_DONE;
+	AVI_PROFILE_END(AVI_OP_INIT);
+	return ret;
+}
+
+AVI_FUNC uint32_t avi_reader_get_total_frames(avi_reader *r)
+{
+	if (!r) return 0;
+	if (r->odml_total_frames) return r->odml_total_frames;
+	return r->avih.dwTotalFrames;
+}
+
+
 AVI_STATIC_FUNC void default_on_stream_data_cb(fsize_t offset, fsize_t length, void *userdata)
 {
 	(void)offset;
@@ -523,12 +729,21 @@ AVI_STATIC_FUNC void default_on_stream_data_cb(fsize_t offset, fsize_t length, v
 	(void)userdata;
 }
 
+/// A standard index has 2 longs per entry, a field index of interlaced video has 3 longs per entry.
+AVI_STATIC_FUNC int avi_is_stdindex(const avi_meta_index *mi)
+{
+	if (mi->index_type != 1) return 0;
+	if (mi->longs_per_entry == 2 && mi->index_sub_type == 0) return 1;
+	if (mi->longs_per_entry == 3 && mi->index_sub_type == AVI_INDEX_2FIELD) return 1;
+	return 0;
+}
+
 AVI_STATIC_FUNC int avi_setup_indx_cache(avi_stream_reader *s, fsize_t indx_offset)
 {
 	avi_meta_index mi;
 	avi_reader *r = s->r;
 	avi_indx_cache *indx = &s->indx;
-	fsize_t cur_offset;
+	fsize_t cur_offset = 0;
 
 	if (!indx_offset)
 	{
@@ -541,10 +756,10 @@ AVI_STATIC_FUNC int avi_setup_indx_cache(avi_stream_reader *s, fsize_t indx_offs
 		INFO_PRINTF(r, "Reading the 'indx' chunk of stream %d." NL, s->stream_id);
 	}
 
-	if (!must_tell_s(s, &cur_offset)) goto ErrRet;
-	if (!must_seek_s(s, indx_offset)) goto ErrRet;
-	if (!must_read_s(s, &mi, sizeof mi)) goto ErrRet;
-	if (!must_seek_s(s, cur_offset)) goto ErrRet;
+	if (!must_tell_s(s, &cur_offset, AVI_IO_INDX)) goto ErrRet;
+	if (!must_seek_s(s, indx_offset, AVI_IO_INDX)) goto ErrRet;
+	if (!must_read_s(s, &mi, sizeof mi, AVI_IO_INDX)) goto ErrRet;
+	if (!must_seek_s(s, cur_offset, AVI_IO_INDX)) goto ErrRet;
 	cur_offset = 0;
 
 	indx->offset_to_first_entry = indx_offset + sizeof(avi_meta_index);
@@ -559,101 +774,116 @@ AVI_STATIC_FUNC int avi_setup_indx_cache(avi_stream_reader *s, fsize_t indx_offs
 			WARN_PRINTF(r, "The 'indx' chunk is a super index chunk but `longs_per_entry` is %u, it should be 4." NL, mi.longs_per_entry);
 			goto ErrRet;
 		}
-		if (mi.index_sub_type != 0)
+		if (mi.index_sub_type != 0 && mi.index_sub_type != AVI_INDEX_2FIELD)
 		{
-			WARN_PRINTF(r, "The 'indx' chunk is a super index chunk but `index_sub_type` is %u, it should be 0." NL, mi.index_sub_type);
+			WARN_PRINTF(r, "The 'indx' chunk is a super index chunk but `index_sub_type` is %u, it should be 0 or `AVI_INDEX_2FIELD`." NL, mi.index_sub_type);
 			goto ErrRet;
 		}
 		indx->is_super = 1;
 		break;
 	case 1:
-		if (mi.longs_per_entry != 2)
-		{
-			WARN_PRINTF(r, "The 'indx' chunk is a standard index chunk but `longs_per_entry` is %u, it should be 2." NL, mi.longs_per_entry);
-			goto ErrRet;
-		}
-		if (mi.index_sub_type != 0)
+		if (!avi_is_stdindex(&mi))
 		{
-			WARN_PRINTF(r, "The 'indx' chunk is a standard index chunk but `index_sub_type` is %u, it should be 0." NL, mi.index_sub_type);
+			WARN_PRINTF(r, "The 'indx' chunk is a standard index chunk but `longs_per_entry` is %u and `index_sub_type` is %u, they should be 2 and 0, or 3 and `AVI_INDEX_2FIELD`." NL, mi.longs_per_entry, mi.index_sub_type);
 			goto ErrRet;
 		}
 		indx->is_super = 0;
-		indx->base_offset = mi.reserved[0];
+		indx->is_field_index = mi.index_sub_type == AVI_INDEX_2FIELD;
+		indx->base_offset = avi_get_base_offset(&mi);
 		break;
 	default:
 		WARN_PRINTF(r, "Unknown 'indx' chunk type: %u." NL, mi.index_type);
 		goto ErrRet;
 	}
 
-	indx->cache_head = &indx->cache[0];
-	indx->cache_tail = &indx->cache[AVI_MAX_INDX_CACHE - 1];
 	for (size_t i = 0; i < AVI_MAX_INDX_CACHE; i++)
 	{
-		avi_indx_cached_entry *cached = &indx->cache[i];
-		cached->prev = (i == 0) ? NULL : &indx->cache[i - 1];
-		cached->next = (i == AVI_MAX_INDX_CACHE - 1) ? NULL : &indx->cache[i + 1];
+		indx->lru[i] = (uint8_t)i;
+		indx->cache[i].offset = 0;
 	}
 
 	return 1;
 ErrRet:
-	if (cur_offset) must_seek_s(s, cur_offset);
+	if (cur_offset) must_seek_s(s, cur_offset, AVI_IO_INDX);
 	WARN_PRINTF(r, "Stream %d read 'indx' chunk failed." NL, s->stream_id);
 	return 0;
 }
 
-AVI_STATIC_FUNC void avi_indx_move_cache_to_head(avi_stream_reader *s, avi_indx_cached_entry *cached)
+AVI_STATIC_FUNC void avi_indx_move_cache_to_head(avi_indx_cache *indx, uint32_t lru_pos)
 {
-	avi_indx_cache *indx = &s->indx;
+	uint8_t slot = indx->lru[lru_pos];
+	for (; lru_pos > 0; lru_pos--) indx->lru[lru_pos] = indx->lru[lru_pos - 1];
+	indx->lru[0] = slot;
+}
 
-	avi_indx_cached_entry *prev = cached->prev;
-	avi_indx_cached_entry *next = cached->next;
-	if (cached == indx->cache_head) return;
-	if (prev) prev->next = next;
-	if (next) next->prev = prev;
-	if (cached == indx->cache_tail)
+AVI_STATIC_FUNC const avi_indx_cached_entry *avi_indx_find_shared_entry(const avi_indx_cache *shared, uint32_t entry_index)
+{
+	for (size_t i = 0; i < AVI_MAX_INDX_CACHE; i++)
 	{
-		indx->cache_tail = prev;
-		if (prev) prev->next = NULL;
+		const avi_indx_cached_entry *cached = &shared->cache[i];
+		if (cached->offset != 0 && cached->index == entry_index) return cached;
 	}
-	if (indx->cache_head)
-		indx->cache_head->prev = cached;
-	cached->prev = NULL;
-	cached->next = indx->cache_head;
-	indx->cache_head = cached;
+	return NULL;
 }
 
 AVI_STATIC_FUNC avi_indx_cached_entry *avi_indx_read_entry(avi_stream_reader *s, uint32_t entry_index)
 {
 	avi_reader *r = s->r;
 	avi_indx_cache *indx = &s->indx;
-	avi_indx_cached_entry *cached = indx->cache_head;
+	avi_indx_cached_entry *cached;
+	const avi_indx_cached_entry *shared;
+	uint32_t lru_pos = AVI_MAX_INDX_CACHE;
 	avi_super_index_entry si;
 	avi_meta_index mi;
+	int loaded;
 
 	if (entry_index >= indx->num_entries) return NULL;
-	if (!cached) return NULL;
 	if (!indx->is_super) return NULL;
 
-	do
+	for (uint32_t i = 0; i < AVI_MAX_INDX_CACHE; i++)
 	{
-		if (cached->index == entry_index && cached->offset != 0) return cached;
-		if (!cached->offset) break;
-		cached = cached->next;
-	} while (cached);
-
-	INFO_PRINTF(r, "Reading super index %u for stream %u into cache" NL, entry_index, s->stream_id);
+		cached = &indx->cache[indx->lru[i]];
+		if (!cached->offset)
+		{
+			if (lru_pos == AVI_MAX_INDX_CACHE) lru_pos = i;
+			continue;
+		}
+		if (cached->index == entry_index)
+		{
+			avi_indx_move_cache_to_head(indx, i);
+			return cached;
+		}
+	}
 
-	if (!cached) cached = indx->cache_tail;
-	avi_indx_move_cache_to_head(s, cached);
+	// Use an empty slot, or the least recently used one.
+	if (lru_pos == AVI_MAX_INDX_CACHE) lru_pos = AVI_MAX_INDX_CACHE - 1;
+	cached = &indx->cache[indx->lru[lru_pos]];
+	if (cached->offset) s->io_stats.indx_cache_evictions++;
+	avi_indx_move_cache_to_head(indx, lru_pos);
 	cached->index = entry_index;
-	if (!must_seek(r, indx->offset_to_first_entry + entry_index * sizeof si)) goto FailExit;
-	if (!must_read(r, &si, sizeof si)) goto FailExit;
-	if (!must_seek(r, (fsize_t)si.offset + 8)) goto FailExit;
-	if (!must_read(r, &mi, sizeof mi)) goto FailExit;
-	if (mi.longs_per_entry != 2 || mi.index_type != 1 || mi.index_sub_type != 0)
+
+	// A clone takes the super index entry from the cache of the source, and loads only the index entries it misses.
+	shared = s->indx_shared ? avi_indx_find_shared_entry(s->indx_shared, entry_index) : NULL;
+	if (shared)
+	{
+		memcpy(cached, shared, offsetof(avi_indx_cached_entry, cached_entries));
+		cached->cached_entries_start_index = -1;
+		return cached;
+	}
+
+	INFO_PRINTF(r, "Reading super index %u for stream %u into cache" NL, entry_index, s->stream_id);
+	AVI_PROFILE_BEGIN(AVI_OP_INDEX_LOAD);
+	loaded =
+		must_seek_s(s, indx->offset_to_first_entry + entry_index * sizeof si, AVI_IO_INDX) &&
+		must_read_s(s, &si, sizeof si, AVI_IO_INDX) &&
+		must_seek_s(s, (fsize_t)si.offset + 8, AVI_IO_INDX) &&
+		must_read_s(s, &mi, sizeof mi, AVI_IO_INDX);
+	AVI_PROFILE_END(AVI_OP_INDEX_LOAD);
+	if (!loaded) goto FailExit;
+	if (!avi_is_stdindex(&mi))
 	{
 		FATAL_PRINTF(r, "Standard index chunk expected." NL, 0);
-		return 0;
+		goto FailExit;
 	}
 	cached->offset = (fsize_t)si.offset;
 	cached->length = si.size;
@@ -661,7 +891,8 @@ AVI_STATIC_FUNC avi_indx_cached_entry *avi_indx_read_entry(avi_stream_reader *s,
 	cached->num_packets = mi.entries_in_use;
 	cached->duration = si.duration;
 	cached->chunk_id = mi.chunk_id;
-	cached->chunk_base_offset = mi.reserved[0];
+	cached->chunk_base_offset = avi_get_base_offset(&mi);
+	cached->is_field_index = mi.index_sub_type == AVI_INDEX_2FIELD;
 	cached->cached_entries_start_index = -1;
 	return cached;
 FailExit:
@@ -670,6 +901,62 @@ FailExit:
 	return NULL;
 }
 
+AVI_STATIC_FUNC int avi_indx_is_entry_cached(const avi_indx_cached_entry *cache, uint64_t packet_index)
+{
+	fsize_t rel_entry_index;
+	if (cache->start_packet_number < 0) return 0;
+	if (cache->cached_entries_start_index == -1) return 0;
+	rel_entry_index = (fsize_t)(packet_index - cache->start_packet_number);
+	if (rel_entry_index < cache->cached_entries_start_index) return 0;
+	if (rel_entry_index >= cache->cached_entries_start_index + AVI_ENTRIES_PER_INDX_CACHE) return 0;
+	return 1;
+}
+
+AVI_STATIC_FUNC const avi_indx_cached_entry *avi_indx_find_shared_packet(const avi_indx_cache *shared, uint64_t packet_index)
+{
+	for (size_t i = 0; i < AVI_MAX_INDX_CACHE; i++)
+	{
+		const avi_indx_cached_entry *cached = &shared->cache[i];
+		if (!cached->offset || cached->start_packet_number < 0) continue;
+		if (packet_index < (uint64_t)cached->start_packet_number) continue;
+		if (packet_index >= (uint64_t)cached->start_packet_number + cached->num_packets) continue;
+		if (avi_indx_is_entry_cached(cached, packet_index)) return cached;
+	}
+	return NULL;
+}
+
+AVI_STATIC_FUNC void avi_indx_set_cur_packet(avi_stream_reader *s, const avi_field_index_entry *fi, fsize_t base_offset, int is_field_index)
+{
+	fsize_t offset_field2 = fi->offset_field2 + base_offset;
+	s->cur_packet_offset = fi->offset + base_offset;
+	s->cur_packet_len = fi->size & AVI_STDINDEX_SIZEMASK;
+	s->cur_packet_is_keyframe = !(fi->size & AVI_STDINDEX_DELTAFRAME);
+	s->cur_field2_offset = 0;
+
+	// Only trust the second field inside the frame.
+	if (is_field_index && offset_field2 > s->cur_packet_offset && offset_field2 < s->cur_packet_offset + s->cur_packet_len)
+		s->cur_field2_offset = offset_field2;
+}
+
+AVI_STATIC_FUNC void avi_indx_use_cached_packet(avi_stream_reader *s, const avi_indx_cached_entry *cache, uint64_t packet_index)
+{
+	fsize_t rel_entry_index = (fsize_t)(packet_index - cache->start_packet_number) % AVI_ENTRIES_PER_INDX_CACHE;
+	avi_field_index_entry fi;
+	if (cache->is_field_index)
+		fi = cache->cached_field_entries[rel_entry_index];
+	else
+	{
+		fi.offset = cache->cached_entries[rel_entry_index].offset;
+		fi.size = cache->cached_entries[rel_entry_index].size;
+		fi.offset_field2 = 0;
+	}
+	s->is_no_more_packets = 0;
+	s->cur_4cc = cache->chunk_id;
+	s->cur_packet_index = (fsize_t)packet_index;
+	s->cur_stream_packet_index = (fsize_t)packet_index;
+	avi_indx_set_cur_packet(s, &fi, cache->chunk_base_offset, cache->is_field_index);
+}
+
 AVI_STATIC_FUNC int avi_indx_seek_to_packet(avi_stream_reader *s, uint64_t packet_index)
 {
 	avi_reader *r = s->r;
@@ -677,6 +964,18 @@ AVI_STATIC_FUNC int avi_indx_seek_to_packet(avi_stream_reader *s, uint64_t packe
 
 	if (indx->is_super)
 	{
+		// One hit or one miss per lookup, it's a miss if any super index entry or any index entries had to be read.
+		uint64_t num_indx_reads = s->io_stats.num_reads[AVI_IO_INDX];
+
+		// A clone first looks in the cache of the source, without writing it.
+		const avi_indx_cached_entry *shared = s->indx_shared ? avi_indx_find_shared_packet(s->indx_shared, packet_index) : NULL;
+		if (shared)
+		{
+			indx->last_cache_index = shared->index;
+			s->io_stats.indx_cache_hits++;
+			avi_indx_use_cached_packet(s, shared, packet_index);
+			return 1;
+		}
 		for(;;)
 		{
 			uint32_t cur_entry_index = indx->last_cache_index;
@@ -684,9 +983,11 @@ AVI_STATIC_FUNC int avi_indx_seek_to_packet(avi_stream_reader *s, uint64_t packe
 			uint32_t cur_entry_packets;
 			fsize_t rel_entry_index;
 			fsize_t entry_offset;
-			avi_stdindex_entry *si;
+			size_t entry_size;
 			if (cur_entry_index >= indx->num_entries)
 			{
+				// Stay on the last entry, so that the stream reader could still move backward.
+				if (indx->num_entries) indx->last_cache_index = indx->num_entries - 1;
 				s->is_no_more_packets = 1;
 				return 0;
 			}
@@ -730,47 +1031,69 @@ AVI_STATIC_FUNC int avi_indx_seek_to_packet(avi_stream_reader *s, uint64_t packe
 				continue;
 			}
 			entry_offset = cache->offset + 8 + sizeof(avi_meta_index);
+			entry_size = cache->is_field_index ? sizeof(avi_field_index_entry) : sizeof(avi_stdindex_entry);
 			rel_entry_index = (fsize_t)(packet_index - cache->start_packet_number);
-			if (cache->cached_entries_start_index == -1 || rel_entry_index < cache->cached_entries_start_index || rel_entry_index >= cache->cached_entries_start_index + AVI_ENTRIES_PER_INDX_CACHE)
+			if (!avi_indx_is_entry_cached(cache, packet_index))
 			{
-				fsize_t num_entries_to_load = cache->num_packets - cache->start_packet_number;
-				if (num_entries_to_load > AVI_ENTRIES_PER_INDX_CACHE) num_entries_to_load = AVI_ENTRIES_PER_INDX_CACHE;
 				cache->cached_entries_start_index = (rel_entry_index / AVI_ENTRIES_PER_INDX_CACHE) * AVI_ENTRIES_PER_INDX_CACHE;
+				fsize_t num_entries_to_load = (fsize_t)(cache->num_packets - cache->cached_entries_start_index);
+				if (num_entries_to_load > AVI_ENTRIES_PER_INDX_CACHE) num_entries_to_load = AVI_ENTRIES_PER_INDX_CACHE;
 				INFO_PRINTF(r, "Stream %d: loading entries from %"PRIfsize_t" to %"PRIfsize_t NL, s->stream_id, cache->cached_entries_start_index, cache->cached_entries_start_index + num_entries_to_load - 1);
-				if (!must_seek(r, (fsize_t)(entry_offset + cache->cached_entries_start_index * sizeof *si))) return 0;
-				if (!must_read(r, &cache->cached_entries, num_entries_to_load * sizeof * si)) return 0;
+				AVI_PROFILE_BEGIN(AVI_OP_INDEX_LOAD);
+				int loaded =
+					must_seek_s(s, (fsize_t)(entry_offset + cache->cached_entries_start_index * entry_size), AVI_IO_INDX) &&
+					must_read_s(s, &cache->cached_entries, num_entries_to_load * entry_size, AVI_IO_INDX);
+				AVI_PROFILE_END(AVI_OP_INDEX_LOAD);
+				if (!loaded) return 0;
 			}
-			rel_entry_index %= AVI_ENTRIES_PER_INDX_CACHE;
-			si = &cache->cached_entries[rel_entry_index];
-			s->is_no_more_packets = 0;
-			s->cur_4cc = cache->chunk_id;
-			s->cur_packet_index = (fsize_t)packet_index;
-			s->cur_stream_packet_index = (fsize_t)packet_index;
-			s->cur_packet_offset = si->offset + cache->chunk_base_offset;
-			s->cur_packet_len = si->size;
+			if (s->io_stats.num_reads[AVI_IO_INDX] != num_indx_reads)
+				s->io_stats.indx_cache_misses++;
+			else
+				s->io_stats.indx_cache_hits++;
+			avi_indx_use_cached_packet(s, cache, packet_index);
 			return 1;
 		}
 	}
 	else
 	{
-		avi_stdindex_entry si;
+		avi_field_index_entry fi = { 0 };
+		size_t entry_size = indx->is_field_index ? sizeof(avi_field_index_entry) : sizeof(avi_stdindex_entry);
 		if (packet_index >= indx->num_entries)
 		{
 			s->is_no_more_packets = 1;
 			return 0;
 		}
-		if (!must_seek(r, (fsize_t)(indx->offset_to_first_entry + packet_index * sizeof si))) return 0;
-		if (!must_read(r, &si, sizeof si)) return 0;
+		if (!must_seek_s(s, (fsize_t)(indx->offset_to_first_entry + packet_index * entry_size), AVI_IO_INDX)) return 0;
+		if (!must_read_s(s, &fi, entry_size, AVI_IO_INDX)) return 0;
 		s->is_no_more_packets = 0;
 		s->cur_4cc = indx->chunk_id;
 		s->cur_packet_index = (fsize_t)packet_index;
 		s->cur_stream_packet_index = (fsize_t)packet_index;
-		s->cur_packet_offset = si.offset + indx->base_offset;
-		s->cur_packet_len = si.size;
+		avi_indx_set_cur_packet(s, &fi, indx->base_offset, indx->is_field_index);
 		return 1;
 	}
 }
 
+AVI_STATIC_FUNC int avi_packet_table_seek_to_packet(avi_stream_reader *s, fsize_t packet_index)
+{
+	const avi_packet_table_entry *entry;
+	if (packet_index >= s->packet_table_len)
+	{
+		s->is_no_more_packets = 1;
+		return 0;
+	}
+	entry = &s->packet_table[packet_index];
+	s->is_no_more_packets = 0;
+	s->cur_4cc = entry->chunk_id;
+	s->cur_packet_index = packet_index;
+	s->cur_stream_packet_index = packet_index;
+	s->cur_packet_offset = (fsize_t)entry->offset;
+	s->cur_packet_len = entry->size & AVI_STDINDEX_SIZEMASK;
+	s->cur_field2_offset = 0;
+	s->cur_packet_is_keyframe = !(entry->size & AVI_STDINDEX_DELTAFRAME);
+	return 1;
+}
+
 AVI_FUNC int avi_get_stream_reader
 (
 	avi_reader *r,
@@ -986,7 +1309,11 @@ AVI_FUNC int avi_apply_palette_change(avi_stream_reader *s, void *pc)
 	for (uint32_t si = 0; si < pc_data->num_entries; si++)
 	{
 		di = si + pc_data->first_entry;
-		sif->bitmap_format.palette[di] = pc_data->palette[si];
+		if (di >= 256) break;
+		sif->bitmap_format.palette[di].B = pc_data->palette[si].B;
+		sif->bitmap_format.palette[di].G = pc_data->palette[si].G;
+		sif->bitmap_format.palette[di].R = pc_data->palette[si].R;
+		sif->bitmap_format.palette[di].Reserved = 0;
 	}
 
 	if (sif->bitmap_format.BMIF.biClrUsed && sif->bitmap_format.BMIF.biClrUsed < di) sif->bitmap_format.BMIF.biClrUsed = di;
@@ -1013,6 +1340,16 @@ AVI_FUNC void avi_stream_reader_set_read_seek_tell
 	return;
 }
 
+AVI_STATIC_FUNC int avi_stream_reader_call_on_video_fields(avi_stream_reader *s)
+{
+	fsize_t field1_len, field2_len;
+	if (!s->on_video_fields || !s->cur_field2_offset) return 0;
+	field1_len = s->cur_field2_offset - s->cur_packet_offset;
+	field2_len = s->cur_packet_len - field1_len;
+	s->on_video_fields(s->cur_packet_offset, field1_len, s->cur_field2_offset, field2_len, s->userdata);
+	return 1;
+}
+
 AVI_FUNC int avi_stream_reader_call_callback_functions(avi_stream_reader *s)
 {
 	avi_reader *r = NULL;
@@ -1024,11 +1361,11 @@ AVI_FUNC int avi_stream_reader_call_callback_functions(avi_stream_reader *s)
 	{
 	case TCC_db:
 	case TCC_db_:
-		s->on_video(s->cur_packet_offset, s->cur_packet_len, s->userdata);
+		if (!avi_stream_reader_call_on_video_fields(s)) s->on_video(s->cur_packet_offset, s->cur_packet_len, s->userdata);
 		break;
 	case TCC_dc:
 	case TCC_dc_:
-		s->on_video_compressed(s->cur_packet_offset, s->cur_packet_len, s->userdata);
+		if (!avi_stream_reader_call_on_video_fields(s)) s->on_video_compressed(s->cur_packet_offset, s->cur_packet_len, s->userdata);
 		break;
 	case TCC_pc:
 	case TCC_pc_:
@@ -1045,6 +1382,52 @@ AVI_FUNC int avi_stream_reader_call_callback_functions(avi_stream_reader *s)
 	return 1;
 }
 
+AVI_STATIC_FUNC int avi_stream_reader_read_packet_impl(avi_stream_reader *s, void *buffer, size_t buffer_size)
+{
+	avi_reader *r = NULL;
+	if (!s || !buffer) return 0;
+	r = s->r;
+	if (!s->cur_packet_offset) return 0;
+	if (buffer_size < s->cur_packet_len)
+	{
+		WARN_PRINTF(r, "Stream %d: the buffer (%u bytes) is too small for the packet (%"PRIfsize_t" bytes)." NL, s->stream_id, (unsigned int)buffer_size, s->cur_packet_len);
+		return 0;
+	}
+	if (!must_seek_s(s, s->cur_packet_offset, AVI_IO_PAYLOAD)) return 0;
+	if (!must_read_s(s, buffer, s->cur_packet_len, AVI_IO_PAYLOAD)) return 0;
+	return 1;
+}
+
+AVI_FUNC int avi_stream_reader_read_packet(avi_stream_reader *s, void *buffer, size_t buffer_size)
+{
+	int ret;
+	AVI_PROFILE_BEGIN(AVI_OP_READ_PACKET);
+	ret = avi_stream_reader_read_packet_impl(s, buffer, buffer_size);
+	AVI_PROFILE_END(AVI_OP_READ_PACKET);
+	return ret;
+}
+
+AVI_FUNC int avi_stream_reader_get_field(avi_stream_reader *s, int field_no, fsize_t *offset_out, fsize_t *length_out)
+{
+	fsize_t field1_len;
+	if (!s || !offset_out || !length_out) return 0;
+	if (!s->cur_packet_offset || !s->cur_field2_offset) return 0;
+	field1_len = s->cur_field2_offset - s->cur_packet_offset;
+	switch (field_no)
+	{
+	case 0:
+		*offset_out = s->cur_packet_offset;
+		*length_out = field1_len;
+		return 1;
+	case 1:
+		*offset_out = s->cur_field2_offset;
+		*length_out = s->cur_packet_len - field1_len;
+		return 1;
+	default:
+		return 0;
+	}
+}
+
 AVI_FUNC fsize_t avi_video_get_frame_number_by_time(avi_stream_reader *s, uint64_t time_in_ms)
 {
 	avi_stream_info *h_video;
@@ -1065,13 +1448,14 @@ AVI_FUNC fsize_t avi_audio_get_target_byte_offset_by_time(avi_stream_reader *s,
 	return (fsize_t)(time_in_ms * h_audio->audio_format.nAvgBytesPerSec / 1000);
 }
 
-AVI_FUNC int avi_video_seek_to_frame_index(avi_stream_reader *s, fsize_t frame_index, int call_receive_functions)
+AVI_STATIC_FUNC int avi_video_seek_to_frame_index_impl(avi_stream_reader *s, fsize_t frame_index, int call_receive_functions)
 {
 	int informed = 0;
 	if (!s) return 0;
 	while (s->cur_stream_packet_index > frame_index)
 	{
 		fsize_t to_move = s->cur_stream_packet_index - frame_index;
+		if (to_move > 1) s->io_stats.num_seek_skipped_packets++;
 		if (to_move > 1 && !informed)
 		{
 			INFO_PRINTF(s->r, "Stream %d: skipping backward %"PRIfsize_t" frames" NL, s->stream_id, to_move - 1);
@@ -1082,6 +1466,7 @@ AVI_FUNC int avi_video_seek_to_frame_index(avi_stream_reader *s, fsize_t frame_i
 	while (s->cur_stream_packet_index < frame_index)
 	{
 		fsize_t to_move = frame_index - s->cur_stream_packet_index;
+		if (to_move > 1) s->io_stats.num_seek_skipped_packets++;
 		if (to_move > 1 && !informed)
 		{
 			INFO_PRINTF(s->r, "Stream %d: skipping %"PRIfsize_t" frames" NL, s->stream_id, to_move - 1);
@@ -1099,7 +1484,16 @@ AVI_FUNC int avi_video_seek_to_frame_index(avi_stream_reader *s, fsize_t frame_i
 	return 1;
 }
 
-AVI_FUNC int avi_audio_seek_to_byte_offset(avi_stream_reader *s, fsize_t byte_offset, int call_receive_functions)
+AVI_FUNC int avi_video_seek_to_frame_index(avi_stream_reader *s, fsize_t frame_index, int call_receive_functions)
+{
+	int ret;
+	AVI_PROFILE_BEGIN(AVI_OP_SEEK);
+	ret = avi_video_seek_to_frame_index_impl(s, frame_index, call_receive_functions);
+	AVI_PROFILE_END(AVI_OP_SEEK);
+	return ret;
+}
+
+AVI_STATIC_FUNC int avi_audio_seek_to_byte_offset_impl(avi_stream_reader *s, fsize_t byte_offset, int call_receive_functions)
 {
 	if (!s) return 0;
 	if (s->cur_stream_byte_offset <= byte_offset && (s->cur_stream_byte_offset + s->cur_packet_len) > byte_offset)
@@ -1112,10 +1506,13 @@ AVI_FUNC int avi_audio_seek_to_byte_offset(avi_stream_reader *s, fsize_t byte_of
 	while (s->cur_stream_byte_offset > byte_offset)
 	{
 		if (!avi_stream_reader_move_to_prev_packet(s, 0)) return 0;
+		// Same as the video seek, the packet holding the target isn't skipped.
+		if (s->cur_stream_byte_offset > byte_offset) s->io_stats.num_seek_skipped_packets++;
 	}
 	while (s->cur_stream_byte_offset + s->cur_packet_len <= byte_offset)
 	{
 		if (!avi_stream_reader_move_to_next_packet(s, 0)) return 0;
+		if (s->cur_stream_byte_offset + s->cur_packet_len <= byte_offset) s->io_stats.num_seek_skipped_packets++;
 	}
 	if (call_receive_functions)
 	{
@@ -1127,11 +1524,182 @@ AVI_FUNC int avi_audio_seek_to_byte_offset(avi_stream_reader *s, fsize_t byte_of
 	return 1;
 }
 
-AVI_FUNC int avi_stream_reader_move_to_next_packet(avi_stream_reader *s, int call_receive_functions)
+AVI_FUNC int avi_audio_seek_to_byte_offset(avi_stream_reader *s, fsize_t byte_offset, int call_receive_functions)
+{
+	int ret;
+	AVI_PROFILE_BEGIN(AVI_OP_SEEK);
+	ret = avi_audio_seek_to_byte_offset_impl(s, byte_offset, call_receive_functions);
+	AVI_PROFILE_END(AVI_OP_SEEK);
+	return ret;
+}
+
+/// Get the position of the next chunk to traverse, skip to the next `movi` chunk at the end of the current one. Returns 0 if there's no more chunk.
+AVI_STATIC_FUNC fsize_t avi_reader_get_traverse_pos(avi_reader *r, fsize_t pos)
+{
+	if (!r->num_movi_ranges) return pos + 8 <= r->end_of_file ? pos : 0;
+	for (uint32_t i = 0; i < r->num_movi_ranges; i++)
+	{
+		avi_movi_range *range = &r->movi_ranges[i];
+		if (pos < range->offset) return range->offset;
+		if (pos + 8 <= range->end) return pos;
+	}
+	return 0;
+}
+
+AVI_STATIC_FUNC avi_step_result avi_stream_reader_traverse(avi_stream_reader *s, int call_receive_functions, uint32_t max_chunks)
+{
+	avi_reader *r = s->r;
+	int stream_id = s->stream_id;
+	char fourcc_buf[5] = { 0 };
+	uint32_t chunk_size;
+	fsize_t chunk_start = 0;
+	fsize_t chunk_end = 0;
+	fsize_t real_packet_len;
+
+	for (uint32_t i = 0; ; i++)
+	{
+		fsize_t chunk_pos;
+		if (max_chunks && i >= max_chunks) return AVI_STEP_IN_PROGRESS;
+		chunk_pos = avi_reader_get_traverse_pos(r, s->trav_next_chunk_pos);
+		if (!chunk_pos) break;
+		if (!must_seek_s(s, chunk_pos, AVI_IO_TRAVERSAL)) goto ErrRet;
+		if (!must_read_s(s, fourcc_buf, 4, AVI_IO_TRAVERSAL)) goto ErrRet;
+		if (!must_read_s(s, &chunk_size, 4, AVI_IO_TRAVERSAL)) goto ErrRet;
+		if (!must_tell_s(s, &chunk_start, AVI_IO_TRAVERSAL)) goto ErrRet;
+		real_packet_len = ((chunk_size - 1) / 2 + 1) * 2;
+		chunk_end = chunk_start + real_packet_len;
+
+		if (!memcmp(fourcc_buf, "LIST", 4))
+		{
+			if (!must_match_s(s, "rec ", AVI_IO_TRAVERSAL)) goto ErrRet;
+			if (!s->mute_cur_stream_debug_print)
+			{
+				DEBUG_PRINTF(r, "Seeking into a LIST(rec) chunk." NL, 0);
+			}
+			// Move inside the LIST chunk to find the packet, not to skip the chunk.
+			s->trav_next_chunk_pos = chunk_start + 4;
+		}
+		else
+		{
+			int stream_no = avi_get_fourcc_stream_id(*(uint32_t *)fourcc_buf);
+			if (stream_no < 0)
+			{
+				WARN_PRINTF(r, "Encountering unknown FourCC \"%s\" while seeking for a packet, skipping." NL, fourcc_buf);
+			}
+			else if (stream_no == stream_id)
+			{
+				if (!s->mute_cur_stream_debug_print)
+				{
+					DEBUG_PRINTF(r, "Successfully found packet %"PRIfsize_t"(%"PRIfsize_t") of the stream %d: Offset = 0x%"PRIxfsize_t", Length = 0x%"PRIx32"." NL, s->trav_packet_no, s->trav_packet_index, stream_id, chunk_start, chunk_size);
+				}
+				s->is_traversing = 0;
+				s->cur_4cc = *(uint32_t *)fourcc_buf;
+				s->cur_packet_index = s->trav_packet_index;
+				s->cur_packet_offset = chunk_start;
+				s->cur_packet_len = chunk_size;
+				s->cur_field2_offset = 0;
+				s->cur_packet_is_keyframe = 1; // No index, no key frame info.
+				s->cur_stream_packet_index = s->trav_packet_no;
+				s->cur_stream_byte_offset = s->trav_byte_offset;
+				s->is_no_more_packets = 0;
+				if (call_receive_functions)
+				{
+					if (!avi_stream_reader_call_callback_functions(s)) goto ErrRet;
+				}
+				return AVI_STEP_DONE;
+			}
+			else if (!(
+				memcmp(&fourcc_buf[2], "db", 2) &
+				memcmp(&fourcc_buf[2], "dc", 2) &
+				memcmp(&fourcc_buf[2], "pc", 2) &
+				memcmp(&fourcc_buf[2], "wb", 2)))
+			{
+				s->trav_packet_index++;
+			}
+			// Skip the current chunk
+			s->trav_next_chunk_pos = chunk_end;
+		}
+	}
+
+	s->is_traversing = 0;
+	s->is_no_more_packets = 1;
+	WARN_PRINTF(r, "No packet found for stream id %d after full file traversal." NL, stream_id);
+	return AVI_STEP_FAILED;
+ErrRet:
+	s->is_traversing = 0;
+	WARN_PRINTF(r, "`avi_stream_reader_move_to_next_packet()` failed." NL, 0);
+	return AVI_STEP_FAILED;
+}
+
+AVI_FUNC int avi_get_fourcc_stream_id(uint32_t fourcc)
+{
+	const uint8_t *c = (const uint8_t *)&fourcc;
+	if (c[0] < '0' || c[0] > '9' || c[1] < '0' || c[1] > '9') return -1;
+	return (c[0] - '0') * 10 + (c[1] - '0');
+}
+
+// The `dwOffset` of the `idx1` entries is from the `movi` FourCC to the chunk header of the packet.
+AVI_STATIC_FUNC fsize_t avi_get_idx1_packet_offset(const avi_reader *r, const avi_index_entry *entry)
+{
+	return entry->dwOffset + (r->stream_data_offset - 4) + 8;
+}
+
+AVI_FUNC fsize_t avi_reader_read_idx1_block(avi_reader *r, fsize_t first_entry, avi_index_entry *entries, fsize_t max_entries)
+{
+	fsize_t num_entries;
+	fssize_t rl;
+	if (!r || !entries || !r->idx1_offset || first_entry >= r->num_indices) return 0;
+	num_entries = r->num_indices - first_entry;
+	if (num_entries > max_entries) num_entries = max_entries;
+	rl = avi_reader_read_at(r, r->idx1_offset + first_entry * sizeof(avi_index_entry), entries, num_entries * sizeof(avi_index_entry), AVI_IO_IDX1);
+	if (rl <= 0) return 0;
+	return (fsize_t)rl / sizeof(avi_index_entry);
+}
+
+AVI_FUNC void avi_reader_get_idx1_position(const avi_reader *r, const avi_index_entry *entry, fsize_t entry_index, avi_stream_position *pos_out)
+{
+	if (!r || !entry || !pos_out) return;
+	memset(pos_out, 0, sizeof *pos_out);
+	pos_out->cur_4cc = entry->dwChunkId;
+	pos_out->cur_packet_index = entry_index;
+	pos_out->cur_packet_offset = avi_get_idx1_packet_offset(r, entry);
+	pos_out->cur_packet_len = entry->dwSize;
+	pos_out->cur_packet_is_keyframe = (entry->dwFlags & AVIIF_KEYFRAME) == AVIIF_KEYFRAME;
+}
+
+// Get the `idx1` entry from the block of the stream reader, read the block around it if it's not there.
+// Walking backward reads the block that ends at the entry.
+AVI_STATIC_FUNC const avi_index_entry *avi_stream_reader_get_idx1_entry(avi_stream_reader *s, fsize_t entry_index, int backward)
+{
+	avi_reader *r = s->r;
+	fsize_t first = entry_index;
+	fsize_t num_entries;
+	fssize_t rl;
+	if (entry_index - s->idx1_block_first < s->idx1_block_len) return &s->idx1_block[entry_index - s->idx1_block_first];
+
+	if (backward) first = entry_index >= AVI_IDX1_BLOCK_ENTRIES ? entry_index - (AVI_IDX1_BLOCK_ENTRIES - 1) : 0;
+	num_entries = r->num_indices - first;
+	if (num_entries > AVI_IDX1_BLOCK_ENTRIES) num_entries = AVI_IDX1_BLOCK_ENTRIES;
+	s->idx1_block_len = 0;
+	rl = avi_stream_reader_read_at(s, r->idx1_offset + first * sizeof(avi_index_entry), s->idx1_block, num_entries * sizeof(avi_index_entry), AVI_IO_IDX1);
+
+	// A truncated `idx1` chunk still gives the entries before the end of the file.
+	if (rl <= 0 || (fsize_t)rl / sizeof(avi_index_entry) <= entry_index - first)
+	{
+		FATAL_PRINTF(r, "Reading the `idx1` entry %"PRIfsize_t" failed." NL, entry_index);
+		return NULL;
+	}
+	s->idx1_block_first = first;
+	s->idx1_block_len = (fsize_t)rl / sizeof(avi_index_entry);
+	return &s->idx1_block[entry_index - first];
+}
+
+AVI_STATIC_FUNC avi_step_result avi_stream_reader_move_to_next_packet_continue_impl(avi_stream_reader *s, int call_receive_functions, uint32_t max_chunks)
 {
 	avi_reader *r = NULL;
-	if (!s) return 0;
+	if (!s) return AVI_STEP_FAILED;
 	r = s->r;
+	if (s->is_traversing) return avi_stream_reader_traverse(s, call_receive_functions, max_chunks);
 	fsize_t packet_no = s->cur_stream_packet_index + 1;
 	fsize_t packet_no_avi = s->cur_packet_index + 1;
 	fsize_t cur_byte_offset = s->cur_stream_byte_offset + s->cur_packet_len;
@@ -1145,17 +1713,25 @@ AVI_FUNC int avi_stream_reader_move_to_next_packet(avi_stream_reader *s, int cal
 		cur_byte_offset = 0;
 		s->cur_packet_offset = r->stream_data_offset;
 		s->cur_packet_len = 0;
+		s->cur_field2_offset = 0;
 		s->cur_stream_byte_offset = 0;
 		s->cur_stream_packet_index = 0;
 	}
 
 	int packet_found = 0;
-	if (s->indx.num_entries != 0)
+	if (s->packet_table)
+	{
+		if (!avi_packet_table_seek_to_packet(s, packet_no)) goto ErrRet;
+		s->cur_stream_byte_offset = cur_byte_offset;
+		if (call_receive_functions) if (!avi_stream_reader_call_callback_functions(s)) goto ErrRet;
+		return AVI_STEP_DONE;
+	}
+	else if (s->indx.num_entries != 0)
 	{
 		if (!avi_indx_seek_to_packet(s, packet_no)) goto ErrRet;
 		s->cur_stream_byte_offset = cur_byte_offset;
 		if (call_receive_functions) if (!avi_stream_reader_call_callback_functions(s)) goto ErrRet;
-		return 1;
+		return AVI_STEP_DONE;
 	}
 	else if (r->idx1_offset && r->num_indices)
 	{
@@ -1163,27 +1739,23 @@ AVI_FUNC int avi_stream_reader_move_to_next_packet(avi_stream_reader *s, int cal
 		{
 			DEBUG_PRINTF(r, "Seeking packet %"PRIfsize_t" of the stream %d using the indices from the AVI file." NL, packet_no, stream_id);
 		}
-		fsize_t start_of_movi = r->stream_data_offset - 4;
-		avi_index_entry index;
 		for (fsize_t i = packet_no_avi; i < r->num_indices; i++)
 		{
-			int stream_no;
-			char fourcc_buf[5] = { 0 };
-			if (!must_seek(r, r->idx1_offset + i * (sizeof index))) goto ErrRet;
-			if (!must_read(r, &index, sizeof index)) goto ErrRet;
-			*(uint32_t *)fourcc_buf = index.dwChunkId;
-			if (sscanf(fourcc_buf, "%d", &stream_no) != 1) continue;
-			if (stream_no == stream_id)
+			const avi_index_entry *index = avi_stream_reader_get_idx1_entry(s, i, 0);
+			if (!index) goto ErrRet;
+			if (avi_get_fourcc_stream_id(index->dwChunkId) == stream_id)
 			{
-				fsize_t offset = index.dwOffset + start_of_movi + 8;
+				fsize_t offset = avi_get_idx1_packet_offset(r, index);
 				if (!s->mute_cur_stream_debug_print)
 				{
-					DEBUG_PRINTF(r, "Successfully found packet %"PRIfsize_t"(%"PRIfsize_t") of the stream %d: Offset = 0x%"PRIxfsize_t", Length = 0x%"PRIx32"." NL, packet_no, packet_no_avi, stream_id, offset, index.dwSize);
+					DEBUG_PRINTF(r, "Successfully found packet %"PRIfsize_t"(%"PRIfsize_t") of the stream %d: Offset = 0x%"PRIxfsize_t", Length = 0x%"PRIx32"." NL, packet_no, packet_no_avi, stream_id, offset, index->dwSize);
 				}
-				s->cur_4cc = index.dwChunkId;
+				s->cur_4cc = index->dwChunkId;
 				s->cur_packet_index = i;
 				s->cur_packet_offset = offset;
-				s->cur_packet_len = index.dwSize;
+				s->cur_packet_len = index->dwSize;
+				s->cur_field2_offset = 0;
+				s->cur_packet_is_keyframe = (index->dwFlags & AVIIF_KEYFRAME) == AVIIF_KEYFRAME;
 				s->cur_stream_packet_index = packet_no;
 				s->cur_stream_byte_offset = cur_byte_offset;
 				s->is_no_more_packets = 0;
@@ -1199,7 +1771,7 @@ AVI_FUNC int avi_stream_reader_move_to_next_packet(avi_stream_reader *s, int cal
 		{
 			s->is_no_more_packets = 1;
 			WARN_PRINTF(r, "Could not find packet %"PRIfsize_t" for the stream id %d." NL, packet_no, stream_id);
-			return 0;
+			return AVI_STEP_FAILED;
 		}
 	}
 	else
@@ -1209,85 +1781,35 @@ AVI_FUNC int avi_stream_reader_move_to_next_packet(avi_stream_reader *s, int cal
 		{
 			DEBUG_PRINTF(r, "Seeking packet %"PRIfsize_t" of the stream %d via file traversal." NL, packet_no, stream_id);
 		}
-		if (!must_seek_s(s, s->cur_packet_offset + real_packet_len)) goto ErrRet;
-
-		char fourcc_buf[5] = { 0 };
-		uint32_t chunk_size;
-		fsize_t chunk_start = 0;
-		fsize_t chunk_end = 0;
-		fsize_t packet_index = 0;
-		do
-		{
-			if (!must_read_s(s, fourcc_buf, 4)) goto ErrRet;
-			if (!must_read_s(s, &chunk_size, 4)) goto ErrRet;
-			if (!must_tell_s(s, &chunk_start)) goto ErrRet;
-			real_packet_len = ((chunk_size - 1) / 2 + 1) * 2;
-			chunk_end = chunk_start + real_packet_len;
-
-			if (!memcmp(fourcc_buf, "LIST", 4))
-			{
-				if (!must_match_s(s, "rec ")) goto ErrRet;
-				if (!s->mute_cur_stream_debug_print)
-				{
-					DEBUG_PRINTF(r, "Seeking into a LIST(rec) chunk." NL, 0);
-				}
-				// Move inside the LIST chunk to find the packet.
-				continue; // Not to skip the chunk.
-			}
-			else
-			{
-				int stream_no;
-				if (sscanf(fourcc_buf, "%d", &stream_no) != 1)
-				{
-					WARN_PRINTF(r, "Encountering unknown FourCC \"%s\" while seeking for a packet, skipping." NL, fourcc_buf);
-				}
-				else if (stream_no == stream_id)
-				{
-					if (!s->mute_cur_stream_debug_print)
-					{
-						DEBUG_PRINTF(r, "Successfully found packet %"PRIfsize_t"(%"PRIfsize_t") of the stream %d: Offset = 0x%"PRIxfsize_t", Length = 0x%"PRIx32"." NL, packet_no, packet_no_avi, stream_id, chunk_start, packet_index);
-					}
-					s->cur_4cc = *(uint32_t *)fourcc_buf;
-					s->cur_packet_index = packet_index;
-					s->cur_packet_offset = chunk_start;
-					s->cur_packet_len = chunk_size;
-					s->cur_stream_packet_index = packet_no;
-					s->cur_stream_byte_offset = cur_byte_offset;
-					s->is_no_more_packets = 0;
-					packet_found = 1;
-					if (call_receive_functions)
-					{
-						if (!avi_stream_reader_call_callback_functions(s)) goto ErrRet;
-					}
-					break;
-				}
-				else if (!(
-					memcmp(&fourcc_buf[2], "db", 2) &
-					memcmp(&fourcc_buf[2], "dc", 2) &
-					memcmp(&fourcc_buf[2], "pc", 2) &
-					memcmp(&fourcc_buf[2], "wb", 2)))
-				{
-					packet_index++;
-				}
-			}
-			// Skip the current chunk
-			if (!must_seek_s(s, chunk_end)) goto ErrRet;
-		} while (chunk_end < r->end_of_file);
-		if (!packet_found)
-		{
-			s->is_no_more_packets = 1;
-			WARN_PRINTF(r, "No packet found for stream id %d after full file traversal." NL, stream_id);
-			return 0;
-		}
+		s->is_traversing = 1;
+		s->trav_next_chunk_pos = s->cur_packet_offset + real_packet_len;
+		s->trav_packet_index = 0;
+		s->trav_packet_no = packet_no;
+		s->trav_byte_offset = cur_byte_offset;
+		return avi_stream_reader_traverse(s, call_receive_functions, max_chunks);
 	}
 
-	return 1;
+	return AVI_STEP_DONE;
 ErrRet:
 	if (r) WARN_PRINTF(r, "`avi_stream_reader_move_to_next_packet()` failed." NL, 0);
-	return 0;
+	return AVI_STEP_FAILED;
 }
 
-AVI_FUNC int avi_stream_reader_move_to_prev_packet(avi_stream_reader *s, int call_receive_functions)
+AVI_FUNC avi_step_result avi_stream_reader_move_to_next_packet_continue(avi_stream_reader *s, int call_receive_functions, uint32_t max_chunks)
+{
+	avi_step_result ret;
+	AVI_PROFILE_BEGIN(AVI_OP_NEXT_PACKET);
+	ret = avi_stream_reader_move_to_next_packet_continue_impl(s, call_receive_functions, max_chunks);
+	AVI_PROFILE_END(AVI_OP_NEXT_PACKET);
+	return ret;
+}
+
+AVI_FUNC int avi_stream_reader_move_to_next_packet(avi_stream_reader *s, int call_receive_functions)
+{
+	return avi_stream_reader_move_to_next_packet_continue(s, call_receive_functions, 0) == AVI_STEP_DONE;
+}
+
+AVI_STATIC_FUNC int avi_stream_reader_move_to_prev_packet_impl(avi_stream_reader *s, int call_receive_functions)
 {
 	avi_reader *r = NULL;
 	if (!s) return 0;
@@ -1296,6 +1818,7 @@ AVI_FUNC int avi_stream_reader_move_to_prev_packet(avi_stream_reader *s, int cal
 	fsize_t packet_no_avi = s->cur_packet_index ? s->cur_packet_index - 1 : 0;
 	fsize_t cur_byte_offset = s->cur_stream_byte_offset - s->cur_packet_len;
 	int stream_id = s->stream_id;
+	s->is_traversing = 0;
 
 	// The kickstart of the packet seeking
 	if (!s->cur_packet_offset)
@@ -1305,12 +1828,20 @@ AVI_FUNC int avi_stream_reader_move_to_prev_packet(avi_stream_reader *s, int cal
 		cur_byte_offset = 0;
 		s->cur_packet_offset = r->stream_data_offset;
 		s->cur_packet_len = 0;
+		s->cur_field2_offset = 0;
 		s->cur_stream_byte_offset = 0;
 		s->cur_stream_packet_index = 0;
 	}
 
 	int packet_found = 0;
-	if (s->indx.num_entries != 0)
+	if (s->packet_table)
+	{
+		if (!avi_packet_table_seek_to_packet(s, packet_no)) goto ErrRet;
+		s->cur_stream_byte_offset = cur_byte_offset;
+		if (call_receive_functions) if (!avi_stream_reader_call_callback_functions(s)) goto ErrRet;
+		return 1;
+	}
+	else if (s->indx.num_entries != 0)
 	{
 		if (!avi_indx_seek_to_packet(s, packet_no)) goto ErrRet;
 		s->cur_stream_byte_offset = cur_byte_offset;
@@ -1319,27 +1850,23 @@ AVI_FUNC int avi_stream_reader_move_to_prev_packet(avi_stream_reader *s, int cal
 	}
 	else if (r->idx1_offset && r->num_indices)
 	{
-		fsize_t start_of_movi = r->stream_data_offset - 4;
-		avi_index_entry index;
 		for (fssize_t i = packet_no_avi; i >= 0; i--)
 		{
-			int stream_no;
-			char fourcc_buf[5] = { 0 };
-			if (!must_seek(r, r->idx1_offset + i * (sizeof index))) goto ErrRet;
-			if (!must_read(r, &index, sizeof index)) goto ErrRet;
-			*(uint32_t *)fourcc_buf = index.dwChunkId;
-			if (sscanf(fourcc_buf, "%d", &stream_no) != 1) continue;
-			if (stream_no == stream_id)
+			const avi_index_entry *index = avi_stream_reader_get_idx1_entry(s, (fsize_t)i, 1);
+			if (!index) goto ErrRet;
+			if (avi_get_fourcc_stream_id(index->dwChunkId) == stream_id)
 			{
-				fsize_t offset = index.dwOffset + start_of_movi + 8;
+				fsize_t offset = avi_get_idx1_packet_offset(r, index);
 				if (!s->mute_cur_stream_debug_print)
 				{
-					DEBUG_PRINTF(r, "Successfully found packet %"PRIfsize_t"(%"PRIfsize_t") of the stream %d: Offset = 0x%"PRIxfsize_t", Length = 0x%"PRIx32"." NL, packet_no, packet_no_avi, stream_id, offset, index.dwSize);
+					DEBUG_PRINTF(r, "Successfully found packet %"PRIfsize_t"(%"PRIfsize_t") of the stream %d: Offset = 0x%"PRIxfsize_t", Length = 0x%"PRIx32"." NL, packet_no, packet_no_avi, stream_id, offset, index->dwSize);
 				}
-				s->cur_4cc = index.dwChunkId;
+				s->cur_4cc = index->dwChunkId;
 				s->cur_packet_index = i;
 				s->cur_packet_offset = offset;
-				s->cur_packet_len = index.dwSize;
+				s->cur_packet_len = index->dwSize;
+				s->cur_field2_offset = 0;
+				s->cur_packet_is_keyframe = (index->dwFlags & AVIIF_KEYFRAME) == AVIIF_KEYFRAME;
 				s->cur_stream_packet_index = packet_no;
 				s->cur_stream_byte_offset = cur_byte_offset;
 				s->is_no_more_packets = 0;
@@ -1368,9 +1895,244 @@ ErrRet:
 	return 0;
 }
 
+AVI_FUNC int avi_stream_reader_move_to_prev_packet(avi_stream_reader *s, int call_receive_functions)
+{
+	int ret;
+	AVI_PROFILE_BEGIN(AVI_OP_PREV_PACKET);
+	ret = avi_stream_reader_move_to_prev_packet_impl(s, call_receive_functions);
+	AVI_PROFILE_END(AVI_OP_PREV_PACKET);
+	return ret;
+}
+
 AVI_FUNC int avi_stream_reader_is_end_of_stream(avi_stream_reader *s)
 {
 	if (!s) return 1;
 	return s->is_no_more_packets;
 }
 
+AVI_FUNC void avi_stream_reader_get_position(avi_stream_reader *s, avi_stream_position *pos_out)
+{
+	if (!s || !pos_out) return;
+	pos_out->cur_4cc = s->cur_4cc;
+	pos_out->cur_packet_index = s->cur_packet_index;
+	pos_out->cur_stream_packet_index = s->cur_stream_packet_index;
+	pos_out->cur_stream_byte_offset = s->cur_stream_byte_offset;
+	pos_out->cur_packet_offset = s->cur_packet_offset;
+	pos_out->cur_packet_len = s->cur_packet_len;
+	pos_out->cur_packet_is_keyframe = s->cur_packet_is_keyframe;
+	pos_out->cur_field2_offset = s->cur_field2_offset;
+	pos_out->is_no_more_packets = s->is_no_more_packets;
+}
+
+AVI_FUNC void avi_stream_reader_set_position(avi_stream_reader *s, const avi_stream_position *pos)
+{
+	if (!s || !pos) return;
+	s->is_traversing = 0;
+	s->cur_4cc = pos->cur_4cc;
+	s->cur_packet_index = pos->cur_packet_index;
+	s->cur_stream_packet_index = pos->cur_stream_packet_index;
+	s->cur_stream_byte_offset = pos->cur_stream_byte_offset;
+	s->cur_packet_offset = pos->cur_packet_offset;
+	s->cur_packet_len = pos->cur_packet_len;
+	s->cur_packet_is_keyframe = pos->cur_packet_is_keyframe;
+	s->cur_field2_offset = pos->cur_field2_offset;
+	s->is_no_more_packets = pos->is_no_more_packets;
+}
+
+AVI_FUNC int avi_stream_reader_partition
+(
+	avi_stream_reader *s,
+	uint32_t num_ranges,
+	int keyframe_aligned,
+	avi_stream_range *ranges_out,
+	uint32_t *num_ranges_out
+)
+{
+	avi_reader *r = NULL;
+	avi_stream_position saved;
+	avi_stream_position rewind = { 0 };
+	fsize_t num_packets = 0;
+	uint32_t range_count = 0;
+	int mute = 0;
+	if (!s) return 0;
+	if (!num_ranges || !ranges_out || !num_ranges_out) return 0;
+	r = s->r;
+	*num_ranges_out = 0;
+	avi_stream_reader_get_position(s, &saved);
+	mute = s->mute_cur_stream_debug_print;
+	s->mute_cur_stream_debug_print = 1;
+
+	// The first pass counts the packets
+	avi_stream_reader_set_position(s, &rewind);
+	while (avi_stream_reader_move_to_next_packet(s, 0)) num_packets++;
+
+	// The second pass cuts the ranges at the first acceptable packet after each target
+	avi_stream_reader_set_position(s, &rewind);
+	for (fsize_t i = 0; i < num_packets; i++)
+	{
+		uint64_t target = (uint64_t)range_count * num_packets / num_ranges;
+		if (!avi_stream_reader_move_to_next_packet(s, 0)) goto ErrRet;
+		if (range_count >= num_ranges || i < target) continue;
+		if (i && keyframe_aligned && !s->cur_packet_is_keyframe) continue;
+		if (range_count)
+		{
+			avi_stream_range *prev = &ranges_out[range_count - 1];
+			prev->num_packets = i - prev->first.cur_stream_packet_index;
+		}
+		avi_stream_reader_get_position(s, &ranges_out[range_count].first);
+		ranges_out[range_count].num_packets = 0;
+		range_count++;
+	}
+	if (range_count)
+	{
+		avi_stream_range *last = &ranges_out[range_count - 1];
+		last->num_packets = num_packets - last->first.cur_stream_packet_index;
+	}
+	INFO_PRINTF(r, "Stream %d: %"PRIfsize_t" packets partitioned into %u ranges." NL, s->stream_id, num_packets, range_count);
+
+	*num_ranges_out = range_count;
+	avi_stream_reader_set_position(s, &saved);
+	s->mute_cur_stream_debug_print = mute;
+	return 1;
+ErrRet:
+	avi_stream_reader_set_position(s, &saved);
+	s->mute_cur_stream_debug_print = mute;
+	WARN_PRINTF(r, "`avi_stream_reader_partition()` failed." NL, 0);
+	return 0;
+}
+
+AVI_FUNC int avi_stream_reader_move_to_range(avi_stream_reader *s, const avi_stream_range *range, int call_receive_functions)
+{
+	if (!s || !range) return 0;
+	if (!range->num_packets) return 0;
+	avi_stream_reader_set_position(s, &range->first);
+	if (call_receive_functions) return avi_stream_reader_call_callback_functions(s);
+	return 1;
+}
+
+AVI_FUNC int avi_stream_reader_move_to_next_packet_in_range(avi_stream_reader *s, const avi_stream_range *range, int call_receive_functions)
+{
+	if (!s || !range) return 0;
+	if (s->cur_stream_packet_index + 1 >= range->first.cur_stream_packet_index + range->num_packets) return 0;
+	return avi_stream_reader_move_to_next_packet(s, call_receive_functions);
+}
+
+AVI_FUNC int avi_stream_reader_clone(avi_stream_reader *src, avi_stream_reader *dst)
+{
+	if (!src || !dst) return 0;
+	if (src == dst) return 0;
+
+	// Copy everything but the `idx1` block and the cached `indx` entries, the clone reads the entries of the source and starts with an empty cache of its own.
+	memcpy(dst, src, offsetof(avi_stream_reader, idx1_block_first));
+	dst->idx1_block_first = 0;
+	dst->idx1_block_len = 0;
+	memcpy(&dst->indx, &src->indx, offsetof(avi_indx_cache, cache));
+	if (!dst->indx_shared && src->indx.is_super) dst->indx_shared = &src->indx;
+	for (size_t i = 0; i < AVI_MAX_INDX_CACHE; i++)
+	{
+		dst->indx.lru[i] = (uint8_t)i;
+		dst->indx.cache[i].offset = 0;
+	}
+	memset(&dst->io_stats, 0, sizeof dst->io_stats);
+	return 1;
+}
+
+AVI_FUNC int avi_stream_reader_build_packet_table(avi_stream_reader *s, avi_packet_table_entry *table, fsize_t max_entries, fsize_t *num_entries_out)
+{
+	avi_reader *r = NULL;
+	avi_stream_position saved;
+	avi_stream_position rewind = { 0 };
+	fsize_t num_entries = 0;
+	int mute = 0;
+	if (!s || !num_entries_out) return 0;
+	r = s->r;
+	*num_entries_out = 0;
+	avi_stream_reader_get_position(s, &saved);
+	mute = s->mute_cur_stream_debug_print;
+	s->mute_cur_stream_debug_print = 1;
+
+	avi_stream_reader_set_position(s, &rewind);
+	while (avi_stream_reader_move_to_next_packet(s, 0))
+	{
+		if (table)
+		{
+			avi_packet_table_entry *entry;
+			if (num_entries >= max_entries)
+			{
+				WARN_PRINTF(r, "Stream %d: the packet table is full (%"PRIfsize_t" entries)." NL, s->stream_id, max_entries);
+				goto ErrRet;
+			}
+			entry = &table[num_entries];
+			entry->offset = s->cur_packet_offset;
+			entry->size = (uint32_t)s->cur_packet_len;
+			if (!s->cur_packet_is_keyframe) entry->size |= AVI_STDINDEX_DELTAFRAME;
+			entry->chunk_id = s->cur_4cc;
+		}
+		num_entries++;
+	}
+	INFO_PRINTF(r, "Stream %d: the packet table has %"PRIfsize_t" entries." NL, s->stream_id, num_entries);
+
+	*num_entries_out = num_entries;
+	avi_stream_reader_set_position(s, &saved);
+	s->mute_cur_stream_debug_print = mute;
+	return 1;
+ErrRet:
+	avi_stream_reader_set_position(s, &saved);
+	s->mute_cur_stream_debug_print = mute;
+	return 0;
+}
+
+AVI_FUNC void avi_stream_reader_use_packet_table(avi_stream_reader *s, const avi_packet_table_entry *table, fsize_t num_entries)
+{
+	avi_stream_position rewind = { 0 };
+	if (!s) return;
+	s->packet_table = table;
+	s->packet_table_len = table ? num_entries : 0;
+	avi_stream_reader_set_position(s, &rewind);
+}
+
+AVI_FUNC void avi_reader_get_io_stats(avi_reader *r, avi_io_stats *stats_out)
+{
+	if (!r || !stats_out) return;
+	*stats_out = r->io_stats;
+}
+
+AVI_FUNC void avi_reader_reset_io_stats(avi_reader *r)
+{
+	if (!r) return;
+	memset(&r->io_stats, 0, sizeof r->io_stats);
+}
+
+AVI_FUNC void avi_stream_reader_get_io_stats(avi_stream_reader *s, avi_io_stats *stats_out)
+{
+	if (!s || !stats_out) return;
+	*stats_out = s->io_stats;
+}
+
+AVI_FUNC void avi_stream_reader_reset_io_stats(avi_stream_reader *s)
+{
+	if (!s) return;
+	memset(&s->io_stats, 0, sizeof s->io_stats);
+}
+
+AVI_FUNC fssize_t avi_reader_read_at(avi_reader *r, fsize_t offset, void *buffer, size_t len, avi_io_category category)
+{
+	fssize_t rl;
+	if (!r || category >= AVI_IO_NUM_CATEGORIES) return -1;
+	r->io_stats.num_seeks[category]++;
+	if (r->f_seek(offset, r->userdata) == -1) return -1;
+	rl = r->f_read(buffer, len, r->userdata);
+	avi_count_read(&r->io_stats, category, rl);
+	return rl;
+}
+
+AVI_FUNC fssize_t avi_stream_reader_read_at(avi_stream_reader *s, fsize_t offset, void *buffer, size_t len, avi_io_category category)
+{
+	fssize_t rl;
+	if (!s || category >= AVI_IO_NUM_CATEGORIES) return -1;
+	s->io_stats.num_seeks[category]++;
+	if (s->f_seek(offset, s->userdata) == -1) return -1;
+	rl = s->f_read(buffer, len, s->userdata);
+	avi_count_read(&s->io_stats, category, rl);
+	return rl;
+}
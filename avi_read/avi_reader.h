@@ -31,10 +31,19 @@ typedef int64_t fssize_t;
 #define AVI_ENTRIES_PER_INDX_CACHE 128
 #endif
 
+// The `idx1` entries read at once by a stream reader walking the `idx1` chunk.
+#ifndef AVI_IDX1_BLOCK_ENTRIES
+#define AVI_IDX1_BLOCK_ENTRIES 64
+#endif
+
 #ifndef AVI_MAX_STREAM_NAME
 #define AVI_MAX_STREAM_NAME 64
 #endif
 
+#ifndef AVI_MAX_RIFF_CHUNKS
+#define AVI_MAX_RIFF_CHUNKS 128
+#endif
+
 #ifndef AVI_FUNC
 #define AVI_FUNC
 #endif
@@ -43,6 +52,20 @@ typedef int64_t fssize_t;
 #define AVI_STATIC_FUNC static
 #endif
 
+// The SIMD kernels of the pixel, PCM, and palette conversions are used when the compiler targets the instruction set.
+// Define `AVI_DISABLE_SIMD` to use only the portable loops, e.g. to compare them by `bench/avi_bench.c`.
+#ifndef AVI_DISABLE_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AVI_USE_SSE2 1
+#endif
+#if defined(__SSSE3__) || defined(__AVX2__)
+#define AVI_USE_SSSE3 1
+#endif
+#if defined(__AVX2__)
+#define AVI_USE_AVX2 1
+#endif
+#endif
+
 typedef struct
 {
 	avi_stream_header stream_header;
@@ -71,6 +94,7 @@ typedef fssize_t(*tell_cb)(void *userdata);
 typedef void (*logprintf_cb)(void *userdata, const char *fmt, ...);
 
 typedef void(*on_stream_data_cb)(fsize_t offset, fsize_t length, void *userdata);
+typedef void(*on_video_fields_cb)(fsize_t field1_offset, fsize_t field1_length, fsize_t field2_offset, fsize_t field2_length, void *userdata);
 
 typedef enum
 {
@@ -81,35 +105,101 @@ typedef enum
 	PRINT_DEBUG = 4,
 }avi_logprintf_level;
 
+/// The returned value of the resumable functions which only do a bounded amount of work per call.
+typedef enum
+{
+	AVI_STEP_FAILED = 0,
+	AVI_STEP_DONE = 1,
+	AVI_STEP_IN_PROGRESS = 2,
+}avi_step_result;
+
 typedef struct avi_indx_cached_entry_s
 {
 	uint32_t index;
 	fsize_t offset;
 	uint32_t length;
 	uint32_t chunk_id;
-	uint32_t chunk_base_offset;
+	fsize_t chunk_base_offset;
 	int64_t start_packet_number;
 	uint32_t num_packets;
 	uint32_t duration;
-	avi_stdindex_entry cached_entries[AVI_ENTRIES_PER_INDX_CACHE];
+	int is_field_index;
+	union
+	{
+		avi_stdindex_entry cached_entries[AVI_ENTRIES_PER_INDX_CACHE];
+		avi_field_index_entry cached_field_entries[AVI_ENTRIES_PER_INDX_CACHE];
+	};
 	fssize_t cached_entries_start_index;
-	struct avi_indx_cached_entry_s *prev;
-	struct avi_indx_cached_entry_s *next;
 }avi_indx_cached_entry;
 
 typedef struct
 {
-	avi_indx_cached_entry cache[AVI_MAX_INDX_CACHE];
-	avi_indx_cached_entry *cache_head;
-	avi_indx_cached_entry *cache_tail;
 	uint32_t num_entries;
 	fsize_t offset_to_first_entry;
 	uint32_t last_cache_index;
 	int is_super;
-	uint32_t base_offset;
+	int is_field_index;
+	fsize_t base_offset;
 	uint32_t chunk_id;
+
+	/// The slots of `cache` from the most recently used one. The order is kept here, so looking up the cache doesn't write the slots that the clones read.
+	uint8_t lru[AVI_MAX_INDX_CACHE];
+
+	/// The cached entries are the last member, `avi_stream_reader_clone()` doesn't copy them.
+	avi_indx_cached_entry cache[AVI_MAX_INDX_CACHE];
 }avi_indx_cache;
 
+/// <summary>
+/// A resolved packet position of a stream, see `avi_stream_reader_build_packet_table()`.
+/// The fixed size fields let the table be stored in a file or shared between processes.
+/// </summary>
+typedef struct
+{
+	uint64_t offset;   /// The position of the packet payload in the file.
+	uint32_t size;     /// The packet length. The bit 31 is set if the packet is not a key frame, same as the standard index entry.
+	uint32_t chunk_id; /// The FourCC of the packet.
+}avi_packet_table_entry;
+
+/// <summary>
+/// The `movi` chunk of a `RIFF` chunk, an OpenDML AVI file bigger than 1 GB has a `RIFF AVIX` chunk for every extra gigabyte.
+/// </summary>
+typedef struct
+{
+	fsize_t offset; /// The position after the `movi` FourCC.
+	fsize_t end;    /// The end of the `LIST(movi)` chunk.
+}avi_movi_range;
+
+/// The categories of the I/O done by the readers, for `avi_io_stats`.
+typedef enum
+{
+	AVI_IO_HEADER = 0,    /// Parsing the headers and the `RIFF AVIX` chunks
+	AVI_IO_IDX1 = 1,      /// Reading the `idx1` entries
+	AVI_IO_INDX = 2,      /// Reading the OpenDML `indx` chunks and the standard index chunks
+	AVI_IO_PAYLOAD = 3,   /// Reading the packets by `avi_stream_reader_read_packet()`
+	AVI_IO_TRAVERSAL = 4, /// Walking the chunks of an AVI file without an index
+	AVI_IO_NUM_CATEGORIES = 5,
+}avi_io_category;
+
+/// <summary>
+/// The counters of the calls to your callback functions and the index cache, to find out why a file plays badly.
+/// The other modules read through `avi_reader_read_at()` and `avi_stream_reader_read_at()`, so their reads are counted too. The writes are not counted.
+/// </summary>
+typedef struct
+{
+	uint64_t num_reads[AVI_IO_NUM_CATEGORIES];
+	uint64_t num_read_bytes[AVI_IO_NUM_CATEGORIES];
+	uint64_t num_seeks[AVI_IO_NUM_CATEGORIES];
+	uint64_t num_tells[AVI_IO_NUM_CATEGORIES];
+
+	/// Each packet lookup counts one hit if it's served by the cached index entries, or one miss if any index entries had to be loaded. Then the cache slots reused for another super index entry.
+	uint64_t indx_cache_hits;
+	uint64_t indx_cache_misses;
+	uint64_t indx_cache_evictions;
+
+	/// The packets walked over by `avi_video_seek_to_frame_index()` and `avi_audio_seek_to_byte_offset()` before reaching the target.
+	uint64_t num_seek_skipped_packets;
+}avi_io_stats;
+
 /// <summary>
 /// The core struct of this library, stores the critical informations about the AVI file.
 /// With this struct initialized by calling `avi_reader_init()`, you can then extract packets from each stream of the AVI file.
@@ -147,6 +237,27 @@ typedef struct
 
 	/// Number of entries in the `idx1` chunk.
 	fsize_t num_indices;
+
+	/// The `movi` chunks of all of the `RIFF` chunks, the first one is in `RIFF AVI `, the others are in `RIFF AVIX`.
+	/// The per-packet file traversal walks them in order.
+	avi_movi_range movi_ranges[AVI_MAX_RIFF_CHUNKS];
+	uint32_t num_movi_ranges;
+
+	/// The total frames of the whole file from the OpenDML header `dmlh`, zero if there's no `dmlh` chunk.
+	/// `avih.dwTotalFrames` only counts the frames in the first `RIFF` chunk.
+	uint32_t odml_total_frames;
+
+	/// Is the first `RIFF` chunk parsed? Then `avi_reader_init_continue()` looks for the `RIFF AVIX` chunks after it.
+	int is_first_riff_done;
+
+	/// The position of the next toplevel chunk to parse, used by `avi_reader_init_continue()`.
+	fsize_t init_next_chunk_pos;
+
+	/// Is the header parsing finished?
+	int is_init_done;
+
+	/// The I/O of the header parsing and of the modules reading through the `avi_reader`, see `avi_reader_get_io_stats()`.
+	avi_io_stats io_stats;
 }avi_reader;
 
 typedef struct
@@ -160,9 +271,6 @@ typedef struct
 	/// The short path to `r->avi_stream_info[self->stream_id]`
 	avi_stream_info *stream_info;
 
-	/// The `indx` chunk for this stream. If the AVI file is very large, an `idx1` chunk doens't enough.
-	avi_indx_cache indx;
-
 	/// Is this stream ended?
 	int is_no_more_packets;
 
@@ -184,10 +292,25 @@ typedef struct
 	/// The current packet length
 	fsize_t cur_packet_len;
 
+	/// Is the current packet a key frame? If the AVI file has no index, every packet is treated as a key frame.
+	int cur_packet_is_keyframe;
+
+	/// The position of the second field of the current interlaced video frame, from an OpenDML field index (`AVI_INDEX_2FIELD`).
+	/// The first field is from `cur_packet_offset` to here, the second field is from here to the end of the packet. Zero if unknown.
+	fsize_t cur_field2_offset;
+
 	/// When `r->log_level` is `PRINT_DEBUG`, normally the functions associated to the stream will print debug messages.
 	/// Set this to 1 to mute the debug messages from this specific stream.
 	int mute_cur_stream_debug_print;
 
+	/// The state of the file traversal, used by `avi_stream_reader_move_to_next_packet_continue()`.
+	/// When the AVI file has no index, moving to the next packet is done by walking the chunks of the file, it can be paused and resumed.
+	int is_traversing;
+	fsize_t trav_next_chunk_pos;
+	fsize_t trav_packet_index;
+	fsize_t trav_packet_no;
+	fsize_t trav_byte_offset;
+
 	/// Your callback functions, when the packet is going to be processed, the callback functions will be called.
 	void *userdata; /// The data to pass to your callback functions.
 	read_cb f_read; /// Your `read()` callback function pointer.
@@ -197,8 +320,58 @@ typedef struct
 	on_stream_data_cb on_video;				/// Uncompressed video frame (probably BMP) got
 	on_stream_data_cb on_palette_change;	/// Palette change for your video (If the AVI file is using color index as pixel data, the actual color in RGB form comes from the palette)
 	on_stream_data_cb on_audio;				/// Audio, it can be either compressed or uncompressed, depends on its format.
+	on_video_fields_cb on_video_fields;		/// Optional. If set, the video frames with field info call this instead of `on_video_compressed` or `on_video`.
+
+	/// The resolved packet table, moving to any packet costs no file reading. See `avi_stream_reader_use_packet_table()`.
+	const avi_packet_table_entry *packet_table;
+	fsize_t packet_table_len;
+
+	/// The I/O of this stream reader, see `avi_stream_reader_get_io_stats()`. A clone starts from zero.
+	avi_io_stats io_stats;
+
+	/// If this stream reader is a clone, the `indx` cache of the source stream reader. It's only read, the clone loads what it misses into its own cache.
+	const avi_indx_cache *indx_shared;
+
+	/// The block of the `idx1` entries read last, `idx1_block_len` entries from the entry `idx1_block_first`.
+	/// Walking the `idx1` chunk reads the next block only when the walk leaves this one. A clone starts with an empty block.
+	fsize_t idx1_block_first;
+	fsize_t idx1_block_len;
+	avi_index_entry idx1_block[AVI_IDX1_BLOCK_ENTRIES];
+
+	/// The `indx` chunk for this stream. If the AVI file is very large, an `idx1` chunk doens't enough.
+	/// The `idx1` block and this are the last members because of their size, `avi_stream_reader_clone()` copies only the fields in front of them and in front of the cached `indx` entries.
+	avi_indx_cache indx;
 }avi_stream_reader;
 
+/// <summary>
+/// The position of an `avi_stream_reader`, you can save it and restore it later, or give it to another stream reader of the same stream.
+/// A zeroed position means "before the first packet".
+/// </summary>
+typedef struct
+{
+	uint32_t cur_4cc;
+	fsize_t cur_packet_index;
+	fsize_t cur_stream_packet_index;
+	fsize_t cur_stream_byte_offset;
+	fsize_t cur_packet_offset;
+	fsize_t cur_packet_len;
+	int cur_packet_is_keyframe;
+	fsize_t cur_field2_offset;
+	int is_no_more_packets;
+}avi_stream_position;
+
+/// <summary>
+/// A range of consecutive packets of a stream, created by `avi_stream_reader_partition()`.
+/// </summary>
+typedef struct
+{
+	/// The position of the first packet of the range.
+	avi_stream_position first;
+
+	/// Number of packets in the range.
+	fsize_t num_packets;
+}avi_stream_range;
+
 /// <summary>
 /// Initialize the `avi_reader`. The callback functions will be used to parse the AVI file header.
 /// After parsed the AVI header, the struct `avi_reader` stores the information if the AVI file.
@@ -225,6 +398,45 @@ AVI_FUNC int avi_reader_init
 	avi_logprintf_level log_level
 );
 
+/// <summary>
+/// The resumable version of `avi_reader_init()`, for your cooperative main loop which couldn't be blocked for long.
+/// This function only checks the `RIFF` header, then you call `avi_reader_init_continue()` repeatedly to parse the rest of the header.
+/// </summary>
+/// <param name="r">Your `avi_reader` to be initialized.</param>
+/// <param name="userdata">Your data to pass to your callback functions.</param>
+/// <param name="f_read">Your `read()` function for me to read the AVI file.</param>
+/// <param name="f_seek">Your `seek()` function for me to change the absolute read position.</param>
+/// <param name="f_tell">Your `tell()` function for me to retrieve the current read position.</param>
+/// <param name="f_logprintf">Your `printf()` function for me to log. You can pass `NULL` and I will call `vprintf()` as the default behavior.</param>
+/// <param name="log_level">The log level, see `avi_logprintf_level`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_reader_init_begin
+(
+	avi_reader *r,
+	void *userdata,
+	read_cb f_read,
+	seek_cb f_seek,
+	tell_cb f_tell,
+	logprintf_cb f_logprintf,
+	avi_logprintf_level log_level
+);
+
+/// <summary>
+/// Parse at most `max_chunks` toplevel chunks of the AVI file, then return.
+/// The parsing position is stored in the `avi_reader`, so you can do your time-critical work between the calls.
+/// </summary>
+/// <param name="r">Your `avi_reader` which `avi_reader_init_begin()` was called.</param>
+/// <param name="max_chunks">The maximum number of chunks to parse in this call. 0 for no limit.</param>
+/// <returns>`AVI_STEP_IN_PROGRESS` if you should call me again, `AVI_STEP_DONE` if the `avi_reader` is ready to use, `AVI_STEP_FAILED` for fail.</returns>
+AVI_FUNC avi_step_result avi_reader_init_continue(avi_reader *r, uint32_t max_chunks);
+
+/// <summary>
+/// Get the total frames of the whole file. For an OpenDML file bigger than 1 GB, it's from the `dmlh` chunk, otherwise it's `avih.dwTotalFrames`.
+/// </summary>
+/// <param name="r">Your initialized `avi_reader`</param>
+/// <returns>The total frames</returns>
+AVI_FUNC uint32_t avi_reader_get_total_frames(avi_reader *r);
+
 /// <summary>
 /// Get the specified stream reader to read the packets of the specified stream.
 /// </summary>
@@ -357,6 +569,26 @@ AVI_FUNC void avi_stream_reader_set_read_seek_tell
 /// <returns>0 for fail, nonzero for success.</returns>
 AVI_FUNC int avi_stream_reader_call_callback_functions(avi_stream_reader *s);
 
+/// <summary>
+/// Read the payload of the current packet into your buffer, using the read()/seek() of the stream reader.
+/// </summary>
+/// <param name="s">Your stream reader</param>
+/// <param name="buffer">Your buffer to receive the packet data</param>
+/// <param name="buffer_size">The size of your buffer, must be not less than `cur_packet_len`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_stream_reader_read_packet(avi_stream_reader *s, void *buffer, size_t buffer_size);
+
+/// <summary>
+/// Get the position of one field of the current interlaced video frame, so you could read only the field you need.
+/// The field info comes from an OpenDML field index, see `cur_field2_offset`.
+/// </summary>
+/// <param name="s">Your stream reader</param>
+/// <param name="field_no">0 for the first field, 1 for the second field</param>
+/// <param name="offset_out">Receives the position of the field in the file</param>
+/// <param name="length_out">Receives the length of the field</param>
+/// <returns>0 if the current packet has no field info, nonzero for success.</returns>
+AVI_FUNC int avi_stream_reader_get_field(avi_stream_reader *s, int field_no, fsize_t *offset_out, fsize_t *length_out);
+
 /// <summary>
 /// Calculate the target frame index of a specific millisecond.
 /// </summary>
@@ -399,6 +631,18 @@ AVI_FUNC int avi_audio_seek_to_byte_offset(avi_stream_reader *s, fsize_t byte_of
 /// <returns>0 for fail, nonzero for success.</returns>
 AVI_FUNC int avi_stream_reader_move_to_next_packet(avi_stream_reader *s, int call_receive_functions);
 
+/// <summary>
+/// The resumable version of `avi_stream_reader_move_to_next_packet()`.
+/// If the AVI file has no index, I have to walk through the chunks to find the next packet, this function walks at most `max_chunks` chunks per call.
+/// If the move is not finished, call me again with the same stream reader to resume it. The indexed paths always finish in one call.
+/// While a move is in progress, `avi_stream_reader_move_to_next_packet()` will also resume it instead of starting a new one.
+/// </summary>
+/// <param name="s">Your stream reader</param>
+/// <param name="call_receive_functions">Call the callback functions when the packet was found.</param>
+/// <param name="max_chunks">The maximum number of chunks to walk in this call. 0 for no limit.</param>
+/// <returns>`AVI_STEP_IN_PROGRESS` if you should call me again, `AVI_STEP_DONE` if the packet was found, `AVI_STEP_FAILED` for fail or no more packets.</returns>
+AVI_FUNC avi_step_result avi_stream_reader_move_to_next_packet_continue(avi_stream_reader *s, int call_receive_functions, uint32_t max_chunks);
+
 /// <summary>
 /// Move to the previous packet, then call the callback functions for you to receive the packet.
 /// If you set `cur_packet_offset` to zero, then it will move to the first packet of the stream.
@@ -414,4 +658,166 @@ AVI_FUNC int avi_stream_reader_move_to_prev_packet(avi_stream_reader *s, int cal
 /// <returns>1 for yes, 0 for no. If yes, then there's no more packets to read. -1 for bad parameters.</returns>
 AVI_FUNC int avi_stream_reader_is_end_of_stream(avi_stream_reader *s);
 
+/// <summary>
+/// Save the position of the stream reader.
+/// </summary>
+/// <param name="s">Your stream reader</param>
+/// <param name="pos_out">The saved position</param>
+AVI_FUNC void avi_stream_reader_get_position(avi_stream_reader *s, avi_stream_position *pos_out);
+
+/// <summary>
+/// Restore the position of the stream reader. The position must come from a stream reader of the same stream.
+/// The callback functions are not called.
+/// </summary>
+/// <param name="s">Your stream reader</param>
+/// <param name="pos">The position to restore</param>
+AVI_FUNC void avi_stream_reader_set_position(avi_stream_reader *s, const avi_stream_position *pos);
+
+/// <summary>
+/// Split the stream into at most `num_ranges` ranges of consecutive packets with roughly the same number of packets.
+/// Every range could be processed independently by a different stream reader, e.g. a worker thread with its own file handle.
+/// The stream reader walks through the index twice, then its position is restored.
+/// </summary>
+/// <param name="s">Your stream reader</param>
+/// <param name="num_ranges">The number of ranges you want, usually the number of your workers</param>
+/// <param name="keyframe_aligned">Make every range start with a key frame. Set this if your decoder needs the previous frames to decode a frame.</param>
+/// <param name="ranges_out">The array of `num_ranges` ranges to receive the ranges in the order of the stream.</param>
+/// <param name="num_ranges_out">The actual number of ranges, could be less than `num_ranges` if the stream is short or has a few key frames.</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_stream_reader_partition
+(
+	avi_stream_reader *s,
+	uint32_t num_ranges,
+	int keyframe_aligned,
+	avi_stream_range *ranges_out,
+	uint32_t *num_ranges_out
+);
+
+/// <summary>
+/// Move the stream reader to the first packet of the range.
+/// To process the range concurrently, use a stream reader that has its own read()/seek()/tell(), see `avi_stream_reader_set_read_seek_tell()`.
+/// </summary>
+/// <param name="s">Your stream reader of the same stream as the range</param>
+/// <param name="range">The range</param>
+/// <param name="call_receive_functions">Call the callback functions for the first packet.</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_stream_reader_move_to_range(avi_stream_reader *s, const avi_stream_range *range, int call_receive_functions);
+
+/// <summary>
+/// Move to the next packet if it's still inside of the range.
+/// </summary>
+/// <param name="s">Your stream reader</param>
+/// <param name="range">The range</param>
+/// <param name="call_receive_functions">Call the callback functions for the packet.</param>
+/// <returns>0 for the end of the range or fail, nonzero for success.</returns>
+AVI_FUNC int avi_stream_reader_move_to_next_packet_in_range(avi_stream_reader *s, const avi_stream_range *range, int call_receive_functions);
+
+/// <summary>
+/// Create a cursor of the same stream for lookahead or prefetching, without disturbing the source stream reader.
+/// The clone has its own position, and it reads the cached `indx` entries of the source in place. What it misses is loaded into its own cache, which starts empty.
+/// Looking up a cache doesn't write it, the source only writes its cache when it loads new index entries. So the clones of a source that isn't moving can run on other threads.
+/// The clone must not outlive the source, and both of them borrow the `avi_reader`, which must outlive them.
+/// Use `avi_stream_reader_set_read_seek_tell()` on the clone if you want it to read from a different file handle.
+/// </summary>
+/// <param name="src">The source stream reader</param>
+/// <param name="dst">The clone to be initialized</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_stream_reader_clone(avi_stream_reader *src, avi_stream_reader *dst);
+
+/// <summary>
+/// Resolve the position of every packet of the stream into your table, by walking through the stream once.
+/// The stream reader uses whichever index the AVI file has, then its position is restored.
+/// </summary>
+/// <param name="s">Your stream reader</param>
+/// <param name="table">Your table to receive the entries. Passing NULL is allowed to count the packets only.</param>
+/// <param name="max_entries">The capacity of your table</param>
+/// <param name="num_entries_out">The number of packets of the stream</param>
+/// <returns>0 for fail (including the table is too small), nonzero for success.</returns>
+AVI_FUNC int avi_stream_reader_build_packet_table(avi_stream_reader *s, avi_packet_table_entry *table, fsize_t max_entries, fsize_t *num_entries_out);
+
+/// <summary>
+/// Let the stream reader use a resolved packet table instead of reading the index of the AVI file.
+/// The table is not copied, it must stay valid while the stream reader uses it. The stream reader is moved before the first packet.
+/// </summary>
+/// <param name="s">Your stream reader</param>
+/// <param name="table">The packet table, NULL to stop using it.</param>
+/// <param name="num_entries">Number of entries of the table</param>
+AVI_FUNC void avi_stream_reader_use_packet_table(avi_stream_reader *s, const avi_packet_table_entry *table, fsize_t num_entries);
+
+/// <summary>
+/// Take a snapshot of the I/O counters of the header parsing, and of the modules reading through the `avi_reader`, e.g. `avi_trim` and `avi_repair`.
+/// </summary>
+/// <param name="r">Your `avi_reader`</param>
+/// <param name="stats_out">The snapshot</param>
+AVI_FUNC void avi_reader_get_io_stats(avi_reader *r, avi_io_stats *stats_out);
+
+/// <summary>
+/// Reset the I/O counters of the `avi_reader` to zero.
+/// </summary>
+/// <param name="r">Your `avi_reader`</param>
+AVI_FUNC void avi_reader_reset_io_stats(avi_reader *r);
+
+/// <summary>
+/// Take a snapshot of the I/O counters of the stream reader, e.g. before and after an operation to see what it costs.
+/// </summary>
+/// <param name="s">Your stream reader</param>
+/// <param name="stats_out">The snapshot</param>
+AVI_FUNC void avi_stream_reader_get_io_stats(avi_stream_reader *s, avi_io_stats *stats_out);
+
+/// <summary>
+/// Reset the I/O counters of the stream reader to zero.
+/// </summary>
+/// <param name="s">Your stream reader</param>
+AVI_FUNC void avi_stream_reader_reset_io_stats(avi_stream_reader *s);
+
+/// <summary>
+/// Seek and read through the callback functions of the `avi_reader`, the I/O is counted into its `io_stats`.
+/// </summary>
+/// <param name="r">Your `avi_reader`</param>
+/// <param name="offset">The position to read from</param>
+/// <param name="buffer">The buffer to receive the data</param>
+/// <param name="len">The number of bytes to read</param>
+/// <param name="category">The category to count the I/O into</param>
+/// <returns>The number of bytes read, -1 if the seek or the read failed.</returns>
+AVI_FUNC fssize_t avi_reader_read_at(avi_reader *r, fsize_t offset, void *buffer, size_t len, avi_io_category category);
+
+/// <summary>
+/// Seek and read through the callback functions of the stream reader, the I/O is counted into its `io_stats`.
+/// The reading position of the stream reader is changed, but not its current packet.
+/// </summary>
+/// <param name="s">Your stream reader</param>
+/// <param name="offset">The position to read from</param>
+/// <param name="buffer">The buffer to receive the data</param>
+/// <param name="len">The number of bytes to read</param>
+/// <param name="category">The category to count the I/O into</param>
+/// <returns>The number of bytes read, -1 if the seek or the read failed.</returns>
+AVI_FUNC fssize_t avi_stream_reader_read_at(avi_stream_reader *s, fsize_t offset, void *buffer, size_t len, avi_io_category category);
+
+/// <summary>
+/// Get the stream index from the FourCC of a packet chunk or an `idx1` entry, e.g. 1 from `01wb`.
+/// </summary>
+/// <returns>-1 if the FourCC doesn't start with 2 digits, e.g. `LIST` or `ix00`.</returns>
+AVI_FUNC int avi_get_fourcc_stream_id(uint32_t fourcc);
+
+/// <summary>
+/// Read a block of the `idx1` entries, e.g. to walk the `idx1` chunk for all of the streams in one pass.
+/// The stream readers walk the `idx1` chunk in blocks of `AVI_IDX1_BLOCK_ENTRIES` by themselves.
+/// </summary>
+/// <param name="r">Your `avi_reader`</param>
+/// <param name="first_entry">The index of the first entry to read</param>
+/// <param name="entries">Your buffer for the entries</param>
+/// <param name="max_entries">Number of entries of `entries`</param>
+/// <returns>Number of the entries read, 0 for fail or no more entries.</returns>
+AVI_FUNC fsize_t avi_reader_read_idx1_block(avi_reader *r, fsize_t first_entry, avi_index_entry *entries, fsize_t max_entries);
+
+/// <summary>
+/// Get the position of the packet of an `idx1` entry, to give to `avi_stream_reader_set_position()`.
+/// The packet index and the byte offset in the stream are not in the entry, count them yourself and fill them in.
+/// </summary>
+/// <param name="r">Your `avi_reader`</param>
+/// <param name="entry">The `idx1` entry</param>
+/// <param name="entry_index">The index of the entry in the `idx1` chunk</param>
+/// <param name="pos_out">The position of the packet</param>
+AVI_FUNC void avi_reader_get_idx1_position(const avi_reader *r, const avi_index_entry *entry, fsize_t entry_index, avi_stream_position *pos_out);
+
 #endif
@@ -0,0 +1,355 @@
+#include "avi_repair.h"
+
+#include <string.h>
+
+#define AVIF_HASINDEX		0x00000010
+
+#define MAKE4CC(c1, c2, c3, c4) ((c1) | ((c2) << 8) | ((c3) << 16) | ((c4) << 24))
+
+#define FCC_RIFF MAKE4CC('R', 'I', 'F', 'F')
+#define FCC_LIST MAKE4CC('L', 'I', 'S', 'T')
+#define FCC_JUNK MAKE4CC('J', 'U', 'N', 'K')
+#define FCC_hdrl MAKE4CC('h', 'd', 'r', 'l')
+#define FCC_avih MAKE4CC('a', 'v', 'i', 'h')
+#define FCC_strl MAKE4CC('s', 't', 'r', 'l')
+#define FCC_strh MAKE4CC('s', 't', 'r', 'h')
+#define FCC_rec_ MAKE4CC('r', 'e', 'c', ' ')
+#define FCC_idx1 MAKE4CC('i', 'd', 'x', '1')
+#define FCC_MJPG MAKE4CC('M', 'J', 'P', 'G')
+#define FCC_mjpg MAKE4CC('m', 'j', 'p', 'g')
+#define FCC_DIB_ MAKE4CC('D', 'I', 'B', ' ')
+#define FCC_raw_ MAKE4CC('r', 'a', 'w', ' ')
+
+AVI_FUNC int avi_repair_init_reader
+(
+	avi_reader *r,
+	void *userdata,
+	read_cb f_read,
+	seek_cb f_seek,
+	tell_cb f_tell,
+	logprintf_cb f_logprintf,
+	avi_logprintf_level log_level
+)
+{
+	if (!avi_reader_init_begin(r, userdata, f_read, f_seek, f_tell, f_logprintf, log_level)) return 0;
+
+	// The chunks after the start of `movi` are not trusted, the scan will walk them.
+	while (!r->is_init_done && !r->stream_data_offset)
+	{
+		if (avi_reader_init_continue(r, 1) == AVI_STEP_FAILED) break;
+	}
+	if (!r->num_streams || !r->stream_data_offset) return 0;
+	r->is_init_done = 1;
+	return 1;
+}
+
+AVI_STATIC_FUNC uint32_t avi_repair_u32(const uint8_t *p)
+{
+	uint32_t ret;
+	memcpy(&ret, p, 4);
+	return ret;
+}
+
+/// Get `len` bytes at `pos` from the buffer, refill the buffer from `pos` if needed. Returns NULL at the end of the file.
+AVI_STATIC_FUNC const uint8_t *avi_repair_fetch(avi_repair *rep, fsize_t pos, size_t len)
+{
+	avi_reader *r = rep->r;
+	fssize_t rl;
+	if (pos >= rep->buffer_pos && pos - rep->buffer_pos + len <= rep->buffer_len) return &rep->buffer[pos - rep->buffer_pos];
+
+	rep->buffer_pos = pos;
+	rep->buffer_len = 0;
+	rl = avi_reader_read_at(r, pos, rep->buffer, rep->buffer_size, AVI_IO_TRAVERSAL);
+	if (rl > 0) rep->buffer_len = (size_t)rl;
+	if (len > rep->buffer_len) return NULL;
+	return rep->buffer;
+}
+
+AVI_STATIC_FUNC int avi_repair_get_stream_no(avi_repair *rep, uint32_t fourcc)
+{
+	int stream_no = avi_get_fourcc_stream_id(fourcc);
+	if (stream_no < 0 || (uint32_t)stream_no >= rep->r->num_streams) return -1;
+	return stream_no;
+}
+
+/// Is every packet of the stream a key frame? The packets don't tell it, so only the formats without inter frames are trusted:
+/// the uncompressed, the JPEG/PNG and the MJPEG video, and the streams that aren't video, e.g. PCM audio.
+AVI_STATIC_FUNC int avi_repair_is_all_keyframes(avi_stream_info *si)
+{
+	uint32_t compression;
+	if (!avi_stream_is_video(si)) return 1;
+	if (!si->format_data_is_valid) return 0;
+	compression = si->bitmap_format.BMIF.biCompression;
+	switch (compression)
+	{
+	case BI_RGB:
+	case BI_BITFIELDS:
+	case BI_JPEG:
+	case BI_PNG:
+	case FCC_MJPG:
+	case FCC_mjpg:
+	case FCC_DIB_:
+	case FCC_raw_:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/// Find the `avih` chunk and the `strh` chunks, the reader doesn't keep their positions.
+AVI_STATIC_FUNC int avi_repair_find_headers(avi_repair *rep)
+{
+	fsize_t pos = 12;
+	fsize_t end = rep->movi_start - 8;
+	uint32_t stream_id = 0;
+	while (pos + 12 <= end)
+	{
+		const uint8_t *p = avi_repair_fetch(rep, pos, 12);
+		fsize_t list_end, list_pos;
+		if (!p) return 0;
+		list_end = pos + 8 + avi_repair_u32(&p[4]);
+		if (avi_repair_u32(&p[0]) != FCC_LIST || avi_repair_u32(&p[8]) != FCC_hdrl)
+		{
+			pos = list_end;
+			continue;
+		}
+		list_pos = pos + 12;
+		while (list_pos + 8 <= list_end)
+		{
+			uint32_t fourcc, size;
+			p = avi_repair_fetch(rep, list_pos, 12);
+			if (!p) return 0;
+			fourcc = avi_repair_u32(&p[0]);
+			size = avi_repair_u32(&p[4]);
+			if (fourcc == FCC_avih)
+			{
+				rep->avih_offset = list_pos + 8;
+			}
+			else if (fourcc == FCC_LIST && avi_repair_u32(&p[8]) == FCC_strl && stream_id < AVI_MAX_STREAMS)
+			{
+				p = avi_repair_fetch(rep, list_pos + 12, 8);
+				if (!p) return 0;
+				if (avi_repair_u32(&p[0]) == FCC_strh) rep->strh_offset[stream_id] = list_pos + 20;
+				stream_id++;
+			}
+			list_pos += 8 + size;
+		}
+		break;
+	}
+	return rep->avih_offset != 0;
+}
+
+AVI_STATIC_FUNC void avi_repair_add_patch(avi_repair *rep, fsize_t offset, uint32_t value)
+{
+	if (!offset || rep->num_patches >= AVI_REPAIR_MAX_PATCHES) return;
+	rep->patches[rep->num_patches].offset = offset;
+	rep->patches[rep->num_patches].value = value;
+	rep->num_patches++;
+}
+
+AVI_FUNC int avi_repair_scan(avi_repair *rep, avi_reader *r, void *buffer, size_t buffer_size, avi_index_entry *index, uint32_t index_capacity)
+{
+	const uint8_t *p;
+	fsize_t pos;
+	fsize_t movi_limit = 0;
+	fsize_t rec_end = 0;
+	uint32_t rec_num_indices = 0;
+	uint64_t file_end;
+	uint32_t movi_size;
+	int first_video = -1;
+	if (!rep || !r || !buffer || buffer_size < 12 || !index) return 0;
+	if (!r->num_streams || !r->stream_data_offset) return 0;
+
+	memset(rep, 0, sizeof *rep);
+	rep->r = r;
+	rep->buffer = buffer;
+	rep->buffer_size = buffer_size;
+	rep->index = index;
+	rep->index_capacity = index_capacity;
+	rep->movi_start = r->stream_data_offset - 4;
+	if (!avi_repair_find_headers(rep)) return 0;
+
+	// Trust the size of `LIST(movi)` only as the limit of the scan, a crashed recorder usually leaves it zero.
+	p = avi_repair_fetch(rep, rep->movi_start - 4, 4);
+	if (!p) return 0;
+	movi_size = avi_repair_u32(p);
+	if (movi_size > 4) movi_limit = rep->movi_start + movi_size;
+
+	pos = r->stream_data_offset;
+	rep->movi_end = pos;
+	for (;;)
+	{
+		uint32_t fourcc, size;
+		fsize_t data_end;
+		int stream_no;
+
+		if (rec_end && pos >= rec_end)
+		{
+			rec_end = 0;
+			rep->movi_end = pos;
+		}
+		if (movi_limit && pos + 8 > movi_limit) break;
+
+		p = avi_repair_fetch(rep, pos, 12);
+		if (!p) p = avi_repair_fetch(rep, pos, 8);
+		if (!p)
+		{
+			rep->is_truncated = 1;
+			break;
+		}
+		fourcc = avi_repair_u32(&p[0]);
+		size = avi_repair_u32(&p[4]);
+		data_end = pos + 8 + size;
+		if (data_end < pos)
+		{
+			rep->is_truncated = 1;
+			break;
+		}
+		if (fourcc == FCC_idx1) break;
+
+		// The `idx1` chunk can't be inserted before a `RIFF AVIX` chunk.
+		if (fourcc == FCC_RIFF) return 0;
+		if (fourcc == FCC_LIST && !rec_end)
+		{
+			p = avi_repair_fetch(rep, pos, 12);
+			if (!p || avi_repair_u32(&p[8]) != FCC_rec_)
+			{
+				rep->is_truncated = 1;
+				break;
+			}
+			// Move inside the `LIST(rec)` chunk, it's kept only if it's complete.
+			rec_end = data_end;
+			rec_num_indices = rep->num_indices;
+			pos += 12;
+			continue;
+		}
+
+		// The chunk is intact if its last byte is in the file.
+		if (size && !avi_repair_fetch(rep, data_end - 1, 1))
+		{
+			rep->is_truncated = 1;
+			break;
+		}
+		stream_no = avi_repair_get_stream_no(rep, fourcc);
+		if (stream_no >= 0)
+		{
+			avi_index_entry *entry;
+			if (rep->num_indices >= rep->index_capacity) return 0;
+			entry = &rep->index[rep->num_indices++];
+			entry->dwChunkId = fourcc;
+			entry->dwFlags = avi_repair_is_all_keyframes(&r->avi_stream_info[stream_no]) ? AVIIF_KEYFRAME : 0;
+			entry->dwOffset = (uint32_t)(pos - rep->movi_start);
+			entry->dwSize = size;
+		}
+		else if (fourcc != FCC_JUNK && (fourcc & 0xFFFF) != MAKE4CC('i', 'x', 0, 0))
+		{
+			rep->is_truncated = 1;
+			break;
+		}
+		pos = data_end + (size & 1);
+		if (!rec_end) rep->movi_end = pos;
+	}
+	if (rec_end) rep->num_indices = rec_num_indices;
+
+	for (uint32_t i = 0; i < rep->num_indices; i++)
+	{
+		int stream_no = avi_repair_get_stream_no(rep, rep->index[i].dwChunkId);
+		rep->num_packets[stream_no]++;
+		rep->num_bytes[stream_no] += rep->index[i].dwSize;
+	}
+
+	file_end = (uint64_t)rep->movi_end + 8 + (uint64_t)rep->num_indices * sizeof(avi_index_entry);
+	if (file_end > 0xFFFFFFFF) return 0;
+	rep->file_end = (fsize_t)file_end;
+	if (r->num_movi_ranges > 1) return 0;
+	p = avi_repair_fetch(rep, 4, 4);
+	if (p)
+	{
+		fsize_t riff_end = 8 + avi_repair_u32(p);
+		if (riff_end >= rep->movi_end && riff_end < rep->file_end)
+		{
+			p = avi_repair_fetch(rep, riff_end + (riff_end & 1), 4);
+			if (p && avi_repair_u32(p) == FCC_RIFF) return 0;
+		}
+	}
+
+	avi_repair_add_patch(rep, 4, (uint32_t)(file_end - 8));
+	avi_repair_add_patch(rep, rep->movi_start - 4, (uint32_t)(rep->movi_end - rep->movi_start));
+	avi_repair_add_patch(rep, rep->avih_offset + offsetof(avi_main_header, dwFlags) - 4, r->avih.dwFlags | AVIF_HASINDEX);
+	for (uint32_t i = 0; i < r->num_streams; i++)
+	{
+		avi_stream_header *sh = &r->avi_stream_info[i].stream_header;
+		uint32_t length = sh->dwSampleSize ? (uint32_t)(rep->num_bytes[i] / sh->dwSampleSize) : rep->num_packets[i];
+		if (first_video < 0 && avi_stream_is_video(&r->avi_stream_info[i])) first_video = (int)i;
+		if (rep->strh_offset[i]) avi_repair_add_patch(rep, rep->strh_offset[i] + offsetof(avi_stream_header, dwLength), length);
+	}
+	if (first_video >= 0) avi_repair_add_patch(rep, rep->avih_offset + offsetof(avi_main_header, dwTotalFrames) - 4, rep->num_packets[first_video]);
+	return 1;
+}
+
+AVI_STATIC_FUNC int avi_repair_write_idx1(avi_repair *rep, void *userdata, write_cb f_write)
+{
+	uint32_t header[2];
+	size_t len = (size_t)rep->num_indices * sizeof(avi_index_entry);
+	header[0] = FCC_idx1;
+	header[1] = (uint32_t)len;
+	if (f_write(header, sizeof header, userdata) != (fssize_t)sizeof header) return 0;
+	if (len && f_write(rep->index, len, userdata) != (fssize_t)len) return 0;
+	return 1;
+}
+
+AVI_FUNC int avi_repair_write_in_place(avi_repair *rep, write_cb f_write)
+{
+	avi_reader *r;
+	if (!rep || !rep->r || !f_write) return 0;
+	r = rep->r;
+
+	if (r->f_seek(rep->movi_end, r->userdata) == -1) return 0;
+	if (!avi_repair_write_idx1(rep, r->userdata, f_write)) return 0;
+
+	// Fix the headers after the index is written, if it fails, the file is not worse than before.
+	for (uint32_t i = 0; i < rep->num_patches; i++)
+	{
+		if (r->f_seek(rep->patches[i].offset, r->userdata) == -1) return 0;
+		if (f_write(&rep->patches[i].value, 4, r->userdata) != 4) return 0;
+	}
+	rep->buffer_len = 0;
+	return 1;
+}
+
+AVI_FUNC int avi_repair_write_to(avi_repair *rep, void *userdata, write_cb f_write)
+{
+	avi_reader *r;
+	fsize_t pos = 0;
+	if (!rep || !rep->r || !f_write) return 0;
+	r = rep->r;
+
+	while (pos < rep->movi_end)
+	{
+		size_t len = rep->buffer_size;
+		fssize_t rl;
+		if (len > rep->movi_end - pos) len = (size_t)(rep->movi_end - pos);
+		rl = avi_reader_read_at(r, pos, rep->buffer, len, AVI_IO_PAYLOAD);
+		if (rl < 0) return 0;
+
+		// Only the padding byte of the last chunk could be missing.
+		if ((size_t)rl < len)
+		{
+			if (pos + rl + 1 < rep->movi_end) return 0;
+			memset(&rep->buffer[rl], 0, len - (size_t)rl);
+		}
+		for (uint32_t i = 0; i < rep->num_patches; i++)
+		{
+			avi_repair_patch *patch = &rep->patches[i];
+			for (uint32_t j = 0; j < 4; j++)
+			{
+				fsize_t at = patch->offset + j;
+				if (at >= pos && at < pos + len) rep->buffer[at - pos] = (uint8_t)(patch->value >> (j * 8));
+			}
+		}
+		if (f_write(rep->buffer, len, userdata) != (fssize_t)len) return 0;
+		pos += (fsize_t)len;
+	}
+	rep->buffer_len = 0;
+	return avi_repair_write_idx1(rep, userdata, f_write);
+}
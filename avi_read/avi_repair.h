@@ -0,0 +1,118 @@
+#ifndef _AVI_REPAIR_H_
+#define _AVI_REPAIR_H_ 1
+
+#include "avi_writer.h"
+
+#ifndef AVI_REPAIR_MAX_PATCHES
+#define AVI_REPAIR_MAX_PATCHES (AVI_MAX_STREAMS + 4)
+#endif
+
+/// <summary>
+/// A 32-bit value to be overwritten in the repaired file.
+/// </summary>
+typedef struct
+{
+	fsize_t offset;
+	uint32_t value;
+}avi_repair_patch;
+
+/// <summary>
+/// Rebuilds the `idx1` index of a broken AVI file, e.g. the recorder crashed before writing the index and fixing the chunk sizes.
+/// The `movi` chunk is scanned once with big reads, the scan stops cleanly at the last intact packet.
+/// Then the `idx1` chunk is written after the last intact packet, the sizes of `RIFF` and `LIST(movi)` are fixed,
+/// the `AVIF_HASINDEX` flag is set, and the lengths of the streams are updated. Opening the repaired file uses the fast indexed paths.
+/// There's no key frame info in the packets, so only the packets of the streams without inter frames are marked as key frames:
+/// the uncompressed and the MJPEG video, and the streams that aren't video, e.g. PCM audio. The packets of the other video streams are left unmarked,
+/// so the players find the key frames of these streams by parsing the codec, instead of trusting a wrong flag.
+/// The files with `RIFF AVIX` chunks are not supported, the `idx1` chunk can't grow without overwriting them.
+/// </summary>
+typedef struct
+{
+	avi_reader *r;
+
+	/// Your buffer to read the file, bigger is faster.
+	uint8_t *buffer;
+	size_t buffer_size;
+	fsize_t buffer_pos;
+	size_t buffer_len;
+
+	/// Your buffer to store the rebuilt `idx1` entries.
+	avi_index_entry *index;
+	uint32_t index_capacity;
+	uint32_t num_indices;
+
+	/// The position of the `movi` FourCC, the offsets of the `idx1` entries are relative to it.
+	fsize_t movi_start;
+
+	/// The end of the last intact chunk inside `movi`, the `idx1` chunk is written here.
+	fsize_t movi_end;
+
+	/// The end of the repaired file. The data after it is garbage, you can truncate the file to this size.
+	fsize_t file_end;
+
+	/// Did the scan stop at a broken or truncated chunk, instead of the end of `movi` or an old `idx1` chunk?
+	int is_truncated;
+
+	/// The positions of the headers to fix, zero if not found.
+	fsize_t avih_offset;
+	fsize_t strh_offset[AVI_MAX_STREAMS];
+
+	/// The packets found by the scan.
+	uint32_t num_packets[AVI_MAX_STREAMS];
+	uint64_t num_bytes[AVI_MAX_STREAMS];
+
+	/// The values to overwrite, made by `avi_repair_scan()`
+	avi_repair_patch patches[AVI_REPAIR_MAX_PATCHES];
+	uint32_t num_patches;
+}avi_repair;
+
+/// <summary>
+/// Parse the headers of a broken AVI file. Unlike `avi_reader_init()`, it stops after the start of the `movi` chunk is found,
+/// so the broken chunk sizes after it don't fail the parsing.
+/// The parameters are the same as `avi_reader_init()`.
+/// </summary>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_repair_init_reader
+(
+	avi_reader *r,
+	void *userdata,
+	read_cb f_read,
+	seek_cb f_seek,
+	tell_cb f_tell,
+	logprintf_cb f_logprintf,
+	avi_logprintf_level log_level
+);
+
+/// <summary>
+/// Scan the `movi` chunk to rebuild the index. The file is not modified.
+/// </summary>
+/// <param name="rep">Your `avi_repair` to be initialized</param>
+/// <param name="r">Your `avi_reader` initialized by `avi_repair_init_reader()` or `avi_reader_init()`</param>
+/// <param name="buffer">Your buffer to read the file, it should be at least 4 KiB.</param>
+/// <param name="buffer_size">The size of `buffer`</param>
+/// <param name="index">Your buffer to store the rebuilt `idx1` entries</param>
+/// <param name="index_capacity">Number of entries of `index`</param>
+/// <returns>0 for fail (including too many packets for `index`, or the file has `RIFF AVIX` chunks), nonzero for success.</returns>
+AVI_FUNC int avi_repair_scan(avi_repair *rep, avi_reader *r, void *buffer, size_t buffer_size, avi_index_entry *index, uint32_t index_capacity);
+
+/// <summary>
+/// Write the rebuilt `idx1` chunk and the fixed header values into the source file.
+/// The reader's `read()`/`seek()` userdata must also be usable by your `write()` function, e.g. a `FILE *` opened by `"rb+"`.
+/// After this, initialize a new `avi_reader` to read the repaired file.
+/// </summary>
+/// <param name="rep">Your `avi_repair` after `avi_repair_scan()`</param>
+/// <param name="f_write">Your `write()` callback function pointer.</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_repair_write_in_place(avi_repair *rep, write_cb f_write);
+
+/// <summary>
+/// Copy the intact part of the source file to a new file, with the fixed header values and the rebuilt `idx1` chunk.
+/// The new file is written sequentially without seeking.
+/// </summary>
+/// <param name="rep">Your `avi_repair` after `avi_repair_scan()`</param>
+/// <param name="userdata">The userdata to pass to `f_write`</param>
+/// <param name="f_write">Your `write()` callback function pointer.</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_repair_write_to(avi_repair *rep, void *userdata, write_cb f_write);
+
+#endif
@@ -0,0 +1,189 @@
+#include "avi_resample.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifdef AVI_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define AVI_RESAMPLE_PI 3.14159265358979323846
+
+AVI_STATIC_FUNC uint32_t avi_resample_gcd(uint32_t a, uint32_t b)
+{
+	while (b)
+	{
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+AVI_FUNC size_t avi_resample_get_filter_len(uint32_t src_rate, uint32_t dst_rate)
+{
+	uint32_t up;
+	if (!src_rate || !dst_rate) return 0;
+	up = dst_rate / avi_resample_gcd(src_rate, dst_rate);
+	if (up > AVI_RESAMPLE_MAX_PHASES) return 0;
+	return (size_t)up * AVI_RESAMPLE_TAPS;
+}
+
+// Make the filter bank from a Blackman windowed sinc low-pass filter at `up` times the input rate.
+// The coefficients of a phase are in the order of the input frames, the oldest first. Each phase is normalized to the unity gain.
+AVI_STATIC_FUNC void avi_resample_make_filter(avi_resample *rs)
+{
+	uint32_t up = rs->up;
+	uint32_t len = up * AVI_RESAMPLE_TAPS;
+	double center = (len - 1) / 2.0;
+	double cutoff = 0.5 / (up > rs->down ? up : rs->down) * 0.9;
+	for (uint32_t p = 0; p < up; p++)
+	{
+		double h[AVI_RESAMPLE_TAPS];
+		double sum = 0;
+		for (uint32_t k = 0; k < AVI_RESAMPLE_TAPS; k++)
+		{
+			// The input frame `k` of the window is `AVI_RESAMPLE_TAPS - 1 - k` frames before the newest one.
+			uint32_t n = p + (AVI_RESAMPLE_TAPS - 1 - k) * up;
+			double x = n - center;
+			double sinc = x == 0 ? 1.0 : sin(2 * AVI_RESAMPLE_PI * cutoff * x) / (2 * AVI_RESAMPLE_PI * cutoff * x);
+			double window = 0.42 - 0.5 * cos(2 * AVI_RESAMPLE_PI * n / (len - 1)) + 0.08 * cos(4 * AVI_RESAMPLE_PI * n / (len - 1));
+			h[k] = sinc * window;
+			sum += h[k];
+		}
+		for (uint32_t k = 0; k < AVI_RESAMPLE_TAPS; k++)
+		{
+			double v = sum != 0 ? h[k] / sum * 16384.0 : 0;
+			if (v > 32767) v = 32767;
+			if (v < -32768) v = -32768;
+			rs->filter[p * AVI_RESAMPLE_TAPS + k] = (int16_t)floor(v + 0.5);
+		}
+	}
+}
+
+AVI_FUNC int avi_resample_init
+(
+	avi_resample *rs,
+	uint32_t src_rate,
+	uint32_t dst_rate,
+	uint32_t channels,
+	int16_t *filter,
+	size_t filter_len,
+	int16_t *chunk,
+	uint32_t chunk_frames,
+	avi_resample_chunk_cb f_chunk,
+	void *userdata
+)
+{
+	size_t need_len = avi_resample_get_filter_len(src_rate, dst_rate);
+	uint32_t gcd;
+	if (!rs || !filter || !chunk || !chunk_frames || !f_chunk) return 0;
+	if (!channels || channels > AVI_RESAMPLE_MAX_CHANNELS) return 0;
+	if (!need_len || filter_len < need_len) return 0;
+
+	memset(rs, 0, sizeof *rs);
+	gcd = avi_resample_gcd(src_rate, dst_rate);
+	rs->src_rate = src_rate;
+	rs->dst_rate = dst_rate;
+	rs->channels = channels;
+	rs->up = dst_rate / gcd;
+	rs->down = src_rate / gcd;
+	rs->filter = filter;
+	rs->chunk = chunk;
+	rs->chunk_frames = chunk_frames;
+	rs->f_chunk = f_chunk;
+	rs->userdata = userdata;
+	avi_resample_make_filter(rs);
+	avi_resample_reset(rs);
+	return 1;
+}
+
+AVI_FUNC void avi_resample_reset(avi_resample *rs)
+{
+	if (!rs) return;
+	memset(rs->history, 0, sizeof rs->history);
+	rs->history_pos = 0;
+	rs->chunk_fill = 0;
+
+	// The first output needs the first input frame.
+	rs->phase = rs->up;
+}
+
+AVI_STATIC_FUNC void avi_resample_push(avi_resample *rs, const int16_t *frame)
+{
+	rs->history_pos = (rs->history_pos + 1) % AVI_RESAMPLE_TAPS;
+	for (uint32_t c = 0; c < rs->channels; c++)
+	{
+		rs->history[c][rs->history_pos] = frame[c];
+		rs->history[c][rs->history_pos + AVI_RESAMPLE_TAPS] = frame[c];
+	}
+}
+
+// The dot product of the phase coefficients and the window of one channel.
+AVI_STATIC_FUNC int32_t avi_resample_dot(const int16_t *coef, const int16_t *window)
+{
+	int32_t acc = 0;
+	uint32_t k = 0;
+#ifdef AVI_USE_SSE2
+	// 8 taps at a time by `_mm_madd_epi16`, then add up the 4 partial sums.
+	__m128i sum = _mm_setzero_si128();
+	for (; k + 8 <= AVI_RESAMPLE_TAPS; k += 8)
+	{
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_loadu_si128((const __m128i *)&coef[k]), _mm_loadu_si128((const __m128i *)&window[k])));
+	}
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	acc = _mm_cvtsi128_si32(sum);
+#endif
+	for (; k < AVI_RESAMPLE_TAPS; k++) acc += (int32_t)coef[k] * window[k];
+	return acc;
+}
+
+// One output frame: the dot product of the phase coefficients and the window of the last input samples of each channel.
+AVI_STATIC_FUNC void avi_resample_output(avi_resample *rs)
+{
+	uint32_t ch = rs->channels;
+	const int16_t *coef = &rs->filter[rs->phase * AVI_RESAMPLE_TAPS];
+	int16_t *out = &rs->chunk[rs->chunk_fill * ch];
+	for (uint32_t c = 0; c < ch; c++)
+	{
+		int32_t acc = avi_resample_dot(coef, &rs->history[c][rs->history_pos + 1]);
+		acc = (acc + 8192) >> 14;
+		if (acc > 32767) acc = 32767;
+		if (acc < -32768) acc = -32768;
+		out[c] = (int16_t)acc;
+	}
+	rs->num_frames_out++;
+	if (++rs->chunk_fill == rs->chunk_frames)
+	{
+		rs->f_chunk(rs->chunk, rs->chunk_fill, rs->userdata);
+		rs->chunk_fill = 0;
+	}
+}
+
+AVI_FUNC int avi_resample_process(avi_resample *rs, const int16_t *pcm, uint32_t num_frames)
+{
+	uint32_t i = 0;
+	if (!rs || (!pcm && num_frames)) return 0;
+	for (;;)
+	{
+		// Consume the input frames until the next output is between the last 2 of them.
+		while (rs->phase >= rs->up)
+		{
+			if (i == num_frames) return 1;
+			avi_resample_push(rs, &pcm[(size_t)i * rs->channels]);
+			rs->num_frames_in++;
+			rs->phase -= rs->up;
+			i++;
+		}
+		avi_resample_output(rs);
+		rs->phase += rs->down;
+	}
+}
+
+AVI_FUNC void avi_resample_flush(avi_resample *rs)
+{
+	if (!rs || !rs->chunk_fill) return;
+	rs->f_chunk(rs->chunk, rs->chunk_fill, rs->userdata);
+	rs->chunk_fill = 0;
+}
@@ -0,0 +1,124 @@
+#ifndef _AVI_RESAMPLE_H_
+#define _AVI_RESAMPLE_H_ 1
+
+#include "avi_reader.h"
+
+/// <summary>
+/// The filter taps of each phase. More taps make a sharper filter and cost more CPU.
+/// Downsampling by a big ratio, e.g. 48000 to 8000, needs more taps to suppress the aliasing.
+/// </summary>
+#ifndef AVI_RESAMPLE_TAPS
+#define AVI_RESAMPLE_TAPS 16
+#endif
+
+#ifndef AVI_RESAMPLE_MAX_CHANNELS
+#define AVI_RESAMPLE_MAX_CHANNELS 8
+#endif
+
+/// <summary>
+/// The limit of the number of phases, `dst_rate / gcd(src_rate, dst_rate)`. E.g. 44100 to 48000 has 160 phases.
+/// </summary>
+#ifndef AVI_RESAMPLE_MAX_PHASES
+#define AVI_RESAMPLE_MAX_PHASES 1024
+#endif
+
+/// <summary>
+/// Receive a chunk of the resampled audio, every chunk has `chunk_frames` frames except the one by `avi_resample_flush()`.
+/// </summary>
+/// <param name="pcm">The interleaved 16-bit PCM samples</param>
+/// <param name="num_frames">Number of frames of the chunk</param>
+/// <param name="userdata">The data you passed to `avi_resample_init()`</param>
+typedef void(*avi_resample_chunk_cb)(const int16_t *pcm, uint32_t num_frames, void *userdata);
+
+/// <summary>
+/// Converts the sample rate of the interleaved 16-bit PCM audio by a polyphase FIR filter bank made at initialization.
+/// The audio is fed in pieces of any size, e.g. the packets converted by `avi_pcm_converter`, the filter history is kept between them.
+/// The output is cut into chunks of the size of your sink buffer.
+/// </summary>
+typedef struct
+{
+	uint32_t src_rate;
+	uint32_t dst_rate;
+	uint32_t channels;
+
+	/// The rate ratio reduced to `up / down`
+	uint32_t up;
+	uint32_t down;
+
+	/// Your buffer for the filter bank, `up * AVI_RESAMPLE_TAPS` coefficients in Q14.
+	int16_t *filter;
+
+	/// The position of the next output between the input frames, in `1 / up` of the input frame.
+	uint32_t phase;
+
+	/// The last `AVI_RESAMPLE_TAPS` input samples of each channel, written twice so the window is always contiguous.
+	int16_t history[AVI_RESAMPLE_MAX_CHANNELS][AVI_RESAMPLE_TAPS * 2];
+	uint32_t history_pos;
+
+	/// Your buffer for the output chunk
+	int16_t *chunk;
+	uint32_t chunk_frames;
+	uint32_t chunk_fill;
+
+	avi_resample_chunk_cb f_chunk;
+	void *userdata;
+
+	/// Statistics
+	uint64_t num_frames_in;
+	uint64_t num_frames_out;
+}avi_resample;
+
+/// <summary>
+/// Get the number of the filter coefficients for the rates, to size your filter buffer.
+/// </summary>
+/// <returns>0 if the rates are invalid or need more than `AVI_RESAMPLE_MAX_PHASES` phases.</returns>
+AVI_FUNC size_t avi_resample_get_filter_len(uint32_t src_rate, uint32_t dst_rate);
+
+/// <summary>
+/// Initialize the resampler and make the filter bank.
+/// </summary>
+/// <param name="rs">Your `avi_resample` to be initialized</param>
+/// <param name="src_rate">The sample rate of the input, e.g. `nSamplesPerSec` of the audio stream</param>
+/// <param name="dst_rate">The sample rate of your sink</param>
+/// <param name="channels">Number of channels</param>
+/// <param name="filter">Your buffer for the filter bank</param>
+/// <param name="filter_len">Number of coefficients of `filter`, see `avi_resample_get_filter_len()`</param>
+/// <param name="chunk">Your buffer for the output chunk, `chunk_frames * channels` samples</param>
+/// <param name="chunk_frames">The frames of each output chunk, e.g. `dst_rate / AUDIO_BUFFERS_PER_SEC`</param>
+/// <param name="f_chunk">Your function to receive the output chunks</param>
+/// <param name="userdata">The data to pass to `f_chunk`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_resample_init
+(
+	avi_resample *rs,
+	uint32_t src_rate,
+	uint32_t dst_rate,
+	uint32_t channels,
+	int16_t *filter,
+	size_t filter_len,
+	int16_t *chunk,
+	uint32_t chunk_frames,
+	avi_resample_chunk_cb f_chunk,
+	void *userdata
+);
+
+/// <summary>
+/// Feed the input frames, the finished output chunks are sent to your `f_chunk`.
+/// </summary>
+/// <param name="rs">Your `avi_resample`</param>
+/// <param name="pcm">The interleaved 16-bit PCM samples</param>
+/// <param name="num_frames">Number of the input frames</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_resample_process(avi_resample *rs, const int16_t *pcm, uint32_t num_frames);
+
+/// <summary>
+/// Send the unfinished output chunk to your `f_chunk`, e.g. at the end of the stream.
+/// </summary>
+AVI_FUNC void avi_resample_flush(avi_resample *rs);
+
+/// <summary>
+/// Drop the filter history and the unfinished output chunk, call it after seeking the audio stream.
+/// </summary>
+AVI_FUNC void avi_resample_reset(avi_resample *rs);
+
+#endif
@@ -0,0 +1,146 @@
+#include "avi_rle.h"
+
+#include <string.h>
+
+AVI_FUNC int avi_rle_init(avi_rle_decoder *d, avi_stream_reader *s, void *framebuffer, size_t stride, avi_pixel_format format)
+{
+	bitmap_info_header *bmif;
+	if (!d || !s || !s->stream_info || !framebuffer) return 0;
+	if (!avi_is_stream_indexed_color(s)) return 0;
+
+	bmif = &s->stream_info->bitmap_format.BMIF;
+	if (bmif->biCompression != BI_RLE8 && bmif->biCompression != BI_RLE4) return 0;
+	if (bmif->biWidth <= 0 || bmif->biHeight == 0) return 0;
+
+	memset(d, 0, sizeof *d);
+	if (!avi_pixel_lut_init_from_stream(&d->lut, s, format)) return 0;
+	d->width = (uint32_t)bmif->biWidth;
+	d->bottom_up = bmif->biHeight > 0;
+	d->height = d->bottom_up ? (uint32_t)bmif->biHeight : (uint32_t)-(int64_t)bmif->biHeight;
+	d->is_rle4 = bmif->biCompression == BI_RLE4;
+	d->framebuffer = framebuffer;
+	d->stride = stride;
+	d->bytes_per_pixel = d->lut.bytes_per_pixel;
+	return stride >= (size_t)d->width * d->bytes_per_pixel;
+}
+
+AVI_FUNC void avi_rle_set_palette(avi_rle_decoder *d, const rgb_quad *palette, uint32_t num_colors)
+{
+	if (!d) return;
+	avi_pixel_lut_init(&d->lut, d->lut.format, palette, num_colors);
+}
+
+// Get the pixel of the framebuffer by the position in the RLE frame.
+AVI_STATIC_FUNC uint8_t *avi_rle_get_pixel_ptr(avi_rle_decoder *d, uint32_t x, uint32_t y)
+{
+	size_t row = d->bottom_up ? d->height - 1 - y : y;
+	return &d->framebuffer[row * d->stride + (size_t)x * d->bytes_per_pixel];
+}
+
+// Fill `count` pixels with 2 alternating colors, the same color twice for RLE8.
+AVI_STATIC_FUNC void avi_rle_fill(avi_rle_decoder *d, uint8_t *dst, uint8_t index0, uint8_t index1, uint32_t count)
+{
+	uint32_t bpp = d->bytes_per_pixel;
+	if (bpp == 1 && index0 == index1)
+	{
+		memset(dst, (uint8_t)d->lut.lut[index0], count);
+		return;
+	}
+	for (uint32_t i = 0; i < count; i++)
+	{
+		memcpy(dst, &d->lut.lut[(i & 1) ? index1 : index0], bpp);
+		dst += bpp;
+	}
+}
+
+// Copy `count` absolute mode pixels
+AVI_STATIC_FUNC void avi_rle_copy(avi_rle_decoder *d, uint8_t *dst, const uint8_t *src, uint32_t count)
+{
+	uint32_t bpp = d->bytes_per_pixel;
+	if (d->is_rle4)
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint8_t index = (i & 1) ? (src[i >> 1] & 0x0F) : (src[i >> 1] >> 4);
+			memcpy(dst, &d->lut.lut[index], bpp);
+			dst += bpp;
+		}
+	}
+	else
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			memcpy(dst, &d->lut.lut[src[i]], bpp);
+			dst += bpp;
+		}
+	}
+}
+
+AVI_FUNC int avi_rle_decode(avi_rle_decoder *d, const void *packet, size_t len)
+{
+	const uint8_t *data = packet;
+	size_t pos = 0;
+	uint32_t x = 0, y = 0;
+	if (!d || !d->framebuffer) return 0;
+	if (!data && len) return 0;
+	d->is_damaged = 0;
+
+	while (pos + 2 <= len)
+	{
+		uint32_t count = data[pos];
+		uint32_t code = data[pos + 1];
+		pos += 2;
+
+		if (count)
+		{
+			// Encoded mode: a run of one color, or two alternating colors for RLE4.
+			uint8_t index0 = d->is_rle4 ? (uint8_t)(code >> 4) : (uint8_t)code;
+			uint8_t index1 = d->is_rle4 ? (uint8_t)(code & 0x0F) : (uint8_t)code;
+			uint32_t n = count;
+			if (y >= d->height || x >= d->width) n = 0;
+			else if (n > d->width - x) n = d->width - x;
+			if (n < count) d->is_damaged = 1;
+			if (n) avi_rle_fill(d, avi_rle_get_pixel_ptr(d, x, y), index0, index1, n);
+			x += count;
+			continue;
+		}
+
+		switch (code)
+		{
+		case 0: // End of line
+			x = 0;
+			y++;
+			break;
+		case 1: // End of bitmap
+			return 1;
+		case 2: // Delta, the skipped pixels keep the previous frame.
+			if (pos + 2 > len)
+			{
+				d->is_damaged = 1;
+				return 1;
+			}
+			x += data[pos];
+			y += data[pos + 1];
+			pos += 2;
+			break;
+		default: // Absolute mode, padded to 16 bits.
+		{
+			size_t num_bytes = d->is_rle4 ? (code + 1) / 2 : code;
+			uint32_t n = code;
+			if (pos + num_bytes > len)
+			{
+				d->is_damaged = 1;
+				return 1;
+			}
+			if (y >= d->height || x >= d->width) n = 0;
+			else if (n > d->width - x) n = d->width - x;
+			if (n < code) d->is_damaged = 1;
+			if (n) avi_rle_copy(d, avi_rle_get_pixel_ptr(d, x, y), &data[pos], n);
+			x += code;
+			pos += (num_bytes + 1) & ~(size_t)1;
+			break;
+		}
+		}
+	}
+	return 1;
+}
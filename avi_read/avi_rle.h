@@ -0,0 +1,62 @@
+#ifndef _AVI_RLE_H_
+#define _AVI_RLE_H_ 1
+
+#include "avi_pixel.h"
+
+/// <summary>
+/// Decodes the `BI_RLE8` and `BI_RLE4` frames into your framebuffer.
+/// An RLE frame could skip pixels by the end-of-line, delta, and end-of-bitmap codes, the skipped pixels keep the previous frame,
+/// so keep the framebuffer between the frames and decode the frames in order after seeking to a key frame.
+/// The palette indices are expanded by a lookup table of the destination format while decoding.
+/// </summary>
+typedef struct
+{
+	uint32_t width;
+	uint32_t height;
+	int is_rle4;
+
+	/// The first row of the frame is the bottom row, as the DIB with positive `biHeight`
+	int bottom_up;
+
+	/// Your framebuffer, the first row is the top row.
+	uint8_t *framebuffer;
+	size_t stride;
+	uint32_t bytes_per_pixel;
+
+	/// The palette in the framebuffer format, keep it in sync by `avi_pixel_lut_apply_palette_change()`
+	avi_pixel_lut lut;
+
+	/// Did the last frame have bad codes or pixels out of the frame? The good part is decoded anyway.
+	int is_damaged;
+}avi_rle_decoder;
+
+/// <summary>
+/// Initialize the decoder by the stream format, the palette of the stream is loaded.
+/// </summary>
+/// <param name="d">Your `avi_rle_decoder` to be initialized</param>
+/// <param name="s">Your stream reader of a `BI_RLE8` or `BI_RLE4` video stream</param>
+/// <param name="framebuffer">Your framebuffer, the first row is the top row.</param>
+/// <param name="stride">The bytes per row of your framebuffer</param>
+/// <param name="format">The pixel format of your framebuffer: `AVI_PIXEL_INDEX8`, `AVI_PIXEL_RGB565`, `AVI_PIXEL_BGRA8888`, or `AVI_PIXEL_RGBA8888`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_rle_init(avi_rle_decoder *d, avi_stream_reader *s, void *framebuffer, size_t stride, avi_pixel_format format);
+
+/// <summary>
+/// Rebuild the lookup table from a palette, e.g. after `avi_apply_palette_change()`. It's `avi_pixel_lut_init()` on the lookup table of the decoder.
+/// The pixels already in the framebuffer are not changed.
+/// </summary>
+/// <param name="d">Your `avi_rle_decoder`</param>
+/// <param name="palette">The palette, e.g. `bitmap_format.palette` of the stream info</param>
+/// <param name="num_colors">Number of the palette entries, the rest of the lookup table is black.</param>
+AVI_FUNC void avi_rle_set_palette(avi_rle_decoder *d, const rgb_quad *palette, uint32_t num_colors);
+
+/// <summary>
+/// Decode an RLE frame into the framebuffer.
+/// </summary>
+/// <param name="d">Your `avi_rle_decoder`</param>
+/// <param name="packet">The packet data, e.g. read by `avi_stream_reader_read_packet()`</param>
+/// <param name="len">The length of the packet</param>
+/// <returns>0 for fail, nonzero for success, check `is_damaged` for the bad frames.</returns>
+AVI_FUNC int avi_rle_decode(avi_rle_decoder *d, const void *packet, size_t len);
+
+#endif
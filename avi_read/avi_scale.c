@@ -0,0 +1,358 @@
+#include "avi_scale.h"
+
+#include <string.h>
+
+#ifdef AVI_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+AVI_FUNC int avi_scale_init
+(
+	avi_scale *sc,
+	uint32_t src_width,
+	uint32_t src_height,
+	avi_pixel_format src_format,
+	size_t src_stride,
+	int bottom_up,
+	uint32_t dst_width,
+	uint32_t dst_height,
+	avi_pixel_format dst_format,
+	size_t dst_stride,
+	avi_scale_filter filter,
+	int keep_aspect,
+	palette_entry border_color
+)
+{
+	if (!sc) return 0;
+	if (!src_width || !src_height || !dst_width || !dst_height) return 0;
+	if (src_format == AVI_PIXEL_INDEX8 || !avi_pixel_get_bytes_per_pixel(src_format)) return 0;
+	switch (dst_format)
+	{
+	case AVI_PIXEL_RGB565:
+	case AVI_PIXEL_BGRA8888:
+	case AVI_PIXEL_RGBA8888:
+		break;
+	default:
+		return 0;
+	}
+	if (filter != AVI_SCALE_NEAREST && filter != AVI_SCALE_BILINEAR) return 0;
+	if (src_stride < (size_t)src_width * avi_pixel_get_bytes_per_pixel(src_format)) return 0;
+	if (dst_stride < (size_t)dst_width * avi_pixel_get_bytes_per_pixel(dst_format)) return 0;
+
+	memset(sc, 0, sizeof *sc);
+	sc->src_width = src_width;
+	sc->src_height = src_height;
+	sc->src_format = src_format;
+	sc->src_stride = src_stride;
+	sc->bottom_up = bottom_up;
+	sc->dst_width = dst_width;
+	sc->dst_height = dst_height;
+	sc->dst_format = dst_format;
+	sc->dst_stride = dst_stride;
+	sc->filter = filter;
+	sc->border_color = avi_pixel_pack_color(dst_format, border_color);
+
+	sc->pic_width = dst_width;
+	sc->pic_height = dst_height;
+	if (keep_aspect)
+	{
+		if ((uint64_t)src_width * dst_height > (uint64_t)dst_width * src_height)
+		{
+			// Wider than the display: letterbox
+			sc->pic_height = (uint32_t)(((uint64_t)dst_width * src_height + src_width / 2) / src_width);
+			if (!sc->pic_height) sc->pic_height = 1;
+		}
+		else
+		{
+			// Taller than the display: pillarbox
+			sc->pic_width = (uint32_t)(((uint64_t)dst_height * src_width + src_height / 2) / src_height);
+			if (!sc->pic_width) sc->pic_width = 1;
+		}
+	}
+	sc->pic_x = (dst_width - sc->pic_width) / 2;
+	sc->pic_y = (dst_height - sc->pic_height) / 2;
+	sc->step_x = (uint32_t)(((uint64_t)src_width << 16) / sc->pic_width);
+	sc->step_y = (uint32_t)(((uint64_t)src_height << 16) / sc->pic_height);
+	return 1;
+}
+
+AVI_FUNC int avi_scale_init_from_stream
+(
+	avi_scale *sc,
+	avi_stream_reader *s,
+	uint32_t dst_width,
+	uint32_t dst_height,
+	avi_pixel_format dst_format,
+	size_t dst_stride,
+	avi_scale_filter filter,
+	int keep_aspect,
+	palette_entry border_color
+)
+{
+	bitmap_info_header *bmif;
+	avi_pixel_format src_format = avi_pixel_get_stream_format(s);
+	uint32_t width, height;
+	if (src_format == AVI_PIXEL_UNKNOWN) return 0;
+
+	bmif = &s->stream_info->bitmap_format.BMIF;
+	if (bmif->biWidth <= 0 || bmif->biHeight == 0) return 0;
+	width = (uint32_t)bmif->biWidth;
+	height = bmif->biHeight > 0 ? (uint32_t)bmif->biHeight : (uint32_t)-(int64_t)bmif->biHeight;
+	return avi_scale_init(sc, width, height, src_format, avi_pixel_get_dib_stride(width, bmif->biBitCount), bmif->biHeight > 0,
+		dst_width, dst_height, dst_format, dst_stride, filter, keep_aspect, border_color);
+}
+
+AVI_FUNC size_t avi_scale_get_scratch_size(const avi_scale *sc)
+{
+	if (!sc) return 0;
+	if (sc->filter == AVI_SCALE_BILINEAR)
+	{
+		// 2 source rows and 1 destination row in BGRA8888
+		return ((size_t)sc->src_width * 2 + sc->pic_width) * 4;
+	}
+	return (size_t)sc->pic_width * avi_pixel_get_bytes_per_pixel(sc->src_format);
+}
+
+AVI_STATIC_FUNC const uint8_t *avi_scale_get_src_row(const avi_scale *sc, const uint8_t *src, uint32_t y)
+{
+	size_t row = sc->bottom_up ? sc->src_height - 1 - y : y;
+	return &src[row * sc->src_stride];
+}
+
+AVI_STATIC_FUNC void avi_scale_fill(uint8_t *dst, uint32_t color, uint32_t bpp, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		memcpy(dst, &color, bpp);
+		dst += bpp;
+	}
+}
+
+// Map the destination pixel to the source by the pixel centers, 16.16 fixed point, clamped to the source.
+AVI_STATIC_FUNC uint32_t avi_scale_map(uint32_t pos, uint32_t step, uint32_t src_size)
+{
+	int64_t v = (int64_t)pos * step + step / 2 - 0x8000;
+	int64_t max = (int64_t)(src_size - 1) << 16;
+	if (v < 0) return 0;
+	if (v > max) return (uint32_t)max;
+	return (uint32_t)v;
+}
+
+// The source pixel of the destination pixel for the nearest filter
+AVI_STATIC_FUNC uint32_t avi_scale_nearest_x(const avi_scale *sc, uint32_t x)
+{
+	uint32_t sx = (uint32_t)(((uint64_t)x * sc->step_x + sc->step_x / 2) >> 16);
+	return sx < sc->src_width ? sx : sc->src_width - 1;
+}
+
+#ifdef AVI_USE_SSE2
+AVI_STATIC_FUNC uint32_t avi_scale_load32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+AVI_STATIC_FUNC uint16_t avi_scale_load16(const uint8_t *p)
+{
+	uint16_t v;
+	memcpy(&v, p, 2);
+	return v;
+}
+
+// Gather the 16-bit and the 32-bit pixels 16 bytes at a time for the nearest filter.
+// Returns the number of pixels done, the rest are left for the portable loop.
+AVI_STATIC_FUNC uint32_t avi_scale_gather_sse2(const avi_scale *sc, const uint8_t *src_row, uint8_t *gather, uint32_t sbpp)
+{
+	uint32_t x = 0;
+	if (sbpp == 4)
+	{
+		for (; x + 4 <= sc->pic_width; x += 4)
+		{
+			__m128i v = _mm_setr_epi32(
+				(int)avi_scale_load32(&src_row[avi_scale_nearest_x(sc, x + 0) * 4]),
+				(int)avi_scale_load32(&src_row[avi_scale_nearest_x(sc, x + 1) * 4]),
+				(int)avi_scale_load32(&src_row[avi_scale_nearest_x(sc, x + 2) * 4]),
+				(int)avi_scale_load32(&src_row[avi_scale_nearest_x(sc, x + 3) * 4]));
+			_mm_storeu_si128((__m128i *)&gather[x * 4], v);
+		}
+	}
+	else if (sbpp == 2)
+	{
+		for (; x + 8 <= sc->pic_width; x += 8)
+		{
+			uint16_t p[8];
+			for (uint32_t i = 0; i < 8; i++) p[i] = avi_scale_load16(&src_row[avi_scale_nearest_x(sc, x + i) * 2]);
+			_mm_storeu_si128((__m128i *)&gather[x * 2], _mm_setr_epi16(
+				(short)p[0], (short)p[1], (short)p[2], (short)p[3], (short)p[4], (short)p[5], (short)p[6], (short)p[7]));
+		}
+	}
+	return x;
+}
+
+// Blend 2 pixels of 4 channels in 8.8 fixed point: `(p0 * (256 - w) + p1 * w + 0x80) >> 8`, the same math as the portable loop.
+AVI_STATIC_FUNC __m128i avi_scale_blend_sse2(__m128i p0, __m128i p1, __m128i w)
+{
+	__m128i iw = _mm_sub_epi16(_mm_set1_epi16(256), w);
+	__m128i v = _mm_add_epi16(_mm_mullo_epi16(p0, iw), _mm_mullo_epi16(p1, w));
+	return _mm_srli_epi16(_mm_add_epi16(v, _mm_set1_epi16(0x80)), 8);
+}
+
+// Blend 4 destination pixels at a time: horizontally in both of the source rows, then vertically.
+// The sums fit in 16 bits: 255 * 256 + 0x80.
+// Returns the number of pixels done, the rest are left for the portable loop.
+AVI_STATIC_FUNC uint32_t avi_scale_row_bilinear_sse2(const avi_scale *sc, const uint8_t *row0, const uint8_t *row1, uint32_t wy, uint8_t *out)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i wyv = _mm_set1_epi16((short)wy);
+	uint32_t x = 0;
+	for (; x + 4 <= sc->pic_width; x += 4)
+	{
+		uint32_t x0[4], x1[4];
+		uint16_t wx[4];
+		__m128i a0, a1, b0, b1, wlo, whi, lo, hi;
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			uint32_t fx = avi_scale_map(x + i, sc->step_x, sc->src_width);
+			x0[i] = (fx >> 16) * 4;
+			x1[i] = (fx >> 16) + 1 < sc->src_width ? x0[i] + 4 : x0[i];
+			wx[i] = (uint16_t)((fx >> 8) & 0xFF);
+		}
+		a0 = _mm_setr_epi32((int)avi_scale_load32(&row0[x0[0]]), (int)avi_scale_load32(&row0[x0[1]]), (int)avi_scale_load32(&row0[x0[2]]), (int)avi_scale_load32(&row0[x0[3]]));
+		a1 = _mm_setr_epi32((int)avi_scale_load32(&row0[x1[0]]), (int)avi_scale_load32(&row0[x1[1]]), (int)avi_scale_load32(&row0[x1[2]]), (int)avi_scale_load32(&row0[x1[3]]));
+		b0 = _mm_setr_epi32((int)avi_scale_load32(&row1[x0[0]]), (int)avi_scale_load32(&row1[x0[1]]), (int)avi_scale_load32(&row1[x0[2]]), (int)avi_scale_load32(&row1[x0[3]]));
+		b1 = _mm_setr_epi32((int)avi_scale_load32(&row1[x1[0]]), (int)avi_scale_load32(&row1[x1[1]]), (int)avi_scale_load32(&row1[x1[2]]), (int)avi_scale_load32(&row1[x1[3]]));
+		wlo = _mm_setr_epi16((short)wx[0], (short)wx[0], (short)wx[0], (short)wx[0], (short)wx[1], (short)wx[1], (short)wx[1], (short)wx[1]);
+		whi = _mm_setr_epi16((short)wx[2], (short)wx[2], (short)wx[2], (short)wx[2], (short)wx[3], (short)wx[3], (short)wx[3], (short)wx[3]);
+		lo = avi_scale_blend_sse2(
+			avi_scale_blend_sse2(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(a1, zero), wlo),
+			avi_scale_blend_sse2(_mm_unpacklo_epi8(b0, zero), _mm_unpacklo_epi8(b1, zero), wlo), wyv);
+		hi = avi_scale_blend_sse2(
+			avi_scale_blend_sse2(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(a1, zero), whi),
+			avi_scale_blend_sse2(_mm_unpackhi_epi8(b0, zero), _mm_unpackhi_epi8(b1, zero), whi), wyv);
+		_mm_storeu_si128((__m128i *)&out[x * 4], _mm_packus_epi16(lo, hi));
+	}
+	return x;
+}
+#endif
+
+AVI_STATIC_FUNC void avi_scale_row_nearest(const avi_scale *sc, const uint8_t *src_row, uint8_t *dst, uint8_t *scratch)
+{
+	uint32_t sbpp = avi_pixel_get_bytes_per_pixel(sc->src_format);
+	int same_format = sc->src_format == sc->dst_format;
+	uint8_t *gather = same_format ? dst : scratch;
+	uint32_t x = 0;
+#ifdef AVI_USE_SSE2
+	x = avi_scale_gather_sse2(sc, src_row, gather, sbpp);
+#endif
+	for (; x < sc->pic_width; x++)
+	{
+		uint32_t sx = avi_scale_nearest_x(sc, x);
+		switch (sbpp)
+		{
+		case 2: memcpy(&gather[x * 2], &src_row[sx * 2], 2); break;
+		case 3: memcpy(&gather[x * 3], &src_row[sx * 3], 3); break;
+		case 4: memcpy(&gather[x * 4], &src_row[sx * 4], 4); break;
+		}
+	}
+	if (!same_format) avi_pixel_convert(scratch, sc->src_format, (size_t)sc->pic_width * sbpp, 0, dst, sc->dst_format, sc->dst_stride, sc->pic_width, 1);
+}
+
+AVI_STATIC_FUNC void avi_scale_row_bilinear(const avi_scale *sc, const uint8_t *row0, const uint8_t *row1, uint32_t wy, uint8_t *dst, uint8_t *scratch)
+{
+	int direct = sc->dst_format == AVI_PIXEL_BGRA8888;
+	uint8_t *out = direct ? dst : scratch;
+	uint32_t x = 0;
+#ifdef AVI_USE_SSE2
+	x = avi_scale_row_bilinear_sse2(sc, row0, row1, wy, out);
+#endif
+	for (; x < sc->pic_width; x++)
+	{
+		uint32_t fx = avi_scale_map(x, sc->step_x, sc->src_width);
+		uint32_t x0 = fx >> 16;
+		uint32_t x1 = x0 + 1 < sc->src_width ? x0 + 1 : x0;
+		uint32_t wx = (fx >> 8) & 0xFF;
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			uint32_t top = (row0[x0 * 4 + c] * (256 - wx) + row0[x1 * 4 + c] * wx + 0x80) >> 8;
+			uint32_t bottom = (row1[x0 * 4 + c] * (256 - wx) + row1[x1 * 4 + c] * wx + 0x80) >> 8;
+			out[x * 4 + c] = (uint8_t)((top * (256 - wy) + bottom * wy + 0x80) >> 8);
+		}
+	}
+	if (!direct) avi_pixel_convert(scratch, AVI_PIXEL_BGRA8888, (size_t)sc->pic_width * 4, 0, dst, sc->dst_format, sc->dst_stride, sc->pic_width, 1);
+}
+
+AVI_FUNC int avi_scale_rows(const avi_scale *sc, const void *src, void *dst, uint32_t first_row, uint32_t end_row, void *scratch, size_t scratch_size)
+{
+	uint32_t dbpp;
+	uint8_t *row_buf[2];
+	uint32_t row_buf_y[2] = { UINT32_MAX, UINT32_MAX };
+	uint8_t *out_buf;
+	if (!sc || !src || !dst || !scratch) return 0;
+	if (scratch_size < avi_scale_get_scratch_size(sc)) return 0;
+	if (end_row > sc->dst_height) end_row = sc->dst_height;
+
+	dbpp = avi_pixel_get_bytes_per_pixel(sc->dst_format);
+	row_buf[0] = scratch;
+	row_buf[1] = row_buf[0] + (size_t)sc->src_width * 4;
+	out_buf = row_buf[1] + (size_t)sc->src_width * 4;
+
+	for (uint32_t y = first_row; y < end_row; y++)
+	{
+		uint8_t *dst_row = (uint8_t *)dst + (size_t)y * sc->dst_stride;
+		uint32_t py;
+		if (y < sc->pic_y || y >= sc->pic_y + sc->pic_height)
+		{
+			avi_scale_fill(dst_row, sc->border_color, dbpp, sc->dst_width);
+			continue;
+		}
+		avi_scale_fill(dst_row, sc->border_color, dbpp, sc->pic_x);
+		avi_scale_fill(dst_row + (size_t)(sc->pic_x + sc->pic_width) * dbpp, sc->border_color, dbpp, sc->dst_width - sc->pic_x - sc->pic_width);
+		dst_row += (size_t)sc->pic_x * dbpp;
+		py = y - sc->pic_y;
+
+		if (sc->filter == AVI_SCALE_NEAREST)
+		{
+			uint32_t sy = (uint32_t)(((uint64_t)py * sc->step_y + sc->step_y / 2) >> 16);
+			if (sy >= sc->src_height) sy = sc->src_height - 1;
+			avi_scale_row_nearest(sc, avi_scale_get_src_row(sc, src, sy), dst_row, scratch);
+		}
+		else
+		{
+			uint32_t fy = avi_scale_map(py, sc->step_y, sc->src_height);
+			uint32_t sy[2];
+			sy[0] = fy >> 16;
+			sy[1] = sy[0] + 1 < sc->src_height ? sy[0] + 1 : sy[0];
+
+			// The 2 source rows are converted to BGRA8888 once, and reused by the next destination rows.
+			if (row_buf_y[0] != sy[0])
+			{
+				if (row_buf_y[1] == sy[0])
+				{
+					uint8_t *t = row_buf[0];
+					row_buf[0] = row_buf[1];
+					row_buf[1] = t;
+					row_buf_y[1] = row_buf_y[0];
+				}
+				else
+				{
+					avi_pixel_convert(avi_scale_get_src_row(sc, src, sy[0]), sc->src_format, sc->src_stride, 0, row_buf[0], AVI_PIXEL_BGRA8888, (size_t)sc->src_width * 4, sc->src_width, 1);
+				}
+				row_buf_y[0] = sy[0];
+			}
+			if (sy[1] != sy[0] && row_buf_y[1] != sy[1])
+			{
+				avi_pixel_convert(avi_scale_get_src_row(sc, src, sy[1]), sc->src_format, sc->src_stride, 0, row_buf[1], AVI_PIXEL_BGRA8888, (size_t)sc->src_width * 4, sc->src_width, 1);
+				row_buf_y[1] = sy[1];
+			}
+			avi_scale_row_bilinear(sc, row_buf[0], sy[1] != sy[0] ? row_buf[1] : row_buf[0], (fy >> 8) & 0xFF, dst_row, out_buf);
+		}
+	}
+	return 1;
+}
+
+AVI_FUNC int avi_scale_frame(const avi_scale *sc, const void *src, void *dst, void *scratch, size_t scratch_size)
+{
+	if (!sc) return 0;
+	return avi_scale_rows(sc, src, dst, 0, sc->dst_height, scratch, scratch_size);
+}
@@ -0,0 +1,123 @@
+#ifndef _AVI_SCALE_H_
+#define _AVI_SCALE_H_ 1
+
+#include "avi_pixel.h"
+
+typedef enum
+{
+	AVI_SCALE_NEAREST = 0,
+	AVI_SCALE_BILINEAR = 1,
+}avi_scale_filter;
+
+/// <summary>
+/// Fits the frames of any size to your fixed size display: the picture is scaled, converted to the display format,
+/// and centered with the borders filled (letterbox or pillarbox), all in one pass over the destination rows.
+/// The rows could be done in separate calls, e.g. split the destination into bands for your threads or cores.
+/// </summary>
+typedef struct
+{
+	uint32_t src_width;
+	uint32_t src_height;
+	avi_pixel_format src_format;
+	size_t src_stride;
+	int bottom_up;
+
+	uint32_t dst_width;
+	uint32_t dst_height;
+	avi_pixel_format dst_format;
+	size_t dst_stride;
+
+	avi_scale_filter filter;
+
+	/// The picture area in the destination, the rest is the border.
+	uint32_t pic_x;
+	uint32_t pic_y;
+	uint32_t pic_width;
+	uint32_t pic_height;
+
+	/// The border color, packed by `avi_pixel_pack_color()`
+	uint32_t border_color;
+
+	/// The source pixels per destination pixel, 16.16 fixed point
+	uint32_t step_x;
+	uint32_t step_y;
+}avi_scale;
+
+/// <summary>
+/// Initialize the scaler.
+/// </summary>
+/// <param name="sc">Your `avi_scale` to be initialized</param>
+/// <param name="src_width">The source width in pixels</param>
+/// <param name="src_height">The source height in pixels</param>
+/// <param name="src_format">The source pixel format, any but `AVI_PIXEL_INDEX8`, expand the indexed color frames by `avi_pixel_expand_frame()` first.</param>
+/// <param name="src_stride">The bytes per row of the source</param>
+/// <param name="bottom_up">Nonzero if the first row of the source is the bottom row of the image</param>
+/// <param name="dst_width">The destination width in pixels</param>
+/// <param name="dst_height">The destination height in pixels</param>
+/// <param name="dst_format">The destination pixel format: `AVI_PIXEL_RGB565`, `AVI_PIXEL_BGRA8888`, or `AVI_PIXEL_RGBA8888`</param>
+/// <param name="dst_stride">The bytes per row of the destination</param>
+/// <param name="filter">`AVI_SCALE_NEAREST` or `AVI_SCALE_BILINEAR`</param>
+/// <param name="keep_aspect">Nonzero to keep the aspect ratio of the source with the borders, zero to stretch the picture to the whole destination.</param>
+/// <param name="border_color">The color of the borders</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_scale_init
+(
+	avi_scale *sc,
+	uint32_t src_width,
+	uint32_t src_height,
+	avi_pixel_format src_format,
+	size_t src_stride,
+	int bottom_up,
+	uint32_t dst_width,
+	uint32_t dst_height,
+	avi_pixel_format dst_format,
+	size_t dst_stride,
+	avi_scale_filter filter,
+	int keep_aspect,
+	palette_entry border_color
+);
+
+/// <summary>
+/// Initialize the scaler for the uncompressed frames of the stream, the source size, format, and orientation come from the stream format.
+/// The other parameters are the same as `avi_scale_init()`.
+/// </summary>
+/// <param name="s">Your stream reader of an uncompressed video stream, see `avi_pixel_get_stream_format()`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_scale_init_from_stream
+(
+	avi_scale *sc,
+	avi_stream_reader *s,
+	uint32_t dst_width,
+	uint32_t dst_height,
+	avi_pixel_format dst_format,
+	size_t dst_stride,
+	avi_scale_filter filter,
+	int keep_aspect,
+	palette_entry border_color
+);
+
+/// <summary>
+/// Get the size of the scratch buffer for `avi_scale_rows()`, each concurrent call needs its own scratch buffer.
+/// </summary>
+AVI_FUNC size_t avi_scale_get_scratch_size(const avi_scale *sc);
+
+/// <summary>
+/// Make the destination rows `[first_row, end_row)`.
+/// </summary>
+/// <param name="sc">Your `avi_scale`</param>
+/// <param name="src">The source frame</param>
+/// <param name="dst">Your destination buffer, the first row is the top row.</param>
+/// <param name="first_row">The first destination row to make</param>
+/// <param name="end_row">The end of the destination rows to make</param>
+/// <param name="scratch">Your scratch buffer, see `avi_scale_get_scratch_size()`</param>
+/// <param name="scratch_size">The size of the scratch buffer</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_scale_rows(const avi_scale *sc, const void *src, void *dst, uint32_t first_row, uint32_t end_row, void *scratch, size_t scratch_size);
+
+/// <summary>
+/// Make the whole destination, the same as `avi_scale_rows()` with all of the rows.
+/// </summary>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_scale_frame(const avi_scale *sc, const void *src, void *dst, void *scratch, size_t scratch_size);
+
+#endif
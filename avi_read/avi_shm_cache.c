@@ -0,0 +1,405 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L // shm_open(), ftruncate(), kill()
+#endif
+
+#include "avi_shm_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define AVI_SHM_WINDOWS 1
+#include <Windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#define AVI_SHM_POSIX 1
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define AVI_SHM_CACHE_MAGIC 0x43534641 // "AFSC"
+#define AVI_SHM_CACHE_VERSION 3
+
+// `is_ready` is the flag between the processes: the other fields must be visible before it on weakly ordered CPUs.
+AVI_STATIC_FUNC void avi_shm_cache_store_release(volatile uint32_t *p, uint32_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	__atomic_store_n(p, value, __ATOMIC_RELEASE);
+#elif defined(_WIN32)
+	MemoryBarrier();
+	*p = value;
+#else
+	*p = value;
+#endif
+}
+
+AVI_STATIC_FUNC uint32_t avi_shm_cache_load_acquire(const volatile uint32_t *p)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#elif defined(_WIN32)
+	uint32_t value = *p;
+	MemoryBarrier();
+	return value;
+#else
+	return *p;
+#endif
+}
+
+AVI_STATIC_FUNC int avi_shm_cache_is_valid(const avi_shm_cache_header *h, size_t mapped_size)
+{
+	if (mapped_size < sizeof *h) return 0;
+	if (!avi_shm_cache_load_acquire(&h->is_ready)) return 0;
+	if (h->magic != AVI_SHM_CACHE_MAGIC) return 0;
+	if (h->version != AVI_SHM_CACHE_VERSION) return 0;
+	if (h->header_size != sizeof *h) return 0;
+	if (h->stream_info_size != sizeof(avi_stream_info)) return 0;
+	if (h->total_size > mapped_size) return 0;
+	if (h->num_streams > AVI_MAX_STREAMS) return 0;
+	for (uint32_t i = 0; i < h->num_streams; i++)
+	{
+		uint64_t end = h->packet_table_offset[i] + h->packet_table_len[i] * sizeof(avi_packet_table_entry);
+		if (h->packet_table_offset[i] < sizeof *h || end > h->total_size) return 0;
+	}
+	return 1;
+}
+
+#if AVI_SHM_WINDOWS
+
+AVI_FUNC int avi_shm_cache_make_key(const char *path, char *key_out, size_t key_size)
+{
+	HANDLE hFile;
+	BY_HANDLE_FILE_INFORMATION info;
+	int ret;
+	if (!path || !key_out || !key_size) return 0;
+
+	hFile = CreateFileA(path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) return 0;
+	ret = GetFileInformationByHandle(hFile, &info);
+	CloseHandle(hFile);
+	if (!ret) return 0;
+
+	ret = snprintf(key_out, key_size, "Local\\avi_%08lx_%08lx%08lx_%08lx%08lx_%08lx%08lx",
+		info.dwVolumeSerialNumber,
+		info.nFileIndexHigh, info.nFileIndexLow,
+		info.nFileSizeHigh, info.nFileSizeLow,
+		info.ftLastWriteTime.dwHighDateTime, info.ftLastWriteTime.dwLowDateTime);
+	return ret > 0 && (size_t)ret < key_size;
+}
+
+AVI_STATIC_FUNC uint64_t avi_shm_cache_get_pid(void)
+{
+	return GetCurrentProcessId();
+}
+
+// The mapping object is gone with the last handle, even if the publisher crashed, so there's no stale segment on Windows.
+AVI_STATIC_FUNC int avi_shm_cache_create(avi_shm_cache *c, const char *key, size_t size)
+{
+	HANDLE hMapping;
+	void *view;
+	hMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, key);
+	if (!hMapping) return 0;
+	if (GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		CloseHandle(hMapping);
+		return 0;
+	}
+	view = MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, size);
+	if (!view)
+	{
+		CloseHandle(hMapping);
+		return 0;
+	}
+	c->header = view;
+	c->mapped_size = size;
+	c->os_handle = hMapping;
+	return 1;
+}
+
+AVI_STATIC_FUNC int avi_shm_cache_map(avi_shm_cache *c, const char *key)
+{
+	HANDLE hMapping;
+	const void *view;
+	MEMORY_BASIC_INFORMATION mbi;
+	hMapping = OpenFileMappingA(FILE_MAP_READ, FALSE, key);
+	if (!hMapping) return 0;
+	view = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view || !VirtualQuery(view, &mbi, sizeof mbi))
+	{
+		if (view) UnmapViewOfFile(view);
+		CloseHandle(hMapping);
+		return 0;
+	}
+	c->header = view;
+	c->mapped_size = mbi.RegionSize;
+	c->os_handle = hMapping;
+	return 1;
+}
+
+AVI_FUNC void avi_shm_cache_detach(avi_shm_cache *c)
+{
+	if (!c || !c->header) return;
+	UnmapViewOfFile(c->header);
+	CloseHandle((HANDLE)c->os_handle);
+	memset(c, 0, sizeof *c);
+}
+
+AVI_FUNC int avi_shm_cache_unlink(const char *key)
+{
+	// The mapping object is gone after the last handle was closed.
+	(void)key;
+	return 1;
+}
+
+#elif AVI_SHM_POSIX
+
+AVI_FUNC int avi_shm_cache_make_key(const char *path, char *key_out, size_t key_size)
+{
+	struct stat st;
+	int ret;
+	if (!path || !key_out || !key_size) return 0;
+	if (stat(path, &st)) return 0;
+
+	// The name must start with a slash and contain no other slashes.
+	ret = snprintf(key_out, key_size, "/avi_%llx_%llx_%llx_%llx",
+		(unsigned long long)st.st_dev,
+		(unsigned long long)st.st_ino,
+		(unsigned long long)st.st_size,
+		(unsigned long long)st.st_mtime);
+	return ret > 0 && (size_t)ret < key_size;
+}
+
+AVI_STATIC_FUNC uint64_t avi_shm_cache_get_pid(void)
+{
+	return (uint64_t)getpid();
+}
+
+// Check if the existing segment was left by a publisher that crashed before it was ready.
+AVI_STATIC_FUNC int avi_shm_cache_is_stale(const char *key)
+{
+	int fd;
+	struct stat st;
+	const avi_shm_cache_header *h;
+	int is_stale = 0;
+	fd = shm_open(key, O_RDONLY, 0);
+	if (fd < 0) return 0;
+	if (fstat(fd, &st))
+	{
+		close(fd);
+		return 0;
+	}
+	if ((size_t)st.st_size < sizeof *h)
+	{
+		// The publisher hasn't set the size yet.
+		is_stale = time(NULL) - st.st_mtime > AVI_SHM_CACHE_STALE_SECONDS;
+		close(fd);
+		return is_stale;
+	}
+	h = mmap(NULL, sizeof *h, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (h == MAP_FAILED) return 0;
+	if (!avi_shm_cache_load_acquire(&h->is_ready))
+	{
+		if (h->publisher_pid)
+			is_stale = kill((pid_t)h->publisher_pid, 0) == -1 && errno == ESRCH;
+		else
+			is_stale = time(NULL) - st.st_mtime > AVI_SHM_CACHE_STALE_SECONDS;
+	}
+	munmap((void *)h, sizeof *h);
+	return is_stale;
+}
+
+AVI_STATIC_FUNC int avi_shm_cache_create(avi_shm_cache *c, const char *key, size_t size)
+{
+	int fd;
+	void *view;
+	fd = shm_open(key, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd < 0 && errno == EEXIST && avi_shm_cache_is_stale(key))
+	{
+		shm_unlink(key);
+		fd = shm_open(key, O_RDWR | O_CREAT | O_EXCL, 0644);
+	}
+	if (fd < 0) return 0;
+	if (ftruncate(fd, (off_t)size)) goto ErrRet;
+	view = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (view == MAP_FAILED) goto ErrRet;
+	close(fd);
+	c->header = view;
+	c->mapped_size = size;
+	c->os_handle = NULL;
+	return 1;
+ErrRet:
+	close(fd);
+	shm_unlink(key);
+	return 0;
+}
+
+AVI_STATIC_FUNC int avi_shm_cache_map(avi_shm_cache *c, const char *key)
+{
+	int fd;
+	struct stat st;
+	void *view;
+	fd = shm_open(key, O_RDONLY, 0);
+	if (fd < 0) return 0;
+	if (fstat(fd, &st) || st.st_size <= 0) goto ErrRet;
+	view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (view == MAP_FAILED) goto ErrRet;
+	close(fd);
+	c->header = view;
+	c->mapped_size = (size_t)st.st_size;
+	c->os_handle = NULL;
+	return 1;
+ErrRet:
+	close(fd);
+	return 0;
+}
+
+AVI_FUNC void avi_shm_cache_detach(avi_shm_cache *c)
+{
+	if (!c || !c->header) return;
+	munmap((void *)c->header, c->mapped_size);
+	memset(c, 0, sizeof *c);
+}
+
+AVI_FUNC int avi_shm_cache_unlink(const char *key)
+{
+	if (!key) return 0;
+	return shm_unlink(key) == 0;
+}
+
+#else
+
+// No shared memory on this platform, every process parses the AVI file by itself.
+AVI_STATIC_FUNC uint64_t avi_shm_cache_get_pid(void) { return 0; }
+AVI_FUNC int avi_shm_cache_make_key(const char *path, char *key_out, size_t key_size) { (void)path; (void)key_out; (void)key_size; return 0; }
+AVI_STATIC_FUNC int avi_shm_cache_create(avi_shm_cache *c, const char *key, size_t size) { (void)c; (void)key; (void)size; return 0; }
+AVI_STATIC_FUNC int avi_shm_cache_map(avi_shm_cache *c, const char *key) { (void)c; (void)key; return 0; }
+AVI_FUNC void avi_shm_cache_detach(avi_shm_cache *c) { if (c) memset(c, 0, sizeof *c); }
+AVI_FUNC int avi_shm_cache_unlink(const char *key) { (void)key; return 0; }
+
+#endif
+
+AVI_FUNC int avi_shm_cache_attach(avi_shm_cache *c, const char *key)
+{
+	if (!c || !key) return 0;
+	memset(c, 0, sizeof *c);
+	if (!avi_shm_cache_map(c, key)) return 0;
+	if (!avi_shm_cache_is_valid(c->header, c->mapped_size))
+	{
+		avi_shm_cache_detach(c);
+		return 0;
+	}
+	return 1;
+}
+
+AVI_FUNC int avi_shm_cache_publish(avi_shm_cache *c, const char *key, avi_reader *r)
+{
+	avi_stream_reader s;
+	avi_shm_cache_header *h;
+	fsize_t table_len[AVI_MAX_STREAMS];
+	uint64_t total_size = sizeof *h;
+	if (!c || !key || !r) return 0;
+	if (!r->is_init_done) return 0;
+	memset(c, 0, sizeof *c);
+
+	// Count the packets first to know the size of the segment.
+	for (uint32_t i = 0; i < r->num_streams; i++)
+	{
+		if (!avi_get_stream_reader(r, r->userdata, i, NULL, NULL, NULL, NULL, &s)) return 0;
+		if (!avi_stream_reader_build_packet_table(&s, NULL, 0, &table_len[i])) return 0;
+		total_size += (uint64_t)table_len[i] * sizeof(avi_packet_table_entry);
+	}
+	if (total_size != (size_t)total_size) return 0;
+	if (!avi_shm_cache_create(c, key, (size_t)total_size)) return 0;
+	c->is_publisher = 1;
+
+	h = (avi_shm_cache_header *)c->header;
+	memset(h, 0, sizeof *h);
+	h->publisher_pid = avi_shm_cache_get_pid();
+	h->magic = AVI_SHM_CACHE_MAGIC;
+	h->version = AVI_SHM_CACHE_VERSION;
+	h->header_size = sizeof *h;
+	h->stream_info_size = sizeof(avi_stream_info);
+	h->num_streams = r->num_streams;
+	h->total_size = total_size;
+	h->end_of_file = r->end_of_file;
+	h->stream_data_offset = r->stream_data_offset;
+	h->idx1_offset = r->idx1_offset;
+	h->num_indices = r->num_indices;
+	h->num_movi_ranges = r->num_movi_ranges;
+	h->odml_total_frames = r->odml_total_frames;
+	memcpy(h->movi_ranges, r->movi_ranges, sizeof h->movi_ranges);
+	h->avih = r->avih;
+	memcpy(h->stream_info, r->avi_stream_info, sizeof h->stream_info);
+
+	total_size = sizeof *h;
+	for (uint32_t i = 0; i < r->num_streams; i++)
+	{
+		fsize_t num_entries;
+		h->packet_table_offset[i] = total_size;
+		h->packet_table_len[i] = table_len[i];
+		if (!avi_get_stream_reader(r, r->userdata, i, NULL, NULL, NULL, NULL, &s)) goto ErrRet;
+		if (!avi_stream_reader_build_packet_table(&s, (avi_packet_table_entry *)((uint8_t *)h + total_size), table_len[i], &num_entries)) goto ErrRet;
+		if (num_entries != table_len[i]) goto ErrRet;
+		total_size += (uint64_t)table_len[i] * sizeof(avi_packet_table_entry);
+	}
+
+	// The attaching processes check this first.
+	avi_shm_cache_store_release(&h->is_ready, 1);
+	return 1;
+ErrRet:
+	avi_shm_cache_detach(c);
+	avi_shm_cache_unlink(key);
+	return 0;
+}
+
+AVI_FUNC int avi_shm_cache_init_reader
+(
+	avi_shm_cache *c,
+	avi_reader *r,
+	void *userdata,
+	read_cb f_read,
+	seek_cb f_seek,
+	tell_cb f_tell,
+	logprintf_cb f_logprintf,
+	avi_logprintf_level log_level
+)
+{
+	const avi_shm_cache_header *h;
+	if (!c || !c->header) return 0;
+	h = c->header;
+
+	// Check the file with its `RIFF` header, then take the rest from the segment.
+	if (!avi_reader_init_begin(r, userdata, f_read, f_seek, f_tell, f_logprintf, log_level)) return 0;
+	if (r->end_of_file != h->end_of_file) return 0;
+
+	r->avih = h->avih;
+	r->num_streams = h->num_streams;
+	memcpy(r->avi_stream_info, h->stream_info, sizeof r->avi_stream_info);
+	r->stream_data_offset = (fsize_t)h->stream_data_offset;
+	r->idx1_offset = (fsize_t)h->idx1_offset;
+	r->num_indices = (fsize_t)h->num_indices;
+	r->num_movi_ranges = h->num_movi_ranges;
+	r->odml_total_frames = h->odml_total_frames;
+	memcpy(r->movi_ranges, h->movi_ranges, sizeof r->movi_ranges);
+	r->is_first_riff_done = 1;
+	r->is_init_done = 1;
+	return 1;
+}
+
+AVI_FUNC int avi_shm_cache_use_for_stream(avi_shm_cache *c, avi_stream_reader *s)
+{
+	const avi_shm_cache_header *h;
+	if (!c || !c->header || !s) return 0;
+	h = c->header;
+	if (s->stream_id < 0 || (uint32_t)s->stream_id >= h->num_streams) return 0;
+
+	avi_stream_reader_use_packet_table(s,
+		(const avi_packet_table_entry *)((const uint8_t *)h + h->packet_table_offset[s->stream_id]),
+		(fsize_t)h->packet_table_len[s->stream_id]);
+	return 1;
+}
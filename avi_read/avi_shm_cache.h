@@ -0,0 +1,137 @@
+#ifndef _AVI_SHM_CACHE_H_
+#define _AVI_SHM_CACHE_H_ 1
+
+#include "avi_reader.h"
+
+#ifndef AVI_SHM_CACHE_MAX_KEY
+#define AVI_SHM_CACHE_MAX_KEY 128
+#endif
+
+/// <summary>
+/// On POSIX systems, a segment that is not ready and has no publisher PID after this many seconds is treated as left by a crashed publisher.
+/// </summary>
+#ifndef AVI_SHM_CACHE_STALE_SECONDS
+#define AVI_SHM_CACHE_STALE_SECONDS 10
+#endif
+
+/// <summary>
+/// The layout of the shared memory segment. The packet tables of the streams follow the header.
+/// Only the processes built with the same configuration (e.g. `AVI_ENABLE_4GB_FILES`, `AVI_MAX_STREAMS`) could share the segment, this is checked by the sizes.
+/// </summary>
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t stream_info_size;
+
+	/// Set by the publisher with a release store after everything else was written, read with an acquire load before anything else.
+	volatile uint32_t is_ready;
+	uint32_t num_streams;
+	uint64_t total_size;
+
+	/// The process that is publishing the segment, to find out the segments left by a crashed publisher.
+	uint64_t publisher_pid;
+
+	/// The parsed `avi_reader` fields
+	uint64_t end_of_file;
+	uint64_t stream_data_offset;
+	uint64_t idx1_offset;
+	uint64_t num_indices;
+	uint32_t num_movi_ranges;
+	uint32_t odml_total_frames;
+	avi_movi_range movi_ranges[AVI_MAX_RIFF_CHUNKS];
+	avi_main_header avih;
+	avi_stream_info stream_info[AVI_MAX_STREAMS];
+
+	/// The packet table of each stream, the offset is relative to the start of the segment.
+	uint64_t packet_table_offset[AVI_MAX_STREAMS];
+	uint64_t packet_table_len[AVI_MAX_STREAMS];
+}avi_shm_cache_header;
+
+/// <summary>
+/// A mapped shared memory segment that stores the parsed header and the packet tables of an AVI file.
+/// The first process that opens the file publishes it, the other processes map it read-only and skip the parsing.
+/// </summary>
+typedef struct
+{
+	/// The mapped segment.
+	const avi_shm_cache_header *header;
+	size_t mapped_size;
+
+	/// The OS handle of the segment.
+	void *os_handle;
+
+	/// Nonzero if this process created the segment.
+	int is_publisher;
+}avi_shm_cache;
+
+/// <summary>
+/// Make the name of the shared memory segment from the identity of the file: device, inode (file index on Windows), size and modification time.
+/// A modified file gets a different key, so a stale segment is never used.
+/// </summary>
+/// <param name="path">The path to the AVI file</param>
+/// <param name="key_out">Your buffer to receive the key</param>
+/// <param name="key_size">The size of your buffer, `AVI_SHM_CACHE_MAX_KEY` is enough.</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_shm_cache_make_key(const char *path, char *key_out, size_t key_size);
+
+/// <summary>
+/// Map an existing segment read-only.
+/// </summary>
+/// <param name="c">Your `avi_shm_cache` to be initialized</param>
+/// <param name="key">The key from `avi_shm_cache_make_key()`</param>
+/// <returns>0 if the segment doesn't exist, isn't ready yet or is incompatible. Nonzero for success.</returns>
+AVI_FUNC int avi_shm_cache_attach(avi_shm_cache *c, const char *key);
+
+/// <summary>
+/// Build the packet tables of every stream of your initialized `avi_reader` and publish them with the parsed header into a new segment.
+/// On Windows, the segment exists while any process keeps it mapped, so the publisher should keep it until it's done with the file.
+/// On POSIX systems, the segment exists until `avi_shm_cache_unlink()` is called. If a publisher crashed before the segment was ready,
+/// the next publisher finds out by the publisher PID (or by `AVI_SHM_CACHE_STALE_SECONDS` if the PID wasn't written yet), then unlinks it and creates it again.
+/// </summary>
+/// <param name="c">Your `avi_shm_cache` to be initialized</param>
+/// <param name="key">The key from `avi_shm_cache_make_key()`</param>
+/// <param name="r">Your initialized `avi_reader`</param>
+/// <returns>0 for fail, including another process is publishing the same key. Nonzero for success.</returns>
+AVI_FUNC int avi_shm_cache_publish(avi_shm_cache *c, const char *key, avi_reader *r);
+
+/// <summary>
+/// Initialize the `avi_reader` from the segment instead of parsing the AVI file. Only the `RIFF` header is read to check the file.
+/// The parameters are the same as `avi_reader_init()`.
+/// </summary>
+/// <returns>0 for fail (e.g. the file doesn't match the segment), nonzero for success.</returns>
+AVI_FUNC int avi_shm_cache_init_reader
+(
+	avi_shm_cache *c,
+	avi_reader *r,
+	void *userdata,
+	read_cb f_read,
+	seek_cb f_seek,
+	tell_cb f_tell,
+	logprintf_cb f_logprintf,
+	avi_logprintf_level log_level
+);
+
+/// <summary>
+/// Let your stream reader use the packet table in the segment, see `avi_stream_reader_use_packet_table()`.
+/// </summary>
+/// <param name="c">The mapped segment</param>
+/// <param name="s">Your stream reader created by `avi_get_stream_reader()`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_shm_cache_use_for_stream(avi_shm_cache *c, avi_stream_reader *s);
+
+/// <summary>
+/// Unmap the segment. The stream readers using it must not be used after this.
+/// </summary>
+/// <param name="c">The mapped segment</param>
+AVI_FUNC void avi_shm_cache_detach(avi_shm_cache *c);
+
+/// <summary>
+/// Remove the segment from the system, the mapped ones are still usable. Does nothing on Windows.
+/// </summary>
+/// <param name="key">The key from `avi_shm_cache_make_key()`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_shm_cache_unlink(const char *key);
+
+#endif
@@ -0,0 +1,233 @@
+#include "avi_thumbs.h"
+
+#include <string.h>
+
+AVI_STATIC_FUNC void avi_thumbs_lock(avi_thumbs *t)
+{
+	if (t->f_lock) t->f_lock(t->userdata);
+}
+
+AVI_STATIC_FUNC void avi_thumbs_unlock(avi_thumbs *t)
+{
+	if (t->f_unlock) t->f_unlock(t->userdata);
+}
+
+// Insertion sort, keeps the order of the equal thumbnails. The number of thumbnails is small.
+AVI_STATIC_FUNC void avi_thumbs_sort(avi_thumb *thumbs, uint32_t num_thumbs, int by_offset)
+{
+	for (uint32_t i = 1; i < num_thumbs; i++)
+	{
+		avi_thumb cur = thumbs[i];
+		fsize_t key = by_offset ? cur.offset : cur.target_frame;
+		uint32_t j = i;
+		while (j && (by_offset ? thumbs[j - 1].offset : thumbs[j - 1].target_frame) > key)
+		{
+			thumbs[j] = thumbs[j - 1];
+			j--;
+		}
+		thumbs[j] = cur;
+	}
+}
+
+// Walks the packets of a stream by the stream reader, from the first one. The stream reader reads the `idx1` entries in blocks.
+typedef struct
+{
+	avi_stream_reader *s;
+	avi_stream_position saved;
+	int mute;
+
+	/// The current packet
+	fsize_t frame_index;
+	fsize_t offset;
+	fsize_t length;
+	int is_keyframe;
+}avi_thumbs_scan;
+
+AVI_STATIC_FUNC void avi_thumbs_scan_begin(avi_thumbs_scan *sc, avi_stream_reader *s)
+{
+	avi_stream_position rewind = { 0 };
+	sc->s = s;
+
+	avi_stream_reader_get_position(s, &sc->saved);
+	sc->mute = s->mute_cur_stream_debug_print;
+	s->mute_cur_stream_debug_print = 1;
+	avi_stream_reader_set_position(s, &rewind);
+}
+
+AVI_STATIC_FUNC int avi_thumbs_scan_next(avi_thumbs_scan *sc)
+{
+	avi_stream_reader *s = sc->s;
+	if (!avi_stream_reader_move_to_next_packet(s, 0)) return 0;
+	sc->frame_index = s->cur_stream_packet_index;
+	sc->offset = s->cur_packet_offset;
+	sc->length = s->cur_packet_len;
+	sc->is_keyframe = s->cur_packet_is_keyframe;
+	return 1;
+}
+
+AVI_STATIC_FUNC void avi_thumbs_scan_end(avi_thumbs_scan *sc)
+{
+	avi_stream_reader_set_position(sc->s, &sc->saved);
+	sc->s->mute_cur_stream_debug_print = sc->mute;
+}
+
+AVI_STATIC_FUNC void avi_thumbs_pick(avi_thumb *thumb, const avi_thumbs_scan *sc)
+{
+	thumb->frame_index = sc->frame_index;
+	thumb->offset = sc->offset;
+	thumb->length = sc->length;
+}
+
+AVI_FUNC int avi_thumbs_locate(avi_stream_reader *s, avi_thumb *thumbs, uint32_t num_thumbs)
+{
+	avi_thumbs_scan sc;
+	avi_thumb prev_key = { 0 };
+	int has_prev_key = 0;
+	uint32_t i = 0;
+	if (!s || !s->r || !thumbs || !num_thumbs) return 0;
+
+	for (uint32_t j = 0; j < num_thumbs; j++) thumbs[j].order = j;
+	avi_thumbs_sort(thumbs, num_thumbs, 0);
+
+	avi_thumbs_scan_begin(&sc, s);
+
+	// The targets are sorted, every target is between the previous key frame and the current one.
+	while (i < num_thumbs && avi_thumbs_scan_next(&sc))
+	{
+		fsize_t cur = sc.frame_index;
+		if (!sc.is_keyframe || !sc.length) continue;
+		for (; i < num_thumbs && thumbs[i].target_frame <= cur; i++)
+		{
+			avi_thumb *thumb = &thumbs[i];
+			if (has_prev_key && thumb->target_frame - prev_key.frame_index <= cur - thumb->target_frame)
+			{
+				thumb->frame_index = prev_key.frame_index;
+				thumb->offset = prev_key.offset;
+				thumb->length = prev_key.length;
+			}
+			else
+			{
+				avi_thumbs_pick(thumb, &sc);
+			}
+		}
+		avi_thumbs_pick(&prev_key, &sc);
+		has_prev_key = 1;
+	}
+
+	avi_thumbs_scan_end(&sc);
+	if (!has_prev_key) return 0;
+
+	// The targets after the last key frame
+	for (; i < num_thumbs; i++)
+	{
+		thumbs[i].frame_index = prev_key.frame_index;
+		thumbs[i].offset = prev_key.offset;
+		thumbs[i].length = prev_key.length;
+	}
+
+	avi_thumbs_sort(thumbs, num_thumbs, 1);
+	return 1;
+}
+
+AVI_FUNC int avi_thumbs_locate_evenly(avi_stream_reader *s, avi_thumb *thumbs, uint32_t num_thumbs)
+{
+	uint64_t num_frames;
+	if (!s || !s->r || !s->stream_info || !thumbs || !num_thumbs) return 0;
+
+	num_frames = s->stream_info->stream_header.dwLength;
+	if (!num_frames) num_frames = s->packet_table_len;
+	if (!num_frames)
+	{
+		avi_thumbs_scan sc;
+		avi_thumbs_scan_begin(&sc, s);
+		while (avi_thumbs_scan_next(&sc)) num_frames++;
+		avi_thumbs_scan_end(&sc);
+	}
+
+	for (uint32_t i = 0; i < num_thumbs; i++)
+	{
+		thumbs[i].target_frame = (fsize_t)((2 * (uint64_t)i + 1) * num_frames / (2 * (uint64_t)num_thumbs));
+	}
+	return avi_thumbs_locate(s, thumbs, num_thumbs);
+}
+
+AVI_FUNC int avi_thumbs_init
+(
+	avi_thumbs *t,
+	avi_thumb *thumbs,
+	uint32_t num_thumbs,
+	avi_thumb_decode_cb f_decode,
+	void *userdata,
+	avi_lock_cb f_lock,
+	avi_lock_cb f_unlock
+)
+{
+	if (!t) return 0;
+	if (!thumbs && num_thumbs) return 0;
+	if (!f_decode) return 0;
+	if (!f_lock != !f_unlock) return 0;
+
+	memset(t, 0, sizeof *t);
+	t->thumbs = thumbs;
+	t->num_thumbs = num_thumbs;
+	t->f_decode = f_decode;
+	t->userdata = userdata;
+	t->f_lock = f_lock;
+	t->f_unlock = f_unlock;
+	return 1;
+}
+
+AVI_FUNC uint32_t avi_thumbs_work(avi_thumbs *t, avi_stream_reader *s, void *buffer, size_t buffer_size)
+{
+	uint8_t *span = buffer;
+	uint32_t first, end, num_ok = 0;
+	fsize_t span_start, span_end;
+	if (!t || !s || !buffer) return 0;
+
+	// Take the next thumbnails as long as they fit in the buffer with small gaps between them.
+	avi_thumbs_lock(t);
+	first = end = t->next;
+	span_start = span_end = first < t->num_thumbs ? t->thumbs[first].offset : 0;
+	while (end < t->num_thumbs && end - first < AVI_THUMBS_MAX_SPAN)
+	{
+		const avi_thumb *thumb = &t->thumbs[end];
+		if (thumb->offset + thumb->length - span_start > buffer_size)
+		{
+			// A key frame bigger than the buffer is taken alone to fail.
+			if (end == first) end++;
+			break;
+		}
+		if (thumb->offset > span_end && thumb->offset - span_end > AVI_THUMBS_MAX_GAP) break;
+		if (thumb->offset + thumb->length > span_end) span_end = thumb->offset + thumb->length;
+		end++;
+	}
+	t->next = end;
+	avi_thumbs_unlock(t);
+	if (first == end) return 0;
+
+	if (span_end > span_start &&
+		avi_stream_reader_read_at(s, span_start, span, span_end - span_start, AVI_IO_PAYLOAD) == (fssize_t)(span_end - span_start))
+	{
+		for (uint32_t i = first; i < end; i++)
+		{
+			const avi_thumb *thumb = &t->thumbs[i];
+			if (t->f_decode(span + (thumb->offset - span_start), thumb->length, thumb, t->userdata)) num_ok++;
+		}
+	}
+
+	avi_thumbs_lock(t);
+	t->num_done += end - first;
+	t->num_failed += end - first - num_ok;
+	avi_thumbs_unlock(t);
+	return end - first;
+}
+
+AVI_FUNC int avi_thumbs_is_finished(avi_thumbs *t)
+{
+	int ret;
+	if (!t) return 1;
+	avi_thumbs_lock(t);
+	ret = t->num_done == t->num_thumbs;
+	avi_thumbs_unlock(t);
+	return ret;
+}
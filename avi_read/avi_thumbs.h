@@ -0,0 +1,130 @@
+#ifndef _AVI_THUMBS_H_
+#define _AVI_THUMBS_H_ 1
+
+#include "avi_pipeline.h"
+
+/// <summary>
+/// The nearby key frames are read by one `f_read()` if the gap between them is not bigger than this.
+/// </summary>
+#ifndef AVI_THUMBS_MAX_GAP
+#define AVI_THUMBS_MAX_GAP 65536
+#endif
+
+/// <summary>
+/// The limit of the number of thumbnails read by one `f_read()`.
+/// </summary>
+#ifndef AVI_THUMBS_MAX_SPAN
+#define AVI_THUMBS_MAX_SPAN 16
+#endif
+
+/// <summary>
+/// A thumbnail: the key frame nearest to the target frame.
+/// </summary>
+typedef struct
+{
+	/// The frame you want, set it before calling `avi_thumbs_locate()`.
+	fsize_t target_frame;
+
+	/// The position of the thumbnail in your request, the thumbnails are sorted by `avi_thumbs_locate()`.
+	uint32_t order;
+
+	/// The key frame picked for the target
+	fsize_t frame_index;
+	fsize_t offset;
+	fsize_t length;
+}avi_thumb;
+
+/// <summary>
+/// Decode a thumbnail, called by your worker threads concurrently, without holding the lock.
+/// </summary>
+/// <param name="packet_data">The payload of the key frame</param>
+/// <param name="packet_len">The length of the payload</param>
+/// <param name="thumb">The thumbnail, use its `order` to find your output buffer</param>
+/// <param name="userdata">The data you passed to `avi_thumbs_init()`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+typedef int(*avi_thumb_decode_cb)(const void *packet_data, fsize_t packet_len, const avi_thumb *thumb, void *userdata);
+
+/// <summary>
+/// Hands the located thumbnails to your workers in the order of the file. Each worker reads a batch of nearby key frames by one `f_read()`, then decodes them.
+/// Like `avi_pipeline`, it has no threads by itself and never allocates memory.
+/// </summary>
+typedef struct
+{
+	avi_thumb *thumbs;
+	uint32_t num_thumbs;
+
+	void *userdata; /// The data to pass to your callback functions.
+	avi_thumb_decode_cb f_decode;
+	avi_lock_cb f_lock;
+	avi_lock_cb f_unlock;
+
+	/// The next thumbnail to be taken by a worker
+	uint32_t next;
+
+	/// Number of thumbnails processed, and the ones failed to read or decode.
+	uint32_t num_done;
+	uint32_t num_failed;
+}avi_thumbs;
+
+/// <summary>
+/// Pick the key frame nearest to the `target_frame` of each thumbnail by walking through the index of the stream once, the payloads are not read.
+/// The walk stops after the last target. The stream reader reads the `idx1` entries in blocks of `AVI_IDX1_BLOCK_ENTRIES`, the packet table and the OpenDML index cache are used as they are.
+/// Then the thumbnails are sorted by their offsets in the file, the same key frame could be picked by more than one thumbnail.
+/// The stream reader's position is restored.
+/// </summary>
+/// <param name="s">Your stream reader of a video stream</param>
+/// <param name="thumbs">Your thumbnails with `target_frame` set</param>
+/// <param name="num_thumbs">Number of thumbnails</param>
+/// <returns>0 for fail (including no key frame), nonzero for success.</returns>
+AVI_FUNC int avi_thumbs_locate(avi_stream_reader *s, avi_thumb *thumbs, uint32_t num_thumbs);
+
+/// <summary>
+/// Set the `target_frame` of the thumbnails evenly spaced over the stream, the middle of each of `num_thumbs` parts, then call `avi_thumbs_locate()`.
+/// The number of frames comes from the stream header or the packet table, or counted by walking through the index the same way if neither tells it.
+/// </summary>
+/// <param name="s">Your stream reader of a video stream</param>
+/// <param name="thumbs">Your thumbnails to receive the results</param>
+/// <param name="num_thumbs">Number of thumbnails</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_thumbs_locate_evenly(avi_stream_reader *s, avi_thumb *thumbs, uint32_t num_thumbs);
+
+/// <summary>
+/// Initialize the work queue of the located thumbnails.
+/// </summary>
+/// <param name="t">Your `avi_thumbs` to be initialized</param>
+/// <param name="thumbs">The thumbnails located by `avi_thumbs_locate()`</param>
+/// <param name="num_thumbs">Number of thumbnails</param>
+/// <param name="f_decode">Your function to decode a thumbnail</param>
+/// <param name="userdata">The data to pass to your callback functions</param>
+/// <param name="f_lock">Your mutex lock function. Passing NULL is allowed if you use it in one thread.</param>
+/// <param name="f_unlock">Your mutex unlock function. Passing NULL is allowed if you use it in one thread.</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_thumbs_init
+(
+	avi_thumbs *t,
+	avi_thumb *thumbs,
+	uint32_t num_thumbs,
+	avi_thumb_decode_cb f_decode,
+	void *userdata,
+	avi_lock_cb f_lock,
+	avi_lock_cb f_unlock
+);
+
+/// <summary>
+/// Take a batch of the nearby thumbnails, read them by one `f_read()` of the stream reader, then decode them. Call it from your worker threads until it returns 0.
+/// </summary>
+/// <param name="t">Your `avi_thumbs`</param>
+/// <param name="s">The stream reader of this worker, only its `f_seek()` and `f_read()` are used, give each worker its own file handle.</param>
+/// <param name="buffer">Your buffer for reading the key frames, must be bigger than any key frame, bigger is better</param>
+/// <param name="buffer_size">The size of `buffer`</param>
+/// <returns>Number of thumbnails processed, 0 if there's nothing to do.</returns>
+AVI_FUNC uint32_t avi_thumbs_work(avi_thumbs *t, avi_stream_reader *s, void *buffer, size_t buffer_size);
+
+/// <summary>
+/// Check if all of the thumbnails were processed.
+/// </summary>
+/// <param name="t">Your `avi_thumbs`</param>
+/// <returns>Nonzero if finished.</returns>
+AVI_FUNC int avi_thumbs_is_finished(avi_thumbs *t);
+
+#endif
@@ -0,0 +1,410 @@
+#include "avi_trim.h"
+
+#include <string.h>
+
+#define WAVE_FORMAT_PCM 1
+
+/// `value * mul / div` with the 128-bit product, so it doesn't overflow for big rates and scales. The result is clamped to `UINT64_MAX`.
+AVI_STATIC_FUNC uint64_t avi_trim_mul_div(uint64_t value, uint64_t mul, uint64_t div)
+{
+	uint64_t lo_lo = (value & 0xFFFFFFFF) * (mul & 0xFFFFFFFF);
+	uint64_t hi_lo = (value >> 32) * (mul & 0xFFFFFFFF);
+	uint64_t lo_hi = (value & 0xFFFFFFFF) * (mul >> 32);
+	uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+	uint64_t hi = (value >> 32) * (mul >> 32) + (hi_lo >> 32) + (cross >> 32);
+	uint64_t lo = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+	uint64_t quotient = 0;
+	if (!div || hi >= div) return UINT64_MAX;
+
+	// Long division, the remainder `hi` stays below `div`.
+	for (int i = 63; i >= 0; i--)
+	{
+		uint64_t carry = hi >> 63;
+		hi = (hi << 1) | ((lo >> i) & 1);
+		quotient <<= 1;
+		if (carry || hi >= div)
+		{
+			hi -= div;
+			quotient |= 1;
+		}
+	}
+	return quotient;
+}
+
+AVI_STATIC_FUNC uint64_t avi_trim_mul_div_ceil(uint64_t value, uint64_t mul, uint64_t div)
+{
+	uint64_t ret = avi_trim_mul_div(value, mul, div);
+	if (avi_trim_mul_div(ret, div, mul) < value) ret++;
+	return ret;
+}
+
+AVI_STATIC_FUNC int avi_trim_is_done(avi_trim_stream *ts)
+{
+	avi_stream_reader *s = &ts->s;
+	if (s->is_no_more_packets) return 1;
+	if (ts->is_audio) return s->cur_stream_byte_offset >= ts->end_byte;
+	return s->cur_stream_packet_index >= ts->end_packet;
+}
+
+/// Move the stream reader to the first packet of the range.
+AVI_STATIC_FUNC void avi_trim_seek_stream(avi_trim_stream *ts, int snap_to_keyframe)
+{
+	avi_stream_reader *s = &ts->s;
+	ts->is_active = 0;
+	if (!avi_stream_reader_move_to_next_packet(s, 0)) return;
+	if (ts->is_audio)
+	{
+		if (!avi_audio_seek_to_byte_offset(s, (fsize_t)ts->start_byte, 0)) return;
+	}
+	else
+	{
+		if (!avi_video_seek_to_frame_index(s, ts->start_packet, 0)) return;
+		if (snap_to_keyframe)
+		{
+			while (!s->cur_packet_is_keyframe && s->cur_stream_packet_index > 0)
+			{
+				if (!avi_stream_reader_move_to_prev_packet(s, 0)) return;
+			}
+			ts->start_packet = s->cur_stream_packet_index;
+		}
+	}
+	ts->is_active = !avi_trim_is_done(ts);
+}
+
+/// Does the stream reader find its packets through the `idx1` chunk? See `avi_stream_reader_move_to_next_packet()`.
+AVI_STATIC_FUNC int avi_trim_uses_idx1(avi_trim *t, avi_trim_stream *ts)
+{
+	avi_reader *r = t->r;
+	return !ts->s.packet_table && !ts->s.indx.num_entries && r->idx1_offset && r->num_indices;
+}
+
+/// Find the first packets of the ranges of the streams in `todo` by one pass of the `idx1` chunk for all of them, read in big blocks into the copy buffer.
+/// Stepping each stream reader there would walk the whole `idx1` chunk before the range once per stream.
+AVI_STATIC_FUNC void avi_trim_seek_streams_idx1(avi_trim *t, uint8_t *todo)
+{
+	avi_reader *r = t->r;
+	avi_index_entry *entries = (avi_index_entry *)t->copy_buffer;
+	fsize_t block_entries = (fsize_t)(t->copy_buffer_size / sizeof(avi_index_entry));
+	fsize_t packet_no[AVI_MAX_STREAMS] = { 0 };
+	uint64_t byte_offset[AVI_MAX_STREAMS] = { 0 };
+	avi_stream_position key_pos[AVI_MAX_STREAMS];
+	int has_key[AVI_MAX_STREAMS] = { 0 };
+	uint32_t num_todo = 0;
+
+	for (uint32_t i = 0; i < t->num_streams; i++)
+	{
+		if (todo[i]) num_todo++;
+	}
+	for (fsize_t first = 0; first < r->num_indices && num_todo;)
+	{
+		fsize_t num_entries = avi_reader_read_idx1_block(r, first, entries, block_entries);
+		if (!num_entries) break;
+
+		for (fsize_t j = 0; j < num_entries && num_todo; j++)
+		{
+			const avi_index_entry *index = &entries[j];
+			int stream_no = avi_get_fourcc_stream_id(index->dwChunkId);
+			avi_trim_stream *ts;
+			avi_stream_position pos;
+			if (stream_no < 0 || (uint32_t)stream_no >= t->num_streams || !todo[stream_no]) continue;
+			ts = &t->streams[stream_no];
+
+			avi_reader_get_idx1_position(r, index, first + j, &pos);
+			pos.cur_stream_packet_index = packet_no[stream_no]++;
+			pos.cur_stream_byte_offset = (fsize_t)byte_offset[stream_no];
+			byte_offset[stream_no] += index->dwSize;
+
+			if (ts->is_audio)
+			{
+				if ((uint64_t)pos.cur_stream_byte_offset + pos.cur_packet_len <= ts->start_byte) continue;
+			}
+			else
+			{
+				// The first packet is the fallback if there's no key frame before the start.
+				if (pos.cur_packet_is_keyframe || !has_key[stream_no])
+				{
+					key_pos[stream_no] = pos;
+					has_key[stream_no] = 1;
+				}
+				if (pos.cur_stream_packet_index < ts->start_packet) continue;
+				if (avi_stream_is_video(ts->s.stream_info))
+				{
+					pos = key_pos[stream_no];
+					ts->start_packet = pos.cur_stream_packet_index;
+				}
+			}
+			avi_stream_reader_set_position(&ts->s, &pos);
+			ts->is_active = !avi_trim_is_done(ts);
+			todo[stream_no] = 0;
+			num_todo--;
+		}
+		first += num_entries;
+	}
+
+	// The streams not found in the `idx1` chunk have nothing to copy.
+	for (uint32_t i = 0; i < t->num_streams; i++)
+	{
+		if (todo[i]) t->streams[i].is_active = 0;
+	}
+}
+
+/// Move the stream readers in `todo` to the first packets of their ranges, the video streams start from a key frame.
+AVI_STATIC_FUNC void avi_trim_seek_streams(avi_trim *t, uint8_t *todo)
+{
+	int has_idx1_streams = 0;
+	for (uint32_t i = 0; i < t->num_streams; i++)
+	{
+		avi_trim_stream *ts = &t->streams[i];
+		if (!todo[i]) continue;
+		if (avi_trim_uses_idx1(t, ts) && t->copy_buffer_size >= sizeof(avi_index_entry))
+		{
+			has_idx1_streams = 1;
+			continue;
+		}
+
+		// The `indx` cache and the packet table are read in blocks already.
+		avi_trim_seek_stream(ts, avi_stream_is_video(ts->s.stream_info));
+		todo[i] = 0;
+	}
+	if (has_idx1_streams) avi_trim_seek_streams_idx1(t, todo);
+}
+
+/// Find the stream whose packet comes first in the file, so the source file is read forward.
+AVI_STATIC_FUNC avi_trim_stream *avi_trim_next_stream(avi_trim *t)
+{
+	avi_trim_stream *next = NULL;
+	for (uint32_t i = 0; i < t->num_streams; i++)
+	{
+		avi_trim_stream *ts = &t->streams[i];
+		if (!ts->is_active) continue;
+		if (!next || ts->s.cur_packet_offset < next->s.cur_packet_offset) next = ts;
+	}
+	return next;
+}
+
+/// Collect the packets for one read of the copy buffer.
+AVI_STATIC_FUNC int avi_trim_collect_batch(avi_trim *t)
+{
+	fsize_t batch_start = 0;
+	t->batch_len = 0;
+	while (t->batch_len < AVI_TRIM_MAX_BATCH)
+	{
+		avi_trim_stream *ts = avi_trim_next_stream(t);
+		avi_stream_reader *s;
+		avi_trim_packet *p;
+		uint64_t head = 0;
+		uint64_t tail = 0;
+		if (!ts) break;
+		s = &ts->s;
+
+		if (ts->is_pcm)
+		{
+			uint64_t packet_end = (uint64_t)s->cur_stream_byte_offset + s->cur_packet_len;
+			if (ts->start_byte > s->cur_stream_byte_offset) head = ts->start_byte - s->cur_stream_byte_offset;
+			if (packet_end > ts->end_byte) tail = packet_end - ts->end_byte;
+			if (head + tail > s->cur_packet_len) head = tail = 0;
+		}
+		if (s->cur_packet_len > t->copy_buffer_size) return 0;
+		if (!t->batch_len) batch_start = s->cur_packet_offset;
+		else if (s->cur_packet_offset + s->cur_packet_len - batch_start > t->copy_buffer_size) break;
+
+		p = &t->batch[t->batch_len++];
+		p->stream_id = s->stream_id;
+		p->offset = (fsize_t)(s->cur_packet_offset + head);
+		p->len = (fsize_t)(s->cur_packet_len - head - tail);
+		p->is_keyframe = s->cur_packet_is_keyframe;
+
+		if (!avi_stream_reader_move_to_next_packet(s, 0)) ts->is_active = 0;
+		else ts->is_active = !avi_trim_is_done(ts);
+	}
+	return 1;
+}
+
+AVI_STATIC_FUNC int avi_trim_copy_batch(avi_trim *t)
+{
+	avi_reader *r = t->r;
+	fsize_t batch_start;
+	fsize_t batch_len;
+	fssize_t rl;
+	if (!t->batch_len) return 1;
+
+	batch_start = t->batch[0].offset;
+	batch_len = 0;
+	for (uint32_t i = 0; i < t->batch_len; i++)
+	{
+		fsize_t end = t->batch[i].offset + t->batch[i].len - batch_start;
+		if (end > batch_len) batch_len = end;
+	}
+
+	// One big sequential read for the whole batch, the small gaps between the packets are read too.
+	rl = avi_reader_read_at(r, batch_start, t->copy_buffer, batch_len, AVI_IO_PAYLOAD);
+	if (rl < 0 || (fsize_t)rl != batch_len) return 0;
+	t->num_batches++;
+
+	for (uint32_t i = 0; i < t->batch_len; i++)
+	{
+		avi_trim_packet *p = &t->batch[i];
+		if (!p->len) continue;
+		if (!avi_writer_write_packet(t->w, p->stream_id, &t->copy_buffer[p->offset - batch_start], (uint32_t)p->len, p->is_keyframe)) return 0;
+		t->num_packets_copied++;
+		t->num_bytes_copied += p->len;
+	}
+	return 1;
+}
+
+AVI_STATIC_FUNC int avi_trim_setup(avi_trim *t, avi_reader *r, avi_writer *w, void *copy_buffer, size_t copy_buffer_size)
+{
+	if (!r->num_streams || !copy_buffer || !copy_buffer_size) return 0;
+
+	memset(t, 0, sizeof *t);
+	t->r = r;
+	t->w = w;
+	t->copy_buffer = copy_buffer;
+	t->copy_buffer_size = copy_buffer_size;
+	t->num_streams = r->num_streams;
+
+	for (uint32_t i = 0; i < t->num_streams; i++)
+	{
+		avi_trim_stream *ts = &t->streams[i];
+		avi_stream_info *si = &r->avi_stream_info[i];
+		if (!avi_get_stream_reader(r, r->userdata, i, NULL, NULL, NULL, NULL, &ts->s)) return 0;
+		ts->s.mute_cur_stream_debug_print = 1;
+		ts->is_audio = avi_stream_is_audio(si);
+		ts->is_pcm = ts->is_audio && si->format_data_is_valid && si->audio_format.wFormatTag == WAVE_FORMAT_PCM && si->audio_format.nBlockAlign;
+	}
+	return 1;
+}
+
+AVI_STATIC_FUNC int avi_trim_copy_packets(avi_trim *t)
+{
+	do
+	{
+		if (!avi_trim_collect_batch(t)) return 0;
+		if (!avi_trim_copy_batch(t)) return 0;
+	} while (t->batch_len);
+	return 1;
+}
+
+AVI_FUNC int avi_trim_begin_writer(avi_trim *t, avi_reader *r, avi_writer *w, avi_stdindex_entry *stdindex_buffer, uint32_t stdindex_capacity)
+{
+	uint32_t stdindex_per_stream;
+	if (!t || !r || !w || !stdindex_buffer) return 0;
+	if (!r->num_streams) return 0;
+	stdindex_per_stream = stdindex_capacity / r->num_streams;
+	if (!stdindex_per_stream) return 0;
+
+	for (uint32_t i = 0; i < r->num_streams; i++)
+	{
+		avi_trim_stream *ts = &t->streams[i];
+		avi_stream_info *si = &r->avi_stream_info[i];
+		avi_stream_header sh = si->stream_header;
+		fssize_t rl;
+
+		if (si->stream_format_len > sizeof ts->format) return 0;
+		ts->format_len = (uint32_t)si->stream_format_len;
+		if (ts->format_len)
+		{
+			rl = avi_reader_read_at(r, si->stream_format_offset, ts->format, ts->format_len, AVI_IO_HEADER);
+			if (rl < 0 || (fsize_t)rl != ts->format_len) return 0;
+		}
+
+		sh.dwStart = 0;
+		sh.dwInitialFrames = 0;
+		if (!avi_writer_add_stream(w, &sh, ts->format, ts->format_len, si->stream_name[0] ? si->stream_name : NULL, &stdindex_buffer[i * stdindex_per_stream], stdindex_per_stream, NULL)) return 0;
+	}
+	return avi_writer_begin(w, &r->avih);
+}
+
+AVI_FUNC int avi_trim_copy_all_packets(avi_trim *t, avi_reader *r, avi_writer *w, void *copy_buffer, size_t copy_buffer_size)
+{
+	uint8_t todo[AVI_MAX_STREAMS];
+	if (!t || !r || !w) return 0;
+	if (!avi_trim_setup(t, r, w, copy_buffer, copy_buffer_size)) return 0;
+	for (uint32_t i = 0; i < t->num_streams; i++)
+	{
+		avi_trim_stream *ts = &t->streams[i];
+		ts->end_packet = (fsize_t)-1;
+		ts->end_byte = (uint64_t)-1;
+		todo[i] = 1;
+	}
+	avi_trim_seek_streams(t, todo);
+	return avi_trim_copy_packets(t);
+}
+
+AVI_FUNC int avi_trim_copy
+(
+	avi_trim *t,
+	avi_reader *r,
+	avi_writer *w,
+	uint64_t start_time_ms,
+	uint64_t end_time_ms,
+	avi_stdindex_entry *stdindex_buffer,
+	uint32_t stdindex_capacity,
+	void *copy_buffer,
+	size_t copy_buffer_size
+)
+{
+	avi_trim_stream *master = NULL;
+	uint8_t todo[AVI_MAX_STREAMS] = { 0 };
+	uint64_t start_num, start_den;
+	uint64_t end_num, end_den;
+	if (!t || !r || !w) return 0;
+	if (end_time_ms <= start_time_ms) return 0;
+	if (!avi_trim_setup(t, r, w, copy_buffer, copy_buffer_size)) return 0;
+	for (uint32_t i = 0; i < t->num_streams; i++)
+	{
+		avi_stream_header *sh = &t->streams[i].s.stream_info->stream_header;
+		if (avi_stream_is_video(t->streams[i].s.stream_info) && sh->dwRate && sh->dwScale)
+		{
+			master = &t->streams[i];
+			break;
+		}
+	}
+
+	// The time is kept as a fraction of seconds to avoid the rounding errors: `start_num / start_den`.
+	// The first video stream decides the start time, it can only start from a key frame.
+	start_num = start_time_ms;
+	start_den = 1000;
+	end_num = end_time_ms;
+	end_den = 1000;
+	if (master)
+	{
+		avi_stream_header *sh = &master->s.stream_info->stream_header;
+		master->start_packet = (fsize_t)avi_trim_mul_div(start_num, sh->dwRate, start_den * sh->dwScale);
+		master->end_packet = (fsize_t)avi_trim_mul_div_ceil(end_num, sh->dwRate, end_den * sh->dwScale);
+		todo[master->s.stream_id] = 1;
+		avi_trim_seek_streams(t, todo);
+		start_num = (uint64_t)master->start_packet * sh->dwScale;
+		start_den = sh->dwRate;
+	}
+	t->start_time_ms = avi_trim_mul_div(start_num, 1000, start_den);
+	t->end_time_ms = end_time_ms;
+
+	for (uint32_t i = 0; i < t->num_streams; i++)
+	{
+		avi_trim_stream *ts = &t->streams[i];
+		avi_stream_info *si = ts->s.stream_info;
+		avi_stream_header *sh = &si->stream_header;
+		if (ts == master) continue;
+		if (ts->is_audio)
+		{
+			uint64_t bytes_per_sec = si->audio_format.nAvgBytesPerSec;
+			uint64_t block_align = si->audio_format.nBlockAlign ? si->audio_format.nBlockAlign : 1;
+			if (!bytes_per_sec) continue;
+			ts->start_byte = avi_trim_mul_div(start_num, bytes_per_sec, start_den) / block_align * block_align;
+			ts->end_byte = avi_trim_mul_div(end_num, bytes_per_sec, end_den) / block_align * block_align;
+		}
+		else
+		{
+			if (!sh->dwRate || !sh->dwScale) continue;
+			ts->start_packet = (fsize_t)avi_trim_mul_div(start_num, sh->dwRate, start_den * sh->dwScale);
+			ts->end_packet = (fsize_t)avi_trim_mul_div_ceil(end_num, sh->dwRate, end_den * sh->dwScale);
+		}
+		todo[i] = 1;
+	}
+	avi_trim_seek_streams(t, todo);
+
+	if (!avi_trim_begin_writer(t, r, w, stdindex_buffer, stdindex_capacity)) return 0;
+	if (!avi_trim_copy_packets(t)) return 0;
+	return avi_writer_finish(w);
+}
@@ -0,0 +1,125 @@
+#ifndef _AVI_TRIM_H_
+#define _AVI_TRIM_H_ 1
+
+#include "avi_writer.h"
+
+#ifndef AVI_TRIM_MAX_BATCH
+#define AVI_TRIM_MAX_BATCH 256
+#endif
+
+#ifndef AVI_TRIM_MAX_FORMAT
+#define AVI_TRIM_MAX_FORMAT (sizeof(bitmap_header_max_size))
+#endif
+
+typedef struct
+{
+	avi_stream_reader s;
+
+	/// The stream format copied from the source file for the destination file.
+	uint8_t format[AVI_TRIM_MAX_FORMAT];
+	uint32_t format_len;
+
+	/// Does the stream have a packet to copy? The stream reader is on it.
+	int is_active;
+
+	/// For PCM audio, the packets on the edges of the range are cut at the sample level.
+	int is_pcm;
+
+	/// The range of the packets to copy: `[start_packet, end_packet)`, or `[start_byte, end_byte)` for audio.
+	int is_audio;
+	fsize_t start_packet;
+	fsize_t end_packet;
+	uint64_t start_byte;
+	uint64_t end_byte;
+}avi_trim_stream;
+
+typedef struct
+{
+	int stream_id;
+	fsize_t offset;
+	fsize_t len;
+	int is_keyframe;
+}avi_trim_packet;
+
+/// <summary>
+/// Copies a time range of an AVI file into a new AVI file without decoding the packets.
+/// The start of the range is moved back to the key frame of the first video stream, the other streams follow the same start time.
+/// PCM audio is cut at the sample level, the other streams are cut at the packet level.
+/// The packets are read in file order in big batches, so the time it takes is proportional to the length of the range, not the source file.
+/// </summary>
+typedef struct
+{
+	avi_reader *r;
+	avi_writer *w;
+
+	/// Your buffer to read the batches of packets, it must be able to hold the biggest packet.
+	uint8_t *copy_buffer;
+	size_t copy_buffer_size;
+
+	uint32_t num_streams;
+	avi_trim_stream streams[AVI_MAX_STREAMS];
+
+	avi_trim_packet batch[AVI_TRIM_MAX_BATCH];
+	uint32_t batch_len;
+
+	/// The actual range after snapping to the key frame, in milliseconds.
+	uint64_t start_time_ms;
+	uint64_t end_time_ms;
+
+	/// Statistics
+	uint64_t num_packets_copied;
+	uint64_t num_bytes_copied;
+	uint64_t num_batches;
+}avi_trim;
+
+/// <summary>
+/// Copy the packets of `[start_time_ms, end_time_ms)` from the source AVI file to the destination AVI file.
+/// The streams are added to the writer by this function, then the writer is finished.
+/// </summary>
+/// <param name="t">Your `avi_trim`, it's big, better not to put it on the stack of your embedded device.</param>
+/// <param name="r">Your initialized `avi_reader` of the source AVI file</param>
+/// <param name="w">Your initialized `avi_writer` of the destination AVI file, with no streams added.</param>
+/// <param name="start_time_ms">The start time of the range</param>
+/// <param name="end_time_ms">The end time of the range</param>
+/// <param name="stdindex_buffer">Your buffer for the standard index entries of the writer, shared evenly by the streams.</param>
+/// <param name="stdindex_capacity">Number of entries of `stdindex_buffer`</param>
+/// <param name="copy_buffer">Your buffer to read the packets, bigger is faster.</param>
+/// <param name="copy_buffer_size">The size of `copy_buffer`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_trim_copy
+(
+	avi_trim *t,
+	avi_reader *r,
+	avi_writer *w,
+	uint64_t start_time_ms,
+	uint64_t end_time_ms,
+	avi_stdindex_entry *stdindex_buffer,
+	uint32_t stdindex_capacity,
+	void *copy_buffer,
+	size_t copy_buffer_size
+);
+
+/// <summary>
+/// Add the streams of the source AVI file to the writer, then call `avi_writer_begin()` with the main header of the source.
+/// </summary>
+/// <param name="t">Your `avi_trim`, used to store the stream formats read from the source.</param>
+/// <param name="r">Your initialized `avi_reader` of the source AVI file</param>
+/// <param name="w">Your initialized `avi_writer` with no streams added.</param>
+/// <param name="stdindex_buffer">Your buffer for the standard index entries of the writer, shared evenly by the streams.</param>
+/// <param name="stdindex_capacity">Number of entries of `stdindex_buffer`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_trim_begin_writer(avi_trim *t, avi_reader *r, avi_writer *w, avi_stdindex_entry *stdindex_buffer, uint32_t stdindex_capacity);
+
+/// <summary>
+/// Copy every packet of the source AVI file to the writer, in the same batches as `avi_trim_copy()`. The writer is not finished.
+/// The streams of the writer must be in the same order as the source, e.g. added by `avi_trim_begin_writer()`.
+/// </summary>
+/// <param name="t">Your `avi_trim`</param>
+/// <param name="r">Your initialized `avi_reader` of the source AVI file</param>
+/// <param name="w">Your begun `avi_writer`</param>
+/// <param name="copy_buffer">Your buffer to read the packets, bigger is faster.</param>
+/// <param name="copy_buffer_size">The size of `copy_buffer`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_trim_copy_all_packets(avi_trim *t, avi_reader *r, avi_writer *w, void *copy_buffer, size_t copy_buffer_size);
+
+#endif
@@ -0,0 +1,519 @@
+#include "avi_writer.h"
+
+#include <string.h>
+
+#define AVIF_HASINDEX		0x00000010
+#define AVIF_ISINTERLEAVED	0x00000100
+#define AVIF_TRUSTCKTYPE	0x00000800
+
+#define AVI_STDINDEX_DELTAFRAME 0x80000000 // this frame is not a key frame.
+
+#define MAKE4CC(c1, c2, c3, c4) ((c1) | ((c2) << 8) | ((c3) << 16) | ((c4) << 24))
+
+#define FCC_RIFF MAKE4CC('R', 'I', 'F', 'F')
+#define FCC_LIST MAKE4CC('L', 'I', 'S', 'T')
+#define FCC_AVI_ MAKE4CC('A', 'V', 'I', ' ')
+#define FCC_AVIX MAKE4CC('A', 'V', 'I', 'X')
+#define FCC_hdrl MAKE4CC('h', 'd', 'r', 'l')
+#define FCC_avih MAKE4CC('a', 'v', 'i', 'h')
+#define FCC_strl MAKE4CC('s', 't', 'r', 'l')
+#define FCC_strh MAKE4CC('s', 't', 'r', 'h')
+#define FCC_strf MAKE4CC('s', 't', 'r', 'f')
+#define FCC_strn MAKE4CC('s', 't', 'r', 'n')
+#define FCC_indx MAKE4CC('i', 'n', 'd', 'x')
+#define FCC_odml MAKE4CC('o', 'd', 'm', 'l')
+#define FCC_dmlh MAKE4CC('d', 'm', 'l', 'h')
+#define FCC_movi MAKE4CC('m', 'o', 'v', 'i')
+#define FCC_idx1 MAKE4CC('i', 'd', 'x', '1')
+#define FCC_vids MAKE4CC('v', 'i', 'd', 's')
+#define FCC_auds MAKE4CC('a', 'u', 'd', 's')
+
+#define AVI_DMLH_SIZE 248
+
+AVI_STATIC_FUNC int avi_writer_write_direct(avi_writer *w, const void *data, size_t len)
+{
+	if (!len) return 1;
+	if (w->f_write(data, len, w->userdata) != (fssize_t)len) return 0;
+	w->flushed_pos += len;
+	return 1;
+}
+
+AVI_STATIC_FUNC int avi_writer_flush(avi_writer *w)
+{
+	size_t len = w->write_buffer_len;
+	w->write_buffer_len = 0;
+	return avi_writer_write_direct(w, w->write_buffer, len);
+}
+
+AVI_STATIC_FUNC int avi_writer_write(avi_writer *w, const void *data, size_t len)
+{
+	const uint8_t *src = data;
+
+#ifndef AVI_ENABLE_4GB_FILES
+	// The seek callback takes `fsize_t`, the file can't grow beyond it.
+	if (w->cur_pos + len > 0xFFFFFFFF) return 0;
+#endif
+	w->cur_pos += len;
+
+	while (len)
+	{
+		size_t n;
+		if (!w->write_buffer_len && len >= w->write_buffer_size)
+		{
+			// Bypass the buffer for the big payloads, still writing whole buffers to keep the alignment.
+			n = w->write_buffer_size ? len - len % w->write_buffer_size : len;
+			if (!avi_writer_write_direct(w, src, n)) return 0;
+		}
+		else
+		{
+			n = w->write_buffer_size - w->write_buffer_len;
+			if (n > len) n = len;
+			memcpy(&w->write_buffer[w->write_buffer_len], src, n);
+			w->write_buffer_len += n;
+			if (w->write_buffer_len == w->write_buffer_size)
+			{
+				if (!avi_writer_flush(w)) return 0;
+			}
+		}
+		src += n;
+		len -= n;
+	}
+	return 1;
+}
+
+AVI_STATIC_FUNC int avi_writer_write_zeros(avi_writer *w, size_t len)
+{
+	static const uint8_t zeros[64] = { 0 };
+	while (len)
+	{
+		size_t n = len > sizeof zeros ? sizeof zeros : len;
+		if (!avi_writer_write(w, zeros, n)) return 0;
+		len -= n;
+	}
+	return 1;
+}
+
+AVI_STATIC_FUNC int avi_writer_write_u32(avi_writer *w, uint32_t value)
+{
+	return avi_writer_write(w, &value, 4);
+}
+
+AVI_STATIC_FUNC int avi_writer_write_chunk_header(avi_writer *w, uint32_t fourcc, uint32_t size)
+{
+	return avi_writer_write_u32(w, fourcc) && avi_writer_write_u32(w, size);
+}
+
+/// Overwrite the data already written. The data still in the buffer is modified in place, so the buffer isn't flushed early.
+AVI_STATIC_FUNC int avi_writer_patch(avi_writer *w, uint64_t pos, const void *data, size_t len)
+{
+	const uint8_t *src = data;
+	if (pos < w->flushed_pos)
+	{
+		size_t n = len;
+		if (pos + n > w->flushed_pos) n = (size_t)(w->flushed_pos - pos);
+		if (w->f_seek((fsize_t)pos, w->userdata) == -1) return 0;
+		if (w->f_write(src, n, w->userdata) != (fssize_t)n) return 0;
+		if (w->f_seek((fsize_t)w->flushed_pos, w->userdata) == -1) return 0;
+		src += n;
+		pos += n;
+		len -= n;
+	}
+	if (len) memcpy(&w->write_buffer[pos - w->flushed_pos], src, len);
+	return 1;
+}
+
+AVI_STATIC_FUNC int avi_writer_patch_u32(avi_writer *w, uint64_t pos, uint32_t value)
+{
+	return avi_writer_patch(w, pos, &value, 4);
+}
+
+AVI_STATIC_FUNC uint32_t avi_writer_packet_duration(const avi_writer_stream *ws, uint32_t len)
+{
+	// For the audio streams with a fixed sample size, the length is counted in samples.
+	if (ws->stream_header.dwSampleSize) return len / ws->stream_header.dwSampleSize;
+	return 1;
+}
+
+AVI_FUNC int avi_writer_init
+(
+	avi_writer *w,
+	void *userdata,
+	write_cb f_write,
+	seek_cb f_seek,
+	void *write_buffer,
+	size_t write_buffer_size,
+	avi_index_entry *idx1_buffer,
+	uint32_t idx1_capacity,
+	uint64_t max_riff_size
+)
+{
+	if (!w) return 0;
+	if (!f_write) return 0;
+	if (!f_seek) return 0;
+	if (!write_buffer) write_buffer_size = 0;
+	if (!idx1_buffer) idx1_capacity = 0;
+	if (!max_riff_size) max_riff_size = AVI_WRITER_DEFAULT_RIFF_SIZE;
+
+	// The standard index entries store 32-bit offsets relative to the `LIST movi` chunk of the `RIFF`.
+	if (max_riff_size > 0xFFFFFFFF) return 0;
+
+	memset(w, 0, sizeof *w);
+	w->userdata = userdata;
+	w->f_write = f_write;
+	w->f_seek = f_seek;
+	w->write_buffer = write_buffer;
+	w->write_buffer_size = write_buffer_size;
+	w->idx1 = idx1_buffer;
+	w->idx1_capacity = idx1_capacity;
+	w->max_riff_size = max_riff_size;
+	return 1;
+}
+
+AVI_FUNC int avi_writer_add_stream
+(
+	avi_writer *w,
+	const avi_stream_header *stream_header,
+	const void *stream_format,
+	uint32_t stream_format_len,
+	const char *stream_name,
+	avi_stdindex_entry *stdindex_buffer,
+	uint32_t stdindex_capacity,
+	int *stream_id_out
+)
+{
+	avi_writer_stream *ws;
+	uint32_t stream_id;
+	uint32_t twocc;
+	if (!w || !stream_header || !stdindex_buffer || !stdindex_capacity) return 0;
+	if (!stream_format && stream_format_len) return 0;
+	if (w->is_begun) return 0;
+	if (w->num_streams >= AVI_MAX_STREAMS || w->num_streams >= 100) return 0;
+
+	stream_id = w->num_streams++;
+	ws = &w->streams[stream_id];
+	memset(ws, 0, sizeof *ws);
+	ws->stream_header = *stream_header;
+	ws->stream_format = stream_format;
+	ws->stream_format_len = stream_format_len;
+	ws->stream_name = stream_name;
+	ws->stdindex = stdindex_buffer;
+	ws->stdindex_capacity = stdindex_capacity;
+
+	switch (stream_header->fccType)
+	{
+	case FCC_vids:
+		twocc = MAKE4CC(0, 0, 'd', 'c');
+		if (stream_format_len >= sizeof(bitmap_info_header) && ((const bitmap_info_header *)stream_format)->biCompression == BI_RGB)
+			twocc = MAKE4CC(0, 0, 'd', 'b');
+		break;
+	case FCC_auds:
+		twocc = MAKE4CC(0, 0, 'w', 'b');
+		break;
+	default:
+		twocc = MAKE4CC(0, 0, 'd', 'c');
+		break;
+	}
+	ws->packet_4cc = MAKE4CC('0' + stream_id / 10, '0' + stream_id % 10, 0, 0) | twocc;
+	ws->stdindex_4cc = MAKE4CC('i', 'x', '0' + stream_id / 10, '0' + stream_id % 10);
+	if (stream_id_out) *stream_id_out = (int)stream_id;
+	return 1;
+}
+
+AVI_STATIC_FUNC int avi_writer_begin_movi(avi_writer *w, uint32_t riff_type)
+{
+	if (riff_type == FCC_AVIX)
+	{
+		w->riff_offset = w->cur_pos;
+		if (!avi_writer_write_chunk_header(w, FCC_RIFF, 0)) return 0;
+		if (!avi_writer_write_u32(w, FCC_AVIX)) return 0;
+	}
+	if (!avi_writer_write_chunk_header(w, FCC_LIST, 0)) return 0;
+	w->movi_offset = w->cur_pos;
+	return avi_writer_write_u32(w, FCC_movi);
+}
+
+AVI_FUNC int avi_writer_set_expected_packets(avi_writer *w, int stream_id, uint32_t num_packets)
+{
+	if (!w || w->is_begun) return 0;
+	if (stream_id < 0 || (uint32_t)stream_id >= w->num_streams) return 0;
+	w->streams[stream_id].expected_packets = num_packets;
+	return 1;
+}
+
+/// Size the reserved super index of every stream from the expected number of packets.
+AVI_STATIC_FUNC void avi_writer_plan_super_index(avi_writer *w)
+{
+	uint32_t max_expected = 0;
+	for (uint32_t i = 0; i < w->num_streams; i++)
+	{
+		avi_writer_stream *ws = &w->streams[i];
+		if (!ws->expected_packets && !ws->stream_header.dwSampleSize) ws->expected_packets = ws->stream_header.dwLength;
+		if (ws->expected_packets > max_expected) max_expected = ws->expected_packets;
+	}
+	for (uint32_t i = 0; i < w->num_streams; i++)
+	{
+		avi_writer_stream *ws = &w->streams[i];
+		uint32_t expected = ws->expected_packets ? ws->expected_packets : max_expected;
+		uint64_t capacity = AVI_WRITER_MAX_SUPER_INDEX + ((uint64_t)expected + ws->stdindex_capacity - 1) / ws->stdindex_capacity;
+
+		// The `indx` chunk size is 32 bits.
+		if (capacity > (0xFFFFFFFF - sizeof(avi_meta_index)) / sizeof(avi_super_index_entry))
+			capacity = (0xFFFFFFFF - sizeof(avi_meta_index)) / sizeof(avi_super_index_entry);
+		ws->super_index_capacity = (uint32_t)capacity;
+	}
+}
+
+AVI_FUNC int avi_writer_begin(avi_writer *w, const avi_main_header *avih)
+{
+	uint64_t hdrl_offset;
+	if (!w || !avih) return 0;
+	if (w->is_begun || !w->num_streams) return 0;
+	w->is_begun = 1;
+
+	w->frames_stream_id = 0;
+	for (uint32_t i = 0; i < w->num_streams; i++)
+	{
+		if (w->streams[i].stream_header.fccType == FCC_vids)
+		{
+			w->frames_stream_id = i;
+			break;
+		}
+	}
+	avi_writer_plan_super_index(w);
+
+	w->avih = *avih;
+	w->avih.cb = sizeof w->avih - 4;
+	w->avih.dwStreams = w->num_streams;
+	w->avih.dwFlags = AVIF_ISINTERLEAVED | AVIF_TRUSTCKTYPE;
+	if (w->idx1_capacity) w->avih.dwFlags |= AVIF_HASINDEX;
+
+	if (!avi_writer_write_chunk_header(w, FCC_RIFF, 0)) return 0;
+	if (!avi_writer_write_u32(w, FCC_AVI_)) return 0;
+
+	if (!avi_writer_write_chunk_header(w, FCC_LIST, 0)) return 0;
+	hdrl_offset = w->cur_pos;
+	if (!avi_writer_write_u32(w, FCC_hdrl)) return 0;
+	if (!avi_writer_write_chunk_header(w, FCC_avih, w->avih.cb)) return 0;
+	w->avih_offset = w->cur_pos;
+	if (!avi_writer_write(w, &w->avih.dwMicroSecPerFrame, w->avih.cb)) return 0;
+
+	for (uint32_t i = 0; i < w->num_streams; i++)
+	{
+		avi_writer_stream *ws = &w->streams[i];
+		avi_meta_index mi;
+		uint64_t strl_offset;
+		uint32_t format_len = (ws->stream_format_len + 1) & ~1;
+		uint32_t indx_len = sizeof mi + ws->super_index_capacity * sizeof(avi_super_index_entry);
+
+		if (!avi_writer_write_chunk_header(w, FCC_LIST, 0)) return 0;
+		strl_offset = w->cur_pos;
+		if (!avi_writer_write_u32(w, FCC_strl)) return 0;
+
+		if (!avi_writer_write_chunk_header(w, FCC_strh, sizeof ws->stream_header)) return 0;
+		ws->strh_offset = w->cur_pos;
+		if (!avi_writer_write(w, &ws->stream_header, sizeof ws->stream_header)) return 0;
+
+		// The reader doesn't skip the pad byte in the header list, so the odd sized chunks are padded in their sizes.
+		if (!avi_writer_write_chunk_header(w, FCC_strf, format_len)) return 0;
+		if (!avi_writer_write(w, ws->stream_format, ws->stream_format_len)) return 0;
+		if (!avi_writer_write_zeros(w, format_len - ws->stream_format_len)) return 0;
+
+		// Reserve the super index, it's filled when finishing.
+		memset(&mi, 0, sizeof mi);
+		mi.longs_per_entry = 4;
+		mi.index_sub_type = 0;
+		mi.index_type = 0;
+		mi.entries_in_use = 0;
+		mi.chunk_id = ws->packet_4cc;
+		if (!avi_writer_write_chunk_header(w, FCC_indx, indx_len)) return 0;
+		ws->indx_offset = w->cur_pos;
+		if (!avi_writer_write(w, &mi, sizeof mi)) return 0;
+		if (!avi_writer_write_zeros(w, indx_len - sizeof mi)) return 0;
+
+		if (ws->stream_name)
+		{
+			size_t name_len = strlen(ws->stream_name) + 1;
+			if (name_len > AVI_MAX_STREAM_NAME) name_len = AVI_MAX_STREAM_NAME;
+			if (!avi_writer_write_chunk_header(w, FCC_strn, (uint32_t)((name_len + 1) & ~1))) return 0;
+			if (!avi_writer_write(w, ws->stream_name, name_len - 1)) return 0;
+			if (!avi_writer_write_zeros(w, ((name_len + 1) & ~1) - (name_len - 1))) return 0;
+		}
+
+		if (!avi_writer_patch_u32(w, strl_offset - 4, (uint32_t)(w->cur_pos - strl_offset))) return 0;
+	}
+
+	// The OpenDML extended header stores the total frames of all of the `RIFF` chunks.
+	if (!avi_writer_write_chunk_header(w, FCC_LIST, 4 + 8 + AVI_DMLH_SIZE)) return 0;
+	if (!avi_writer_write_u32(w, FCC_odml)) return 0;
+	if (!avi_writer_write_chunk_header(w, FCC_dmlh, AVI_DMLH_SIZE)) return 0;
+	w->dmlh_offset = w->cur_pos;
+	if (!avi_writer_write_zeros(w, AVI_DMLH_SIZE)) return 0;
+
+	if (!avi_writer_patch_u32(w, hdrl_offset - 4, (uint32_t)(w->cur_pos - hdrl_offset))) return 0;
+
+	return avi_writer_begin_movi(w, FCC_AVI_);
+}
+
+AVI_STATIC_FUNC int avi_writer_write_stdindex(avi_writer *w, avi_writer_stream *ws)
+{
+	avi_meta_index mi;
+	avi_super_index_entry si;
+	uint32_t chunk_len;
+	if (!ws->stdindex_len) return 1;
+
+	chunk_len = sizeof mi + ws->stdindex_len * sizeof(avi_stdindex_entry);
+	if (ws->num_super_index < ws->super_index_capacity)
+	{
+		si.offset = w->cur_pos;
+		si.size = 8 + chunk_len;
+		si.duration = ws->stdindex_duration;
+		if (!avi_writer_patch(w, ws->indx_offset + sizeof mi + (uint64_t)ws->num_super_index * sizeof si, &si, sizeof si)) return 0;
+		ws->num_super_index++;
+	}
+	else
+	{
+		ws->num_unindexed_packets += ws->stdindex_len;
+	}
+
+	memset(&mi, 0, sizeof mi);
+	mi.longs_per_entry = 2;
+	mi.index_sub_type = 0;
+	mi.index_type = 1;
+	mi.entries_in_use = ws->stdindex_len;
+	mi.chunk_id = ws->packet_4cc;
+	mi.reserved[0] = (uint32_t)ws->stdindex_base_offset;
+	mi.reserved[1] = (uint32_t)(ws->stdindex_base_offset >> 32);
+	if (!avi_writer_write_chunk_header(w, ws->stdindex_4cc, chunk_len)) return 0;
+	if (!avi_writer_write(w, &mi, sizeof mi)) return 0;
+	if (!avi_writer_write(w, ws->stdindex, ws->stdindex_len * sizeof(avi_stdindex_entry))) return 0;
+
+	ws->stdindex_len = 0;
+	ws->stdindex_duration = 0;
+	return 1;
+}
+
+AVI_STATIC_FUNC int avi_writer_end_riff(avi_writer *w)
+{
+	for (uint32_t i = 0; i < w->num_streams; i++)
+	{
+		if (!avi_writer_write_stdindex(w, &w->streams[i])) return 0;
+	}
+	if (!avi_writer_patch_u32(w, w->movi_offset - 4, (uint32_t)(w->cur_pos - w->movi_offset))) return 0;
+
+	if (w->riff_index == 0 && w->idx1_capacity)
+	{
+		if (!avi_writer_write_chunk_header(w, FCC_idx1, w->idx1_len * sizeof(avi_index_entry))) return 0;
+		if (!avi_writer_write(w, w->idx1, w->idx1_len * sizeof(avi_index_entry))) return 0;
+	}
+	return avi_writer_patch_u32(w, w->riff_offset + 4, (uint32_t)(w->cur_pos - w->riff_offset - 8));
+}
+
+/// The size the current `RIFF` chunk would grow to if the packet is written, including the pending indices.
+AVI_STATIC_FUNC uint64_t avi_writer_riff_size_with_packet(avi_writer *w, int stream_id, uint32_t len)
+{
+	uint64_t size = w->cur_pos - w->riff_offset + 8 + ((len + 1) & ~1);
+	for (uint32_t i = 0; i < w->num_streams; i++)
+	{
+		avi_writer_stream *ws = &w->streams[i];
+		uint32_t num_entries = ws->stdindex_len + ((int)i == stream_id);
+		if (num_entries) size += 8 + sizeof(avi_meta_index) + (uint64_t)num_entries * sizeof(avi_stdindex_entry);
+	}
+	if (w->riff_index == 0 && w->idx1_capacity) size += 8 + (uint64_t)(w->idx1_len + 1) * sizeof(avi_index_entry);
+	return size;
+}
+
+AVI_FUNC int avi_writer_write_packet(avi_writer *w, int stream_id, const void *data, uint32_t len, int is_keyframe)
+{
+	avi_writer_stream *ws;
+	avi_stdindex_entry *entry;
+	uint64_t chunk_offset;
+	int has_packets;
+	if (!w || !w->is_begun || w->is_finished) return 0;
+	if (stream_id < 0 || (uint32_t)stream_id >= w->num_streams) return 0;
+	if (!data && len) return 0;
+	if (len > 0x7FFFFFFF) return 0;
+	ws = &w->streams[stream_id];
+	if (ws->stream_header.fccType == FCC_auds) is_keyframe = 1;
+
+	// Start a new `RIFF` when the current one is full, or the `idx1` chunk can't take more entries.
+	has_packets = w->cur_pos > w->movi_offset + 4;
+	if (has_packets)
+	{
+		int is_idx1_full = w->riff_index == 0 && w->idx1_capacity && w->idx1_len >= w->idx1_capacity;
+		if (is_idx1_full || avi_writer_riff_size_with_packet(w, stream_id, len) > w->max_riff_size)
+		{
+			if (!avi_writer_end_riff(w)) return 0;
+			w->riff_index++;
+			if (!avi_writer_begin_movi(w, FCC_AVIX)) return 0;
+		}
+	}
+
+	chunk_offset = w->cur_pos;
+	if (!avi_writer_write_chunk_header(w, ws->packet_4cc, len)) return 0;
+	if (!avi_writer_write(w, data, len)) return 0;
+	if (len & 1) if (!avi_writer_write_zeros(w, 1)) return 0;
+
+	if (w->riff_index == 0)
+	{
+		if (w->idx1_len < w->idx1_capacity)
+		{
+			avi_index_entry *index = &w->idx1[w->idx1_len++];
+			index->dwChunkId = ws->packet_4cc;
+			index->dwFlags = is_keyframe ? AVIIF_KEYFRAME : 0;
+			index->dwOffset = (uint32_t)(chunk_offset - w->movi_offset);
+			index->dwSize = len;
+		}
+		if ((uint32_t)stream_id == w->frames_stream_id) w->num_frames_first_riff++;
+	}
+
+	if (!ws->stdindex_len) ws->stdindex_base_offset = w->movi_offset;
+	entry = &ws->stdindex[ws->stdindex_len++];
+	entry->offset = (uint32_t)(chunk_offset + 8 - ws->stdindex_base_offset);
+	entry->size = len | (is_keyframe ? 0 : AVI_STDINDEX_DELTAFRAME);
+	ws->stdindex_duration += avi_writer_packet_duration(ws, len);
+	if (ws->stdindex_len >= ws->stdindex_capacity)
+	{
+		if (!avi_writer_write_stdindex(w, ws)) return 0;
+	}
+
+	ws->num_packets++;
+	ws->num_bytes += len;
+	if (len > ws->max_packet_len) ws->max_packet_len = len;
+	return 1;
+}
+
+AVI_FUNC int avi_writer_finish(avi_writer *w)
+{
+	uint32_t max_packet_len = 0;
+	if (!w || !w->is_begun || w->is_finished) return 0;
+	w->is_finished = 1;
+	if (!avi_writer_end_riff(w)) return 0;
+
+	for (uint32_t i = 0; i < w->num_streams; i++)
+	{
+		avi_writer_stream *ws = &w->streams[i];
+		avi_stream_header *sh = &ws->stream_header;
+		avi_meta_index mi;
+
+		sh->dwLength = sh->dwSampleSize ? (uint32_t)(ws->num_bytes / sh->dwSampleSize) : ws->num_packets;
+		sh->dwSuggestedBufferSize = ws->max_packet_len;
+		if (!avi_writer_patch(w, ws->strh_offset, sh, sizeof *sh)) return 0;
+
+		memset(&mi, 0, sizeof mi);
+		mi.longs_per_entry = 4;
+		mi.index_sub_type = 0;
+		mi.index_type = 0;
+		mi.entries_in_use = ws->num_super_index;
+		mi.chunk_id = ws->packet_4cc;
+		if (!avi_writer_patch(w, ws->indx_offset, &mi, sizeof mi)) return 0;
+
+		if (ws->max_packet_len > max_packet_len) max_packet_len = ws->max_packet_len;
+	}
+
+	w->avih.dwTotalFrames = w->num_frames_first_riff;
+	w->avih.dwSuggestedBufferSize = max_packet_len + 8;
+	if (!avi_writer_patch(w, w->avih_offset, &w->avih.dwMicroSecPerFrame, w->avih.cb)) return 0;
+	if (!avi_writer_patch_u32(w, w->dmlh_offset, w->streams[w->frames_stream_id].num_packets)) return 0;
+
+	return avi_writer_flush(w);
+}
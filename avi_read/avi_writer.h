@@ -0,0 +1,199 @@
+#ifndef _AVI_WRITER_H_
+#define _AVI_WRITER_H_ 1
+
+#include "avi_reader.h"
+
+/// <summary>
+/// The entries reserved in the `indx` chunk of a stream for the `ix##` chunks ending the `RIFF` chunks, and the whole reservation if the number of packets is not known.
+/// </summary>
+#ifndef AVI_WRITER_MAX_SUPER_INDEX
+#define AVI_WRITER_MAX_SUPER_INDEX 256
+#endif
+
+#ifndef AVI_WRITER_DEFAULT_RIFF_SIZE
+#define AVI_WRITER_DEFAULT_RIFF_SIZE 0x40000000
+#endif
+
+typedef fssize_t(*write_cb)(const void *buffer, size_t len, void *userdata);
+
+typedef struct
+{
+	avi_stream_header stream_header;
+
+	/// The stream format and name, they must stay valid until `avi_writer_begin()`.
+	const void *stream_format;
+	uint32_t stream_format_len;
+	const char *stream_name;
+
+	/// The FourCC of the packets, e.g. `00dc`, and of the standard index chunks, e.g. `ix00`.
+	uint32_t packet_4cc;
+	uint32_t stdindex_4cc;
+
+	/// The positions to patch when finishing.
+	uint64_t strh_offset;
+	uint64_t indx_offset;
+
+	/// The expected number of packets, see `avi_writer_set_expected_packets()`.
+	uint32_t expected_packets;
+
+	/// Statistics for the stream header.
+	uint32_t num_packets;
+	uint64_t num_bytes;
+	uint32_t max_packet_len;
+
+	/// Your buffer for the pending standard index entries, written as an `ix##` chunk when it's full or the `RIFF` ends.
+	avi_stdindex_entry *stdindex;
+	uint32_t stdindex_capacity;
+	uint32_t stdindex_len;
+	uint64_t stdindex_base_offset;
+	uint32_t stdindex_duration;
+
+	/// The super index entries are written into the reserved `indx` chunk as soon as their `ix##` chunks are written.
+	uint32_t super_index_capacity;
+	uint32_t num_super_index;
+
+	/// The packets in the `ix##` chunks that didn't fit in the reserved `indx` chunk, they are not in the OpenDML index.
+	uint32_t num_unindexed_packets;
+}avi_writer_stream;
+
+/// <summary>
+/// Writes an AVI file in one pass. The packets are written with buffered writes, the `idx1` chunk and the OpenDML indices are generated on the way.
+/// The file has a `RIFF AVI ` chunk followed by `RIFF AVIX` chunks when it grows, each of them has its own `LIST movi` chunk.
+/// The `idx1` chunk covers the first `RIFF` only, the super index in the `indx` chunk of each stream covers all of them.
+/// </summary>
+typedef struct
+{
+	void *userdata; /// The data to pass to your callback functions.
+	write_cb f_write; /// Your `write()` callback function pointer.
+	seek_cb f_seek; /// Your `seek()` callback function pointer.
+
+	/// Your buffer for the writes. Full buffers are written at once, so the writes are aligned to the buffer size.
+	uint8_t *write_buffer;
+	size_t write_buffer_size;
+	size_t write_buffer_len;
+
+	/// The position of the data already written, and the position of the end of the data including the buffered ones.
+	uint64_t flushed_pos;
+	uint64_t cur_pos;
+
+	/// Your buffer for the `idx1` entries of the first `RIFF`.
+	avi_index_entry *idx1;
+	uint32_t idx1_capacity;
+	uint32_t idx1_len;
+
+	/// The max size of a `RIFF` chunk.
+	uint64_t max_riff_size;
+
+	avi_main_header avih;
+	uint64_t avih_offset;
+	uint64_t dmlh_offset;
+
+	uint32_t num_streams;
+	avi_writer_stream streams[AVI_MAX_STREAMS];
+
+	/// The current `RIFF` chunk and its `LIST movi` chunk.
+	uint32_t riff_index;
+	uint64_t riff_offset;
+	uint64_t movi_offset;
+
+	/// The first video stream (or the first stream if there's no video), its packets are the frames of `avih.dwTotalFrames` and `dmlh`.
+	uint32_t frames_stream_id;
+
+	/// Number of packets of `frames_stream_id` in the first `RIFF`, this goes to `avih.dwTotalFrames`.
+	uint32_t num_frames_first_riff;
+
+	int is_begun;
+	int is_finished;
+}avi_writer;
+
+/// <summary>
+/// Initialize the writer. Nothing is written until `avi_writer_begin()`.
+/// </summary>
+/// <param name="w">Your `avi_writer` to be initialized</param>
+/// <param name="userdata">The data to pass to your callback functions</param>
+/// <param name="f_write">Your `write()` callback function</param>
+/// <param name="f_seek">Your `seek()` callback function, used to patch the headers</param>
+/// <param name="write_buffer">Your buffer for the writes. Passing NULL is allowed to write directly.</param>
+/// <param name="write_buffer_size">The size of `write_buffer`, the cluster size of your file system is a good choice.</param>
+/// <param name="idx1_buffer">Your buffer for the `idx1` entries. When it's full, the writer starts a new `RIFF` earlier. Passing NULL is allowed to write no `idx1` chunk.</param>
+/// <param name="idx1_capacity">Number of entries of `idx1_buffer`</param>
+/// <param name="max_riff_size">The max size of a `RIFF` chunk, 0 for `AVI_WRITER_DEFAULT_RIFF_SIZE`.</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_writer_init
+(
+	avi_writer *w,
+	void *userdata,
+	write_cb f_write,
+	seek_cb f_seek,
+	void *write_buffer,
+	size_t write_buffer_size,
+	avi_index_entry *idx1_buffer,
+	uint32_t idx1_capacity,
+	uint64_t max_riff_size
+);
+
+/// <summary>
+/// Add a stream before calling `avi_writer_begin()`. `dwLength` and `dwSuggestedBufferSize` of the stream header are filled by the writer.
+/// </summary>
+/// <param name="w">Your `avi_writer`</param>
+/// <param name="stream_header">The stream header</param>
+/// <param name="stream_format">The `strf` chunk data, e.g. `bitmap_info_header` or `wave_format_ex`. It's not copied, keep it valid until `avi_writer_begin()`.</param>
+/// <param name="stream_format_len">The length of `stream_format`</param>
+/// <param name="stream_name">The stream name for the `strn` chunk, keep it valid until `avi_writer_begin()`. Passing NULL is allowed.</param>
+/// <param name="stdindex_buffer">Your buffer for the standard index entries of this stream. A bigger buffer makes fewer `ix##` chunks.</param>
+/// <param name="stdindex_capacity">Number of entries of `stdindex_buffer`</param>
+/// <param name="stream_id_out">The stream index start from zero.</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_writer_add_stream
+(
+	avi_writer *w,
+	const avi_stream_header *stream_header,
+	const void *stream_format,
+	uint32_t stream_format_len,
+	const char *stream_name,
+	avi_stdindex_entry *stdindex_buffer,
+	uint32_t stdindex_capacity,
+	int *stream_id_out
+);
+
+/// <summary>
+/// Tell the writer how many packets a stream will have, so the `indx` chunk is reserved big enough for a long OpenDML recording.
+/// Without it, `dwLength` of the stream header is used if the stream has no `dwSampleSize`, otherwise the biggest number of packets expected for the other streams, since an interleaved stream has about as many packets.
+/// An over-estimate only costs 16 bytes per extra `ix##` chunk in the header.
+/// </summary>
+/// <param name="w">Your `avi_writer`</param>
+/// <param name="stream_id">The stream index from `avi_writer_add_stream()`</param>
+/// <param name="num_packets">The expected number of packets</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_writer_set_expected_packets(avi_writer *w, int stream_id, uint32_t num_packets);
+
+/// <summary>
+/// Write the header chunks and start the `LIST movi` chunk.
+/// The `indx` chunk of each stream is reserved with one entry for every `stdindex_capacity` expected packets, plus `AVI_WRITER_MAX_SUPER_INDEX` entries.
+/// If a stream writes more `ix##` chunks than that, the writing goes on, but the packets of the extra `ix##` chunks are counted in `num_unindexed_packets` instead of being in the OpenDML index.
+/// `dwStreams`, `dwTotalFrames`, `dwSuggestedBufferSize` and `dwFlags` of the main header are filled by the writer.
+/// </summary>
+/// <param name="w">Your `avi_writer`</param>
+/// <param name="avih">The main header, `dwMicroSecPerFrame`, `dwWidth` and `dwHeight` are needed.</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_writer_begin(avi_writer *w, const avi_main_header *avih);
+
+/// <summary>
+/// Write a packet of a stream.
+/// </summary>
+/// <param name="w">Your `avi_writer`</param>
+/// <param name="stream_id">The stream index from `avi_writer_add_stream()`</param>
+/// <param name="data">The payload of the packet</param>
+/// <param name="len">The length of the payload</param>
+/// <param name="is_keyframe">Nonzero if the packet is a key frame. Audio packets are always key frames.</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_writer_write_packet(avi_writer *w, int stream_id, const void *data, uint32_t len, int is_keyframe);
+
+/// <summary>
+/// Write the remaining indices, flush the buffer and patch the headers. The file is complete after this.
+/// </summary>
+/// <param name="w">Your `avi_writer`</param>
+/// <returns>0 for fail, nonzero for success.</returns>
+AVI_FUNC int avi_writer_finish(avi_writer *w);
+
+#endif
@@ -0,0 +1,420 @@
+// Throughput benchmark of the conversion kernels, no AVI file needed.
+// Build it twice to compare the SIMD kernels with the portable loops, add `-mssse3` or `-mavx2` for the SSSE3 and AVX2 kernels:
+//   gcc -O2 -Iavi_read bench/avi_bench.c avi_read/avi_*.c -lm -o avi_bench
+//   gcc -O2 -DAVI_DISABLE_SIMD -Iavi_read bench/avi_bench.c avi_read/avi_*.c -lm -o avi_bench_scalar
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "avi_pixel.h"
+#include "avi_pcm.h"
+#include "avi_scale.h"
+#include "avi_resample.h"
+#include "avi_loudness.h"
+#include "avi_writer.h"
+
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+#define BENCH_PCM_FRAMES 48000
+#define BENCH_LOUDNESS_SECONDS 10
+#define BENCH_MIN_NS 500000000ull
+
+typedef void(*bench_cb)(void *userdata);
+
+static uint64_t bench_get_time_ns(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Run the kernel until at least `BENCH_MIN_NS` passed, then print the throughput of `bytes_per_call`: the source bytes, or the destination bytes of the palette lookups and the scaler.
+static void bench_run(const char *name, bench_cb f, void *userdata, size_t bytes_per_call)
+{
+	uint64_t start, elapsed;
+	uint64_t calls = 0;
+	f(userdata);
+	start = bench_get_time_ns();
+	do
+	{
+		f(userdata);
+		calls++;
+		elapsed = bench_get_time_ns() - start;
+	} while (elapsed < BENCH_MIN_NS);
+	printf("%-32s %10.1f MB/s\n", name, (double)bytes_per_call * (double)calls / ((double)elapsed / 1e9) / 1e6);
+}
+
+typedef struct
+{
+	uint8_t *src;
+	uint8_t *dst;
+	avi_pixel_format src_format;
+	avi_pixel_format dst_format;
+}bench_pixel;
+
+static void bench_pixel_convert(void *userdata)
+{
+	bench_pixel *b = userdata;
+	avi_pixel_convert(b->src, b->src_format, (size_t)BENCH_WIDTH * avi_pixel_get_bytes_per_pixel(b->src_format), 1,
+		b->dst, b->dst_format, (size_t)BENCH_WIDTH * avi_pixel_get_bytes_per_pixel(b->dst_format), BENCH_WIDTH, BENCH_HEIGHT);
+}
+
+static void bench_pixel_formats(uint8_t *src, uint8_t *dst)
+{
+	static const struct
+	{
+		const char *name;
+		avi_pixel_format src_format;
+		avi_pixel_format dst_format;
+	}cases[] =
+	{
+		{ "pixel BGRX8888 -> BGRA8888", AVI_PIXEL_BGRX8888, AVI_PIXEL_BGRA8888 },
+		{ "pixel BGRX8888 -> RGBA8888", AVI_PIXEL_BGRX8888, AVI_PIXEL_RGBA8888 },
+		{ "pixel BGRA8888 -> RGBA8888", AVI_PIXEL_BGRA8888, AVI_PIXEL_RGBA8888 },
+		{ "pixel BGR888 -> RGBA8888", AVI_PIXEL_BGR888, AVI_PIXEL_RGBA8888 },
+		{ "pixel RGB565 -> BGRA8888", AVI_PIXEL_RGB565, AVI_PIXEL_BGRA8888 },
+	};
+	for (size_t i = 0; i < sizeof cases / sizeof cases[0]; i++)
+	{
+		bench_pixel b = { src, dst, cases[i].src_format, cases[i].dst_format };
+		bench_run(cases[i].name, bench_pixel_convert, &b, (size_t)BENCH_WIDTH * BENCH_HEIGHT * avi_pixel_get_bytes_per_pixel(b.src_format));
+	}
+}
+
+typedef struct
+{
+	uint8_t *src;
+	uint8_t *dst;
+	uint32_t bit_count;
+	avi_pixel_lut lut;
+}bench_lut;
+
+static void bench_lut_expand(void *userdata)
+{
+	bench_lut *b = userdata;
+	avi_pixel_expand_indexed(b->src, b->bit_count, avi_pixel_get_dib_stride(BENCH_WIDTH, b->bit_count), 1,
+		b->dst, (size_t)BENCH_WIDTH * b->lut.bytes_per_pixel, BENCH_WIDTH, BENCH_HEIGHT, &b->lut);
+}
+
+static void bench_lut_formats(uint8_t *src, uint8_t *dst)
+{
+	static const struct
+	{
+		const char *name;
+		uint32_t bit_count;
+		avi_pixel_format format;
+	}cases[] =
+	{
+		{ "palette 8-bit -> BGRA8888", 8, AVI_PIXEL_BGRA8888 },
+		{ "palette 8-bit -> RGB565", 8, AVI_PIXEL_RGB565 },
+		{ "palette 4-bit -> BGRA8888", 4, AVI_PIXEL_BGRA8888 },
+		{ "palette 4-bit -> RGB565", 4, AVI_PIXEL_RGB565 },
+		{ "palette 4-bit -> INDEX8", 4, AVI_PIXEL_INDEX8 },
+		{ "palette 2-bit -> BGRA8888", 2, AVI_PIXEL_BGRA8888 },
+		{ "palette 1-bit -> BGRA8888", 1, AVI_PIXEL_BGRA8888 },
+	};
+	rgb_quad palette[256];
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		palette[i].B = (uint8_t)i;
+		palette[i].G = (uint8_t)(i * 3);
+		palette[i].R = (uint8_t)(255 - i);
+		palette[i].Reserved = 0;
+	}
+	for (size_t i = 0; i < sizeof cases / sizeof cases[0]; i++)
+	{
+		bench_lut b;
+		b.src = src;
+		b.dst = dst;
+		b.bit_count = cases[i].bit_count;
+		avi_pixel_lut_init(&b.lut, cases[i].format, palette, 256);
+		bench_run(cases[i].name, bench_lut_expand, &b, (size_t)BENCH_WIDTH * BENCH_HEIGHT * b.lut.bytes_per_pixel);
+	}
+}
+
+typedef struct
+{
+	uint8_t *src;
+	uint8_t *dst;
+	uint8_t *scratch;
+	avi_scale sc;
+}bench_scale;
+
+static void bench_scale_frame(void *userdata)
+{
+	bench_scale *b = userdata;
+	avi_scale_frame(&b->sc, b->src, b->dst, b->scratch, avi_scale_get_scratch_size(&b->sc));
+}
+
+static void bench_scale_formats(uint8_t *src, uint8_t *dst)
+{
+	static const struct
+	{
+		const char *name;
+		avi_pixel_format src_format;
+		uint32_t dst_width;
+		uint32_t dst_height;
+		avi_pixel_format dst_format;
+		avi_scale_filter filter;
+	}cases[] =
+	{
+		{ "scale nearest BGRA", AVI_PIXEL_BGRA8888, 1280, 720, AVI_PIXEL_BGRA8888, AVI_SCALE_NEAREST },
+		{ "scale nearest RGB565", AVI_PIXEL_RGB565, 800, 480, AVI_PIXEL_RGB565, AVI_SCALE_NEAREST },
+		{ "scale bilinear BGRA", AVI_PIXEL_BGRA8888, 1280, 720, AVI_PIXEL_BGRA8888, AVI_SCALE_BILINEAR },
+		{ "scale bilinear BGR -> RGB565", AVI_PIXEL_BGR888, 800, 480, AVI_PIXEL_RGB565, AVI_SCALE_BILINEAR },
+	};
+	palette_entry black = { 0, 0, 0, 255 };
+	for (size_t i = 0; i < sizeof cases / sizeof cases[0]; i++)
+	{
+		bench_scale b;
+		uint32_t dbpp = avi_pixel_get_bytes_per_pixel(cases[i].dst_format);
+		b.src = src;
+		b.dst = dst;
+		avi_scale_init(&b.sc, BENCH_WIDTH, BENCH_HEIGHT, cases[i].src_format, (size_t)BENCH_WIDTH * avi_pixel_get_bytes_per_pixel(cases[i].src_format), 1,
+			cases[i].dst_width, cases[i].dst_height, cases[i].dst_format, (size_t)cases[i].dst_width * dbpp, cases[i].filter, 1, black);
+		b.scratch = malloc(avi_scale_get_scratch_size(&b.sc));
+		if (!b.scratch) return;
+		bench_run(cases[i].name, bench_scale_frame, &b, (size_t)cases[i].dst_width * cases[i].dst_height * dbpp);
+		free(b.scratch);
+	}
+}
+
+typedef struct
+{
+	uint8_t *src;
+	uint8_t *dst;
+	avi_pcm_layout src_layout;
+	avi_pcm_layout dst_layout;
+}bench_pcm;
+
+static void bench_pcm_convert(void *userdata)
+{
+	bench_pcm *b = userdata;
+	avi_pcm_convert(b->src, b->src_layout, b->dst, b->dst_layout, BENCH_PCM_FRAMES);
+}
+
+static void bench_pcm_formats(uint8_t *src, uint8_t *dst)
+{
+	static const struct
+	{
+		const char *name;
+		avi_pcm_layout src_layout;
+		avi_pcm_layout dst_layout;
+	}cases[] =
+	{
+		{ "pcm s16 stereo -> f32 stereo", { AVI_PCM_S16, 2, 0 }, { AVI_PCM_F32, 2, 0 } },
+		{ "pcm s16 stereo -> s16 planar", { AVI_PCM_S16, 2, 0 }, { AVI_PCM_S16, 2, 1 } },
+		{ "pcm s16 5.1 -> s16 stereo", { AVI_PCM_S16, 6, 0 }, { AVI_PCM_S16, 2, 0 } },
+		{ "pcm s24 stereo -> s16 stereo", { AVI_PCM_S24, 2, 0 }, { AVI_PCM_S16, 2, 0 } },
+	};
+	for (size_t i = 0; i < sizeof cases / sizeof cases[0]; i++)
+	{
+		bench_pcm b = { src, dst, cases[i].src_layout, cases[i].dst_layout };
+		bench_run(cases[i].name, bench_pcm_convert, &b, (size_t)BENCH_PCM_FRAMES * b.src_layout.channels * avi_pcm_get_bytes_per_sample(b.src_layout.format));
+	}
+}
+
+typedef struct
+{
+	const int16_t *src;
+	avi_resample rs;
+}bench_resample;
+
+static void bench_resample_chunk(const int16_t *pcm, uint32_t num_frames, void *userdata)
+{
+	(void)pcm;
+	(void)num_frames;
+	(void)userdata;
+}
+
+static void bench_resample_process(void *userdata)
+{
+	bench_resample *b = userdata;
+	avi_resample_process(&b->rs, b->src, BENCH_PCM_FRAMES);
+}
+
+static void bench_resample_rates(uint8_t *src, uint8_t *dst)
+{
+	static const struct
+	{
+		const char *name;
+		uint32_t src_rate;
+		uint32_t dst_rate;
+		uint32_t channels;
+	}cases[] =
+	{
+		{ "resample 44100 -> 48000 stereo", 44100, 48000, 2 },
+		{ "resample 48000 -> 44100 stereo", 48000, 44100, 2 },
+		{ "resample 48000 -> 16000 mono", 48000, 16000, 1 },
+		{ "resample 44100 -> 48000 5.1", 44100, 48000, 6 },
+	};
+	static int16_t filter[AVI_RESAMPLE_MAX_PHASES * AVI_RESAMPLE_TAPS];
+	for (size_t i = 0; i < sizeof cases / sizeof cases[0]; i++)
+	{
+		bench_resample b;
+		b.src = (const int16_t *)src;
+		avi_resample_init(&b.rs, cases[i].src_rate, cases[i].dst_rate, cases[i].channels, filter, sizeof filter / sizeof filter[0],
+			(int16_t *)dst, 1024, bench_resample_chunk, NULL);
+		bench_run(cases[i].name, bench_resample_process, &b, (size_t)BENCH_PCM_FRAMES * cases[i].channels * sizeof(int16_t));
+	}
+}
+
+// The AVI file in memory, for the kernels that read a stream.
+typedef struct
+{
+	uint8_t *data;
+	size_t size;
+	size_t capacity;
+	size_t pos;
+}bench_file;
+
+static fssize_t bench_file_write(const void *buffer, size_t len, void *userdata)
+{
+	bench_file *f = userdata;
+	if (f->pos + len > f->capacity) return -1;
+	memcpy(&f->data[f->pos], buffer, len);
+	f->pos += len;
+	if (f->pos > f->size) f->size = f->pos;
+	return (fssize_t)len;
+}
+
+static fssize_t bench_file_read(void *buffer, size_t len, void *userdata)
+{
+	bench_file *f = userdata;
+	if (len > f->size - f->pos) len = f->size - f->pos;
+	memcpy(buffer, &f->data[f->pos], len);
+	f->pos += len;
+	return (fssize_t)len;
+}
+
+static fssize_t bench_file_seek(fsize_t offset, void *userdata)
+{
+	bench_file *f = userdata;
+	if (offset > f->size) return -1;
+	f->pos = (size_t)offset;
+	return (fssize_t)offset;
+}
+
+static fssize_t bench_file_tell(void *userdata)
+{
+	bench_file *f = userdata;
+	return (fssize_t)f->pos;
+}
+
+// Write `BENCH_LOUDNESS_SECONDS` of 16-bit stereo PCM at 48000 Hz into an AVI file in memory, 100 ms per packet.
+static int bench_make_pcm_avi(bench_file *f, const uint8_t *pcm)
+{
+	static avi_index_entry idx1[BENCH_LOUDNESS_SECONDS * 10 + 1];
+	static avi_stdindex_entry stdindex[BENCH_LOUDNESS_SECONDS * 10 + 1];
+	avi_writer w;
+	avi_stream_header sh;
+	avi_main_header avih;
+	wave_format_ex wf;
+	uint32_t packet_len = 4800 * 4;
+	int stream_id;
+
+	memset(&sh, 0, sizeof sh);
+	memcpy(&sh.fccType, "auds", 4);
+	sh.dwScale = 1;
+	sh.dwRate = 48000;
+	sh.dwSampleSize = 4;
+	memset(&wf, 0, sizeof wf);
+	wf.wFormatTag = 1;
+	wf.nChannels = 2;
+	wf.nSamplesPerSec = 48000;
+	wf.nAvgBytesPerSec = 48000 * 4;
+	wf.nBlockAlign = 4;
+	wf.wBitsPerSample = 16;
+	memset(&avih, 0, sizeof avih);
+	avih.dwMicroSecPerFrame = 100000;
+	avih.dwWidth = 1;
+	avih.dwHeight = 1;
+
+	if (!avi_writer_init(&w, f, bench_file_write, bench_file_seek, NULL, 0, idx1, BENCH_LOUDNESS_SECONDS * 10 + 1, 0)) return 0;
+	if (!avi_writer_add_stream(&w, &sh, &wf, sizeof wf, NULL, stdindex, BENCH_LOUDNESS_SECONDS * 10 + 1, &stream_id)) return 0;
+	if (!avi_writer_begin(&w, &avih)) return 0;
+	for (uint32_t i = 0; i < BENCH_LOUDNESS_SECONDS * 10; i++)
+	{
+		if (!avi_writer_write_packet(&w, stream_id, &pcm[(size_t)i * packet_len], packet_len, 1)) return 0;
+	}
+	return avi_writer_finish(&w);
+}
+
+typedef struct
+{
+	avi_stream_reader *s;
+	avi_loudness *lz;
+	double *energies;
+	uint64_t num_energies;
+	uint8_t *buffer;
+	size_t buffer_size;
+}bench_loudness;
+
+static void bench_loudness_scan(void *userdata)
+{
+	bench_loudness *b = userdata;
+	avi_loudness_init(b->lz, b->s, b->energies, b->num_energies);
+	avi_loudness_scan(b->lz, b->s, b->buffer, b->buffer_size);
+}
+
+static void bench_loudness_stream(uint8_t *src, uint8_t *dst)
+{
+	static avi_reader r;
+	static avi_stream_reader s;
+	static avi_loudness lz;
+	bench_file f;
+	bench_loudness b;
+	f.capacity = (size_t)BENCH_LOUDNESS_SECONDS * 48000 * 4 + 65536;
+	f.data = malloc(f.capacity);
+	f.size = 0;
+	f.pos = 0;
+	if (!f.data) return;
+	if (bench_make_pcm_avi(&f, src) &&
+		bench_file_seek(0, &f) == 0 &&
+		avi_reader_init(&r, &f, bench_file_read, bench_file_seek, bench_file_tell, NULL, PRINT_NOTHING) &&
+		avi_get_stream_reader(&r, &f, 0, NULL, NULL, NULL, NULL, &s))
+	{
+		b.s = &s;
+		b.lz = &lz;
+		b.num_energies = avi_loudness_get_num_energies(&s);
+		b.energies = malloc((size_t)b.num_energies * sizeof b.energies[0]);
+		b.buffer = dst;
+		b.buffer_size = 65536;
+		if (b.energies)
+		{
+			bench_run("loudness s16 stereo", bench_loudness_scan, &b, (size_t)BENCH_LOUDNESS_SECONDS * 48000 * 4);
+			free(b.energies);
+		}
+	}
+	free(f.data);
+}
+
+int main(void)
+{
+	size_t size = (size_t)BENCH_WIDTH * BENCH_HEIGHT * 4;
+	uint8_t *src = malloc(size);
+	uint8_t *dst = malloc(size);
+	if (!src || !dst) return 1;
+	for (size_t i = 0; i < size; i++) src[i] = (uint8_t)(i * 7 + (i >> 8));
+
+#if defined(AVI_USE_AVX2)
+	printf("SSE2, SSSE3 and AVX2 kernels enabled\n");
+#elif defined(AVI_USE_SSSE3)
+	printf("SSE2 and SSSE3 kernels enabled\n");
+#elif defined(AVI_USE_SSE2)
+	printf("SSE2 kernels enabled\n");
+#else
+	printf("Portable loops only\n");
+#endif
+	bench_pixel_formats(src, dst);
+	bench_lut_formats(src, dst);
+	bench_scale_formats(src, dst);
+	bench_pcm_formats(src, dst);
+	bench_resample_rates(src, dst);
+	bench_loudness_stream(src, dst);
+
+	free(src);
+	free(dst);
+	return 0;
+}